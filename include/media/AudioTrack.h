@@ -353,6 +353,35 @@ public:
      */
             void        pause();
 
+    /* Sample accurate start, stop and volume changes, mostly used by games and rhythm
+     * applications.  The mixer applies them within a mix buffer, at the frame presented at
+     * the given CLOCK_MONOTONIC time in nanoseconds, or at the given playback head position
+     * (as returned by getPosition()) if atPosition is true.  A scheduled stop or volume change
+     * is lost if the track is restored after the output device changes.
+     *
+     * scheduleStart() starts the track as start(), and its first frame is presented at
+     * startTimeNs, at most 10 seconds ahead; the output keeps running until then.  pause(),
+     * flush() and stop() cancel the scheduled start.
+     * scheduleStop() stops the track as stop(), except that the frames after the stop are not
+     * played; the application must still call stop() before starting the track again, and
+     * flush() to discard the remaining frames of a streaming track.  From the stop on, write()
+     * no longer blocks once the buffer is full: it returns WOULD_BLOCK instead, and the callback
+     * thread no longer asks for data nor reports events until the track is started again.
+     * scheduleVolume() sets the volume as setVolume() would at the given frame.
+     * A new schedule replaces a pending one of the same kind; stop() cancels a pending start
+     * or stop.
+     *
+     * Returned status (from utils/Errors.h) can be:
+     *  - NO_ERROR: successful operation
+     *  - BAD_VALUE: invalid volume, or start time too far ahead
+     *  - INVALID_OPERATION: the track is active (scheduleStart()), or is a fast, direct or
+     *    offloaded track
+     */
+            status_t    scheduleStart(int64_t startTimeNs);
+            status_t    scheduleStop(int64_t when, bool atPosition = false);
+            status_t    scheduleVolume(float left, float right, int64_t when,
+                                       bool atPosition = false);
+
     /* Set volume for this track, mostly used for games' sound effects
      * left and right volumes. Levels must be >= 0.0 and <= 1.0.
      * This is the older API.  New applications should use setVolume(float) when possible.
@@ -775,6 +804,9 @@ protected:
 
             status_t createTrack_l();
 
+            // can only be called when mState != STATE_ACTIVE
+            status_t start_l();
+
             // can only be called when mState != STATE_ACTIVE
             void flush_l();
 
@@ -800,6 +832,10 @@ protected:
             // increment mPosition by the delta of mServer, and return new value of mPosition
             uint32_t updateAndGetPosition_l();
 
+            // schedule an action of the mixer, see IAudioTrack::scheduleAction()
+            status_t scheduleAction_l(int action, bool atPosition, int64_t when,
+                                      float left, float right);
+
             // check sample rate and speed is compatible with AudioTrack
             bool     isSampleRateSpeedAllowed_l(uint32_t sampleRate, float speed) const;
 
@@ -904,6 +940,9 @@ protected:
                                                     // and could be easily widened to uint64_t
     int64_t                 mStartUs;               // the start time after flush or stop.
                                                     // only used for offloaded and direct tracks.
+    int64_t                 mScheduledStartNs;      // the time of the start scheduled by
+                                                    // scheduleStart(), sent again to a restored
+                                                    // IAudioTrack, or 0 once cancelled.
 
     bool                    mPreviousTimestampValid;// true if mPreviousTimestamp is valid
     bool                    mTimestampStartupGlitchReported; // reduce log spam
@@ -93,6 +93,30 @@ public:
 
     /* Signal the playback thread for a change in control block */
     virtual void        signal() = 0;
+
+    /* Actions that can be scheduled by scheduleAction() */
+    enum {
+        SCHEDULE_START,     // scheduled before start(): the track starts playing at 'when'
+        SCHEDULE_STOP,      // the track stops, and the frames after 'when' are not played
+        SCHEDULE_VOLUME,    // the volume of the track becomes left and right at 'when'
+    };
+
+    /* Schedule an action of the mixer on the track.  If atPosition is false, 'when' is the
+     * CLOCK_MONOTONIC time in nanoseconds at which the action takes effect at the output,
+     * otherwise it is the server position of the track in frames, as in AudioTimestamp.
+     * SCHEDULE_START can only be scheduled at a time, at most kMaxScheduledStartDelayNs
+     * ahead, on a track that is not active; pause(), flush() and stop() cancel it.  The action
+     * is applied within a mix buffer, at the frame it is scheduled for.  An action replaces
+     * any action of the same kind that is still pending, and a 'when' of
+     * kCancelScheduledAction only cancels it.  Once a scheduled stop is reached, the client
+     * no longer waits for room to write.  Returns INVALID_OPERATION for tracks not played by
+     * a normal mixer: fast, direct, offloaded and timed tracks.
+     */
+    static const int64_t kMaxScheduledStartDelayNs = 10000000000LL;  // 10 s
+    static const int64_t kCancelScheduledAction = -1;
+
+    virtual status_t    scheduleAction(int action, bool atPosition, int64_t when,
+                                       float left, float right) = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -22,12 +22,14 @@
 #include <binder/IMemory.h>
 #include <utils/Mutex.h>
 #include <audio_utils/roundup.h>
+#include <media/nbaio/NBLogFormat.h>
 
 namespace android {
 
 class String8;
 
-class NBLog {
+// The events and the binary event formats are defined by NBLogFormat
+class NBLog : public NBLogFormat {
 
 public:
 
@@ -36,12 +38,6 @@ class Reader;
 
 private:
 
-enum Event {
-    EVENT_RESERVED,
-    EVENT_STRING,               // ASCII string, not NUL-terminated
-    EVENT_TIMESTAMP,            // clock_gettime(CLOCK_MONOTONIC)
-};
-
 // ---------------------------------------------------------------------------
 
 // representation of a single log entry in private memory
@@ -50,7 +46,11 @@ struct Entry {
         : mEvent(event), mLength(length), mData(data) { }
     /*virtual*/ ~Entry() { }
 
-    int     readAt(size_t offset) const;
+    // Copies the shared memory representation of the entry to buffer,
+    // which must hold kMaxEntrySize bytes, and returns its size
+    size_t  copyTo(uint8_t *buffer) const;
+
+    static const size_t kMaxEntrySize = 255 + 3;
 
 private:
     friend class Writer;
@@ -128,6 +128,22 @@ public:
     virtual void    logTimestamp();
     virtual void    logTimestamp(const struct timespec& ts);
 
+    // Binary events, which are formatted only when the log is dumped.
+    // They cost about as much as logging a timestamp, so they can be used on fast paths.
+    virtual void    logFormatv(Format format, const Arg *args, size_t count);
+            void    logFormat(Format format)
+                        { logFormatv(format, NULL, 0); }
+            void    logFormat(Format format, Arg a0)
+                        { logFormatv(format, &a0, 1); }
+            void    logFormat(Format format, Arg a0, Arg a1)
+                        { const Arg args[] = {a0, a1}; logFormatv(format, args, 2); }
+            void    logFormat(Format format, Arg a0, Arg a1, Arg a2)
+                        { const Arg args[] = {a0, a1, a2}; logFormatv(format, args, 3); }
+            void    logFormat(Format format, Arg a0, Arg a1, Arg a2, Arg a3)
+                        { const Arg args[] = {a0, a1, a2, a3}; logFormatv(format, args, 4); }
+            void    logFormat(Format format, Arg a0, Arg a1, Arg a2, Arg a3, Arg a4)
+                        { const Arg args[] = {a0, a1, a2, a3, a4}; logFormatv(format, args, 5); }
+
     virtual bool    isEnabled() const;
 
     // return value for all of these is the previous isEnabled()
@@ -161,6 +177,7 @@ public:
     virtual void    logvf(const char *fmt, va_list ap);
     virtual void    logTimestamp();
     virtual void    logTimestamp(const struct timespec& ts);
+    virtual void    logFormatv(Format format, const Arg *args, size_t count);
 
     virtual bool    isEnabled() const;
     virtual bool    setEnabled(bool enabled);
@@ -182,6 +199,10 @@ public:
     virtual ~Reader() { }
 
     void    dump(int fd, size_t indent = 0);
+    // Writes the entries as a NBLogFormat::RawDumpHeader named name, followed by the entries
+    // in shared memory representation, for decoding later by the nblog-decode host tool.
+    // Like dump(), consumes the entries.
+    void    dumpRaw(int fd, const char *name);
     bool    isIMemory(const sp<IMemory>& iMemory) const;
 
 private:
@@ -193,6 +214,10 @@ private:
     int     mIndent;            // indentation level
 
     void    dumpLine(const String8& timestamp, String8& body);
+    // Returns a copy of the entries written since the previous call, to delete[] by the caller,
+    // or NULL if there are none.  The complete entries are from offset *start to *end,
+    // *lost is the number of bytes of entries lost before them.
+    uint8_t *copyEntries(size_t *start, size_t *end, size_t *lost);
 
     static const size_t kSquashTimestamp = 5; // squash this many or more adjacent timestamps
 };
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Binary event format of NBLog, shared with the host side decoder
+
+#ifndef ANDROID_MEDIA_NBLOG_FORMAT_H
+#define ANDROID_MEDIA_NBLOG_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// The format strings of binary events, by ID.  The ID is what is logged, so that the fast
+// path never formats text.  Decoders of old dumps rely on the IDs, so only ever append to
+// this list, and do not change the meaning of the arguments of an existing entry.
+// The conversions of a format string are matched in order with the logged arguments.
+#define NBLOG_FORMATS(F) \
+    F(FORMAT_UNDERRUN,          "underrun: %u us since last cycle") \
+    F(FORMAT_OVERRUN,           "overrun: %u us since last cycle") \
+    F(FORMAT_WARMUP,            "warmup: done after %u cycles in %u us") \
+    F(FORMAT_MIXER_STATE,       "fast mixer: %u fast tracks (%#x), %u frames") \
+    F(FORMAT_MIXER_WRITE_ERROR, "fast mixer: write error %d for %u frames") \
+    F(FORMAT_CAPTURE_STATE,     "fast capture: %u Hz, %u frames") \
+    F(FORMAT_CAPTURE_READ_ERROR, "fast capture: read error %d for %u frames") \
+    F(FORMAT_CAPTURE_SHORT_WRITE, "fast capture: pipe write %d of %u frames") \
+    F(FORMAT_MIXER_CONFIG,      "mixer: %d active tracks (%#x) resampling=%d volumeRamp=%d " \
+                                "parallel=%d")
+
+// NBLogFormat is the part of NBLog that does not depend on the platform,
+// so that logs can be decoded on the host.
+class NBLogFormat {
+
+public:
+
+enum Event {
+    EVENT_RESERVED,
+    EVENT_STRING,               // ASCII string, not NUL-terminated
+    EVENT_TIMESTAMP,            // clock_gettime(CLOCK_MONOTONIC)
+    EVENT_FORMAT,               // format ID and typed arguments, see encode()
+};
+
+#define NBLOG_FORMAT_ID(id, string) id,
+enum Format {
+    NBLOG_FORMATS(NBLOG_FORMAT_ID)
+    FORMAT_COUNT
+};
+#undef NBLOG_FORMAT_ID
+
+// The argument types are ASCII letters, to make raw dumps easier to read
+enum Type {
+    TYPE_INT32      = 'i',
+    TYPE_UINT32     = 'u',
+    TYPE_INT64      = 'l',
+    TYPE_FLOAT      = 'f',
+    TYPE_POINTER    = 'p',      // logged as 64 bits
+};
+
+// An argument of a binary event, which is typed by overload resolution
+struct Arg {
+    Arg(int32_t value) : mType(TYPE_INT32) { mValue.i32 = value; }
+    Arg(uint32_t value) : mType(TYPE_UINT32) { mValue.u32 = value; }
+    Arg(int64_t value) : mType(TYPE_INT64) { mValue.i64 = value; }
+    Arg(float value) : mType(TYPE_FLOAT) { mValue.f = value; }
+    Arg(const void *value) : mType(TYPE_POINTER) { mValue.i64 = (uintptr_t) value; }
+
+    Type    mType;
+    union {
+        int32_t     i32;
+        uint32_t    u32;
+        int64_t     i64;
+        float       f;
+    } mValue;
+};
+
+static const size_t kMaxArgs = 6;
+
+// Longest EVENT_FORMAT data: format ID, then a type byte and the value for each argument
+static const size_t kMaxFormatLength = sizeof(uint16_t) + kMaxArgs * (1 + sizeof(int64_t));
+
+// Encodes an EVENT_FORMAT in data, which must hold kMaxFormatLength bytes,
+// and returns its length.  Arguments after kMaxArgs are dropped.
+static size_t encode(uint8_t *data, Format format, const Arg *args, size_t count);
+
+// Decodes the data of an EVENT_FORMAT into buffer, always NUL-terminated if size > 0.
+// Unknown formats and malformed data are decoded as a warning.
+// Returns the length of the text, which is truncated to size - 1.
+static size_t decode(char *buffer, size_t size, const uint8_t *data, size_t length);
+
+// Returns the format string of a format ID, or NULL if it is unknown
+static const char *formatString(unsigned format);
+
+// Header of each log in a raw dump, as written by NBLog::Reader::dumpRaw():
+// the header, the name of the log, then the entries in shared memory representation.
+struct RawDumpHeader {
+    static const uint32_t kMagic = 0x524c424e;  // "NBLR"
+    static const uint32_t kVersion = 1;
+
+    uint32_t    mMagic;
+    uint32_t    mVersion;
+    uint32_t    mNameLength;    // not NUL-terminated
+    uint32_t    mLength;        // of the entries, which start and end on an entry boundary
+    uint32_t    mLost;          // bytes of entries lost before the first one
+    uint32_t    mTimestampSize; // sizeof(struct timespec) of the writer
+};
+
+};  // class NBLogFormat
+
+}   // namespace android
+
+#endif  // ANDROID_MEDIA_NBLOG_FORMAT_H
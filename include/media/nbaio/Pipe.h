@@ -24,11 +24,16 @@ namespace android {
 // Pipe is multi-thread safe for readers (see PipeReader), but safe for only a single writer thread.
 // It cannot UNDERRUN on write, unless we allow designation of a master reader that provides the
 // time-base. Readers can be added and removed dynamically, and it's OK to have no readers.
+// By default readers do not hold back the writer and overrun if they fall behind, but up to
+// kMaxBlockingReaders can use the PipeReader::BLOCKING policy instead.
+// Each write is timestamped, so that readers can account for their latency.
 class Pipe : public NBAIO_Sink {
 
     friend class PipeReader;
 
 public:
+    static const size_t kMaxBlockingReaders = 4;
+
     // maxFrames will be rounded up to a power of 2, and all slots are available. Must be >= 2.
     // buffer is an optional parameter specifying the virtual address of the pipe buffer,
     // which must be of size roundup(maxFrames) * Format_frameSize(format) bytes.
@@ -49,19 +54,35 @@ public:
     //virtual size_t framesUnderrun() const;
     //virtual size_t underruns() const;
 
-    // The write side of a pipe permits overruns; flow control is the caller's responsibility.
-    // It doesn't return +infinity because that would guarantee an overrun.
-    virtual ssize_t availableToWrite() const { return mMaxFrames; }
+    // The write side of a pipe permits overruns of non-blocking readers; flow control is the
+    // caller's responsibility.  It doesn't return +infinity because that would guarantee an overrun.
+    // With blocking readers, returns the room left by the one furthest behind.
+    virtual ssize_t availableToWrite() const;
 
+    // Writes at most availableToWrite() frames, and never blocks the calling thread.
     virtual ssize_t write(const void *buffer, size_t count);
     //virtual ssize_t writeVia(writeVia_t via, size_t total, void *user, size_t block);
 
+    // Number of frames of the pipe buffer; a reader overruns if the writer gets more ahead.
+    size_t maxFrames() const { return mMaxFrames; }
+
 private:
     const size_t    mMaxFrames;     // always a power of 2
     void * const    mBuffer;
     volatile int32_t mRear;         // written by android_atomic_release_store
     volatile int32_t mReaders;      // number of PipeReader clients currently attached to this Pipe
     const bool      mFreeBufferInDestructor;
+
+    // Blocking readers: mBlockingReaders is a bit mask of the slots of mBlockingFronts in use,
+    // each holding the mFront of a blocking reader.  Changed by android_atomic_cmpxchg.
+    volatile int32_t mBlockingReaders;
+    volatile int32_t mBlockingFronts[kMaxBlockingReaders];
+
+    // The latest write, see PipeReader::getTimestamp().  mWriteSequence is odd while the write
+    // position and time are being updated, like a SingleStateQueue but with many observers.
+    volatile int32_t mWriteSequence;
+    int32_t         mWritePosition; // mRear after the write
+    int64_t         mWriteTimeNs;   // CLOCK_MONOTONIC time at the end of the write
 };
 
 }   // namespace android
@@ -21,14 +21,26 @@
 
 namespace android {
 
-// PipeReader is safe for only a single thread
+// PipeReader is safe for only a single thread, except for framesUnread(), getStats()
+// and getTimestamp()
 class PipeReader : public NBAIO_Source {
 
 public:
 
-    // Construct a PipeReader and associate it with a Pipe
+    enum Policy {
+        // The writer does not wait for this reader, which loses the oldest frames (overruns)
+        // when it falls behind by more than the pipe size.
+        NON_BLOCKING,
+        // The writer does not overwrite frames this reader has not read yet: Pipe::write() is
+        // limited by the blocking reader furthest behind.  A blocking reader that stops reading
+        // stops the writer, so it must keep up with it, e.g. by running on the same clock.
+        BLOCKING,
+    };
+
+    // Construct a PipeReader and associate it with a Pipe.  If the pipe already has
+    // Pipe::kMaxBlockingReaders blocking readers, a BLOCKING reader is NON_BLOCKING instead.
     // FIXME make this constructor a factory method of Pipe.
-    PipeReader(Pipe& pipe);
+    PipeReader(Pipe& pipe, Policy policy = NON_BLOCKING);
     virtual ~PipeReader();
 
     // NBAIO_Port interface
@@ -49,15 +61,61 @@ public:
 
     // NBAIO_Source end
 
+    // Zero-copy alternative to read(), for a reader that consumes the frames in place.
+    // Sets *buffer to the address in the pipe of the next frames, and returns the number of
+    // contiguous frames there, at most count, or a negative status as availableToRead().
+    // The frames must not be modified, as other readers share them.  They stay valid until
+    // release() only if the writer does not get more than the pipe size ahead of this reader.
+    ssize_t obtain(void **buffer, size_t count);
+
+    // Consumes count frames previously returned by obtain().
+    void    release(size_t count);
+
+    // Number of frames written to the pipe but not yet read, which is more than the pipe size
+    // after an overrun.  May be called from any thread, e.g. by the writer for flow control.
+    size_t  framesUnread() const;
+
+    Policy  policy() const { return mBlockingSlot >= 0 ? BLOCKING : NON_BLOCKING; }
+
+    // Sets timestamp to the latest write to the pipe: mTime is the CLOCK_MONOTONIC time at
+    // the end of the write, and mPosition the position just after the frames written, counted
+    // like framesRead(), so that (mPosition - framesRead()) of them are still unread.
+    // Returns INVALID_OPERATION if nothing was written to the pipe yet.
+    status_t getTimestamp(AudioTimestamp& timestamp) const;
+
+    // Statistics of the reader.  They are updated by the reading thread without barrier,
+    // so a copy taken from another thread may be slightly inconsistent.
+    struct Stats {
+        size_t  mFramesRead;
+        size_t  mFramesUnread;      // fill level when the copy was taken
+        size_t  mFramesOverrun;     // frames lost to overruns
+        size_t  mOverruns;
+        // How long the oldest frame read had been in the pipe, at the latest read, estimated
+        // from the write timestamps and the sample rate; -1 if not known yet.
+        int64_t mLatencyNs;
+        int64_t mMaxLatencyNs;      // highest mLatencyNs, -1 if not known yet
+    };
+    void    getStats(Stats *stats) const;
+
 #if 0   // until necessary
     Pipe& pipe() const { return mPipe; }
 #endif
 
 private:
+    // Updates mFront, and the copy of it the writer reads for a blocking reader.
+    void    setFront(int32_t front);
+    // Updates the latency statistics when reading frames from front on.
+    void    updateLatency(int32_t front);
+    // Reads the latest write to the pipe, returns false if there was none.
+    bool    getLatestWrite(int32_t *position, int64_t *timeNs) const;
+
     Pipe&       mPipe;
-    int32_t     mFront;         // follows behind mPipe.mRear
+    volatile int32_t mFront;    // follows behind mPipe.mRear, written by android_atomic_release_store
     size_t      mFramesOverrun;
     size_t      mOverruns;
+    int         mBlockingSlot;  // index in mPipe.mBlockingFronts, or -1 if NON_BLOCKING
+    int64_t     mLatencyNs;
+    int64_t     mMaxLatencyNs;
 };
 
 }   // namespace android
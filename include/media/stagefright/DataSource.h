@@ -65,7 +65,23 @@ public:
     // beyond, the end of the source.
     virtual ssize_t readAt(off64_t offset, void *data, size_t size) = 0;
 
+    // Zero copy read: if the source holds its content in memory, sets *data to
+    // its bytes at the given offset and returns how many of the size bytes
+    // requested are there, which may be fewer at the end of the source.  The
+    // bytes remain valid for the lifetime of the source.  Returns
+    // ERROR_UNSUPPORTED if the source cannot lend its bytes, use readAt() then.
+    virtual ssize_t borrowAt(
+            off64_t /* offset */, size_t /* size */, const void ** /* data */) {
+        return ERROR_UNSUPPORTED;
+    }
+
     // Convenience methods:
+    // Borrows the bytes at the given offset if the source can lend them, or
+    // else reads them into scratch, which must hold size bytes. Sets *data to
+    // the bytes in either case, and returns the number of bytes as readAt().
+    ssize_t readOrBorrowAt(
+            off64_t offset, size_t size, void *scratch, const void **data);
+
     bool getUInt16(off64_t offset, uint16_t *x);
     bool getUInt24(off64_t offset, uint32_t *x); // 3 byte int, returned as a 32-bit int
     bool getUInt32(off64_t offset, uint32_t *x);
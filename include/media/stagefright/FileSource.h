@@ -37,6 +37,8 @@ public:
 
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
 
+    virtual ssize_t borrowAt(off64_t offset, size_t size, const void **data);
+
     virtual status_t getSize(off64_t *size);
 
     virtual sp<DecryptHandle> DrmInitialization(const char *mime);
@@ -50,8 +52,19 @@ private:
     int mFd;
     int64_t mOffset;
     int64_t mLength;
+    // Only serializes DRM reads, other reads use pread() or the mapping
     Mutex mLock;
 
+    // If mapped, the start of the content and how many of its bytes are in
+    // the mapping, which ends at the end of the file if the content is
+    // truncated.  Reads beyond fall back to pread().
+    void *mMapping;
+    size_t mMappingSize;
+    const uint8_t *mMappedData;
+    size_t mMappedSize;
+
+    void map();
+
     /*for DRM*/
     sp<DecryptHandle> mDecryptHandle;
     DrmManagerClient *mDrmManagerClient;
@@ -31,6 +31,21 @@ namespace android {
 struct AAtomizer {
     static const char *Atomize(const char *name);
 
+    // Returns the hash of the string, and its length if len is not NULL.
+    static inline uint32_t Hash(const char *s, size_t *len = NULL) {
+        uint32_t sum = 0;
+        const char *p = s;
+        while (*p != '\0') {
+            sum = (sum * 31) + *p;
+            ++p;
+        }
+
+        if (len != NULL) {
+            *len = p - s;
+        }
+        return sum;
+    }
+
 private:
     static AAtomizer gAtomizer;
 
@@ -41,8 +56,6 @@ private:
 
     const char *atomize(const char *name);
 
-    static uint32_t Hash(const char *s);
-
     DISALLOW_EVIL_CONSTRUCTORS(AAtomizer);
 };
 
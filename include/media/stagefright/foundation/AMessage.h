@@ -62,6 +62,12 @@ struct AMessage : public RefBase {
     AMessage();
     AMessage(uint32_t what, const sp<const AHandler> &handler);
 
+    // Reserves room for numItems items up front, rounded up to a power of
+    // two, for the messages of a known size such as those sent for each
+    // buffer: they allocate no more room than they use, nor grow it. The room
+    // otherwise starts at kMinNumItems items and grows as items are set.
+    AMessage(uint32_t what, const sp<const AHandler> &handler, size_t numItems);
+
     static sp<AMessage> FromParcel(const Parcel &parcel);
     void writeToParcel(Parcel *parcel) const;
 
@@ -176,17 +182,34 @@ private:
             AString *stringValue;
             Rect rectValue;
         } u;
-        const char *mName;
+        enum {
+            kMaxInlineNameLength = 23,
+        };
+        // The name is copied into mInlineName if it fits, which moves along
+        // with the item, or else into mNameCopy.
+        char       *mNameCopy;
         size_t      mNameLength;
+        uint32_t    mNameHash;
         Type mType;
-        void setName(const char *name, size_t len);
+        char        mInlineName[kMaxInlineNameLength + 1];
+        const char *name() const {
+            return mNameCopy != NULL ? mNameCopy : mInlineName;
+        }
+        void setName(const char *name, size_t len, uint32_t hash);
+        void freeName();
     };
 
     enum {
-        kMaxNumItems = 64
+        kMaxNumItems = 64,
+        kMinNumItems = 8,
     };
-    Item mItems[kMaxNumItems];
+    // The items, followed by an open addressing index of them by name hash,
+    // with twice as many slots as mMaxNumItems. A slot holds the index of an
+    // item plus 1, or 0 if free.
+    Item *mItems;
+    uint8_t *mIndex;
     size_t mNumItems;
+    size_t mMaxNumItems;
 
     Item *allocateItem(const char *name);
     void freeItemValue(Item *item);
@@ -195,7 +218,11 @@ private:
     void setObjectInternal(
             const char *name, const sp<RefBase> &obj, Type type);
 
-    size_t findItemIndex(const char *name, size_t len) const;
+    size_t findItemIndex(const char *name, size_t len, uint32_t hash) const;
+
+    // Grows the room to the power of two at least numItems, and minNumItems.
+    void reserve(size_t numItems, size_t minNumItems = kMinNumItems);
+    void indexItem(size_t index);
 
     void deliver();
 
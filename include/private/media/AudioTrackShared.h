@@ -47,6 +47,8 @@ namespace android {
 #define CBLK_OVERRUN   0x100 // set by server immediately on input overrun, cleared by client
 #define CBLK_INTERRUPT 0x200 // set by client on interrupt(), cleared by client in obtainBuffer()
 #define CBLK_STREAM_END_DONE 0x400 // set by server on render completion, cleared by client
+#define CBLK_STOPPED   0x800 // set by server when it stops an output track on its own, at a
+                             // scheduled stop, cleared by server when the track restarts
 
 //EL_FIXME 20 seconds may not be enough and must be reconciled with new obtainBuffer implementation
 #define MAX_RUN_OFFLOADED_TIMEOUT_MS 20000 // assuming up to a maximum of 20 seconds of offloaded
@@ -461,9 +463,43 @@ public:
     //  buffer->mRaw is NULL.
     virtual void        releaseBuffer(Buffer* buffer);
 
+    // Deferred client wakeups.  By default releaseBuffer() wakes the client as soon as enough
+    // frames are available to it.  When deferred, releaseBuffer() only records that a wakeup
+    // is pending, and the caller issues it later with flushWake(), so that the wakeups of all
+    // the tracks of a mix cycle can be issued together after the cycle.  A pending wakeup is
+    // then also held back until minIntervalNs has elapsed since the previous one, unless the
+    // frames left to the server are running low.
+    // Not multi-thread safe; must be called by the same thread as releaseBuffer().
+    void        setDeferWake(bool defer, int64_t minIntervalNs = 0);
+
+    // Issue the pending client wakeup, if any and allowed at time now (CLOCK_MONOTONIC).
+    // force issues it regardless of minIntervalNs, for a track that is no longer mixed and so
+    // would not be flushed again.  Returns true if the client was woken.
+    bool        flushWake(int64_t now, bool force = false);
+
+    // Set when the server stops the track on its own, as at a scheduled stop, so that the
+    // client stops waiting for room to write, and cleared when the track restarts.
+    void        setStopped(bool stopped);
+
+    // Total number of client wakeups issued, and of deferred wakeups coalesced into a later one
+    uint32_t    getWakeCount() const { return mWakeCount; }
+    uint32_t    getCoalescedWakeCount() const { return mCoalescedWakeCount; }
+
 protected:
+    // Wake the client if it is waiting
+    void        wakeClient();
+
     size_t      mAvailToClient; // estimated frames available to client prior to releaseBuffer()
     int32_t     mFlush;         // our copy of cblk->u.mStreaming.mFlush, for streaming output only
+
+private:
+    bool        mDeferWake;
+    bool        mWakePending;       // a deferred wakeup is waiting for flushWake()
+    bool        mWakeUrgent;        // the pending wakeup ignores mMinWakeIntervalNs
+    int64_t     mMinWakeIntervalNs;
+    int64_t     mLastWakeNs;        // time of the last wakeup issued by flushWake()
+    uint32_t    mWakeCount;
+    uint32_t    mCoalescedWakeCount;
 };
 
 // Proxy used by AudioFlinger for servicing AudioTrack
@@ -486,6 +486,7 @@ status_t AudioTrack::set(
     mPosition = 0;
     mReleased = 0;
     mStartUs = 0;
+    mScheduledStartNs = 0;
     AudioSystem::acquireAudioSessionId(mSessionId, mClientPid);
     mSequence = 1;
     mObservedSequence = mSequence;
@@ -506,7 +507,12 @@ status_t AudioTrack::start()
     if (mState == STATE_ACTIVE) {
         return INVALID_OPERATION;
     }
+    mScheduledStartNs = 0;
+    return start_l();
+}
 
+status_t AudioTrack::start_l()
+{
     mInUnderrun = true;
 
     State previousState = mState;
@@ -599,6 +605,7 @@ void AudioTrack::stop()
         mReleased = 0;
     }
 
+    mScheduledStartNs = 0;
     mProxy->interrupt();
     mAudioTrack->stop();
 
@@ -652,6 +659,7 @@ void AudioTrack::flush_l()
 
     mState = STATE_FLUSHED;
     mReleased = 0;
+    mScheduledStartNs = 0;
     if (isOffloaded_l()) {
         mProxy->interrupt();
     }
@@ -669,6 +677,7 @@ void AudioTrack::pause()
     } else {
         return;
     }
+    mScheduledStartNs = 0;
     mProxy->interrupt();
     mAudioTrack->pause();
 
@@ -692,6 +701,69 @@ void AudioTrack::pause()
     }
 }
 
+status_t AudioTrack::scheduleStart(int64_t startTimeNs)
+{
+    AutoMutex lock(mLock);
+    if (mState == STATE_ACTIVE) {
+        return INVALID_OPERATION;
+    }
+    status_t status = scheduleAction_l(IAudioTrack::SCHEDULE_START, false /*atPosition*/,
+            startTimeNs, GAIN_FLOAT_UNITY, GAIN_FLOAT_UNITY);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    // a track restored by start_l() is scheduled again before it is started
+    mScheduledStartNs = startTimeNs;
+    status = start_l();
+    if (status != NO_ERROR) {
+        // otherwise a later start() would be held back until the scheduled start
+        mScheduledStartNs = 0;
+        (void) mAudioTrack->scheduleAction(IAudioTrack::SCHEDULE_START, false /*atPosition*/,
+                IAudioTrack::kCancelScheduledAction, GAIN_FLOAT_UNITY, GAIN_FLOAT_UNITY);
+    }
+    return status;
+}
+
+status_t AudioTrack::scheduleStop(int64_t when, bool atPosition)
+{
+    AutoMutex lock(mLock);
+    return scheduleAction_l(IAudioTrack::SCHEDULE_STOP, atPosition, when,
+            GAIN_FLOAT_UNITY, GAIN_FLOAT_UNITY);
+}
+
+status_t AudioTrack::scheduleVolume(float left, float right, int64_t when, bool atPosition)
+{
+    if (isnanf(left) || left < GAIN_FLOAT_ZERO || left > GAIN_FLOAT_UNITY ||
+            isnanf(right) || right < GAIN_FLOAT_ZERO || right > GAIN_FLOAT_UNITY) {
+        return BAD_VALUE;
+    }
+
+    AutoMutex lock(mLock);
+    status_t status = scheduleAction_l(IAudioTrack::SCHEDULE_VOLUME, atPosition, when,
+            left, right);
+    if (status == NO_ERROR) {
+        // a track restored before the change is applied gets the new volume
+        mVolume[AUDIO_INTERLEAVE_LEFT] = left;
+        mVolume[AUDIO_INTERLEAVE_RIGHT] = right;
+    }
+    return status;
+}
+
+status_t AudioTrack::scheduleAction_l(int action, bool atPosition, int64_t when,
+        float left, float right)
+{
+    if ((mFlags & AUDIO_OUTPUT_FLAG_FAST) || isOffloadedOrDirect_l()) {
+        return INVALID_OPERATION;
+    }
+    if (atPosition) {
+        // Convert the position from client time base to server time base, as the reverse of
+        // getTimestamp().  mPosition and mServer represent the same frame after the update.
+        (void) updateAndGetPosition_l();
+        when = (uint32_t) ((uint32_t) when - mPosition + mServer);
+    }
+    return mAudioTrack->scheduleAction(action, atPosition, when, left, right);
+}
+
 status_t AudioTrack::setVolume(float left, float right)
 {
     // This duplicates a test by AudioTrack JNI, but that is not the only caller
@@ -1751,7 +1823,11 @@ nsecs_t AudioTrack::processAudioBuffer()
     }
 
     bool waitStreamEnd = mState == STATE_STOPPING;
-    bool active = mState == STATE_ACTIVE;
+    // A track the server stopped at a scheduled stop is no longer read, so there is neither
+    // room nor an event to wait for until it is started again, which resumes this thread.
+    // The flags are read again, as a track restored above has a new control block.
+    bool active = mState == STATE_ACTIVE &&
+            !(android_atomic_acquire_load(&mCblk->mFlags) & CBLK_STOPPED);
 
     // Manage underrun callback, must be done under lock to avoid race with releaseBuffer()
     bool newUnderrun = false;
@@ -2145,6 +2221,17 @@ status_t AudioTrack::restoreTrack_l(const char *from)
             }
         }
         if (mState == STATE_ACTIVE) {
+            if (mScheduledStartNs > systemTime()) {
+                // the new IAudioTrack is held back until the scheduled start as well
+                status_t status = mAudioTrack->scheduleAction(IAudioTrack::SCHEDULE_START,
+                        false /*atPosition*/, mScheduledStartNs,
+                        GAIN_FLOAT_UNITY, GAIN_FLOAT_UNITY);
+                if (status != NO_ERROR) {
+                    // the new output does not schedule actions, so the track starts now
+                    ALOGW("restoreTrack_l() scheduled start status %d", status);
+                    mScheduledStartNs = 0;
+                }
+            }
             result = mAudioTrack->start();
         }
     }
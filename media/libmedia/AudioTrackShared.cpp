@@ -192,6 +192,11 @@ status_t ClientProxy::obtainBuffer(Buffer* buffer, const struct timespec *reques
             status = NO_ERROR;
             break;
         }
+        // the server no longer reads a track it stopped on its own
+        if (mIsOut && (flags & CBLK_STOPPED)) {
+            status = WOULD_BLOCK;
+            goto end;
+        }
         struct timespec remaining;
         const struct timespec *ts;
         switch (timeout) {
@@ -595,7 +600,9 @@ void StaticAudioTrackClientProxy::getBufferPositionAndLoopCount(
 ServerProxy::ServerProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
         size_t frameSize, bool isOut, bool clientInServer)
     : Proxy(cblk, buffers, frameCount, frameSize, isOut, clientInServer),
-      mAvailToClient(0), mFlush(0)
+      mAvailToClient(0), mFlush(0),
+      mDeferWake(false), mWakePending(false), mWakeUrgent(false), mMinWakeIntervalNs(0),
+      mLastWakeNs(0), mWakeCount(0), mCoalescedWakeCount(0)
 {
 }
 
@@ -745,10 +752,17 @@ void ServerProxy::releaseBuffer(Buffer* buffer)
     // FIXME AudioRecord wakeup needs to be optimized; it currently wakes up client every time
     if (!mIsOut || (mAvailToClient + stepCount >= minimum)) {
         ALOGV("mAvailToClient=%zu stepCount=%zu minimum=%zu", mAvailToClient, stepCount, minimum);
-        int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
-        if (!(old & CBLK_FUTEX_WAKE)) {
-            (void) syscall(__NR_futex, &cblk->mFutex,
-                    mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE, 1);
+        if (mDeferWake) {
+            if (mWakePending) {
+                mCoalescedWakeCount++;
+            }
+            mWakePending = true;
+            // less than a quarter of the buffer is left for the server to read
+            if (mAvailToClient + stepCount >= mFrameCount - mFrameCount / 4) {
+                mWakeUrgent = true;
+            }
+        } else {
+            wakeClient();
         }
     }
 
@@ -757,6 +771,59 @@ void ServerProxy::releaseBuffer(Buffer* buffer)
     buffer->mNonContig = 0;
 }
 
+void ServerProxy::wakeClient()
+{
+    audio_track_cblk_t* cblk = mCblk;
+    int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
+    if (!(old & CBLK_FUTEX_WAKE)) {
+        (void) syscall(__NR_futex, &cblk->mFutex,
+                mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE, 1);
+        mWakeCount++;
+    }
+}
+
+void ServerProxy::setDeferWake(bool defer, int64_t minIntervalNs)
+{
+    if (!defer && mWakePending) {
+        mWakePending = false;
+        mWakeUrgent = false;
+        wakeClient();
+    }
+    mDeferWake = defer;
+    mMinWakeIntervalNs = minIntervalNs > 0 ? minIntervalNs : 0;
+}
+
+void ServerProxy::setStopped(bool stopped)
+{
+    audio_track_cblk_t* cblk = mCblk;
+    if (stopped) {
+        android_atomic_or(CBLK_STOPPED, &cblk->mFlags);
+        // a client waiting for room would otherwise wait for as long as the track is stopped
+        wakeClient();
+    } else {
+        android_atomic_and(~CBLK_STOPPED, &cblk->mFlags);
+    }
+}
+
+bool ServerProxy::flushWake(int64_t now, bool force)
+{
+    if (!mWakePending) {
+        return false;
+    }
+    if (mIsShutdown) {
+        mWakePending = false;
+        return false;
+    }
+    if (!force && !mWakeUrgent && now - mLastWakeNs < mMinWakeIntervalNs) {
+        return false;
+    }
+    mWakePending = false;
+    mWakeUrgent = false;
+    mLastWakeNs = now;
+    wakeClient();
+    return true;
+}
+
 // ---------------------------------------------------------------------------
 
 size_t AudioTrackServerProxy::framesReady()
@@ -42,6 +42,7 @@ enum {
     SET_PARAMETERS,
     GET_TIMESTAMP,
     SIGNAL,
+    SCHEDULE_ACTION,
 };
 
 class BpAudioTrack : public BpInterface<IAudioTrack>
@@ -195,6 +196,22 @@ public:
         data.writeInterfaceToken(IAudioTrack::getInterfaceDescriptor());
         remote()->transact(SIGNAL, data, &reply);
     }
+
+    virtual status_t scheduleAction(int action, bool atPosition, int64_t when,
+            float left, float right) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IAudioTrack::getInterfaceDescriptor());
+        data.writeInt32(action);
+        data.writeInt32(atPosition);
+        data.writeInt64(when);
+        data.writeFloat(left);
+        data.writeFloat(right);
+        status_t status = remote()->transact(SCHEDULE_ACTION, data, &reply);
+        if (status == NO_ERROR) {
+            status = reply.readInt32();
+        }
+        return status;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(AudioTrack, "android.media.IAudioTrack");
@@ -287,6 +304,16 @@ status_t BnAudioTrack::onTransact(
             signal();
             return NO_ERROR;
         } break;
+        case SCHEDULE_ACTION: {
+            CHECK_INTERFACE(IAudioTrack, data, reply);
+            int action = data.readInt32();
+            bool atPosition = data.readInt32() != 0;
+            int64_t when = data.readInt64();
+            float left = data.readFloat();
+            float right = data.readFloat();
+            reply->writeInt32(scheduleAction(action, atPosition, when, left, right));
+            return NO_ERROR;
+        } break;
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
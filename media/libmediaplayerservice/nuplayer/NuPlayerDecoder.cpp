@@ -572,7 +572,8 @@ bool NuPlayer::Decoder::handleAnOutputBuffer(
     bool eos = flags & MediaCodec::BUFFER_FLAG_EOS;
     // we do not expect CODECCONFIG or SYNCFRAME for decoder
 
-    sp<AMessage> reply = new AMessage(kWhatRenderBuffer, this);
+    // the renderer sets the rendering
+    sp<AMessage> reply = new AMessage(kWhatRenderBuffer, this, 5);
     reply->setSize("buffer-ix", index);
     reply->setInt32("generation", mBufferGeneration);
 
@@ -137,7 +137,7 @@ void NuPlayer::Renderer::queueBuffer(
         bool audio,
         const sp<ABuffer> &buffer,
         const sp<AMessage> &notifyConsumed) {
-    sp<AMessage> msg = new AMessage(kWhatQueueBuffer, this);
+    sp<AMessage> msg = new AMessage(kWhatQueueBuffer, this, 4);
     msg->setInt32("queueGeneration", getQueueGeneration(audio));
     msg->setInt32("audio", static_cast<int32_t>(audio));
     msg->setBuffer("buffer", buffer);
@@ -641,7 +641,7 @@ void NuPlayer::Renderer::postDrainAudioQueue_l(int64_t delayUs) {
     }
 
     mDrainAudioQueuePending = true;
-    sp<AMessage> msg = new AMessage(kWhatDrainAudioQueue, this);
+    sp<AMessage> msg = new AMessage(kWhatDrainAudioQueue, this, 1);
     msg->setInt32("drainGeneration", mAudioDrainGeneration);
     msg->post(delayUs);
 }
@@ -1015,7 +1015,7 @@ void NuPlayer::Renderer::postDrainVideoQueue() {
 
     QueueEntry &entry = *mVideoQueue.begin();
 
-    sp<AMessage> msg = new AMessage(kWhatDrainVideoQueue, this);
+    sp<AMessage> msg = new AMessage(kWhatDrainVideoQueue, this, 1);
     msg->setInt32("drainGeneration", getDrainGeneration(false /* audio */));
 
     if (entry.mBuffer == NULL) {
@@ -13,7 +13,7 @@ LOCAL_SRC_FILES := \
     PipeReader.cpp                  \
     SourceAudioBufferProvider.cpp
 
-LOCAL_SRC_FILES += NBLog.cpp
+LOCAL_SRC_FILES += NBLog.cpp NBLogFormat.cpp
 
 # libsndfile license is incompatible; uncomment to use for local debug only
 #LOCAL_SRC_FILES += LibsndfileSink.cpp LibsndfileSource.cpp
@@ -36,3 +36,5 @@ LOCAL_SHARED_LIBRARIES := \
 LOCAL_C_INCLUDES := $(call include-path-for, audio-utils)
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include <new>
 #include <cutils/atomic.h>
 #include <media/nbaio/NBLog.h>
@@ -30,19 +31,13 @@
 
 namespace android {
 
-int NBLog::Entry::readAt(size_t offset) const
+size_t NBLog::Entry::copyTo(uint8_t *buffer) const
 {
-    // FIXME This is too slow, despite the name it is used during writing
-    if (offset == 0)
-        return mEvent;
-    else if (offset == 1)
-        return mLength;
-    else if (offset < (size_t) (mLength + 2))
-        return ((char *) mData)[offset - 2];
-    else if (offset == (size_t) (mLength + 2))
-        return mLength;
-    else
-        return 0;
+    buffer[0] = mEvent;
+    buffer[1] = mLength;
+    memcpy(&buffer[2], mData, mLength);
+    buffer[2 + mLength] = mLength;
+    return mLength + 3;
 }
 
 // ---------------------------------------------------------------------------
@@ -147,6 +142,15 @@ void NBLog::Writer::logTimestamp(const struct timespec& ts)
     log(EVENT_TIMESTAMP, &ts, sizeof(struct timespec));
 }
 
+void NBLog::Writer::logFormatv(Format format, const Arg *args, size_t count)
+{
+    if (!mEnabled) {
+        return;
+    }
+    uint8_t data[kMaxFormatLength];
+    log(EVENT_FORMAT, data, encode(data, format, args, count));
+}
+
 void NBLog::Writer::log(Event event, const void *data, size_t length)
 {
     if (!mEnabled) {
@@ -158,6 +162,7 @@ void NBLog::Writer::log(Event event, const void *data, size_t length)
     switch (event) {
     case EVENT_STRING:
     case EVENT_TIMESTAMP:
+    case EVENT_FORMAT:
         break;
     case EVENT_RESERVED:
     default:
@@ -176,23 +181,18 @@ void NBLog::Writer::log(const NBLog::Entry *entry, bool trusted)
         log(entry->mEvent, entry->mData, entry->mLength);
         return;
     }
+    // the entry is short, so it is quicker to build it in one piece
+    // and copy it at most twice, than to copy each of its fields around the wrap
+    uint8_t copy[Entry::kMaxEntrySize];
+    size_t need = entry->copyTo(copy);  // need = number of bytes remaining to write
     size_t rear = mRear & (mSize - 1);
     size_t written = mSize - rear;      // written = number of bytes that have been written so far
-    size_t need = entry->mLength + 3;   // mEvent, mLength, data[length], mLength
-                                        // need = number of bytes remaining to write
     if (written > need) {
         written = need;
     }
-    size_t i;
-    // FIXME optimize this using memcpy for the data part of the Entry.
-    // The Entry could have a method copyTo(ptr, offset, size) to optimize the copy.
-    for (i = 0; i < written; ++i) {
-        mShared->mBuffer[rear + i] = entry->readAt(i);
-    }
+    memcpy(&mShared->mBuffer[rear], copy, written);
     if (rear + written == mSize && (need -= written) > 0)  {
-        for (i = 0; i < need; ++i) {
-            mShared->mBuffer[i] = entry->readAt(written + i);
-        }
+        memcpy(mShared->mBuffer, &copy[written], need);
         written += need;
     }
     android_atomic_release_store(mRear += written, &mShared->mRear);
@@ -258,6 +258,12 @@ void NBLog::LockedWriter::logTimestamp(const struct timespec& ts)
     Writer::logTimestamp(ts);
 }
 
+void NBLog::LockedWriter::logFormatv(Format format, const Arg *args, size_t count)
+{
+    Mutex::Autolock _l(mLock);
+    Writer::logFormatv(format, args, count);
+}
+
 bool NBLog::LockedWriter::isEnabled() const
 {
     Mutex::Autolock _l(mLock);
@@ -283,12 +289,12 @@ NBLog::Reader::Reader(size_t size, const sp<IMemory>& iMemory)
 {
 }
 
-void NBLog::Reader::dump(int fd, size_t indent)
+uint8_t *NBLog::Reader::copyEntries(size_t *start, size_t *end, size_t *lostBytes)
 {
     int32_t rear = android_atomic_acquire_load(&mShared->mRear);
     size_t avail = rear - mFront;
     if (avail == 0) {
-        return;
+        return NULL;
     }
     size_t lost = 0;
     if (avail > mSize) {
@@ -315,33 +321,48 @@ void NBLog::Reader::dump(int fd, size_t indent)
         }
     }
     mFront += read;
+    // scan backwards for the oldest complete entry
     size_t i = avail;
-    Event event;
-    size_t length;
-    struct timespec ts;
-    time_t maxSec = -1;
     while (i >= 3) {
-        length = copy[i - 1];
+        size_t length = copy[i - 1];
         if (length + 3 > i || copy[i - length - 2] != length) {
             break;
         }
-        event = (Event) copy[i - length - 3];
-        if (event == EVENT_TIMESTAMP) {
-            if (length != sizeof(struct timespec)) {
-                // corrupt
-                break;
-            }
-            memcpy(&ts, &copy[i - length - 1], sizeof(struct timespec));
+        Event event = (Event) copy[i - length - 3];
+        if (event == EVENT_TIMESTAMP && length != sizeof(struct timespec)) {
+            // corrupt
+            break;
+        }
+        i -= length + 3;
+    }
+    *start = i;
+    *end = avail;
+    *lostBytes = lost + i;
+    return copy;
+}
+
+void NBLog::Reader::dump(int fd, size_t indent)
+{
+    size_t i, avail, lost;
+    uint8_t *copy = copyEntries(&i, &avail, &lost);
+    if (copy == NULL) {
+        return;
+    }
+    Event event;
+    size_t length;
+    struct timespec ts;
+    time_t maxSec = -1;
+    for (size_t j = i; j < avail; j += copy[j + 1] + 3) {
+        if ((Event) copy[j] == EVENT_TIMESTAMP) {
+            memcpy(&ts, &copy[j + 2], sizeof(struct timespec));
             if (ts.tv_sec > maxSec) {
                 maxSec = ts.tv_sec;
             }
         }
-        i -= length + 3;
     }
     mFd = fd;
     mIndent = indent;
     String8 timestamp, body;
-    lost += i;
     if (lost > 0) {
         body.appendFormat("warning: lost %zu bytes worth of events", lost);
         // TODO timestamp empty here, only other choice to wait for the first timestamp event in the
@@ -416,6 +437,11 @@ void NBLog::Reader::dump(int fd, size_t indent)
                     (int) (ts.tv_nsec / 1000000));
             deferredTimestamp = true;
             } break;
+        case EVENT_FORMAT: {
+            char text[256];
+            decode(text, sizeof(text), (const uint8_t *) data, length);
+            body.append(text);
+            } break;
         case EVENT_RESERVED:
         default:
             body.appendFormat("warning: unknown event %d", event);
@@ -435,6 +461,29 @@ void NBLog::Reader::dump(int fd, size_t indent)
     delete[] copy;
 }
 
+void NBLog::Reader::dumpRaw(int fd, const char *name)
+{
+    size_t start, avail, lost;
+    uint8_t *copy = copyEntries(&start, &avail, &lost);
+    if (copy == NULL) {
+        start = avail = lost = 0;
+    }
+    RawDumpHeader header;
+    header.mMagic = RawDumpHeader::kMagic;
+    header.mVersion = RawDumpHeader::kVersion;
+    header.mNameLength = strlen(name);
+    header.mLength = avail - start;
+    header.mLost = lost;
+    header.mTimestampSize = sizeof(struct timespec);
+    // a short write is not retried, the decoder stops at the first inconsistent header
+    if (write(fd, &header, sizeof(header)) == (ssize_t) sizeof(header) &&
+            write(fd, name, header.mNameLength) == (ssize_t) header.mNameLength &&
+            header.mLength > 0) {
+        (void) write(fd, &copy[start], header.mLength);
+    }
+    delete[] copy;
+}
+
 void NBLog::Reader::dumpLine(const String8& timestamp, String8& body)
 {
     if (mFd >= 0) {
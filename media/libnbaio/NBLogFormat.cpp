@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file is also built for the host by the nblog-decode tool, so it must only
+// depend on the C library.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <media/nbaio/NBLogFormat.h>
+
+namespace android {
+
+#define NBLOG_FORMAT_STRING(id, string) string,
+static const char * const sFormatStrings[NBLogFormat::FORMAT_COUNT] = {
+    NBLOG_FORMATS(NBLOG_FORMAT_STRING)
+};
+#undef NBLOG_FORMAT_STRING
+
+/*static*/
+const char *NBLogFormat::formatString(unsigned format)
+{
+    return format < FORMAT_COUNT ? sFormatStrings[format] : NULL;
+}
+
+/*static*/
+size_t NBLogFormat::encode(uint8_t *data, Format format, const Arg *args, size_t count)
+{
+    const uint16_t id = format;
+    memcpy(data, &id, sizeof(id));
+    size_t length = sizeof(id);
+    if (count > kMaxArgs) {
+        count = kMaxArgs;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const Arg& arg = args[i];
+        data[length++] = arg.mType;
+        const size_t size = arg.mType == TYPE_INT64 || arg.mType == TYPE_POINTER ?
+                sizeof(int64_t) : sizeof(int32_t);
+        memcpy(&data[length], &arg.mValue, size);
+        length += size;
+    }
+    return length;
+}
+
+// Appends to a text buffer like snprintf(), but never beyond its end
+struct TextBuffer {
+    TextBuffer(char *buffer, size_t size) : mBuffer(buffer), mSize(size), mLength(0) {
+        if (size > 0) {
+            buffer[0] = '\0';
+        }
+    }
+
+    void appendf(const char *fmt, ...) __attribute__ ((format (printf, 2, 3))) {
+        if (mLength + 1 >= mSize) {
+            return;
+        }
+        va_list ap;
+        va_start(ap, fmt);
+        int length = vsnprintf(&mBuffer[mLength], mSize - mLength, fmt, ap);
+        va_end(ap);
+        if (length > 0) {
+            mLength += (size_t) length < mSize - mLength ? length : mSize - mLength - 1;
+        }
+    }
+
+    char * const mBuffer;
+    const size_t mSize;
+    size_t  mLength;
+};
+
+/*static*/
+size_t NBLogFormat::decode(char *buffer, size_t size, const uint8_t *data, size_t length)
+{
+    TextBuffer text(buffer, size);
+    uint16_t id;
+    if (length < sizeof(id)) {
+        text.appendf("warning: format event of %zu bytes", length);
+        return text.mLength;
+    }
+    memcpy(&id, data, sizeof(id));
+    const char *format = formatString(id);
+    if (format == NULL) {
+        text.appendf("warning: unknown format %u", id);
+        return text.mLength;
+    }
+    size_t i = sizeof(id);
+    for (const char *p = format; *p != '\0'; ) {
+        if (*p != '%') {
+            const char *literal = strchr(p, '%');
+            const int n = literal != NULL ? literal - p : strlen(p);
+            text.appendf("%.*s", n, p);
+            p += n;
+            continue;
+        }
+        if (p[1] == '%') {
+            text.appendf("%%");
+            p += 2;
+            continue;
+        }
+        // Copy the flags, width and precision of the conversion, and replace its length
+        // modifier by the one for the type that was actually logged.
+        char spec[16];
+        size_t specLength = 0;
+        spec[specLength++] = *p++;
+        while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL) {
+            if (specLength < sizeof(spec) - 4) {
+                spec[specLength++] = *p;
+            }
+            p++;
+        }
+        while (*p != '\0' && strchr("hlLqjzt", *p) != NULL) {
+            p++;
+        }
+        const char conversion = *p;
+        if (conversion != '\0') {
+            p++;
+        }
+        if (i >= length) {
+            text.appendf("<missing>");
+            continue;
+        }
+        const Type type = (Type) data[i++];
+        const size_t valueSize = type == TYPE_INT64 || type == TYPE_POINTER ?
+                sizeof(int64_t) : sizeof(int32_t);
+        if (i + valueSize > length) {
+            text.appendf("<truncated>");
+            i = length;
+            continue;
+        }
+        union {
+            int32_t     i32;
+            uint32_t    u32;
+            int64_t     i64;
+            float       f;
+        } value;
+        memcpy(&value, &data[i], valueSize);
+        i += valueSize;
+        const bool isFloatConversion = conversion != '\0' && strchr("fFeEgGaA", conversion);
+        switch (type) {
+        case TYPE_INT32:
+        case TYPE_UINT32: {
+            const int64_t integer = type == TYPE_INT32 ? (int64_t) value.i32 : value.u32;
+            if (isFloatConversion) {
+                spec[specLength++] = conversion;
+                spec[specLength] = '\0';
+                text.appendf(spec, (double) integer);
+            } else if (conversion == 'p' || conversion == 's' || conversion == '\0') {
+                text.appendf("%lld", (long long) integer);
+            } else {
+                spec[specLength++] = conversion;
+                spec[specLength] = '\0';
+                // the value fits in an int whatever its signedness
+                text.appendf(spec, type == TYPE_INT32 ? value.i32 : (int) value.u32);
+            }
+            } break;
+        case TYPE_INT64:
+        case TYPE_POINTER:
+            if (isFloatConversion) {
+                spec[specLength++] = conversion;
+                spec[specLength] = '\0';
+                text.appendf(spec, (double) value.i64);
+            } else if (type == TYPE_POINTER || conversion == 'p') {
+                text.appendf("%#llx", (unsigned long long) value.i64);
+            } else if (conversion == 's' || conversion == '\0') {
+                text.appendf("%lld", (long long) value.i64);
+            } else {
+                spec[specLength++] = 'l';
+                spec[specLength++] = 'l';
+                spec[specLength++] = conversion;
+                spec[specLength] = '\0';
+                text.appendf(spec, (long long) value.i64);
+            }
+            break;
+        case TYPE_FLOAT:
+            if (isFloatConversion) {
+                spec[specLength++] = conversion;
+                spec[specLength] = '\0';
+                text.appendf(spec, (double) value.f);
+            } else {
+                text.appendf("%g", (double) value.f);
+            }
+            break;
+        default:
+            text.appendf("<type %d>", type);
+            i = length;     // the size of the remaining arguments is unknown
+            break;
+        }
+    }
+    if (i < length) {
+        text.appendf(" <%zu extra bytes>", length - i);
+    }
+    return text.mLength;
+}
+
+}   // namespace android
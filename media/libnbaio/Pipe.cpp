@@ -17,6 +17,7 @@
 #define LOG_TAG "Pipe"
 //#define LOG_NDEBUG 0
 
+#include <time.h>
 #include <cutils/atomic.h>
 #include <cutils/compiler.h>
 #include <utils/Log.h>
@@ -31,8 +32,15 @@ Pipe::Pipe(size_t maxFrames, const NBAIO_Format& format, void *buffer) :
         mBuffer(buffer == NULL ? malloc(mMaxFrames * Format_frameSize(format)) : buffer),
         mRear(0),
         mReaders(0),
-        mFreeBufferInDestructor(buffer == NULL)
+        mFreeBufferInDestructor(buffer == NULL),
+        mBlockingReaders(0),
+        mWriteSequence(0),
+        mWritePosition(0),
+        mWriteTimeNs(0)
 {
+    for (size_t i = 0; i < kMaxBlockingReaders; i++) {
+        mBlockingFronts[i] = 0;
+    }
 }
 
 Pipe::~Pipe()
@@ -43,12 +51,39 @@ Pipe::~Pipe()
     }
 }
 
+ssize_t Pipe::availableToWrite() const
+{
+    int32_t blockingReaders = android_atomic_acquire_load(&mBlockingReaders);
+    size_t avail = mMaxFrames;
+    for (size_t i = 0; blockingReaders != 0; i++, blockingReaders >>= 1) {
+        if (blockingReaders & 1) {
+            size_t unread = mRear - android_atomic_acquire_load(&mBlockingFronts[i]);
+            if (unread >= mMaxFrames) {
+                return 0;
+            }
+            if (mMaxFrames - unread < avail) {
+                avail = mMaxFrames - unread;
+            }
+        }
+    }
+    return avail;
+}
+
 ssize_t Pipe::write(const void *buffer, size_t count)
 {
     // count == 0 is unlikely and not worth checking for
     if (CC_UNLIKELY(!mNegotiated)) {
         return NEGOTIATE;
     }
+    if (CC_UNLIKELY(android_atomic_acquire_load(&mBlockingReaders) != 0)) {
+        size_t avail = availableToWrite();
+        if (count > avail) {
+            count = avail;
+        }
+        if (count == 0) {
+            return 0;
+        }
+    }
     // write() is not multi-thread safe w.r.t. itself, so no mutex or atomic op needed to read mRear
     size_t rear = mRear & (mMaxFrames - 1);
     size_t written = mMaxFrames - rear;
@@ -65,6 +100,16 @@ ssize_t Pipe::write(const void *buffer, size_t count)
             written += count;
         }
     }
+    // Timestamp the write before publishing it, so that a reader that sees the frames
+    // also sees a timestamp at least as recent.
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+        int32_t sequence = mWriteSequence + 1;
+        android_atomic_acquire_store(sequence, &mWriteSequence);
+        mWritePosition = written + mRear;
+        mWriteTimeNs = now.tv_sec * 1000000000LL + now.tv_nsec;
+        android_atomic_release_store(sequence + 1, &mWriteSequence);
+    }
     android_atomic_release_store(written + mRear, &mRear);
     mFramesWritten += written;
     return written;
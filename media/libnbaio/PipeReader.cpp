@@ -17,29 +17,98 @@
 #define LOG_TAG "PipeReader"
 //#define LOG_NDEBUG 0
 
+#include <time.h>
+#include <cutils/atomic.h>
 #include <cutils/compiler.h>
 #include <utils/Log.h>
 #include <media/nbaio/PipeReader.h>
 
 namespace android {
 
-PipeReader::PipeReader(Pipe& pipe) :
+PipeReader::PipeReader(Pipe& pipe, Policy policy) :
         NBAIO_Source(pipe.mFormat),
         mPipe(pipe),
         // any data already in the pipe is not visible to this PipeReader
         mFront(android_atomic_acquire_load(&pipe.mRear)),
         mFramesOverrun(0),
-        mOverruns(0)
+        mOverruns(0),
+        mBlockingSlot(-1),
+        mLatencyNs(-1),
+        mMaxLatencyNs(-1)
 {
     android_atomic_inc(&pipe.mReaders);
+    if (policy == BLOCKING) {
+        // Until the slot holds our front, the writer sees the front of its previous user, which
+        // can only hold it back more.  The writer may also have gone ahead since we read mRear,
+        // which shows as frames unread by this reader until the first read.
+        for (size_t i = 0; i < Pipe::kMaxBlockingReaders && mBlockingSlot < 0; ) {
+            int32_t readers = android_atomic_acquire_load(&pipe.mBlockingReaders);
+            if (readers & (1 << i)) {
+                i++;
+            } else if (android_atomic_cmpxchg(readers, readers | (1 << i),
+                    &pipe.mBlockingReaders) == 0) {
+                mBlockingSlot = i;
+                android_atomic_release_store(mFront, &pipe.mBlockingFronts[i]);
+            }
+            // otherwise another reader changed the mask, try this slot again
+        }
+        ALOGW_IF(mBlockingSlot < 0, "too many blocking readers, using NON_BLOCKING");
+    }
 }
 
 PipeReader::~PipeReader()
 {
+    if (mBlockingSlot >= 0) {
+        android_atomic_and(~(1 << mBlockingSlot), &mPipe.mBlockingReaders);
+    }
     int32_t readers = android_atomic_dec(&mPipe.mReaders);
     ALOG_ASSERT(readers > 0);
 }
 
+void PipeReader::setFront(int32_t front)
+{
+    android_atomic_release_store(front, &mFront);
+    if (mBlockingSlot >= 0) {
+        android_atomic_release_store(front, &mPipe.mBlockingFronts[mBlockingSlot]);
+    }
+}
+
+bool PipeReader::getLatestWrite(int32_t *position, int64_t *timeNs) const
+{
+    int32_t before, after;
+    do {
+        before = android_atomic_acquire_load(&mPipe.mWriteSequence);
+        *position = mPipe.mWritePosition;
+        *timeNs = mPipe.mWriteTimeNs;
+        after = android_atomic_release_load(&mPipe.mWriteSequence);
+    } while (before != after || (before & 1));
+    return before != 0;
+}
+
+void PipeReader::updateLatency(int32_t front)
+{
+    int32_t position;
+    int64_t timeNs;
+    struct timespec now;
+    if (!getLatestWrite(&position, &timeNs) || clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return;
+    }
+    // the frame at front was written before the latest write ended, by the time
+    // it takes to play the frames between them, which are at most a pipe full
+    int64_t latencyNs = now.tv_sec * 1000000000LL + now.tv_nsec - timeNs;
+    int32_t frames = position - front;
+    if (frames > (int32_t) mPipe.mMaxFrames) {
+        frames = mPipe.mMaxFrames;
+    }
+    if (frames > 0) {
+        latencyNs += (int64_t) frames * 1000000000LL / Format_sampleRate(mFormat);
+    }
+    mLatencyNs = latencyNs;
+    if (latencyNs > mMaxLatencyNs) {
+        mMaxLatencyNs = latencyNs;
+    }
+}
+
 ssize_t PipeReader::availableToRead()
 {
     if (CC_UNLIKELY(!mNegotiated)) {
@@ -51,8 +120,9 @@ ssize_t PipeReader::availableToRead()
     if (CC_UNLIKELY(avail > mPipe.mMaxFrames)) {
         // Discard 1/16 of the most recent data in pipe to avoid another overrun immediately
         int32_t oldFront = mFront;
-        mFront = rear - mPipe.mMaxFrames + (mPipe.mMaxFrames >> 4);
-        mFramesOverrun += (size_t) (mFront - oldFront);
+        int32_t newFront = rear - mPipe.mMaxFrames + (mPipe.mMaxFrames >> 4);
+        setFront(newFront);
+        mFramesOverrun += (size_t) (newFront - oldFront);
         ++mOverruns;
         return OVERRUN;
     }
@@ -70,6 +140,7 @@ ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS __unused)
     if (CC_LIKELY(count > (size_t) avail)) {
         count = avail;
     }
+    updateLatency(mFront);
     size_t front = mFront & (mPipe.mMaxFrames - 1);
     size_t red = mPipe.mMaxFrames - front;
     if (CC_LIKELY(red > count)) {
@@ -87,9 +158,65 @@ ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS __unused)
             red += count;
         }
     }
-    mFront += red;
+    setFront(red + mFront);
     mFramesRead += red;
     return red;
 }
 
+ssize_t PipeReader::obtain(void **buffer, size_t count)
+{
+    ssize_t avail = availableToRead();
+    if (CC_UNLIKELY(avail <= 0)) {
+        *buffer = NULL;
+        return avail;
+    }
+    if (CC_LIKELY(count > (size_t) avail)) {
+        count = avail;
+    }
+    updateLatency(mFront);
+    // only the frames up to the end of the pipe buffer are contiguous
+    size_t front = mFront & (mPipe.mMaxFrames - 1);
+    size_t contiguous = mPipe.mMaxFrames - front;
+    if (CC_UNLIKELY(count > contiguous)) {
+        count = contiguous;
+    }
+    *buffer = (char *) mPipe.mBuffer + (front * mFrameSize);
+    return count;
+}
+
+void PipeReader::release(size_t count)
+{
+    setFront(count + mFront);
+    mFramesRead += count;
+}
+
+size_t PipeReader::framesUnread() const
+{
+    int32_t rear = android_atomic_acquire_load(&mPipe.mRear);
+    return rear - android_atomic_acquire_load(&mFront);
+}
+
+status_t PipeReader::getTimestamp(AudioTimestamp& timestamp) const
+{
+    int32_t position;
+    int64_t timeNs;
+    if (!getLatestWrite(&position, &timeNs)) {
+        return INVALID_OPERATION;
+    }
+    timestamp.mPosition = (uint32_t) (mFramesRead + (size_t) (position - mFront));
+    timestamp.mTime.tv_sec = timeNs / 1000000000;
+    timestamp.mTime.tv_nsec = timeNs % 1000000000;
+    return OK;
+}
+
+void PipeReader::getStats(Stats *stats) const
+{
+    stats->mFramesRead = mFramesRead;
+    stats->mFramesUnread = framesUnread();
+    stats->mFramesOverrun = mFramesOverrun;
+    stats->mOverruns = mOverruns;
+    stats->mLatencyNs = mLatencyNs;
+    stats->mMaxLatencyNs = mMaxLatencyNs;
+}
+
 }   // namespace android
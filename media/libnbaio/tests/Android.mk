@@ -0,0 +1,24 @@
+# Build the benchmarks for libnbaio
+
+#
+# multi-reader pipe benchmark tool
+#
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	pipe_benchmark.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libnbaio \
+	libcutils \
+	libutils \
+	liblog
+
+LOCAL_MODULE:= pipe-benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CXX_STL := libc++
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <inttypes.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <media/AudioBufferProvider.h>
+#include <media/nbaio/Pipe.h>
+#include <media/nbaio/PipeReader.h>
+
+/* Throughput benchmark of the multi-reader Pipe.
+ *
+ * One writer thread writes to a Pipe as fast as it can, while 0 up to the maximum number
+ * of reader threads read from it, each through its own PipeReader.  The readers are all
+ * NON_BLOCKING, so that the writer never waits and slow readers overrun, or all BLOCKING,
+ * so that the writer is limited by the slowest reader and nothing is lost.
+ *
+ * For each reader count the report gives the frames written per second and the cost per
+ * frame written, and over the readers the least and most frames read, the frames lost to
+ * overruns, and the highest latency measured by PipeReader.  The report is JSON, with one
+ * result per line.
+ *
+ * Example: pipe-benchmark -b -r 4 -d 2000
+ */
+
+using namespace android;
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-b] [-f frame-count] [-p pipe-frames] [-c channels]"
+                    " [-r max-readers] [-d duration-ms] [-o json-file]\n", name);
+    fprintf(stderr, "    -b    BLOCKING readers (default NON_BLOCKING)\n");
+    fprintf(stderr, "    -f    frame count per write and read (default 256)\n");
+    fprintf(stderr, "    -p    pipe size in frames, rounded up to a power of 2 (default 4096)\n");
+    fprintf(stderr, "    -c    channel count of the pcm16 frames (default 2)\n");
+    fprintf(stderr, "    -r    maximum number of readers (default 8)\n");
+    fprintf(stderr, "    -d    duration of each measurement in ms (default 1000)\n");
+    fprintf(stderr, "    -o    write the JSON report to json-file (default stdout)\n");
+}
+
+static int64_t systemTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void negotiate(NBAIO_Port *port, const NBAIO_Format& format) {
+    const NBAIO_Format offers[1] = {format};
+    size_t numCounterOffers = 0;
+    ssize_t index = port->negotiate(offers, 1, NULL, numCounterOffers);
+    if (index != 0) {
+        fprintf(stderr, "negotiate failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    bool blocking = false;
+    size_t frameCount = 256;
+    size_t pipeFrames = 4096;
+    unsigned channels = 2;
+    size_t maxReaders = 8;
+    int durationMs = 1000;
+    const char* outputFile = NULL;
+
+    for (int ch; (ch = getopt(argc, argv, "bf:p:c:r:d:o:")) != -1;) {
+        switch (ch) {
+        case 'b':
+            blocking = true;
+            break;
+        case 'f':
+            frameCount = atoi(optarg);
+            break;
+        case 'p':
+            pipeFrames = atoi(optarg);
+            break;
+        case 'c':
+            channels = atoi(optarg);
+            break;
+        case 'r':
+            maxReaders = atoi(optarg);
+            break;
+        case 'd':
+            durationMs = atoi(optarg);
+            break;
+        case 'o':
+            outputFile = optarg;
+            break;
+        case '?':
+        default:
+            usage(progname);
+            return EXIT_FAILURE;
+        }
+    }
+    if (frameCount == 0 || pipeFrames < 2 * frameCount || channels == 0 || durationMs <= 0) {
+        usage(progname);
+        return EXIT_FAILURE;
+    }
+    if (blocking && maxReaders > Pipe::kMaxBlockingReaders) {
+        fprintf(stderr, "at most %zu blocking readers\n", Pipe::kMaxBlockingReaders);
+        maxReaders = Pipe::kMaxBlockingReaders;
+    }
+    FILE* out = stdout;
+    if (outputFile != NULL && (out = fopen(outputFile, "w")) == NULL) {
+        perror(outputFile);
+        return EXIT_FAILURE;
+    }
+
+    const NBAIO_Format format = Format_from_SR_C(48000, channels, AUDIO_FORMAT_PCM_16_BIT);
+    const size_t frameSize = Format_frameSize(format);
+    std::vector<char> source(frameCount * frameSize);
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = (char) i;
+    }
+
+    for (size_t numReaders = 0; numReaders <= maxReaders; numReaders++) {
+        sp<Pipe> pipe = new Pipe(pipeFrames, format);
+        negotiate(pipe.get(), format);
+        std::vector<sp<PipeReader> > readers;
+        for (size_t i = 0; i < numReaders; i++) {
+            sp<PipeReader> reader = new PipeReader(*pipe.get(),
+                    blocking ? PipeReader::BLOCKING : PipeReader::NON_BLOCKING);
+            negotiate(reader.get(), format);
+            readers.push_back(reader);
+        }
+
+        std::atomic<bool> done(false);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < numReaders; i++) {
+            PipeReader* reader = readers[i].get();
+            threads.push_back(std::thread([reader, frameCount, frameSize, &done]() {
+                std::vector<char> buffer(frameCount * frameSize);
+                while (!done.load(std::memory_order_relaxed)) {
+                    if (reader->read(buffer.data(), frameCount,
+                            AudioBufferProvider::kInvalidPTS) == 0) {
+                        sched_yield();
+                    }
+                }
+            }));
+        }
+
+        size_t framesWritten = 0;
+        const int64_t startNs = systemTimeNs();
+        const int64_t endNs = startNs + durationMs * 1000000LL;
+        int64_t nowNs;
+        do {
+            // check the time only every few writes, as it costs about as much as a write
+            for (int i = 0; i < 16; i++) {
+                ssize_t written = pipe->write(source.data(), frameCount);
+                if (written > 0) {
+                    framesWritten += written;
+                } else {
+                    // blocking readers are behind
+                    sched_yield();
+                }
+            }
+            nowNs = systemTimeNs();
+        } while (nowNs < endNs);
+        done = true;
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+
+        size_t minRead = SIZE_MAX, maxRead = 0, framesOverrun = 0, overruns = 0;
+        int64_t maxLatencyNs = -1;
+        for (size_t i = 0; i < numReaders; i++) {
+            PipeReader::Stats stats;
+            readers[i]->getStats(&stats);
+            minRead = stats.mFramesRead < minRead ? stats.mFramesRead : minRead;
+            maxRead = stats.mFramesRead > maxRead ? stats.mFramesRead : maxRead;
+            framesOverrun += stats.mFramesOverrun;
+            overruns += stats.mOverruns;
+            maxLatencyNs = stats.mMaxLatencyNs > maxLatencyNs ? stats.mMaxLatencyNs : maxLatencyNs;
+        }
+        if (numReaders == 0) {
+            minRead = 0;
+        }
+        const double seconds = (nowNs - startNs) * 1e-9;
+        fprintf(out, "{\"readers\": %zu, \"policy\": \"%s\", \"frame_count\": %zu,"
+                " \"pipe_frames\": %zu, \"frames_per_s\": %.0f, \"ns_per_frame\": %.3f,"
+                " \"min_frames_read\": %zu, \"max_frames_read\": %zu,"
+                " \"frames_overrun\": %zu, \"overruns\": %zu, \"max_latency_us\": %.1f}\n",
+                numReaders, blocking ? "blocking" : "non_blocking", frameCount,
+                pipe->maxFrames(), framesWritten / seconds,
+                framesWritten != 0 ? (nowNs - startNs) / (double) framesWritten : 0.,
+                minRead, maxRead, framesOverrun, overruns,
+                maxLatencyNs >= 0 ? maxLatencyNs * 1e-3 : -1.);
+        fflush(out);
+
+        readers.clear();
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,19 @@
+# Build the host tools for libnbaio
+
+#
+# NBLog raw dump decoder, for "dumpsys media.log --raw"
+#
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	nblog_decode.cpp \
+	../NBLogFormat.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../../include
+
+LOCAL_MODULE:= nblog-decode
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <media/nbaio/NBLogFormat.h>
+
+/* Decoder of NBLog raw dumps.
+ *
+ * The raw dump is taken on the device with
+ *     adb exec-out dumpsys media.log --raw > media_log.raw
+ * ("adb shell" would translate the line feeds in the binary data).
+ *
+ * By default the logs are rebuilt as text, each line prefixed with the latest timestamp
+ * logged before it, as dumpsys media.log would print them.  With -t the events of all
+ * logs are instead merged into one timeline, sorted by time, as tab separated values:
+ * the time in seconds, the time since the previous event of the same log in milliseconds,
+ * the name of the log, and the text of the event.  Events logged before the first timestamp
+ * of their log have no time, and are left out of the timeline.
+ */
+
+using namespace android;
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-t] [raw-dump-file]\n", name);
+    fprintf(stderr, "    -t    print a timeline of all logs (default text of each log)\n");
+    fprintf(stderr, "    reads the raw dump from stdin if no file is given\n");
+}
+
+struct TimelineEvent {
+    int64_t     mTimeNs;
+    int64_t     mDeltaNs;       // since the previous event of the same log, -1 if first
+    std::string mLog;
+    std::string mText;
+
+    bool operator<(const TimelineEvent& other) const { return mTimeNs < other.mTimeNs; }
+};
+
+static bool readTimestamp(const uint8_t *data, size_t length, size_t timestampSize,
+        int64_t *timeNs) {
+    if (length != timestampSize) {
+        return false;
+    }
+    if (timestampSize == 2 * sizeof(int32_t)) {
+        int32_t ts[2];
+        memcpy(ts, data, sizeof(ts));
+        *timeNs = ts[0] * 1000000000LL + ts[1];
+    } else if (timestampSize == 2 * sizeof(int64_t)) {
+        int64_t ts[2];
+        memcpy(ts, data, sizeof(ts));
+        *timeNs = ts[0] * 1000000000LL + ts[1];
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Decodes the entries of one log, returns false if they are corrupt
+static bool decodeLog(const std::string& name, const NBLogFormat::RawDumpHeader& header,
+        const uint8_t *entries, bool timeline, std::vector<TimelineEvent> *events) {
+    if (!timeline) {
+        printf("\n%s:\n", name.c_str());
+        if (header.mLost > 0) {
+            printf("warning: lost %u bytes worth of events\n", header.mLost);
+        }
+    }
+    int64_t timeNs = -1;
+    int64_t previousNs = -1;
+    for (size_t i = 0; i < header.mLength; ) {
+        if (i + 3 > header.mLength) {
+            return false;
+        }
+        const NBLogFormat::Event event = (NBLogFormat::Event) entries[i];
+        const size_t length = entries[i + 1];
+        const uint8_t *data = &entries[i + 2];
+        if (i + length + 3 > header.mLength || entries[i + length + 2] != length) {
+            return false;
+        }
+        i += length + 3;
+
+        char text[256];
+        switch (event) {
+        case NBLogFormat::EVENT_STRING:
+            snprintf(text, sizeof(text), "%.*s", (int) length, (const char *) data);
+            break;
+        case NBLogFormat::EVENT_TIMESTAMP:
+            if (!readTimestamp(data, length, header.mTimestampSize, &timeNs)) {
+                return false;
+            }
+            continue;
+        case NBLogFormat::EVENT_FORMAT:
+            NBLogFormat::decode(text, sizeof(text), data, length);
+            break;
+        default:
+            snprintf(text, sizeof(text), "warning: unknown event %d", event);
+            break;
+        }
+
+        if (!timeline) {
+            if (timeNs >= 0) {
+                printf("[%" PRId64 ".%03d] %s\n", timeNs / 1000000000,
+                        (int) (timeNs % 1000000000 / 1000000), text);
+            } else {
+                printf("%s\n", text);
+            }
+        } else if (timeNs >= 0) {
+            TimelineEvent timelineEvent;
+            timelineEvent.mTimeNs = timeNs;
+            timelineEvent.mDeltaNs = previousNs >= 0 ? timeNs - previousNs : -1;
+            timelineEvent.mLog = name;
+            timelineEvent.mText = text;
+            events->push_back(timelineEvent);
+            previousNs = timeNs;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    bool timeline = false;
+
+    for (int ch; (ch = getopt(argc, argv, "t")) != -1;) {
+        switch (ch) {
+        case 't':
+            timeline = true;
+            break;
+        case '?':
+        default:
+            usage(progname);
+            return EXIT_FAILURE;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc > 1) {
+        usage(progname);
+        return EXIT_FAILURE;
+    }
+
+    FILE* in = stdin;
+    if (argc == 1 && (in = fopen(argv[0], "rb")) == NULL) {
+        perror(argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> dump;
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        dump.insert(dump.end(), buffer, buffer + count);
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    std::vector<TimelineEvent> events;
+    size_t offset = 0;
+    int status = EXIT_SUCCESS;
+    while (offset < dump.size()) {
+        NBLogFormat::RawDumpHeader header;
+        if (dump.size() - offset < sizeof(header)) {
+            fprintf(stderr, "truncated header at offset %zu\n", offset);
+            status = EXIT_FAILURE;
+            break;
+        }
+        memcpy(&header, &dump[offset], sizeof(header));
+        if (header.mMagic != NBLogFormat::RawDumpHeader::kMagic ||
+                header.mVersion != NBLogFormat::RawDumpHeader::kVersion) {
+            fprintf(stderr, "not a raw NBLog dump at offset %zu\n", offset);
+            status = EXIT_FAILURE;
+            break;
+        }
+        offset += sizeof(header);
+        if (dump.size() - offset < (size_t) header.mNameLength + header.mLength) {
+            fprintf(stderr, "truncated log at offset %zu\n", offset);
+            status = EXIT_FAILURE;
+            break;
+        }
+        const std::string name((const char *) &dump[offset], header.mNameLength);
+        offset += header.mNameLength;
+        if (!decodeLog(name, header, &dump[offset], timeline, &events)) {
+            fprintf(stderr, "corrupt entries in log %s\n", name.c_str());
+            status = EXIT_FAILURE;
+        }
+        offset += header.mLength;
+    }
+
+    if (timeline) {
+        std::stable_sort(events.begin(), events.end());
+        for (size_t i = 0; i < events.size(); i++) {
+            const TimelineEvent& event = events[i];
+            printf("%" PRId64 ".%09d\t", event.mTimeNs / 1000000000,
+                    (int) (event.mTimeNs % 1000000000));
+            if (event.mDeltaNs >= 0) {
+                printf("%.3f", event.mDeltaNs * 1e-6);
+            }
+            printf("\t%s\t%s\n", event.mLog.c_str(), event.mText.c_str());
+        }
+    }
+    return status;
+}
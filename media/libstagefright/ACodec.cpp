@@ -4858,7 +4858,8 @@ void ACodec::BaseState::postFillThisBuffer(BufferInfo *info) {
     info->mData->meta()->clear();
     notify->setBuffer("buffer", info->mData);
 
-    sp<AMessage> reply = new AMessage(kWhatInputBufferFilled, mCodec);
+    // the buffer-id, then the buffer or an error
+    sp<AMessage> reply = new AMessage(kWhatInputBufferFilled, mCodec, 3);
     reply->setInt32("buffer-id", info->mBufferID);
 
     notify->setMessage("reply", reply);
@@ -5175,8 +5176,9 @@ bool ACodec::BaseState::onOMXFillBufferDone(
                 break;
             }
 
+            // the buffer-id, the crop of a format change, and the rendering
             sp<AMessage> reply =
-                new AMessage(kWhatOutputBufferDrained, mCodec);
+                new AMessage(kWhatOutputBufferDrained, mCodec, 4);
 
             if (!mCodec->mSentFormat && rangeLength > 0) {
                 mCodec->sendFormatChange(reply);
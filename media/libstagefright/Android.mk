@@ -22,6 +22,7 @@ LOCAL_SRC_FILES:=                         \
         FLACExtractor.cpp                 \
         FrameRenderTracker.cpp            \
         HTTPBase.cpp                      \
+        HTTPDiskCache.cpp                 \
         JPEGSource.cpp                    \
         MP3Extractor.cpp                  \
         MPEG2TSWriter.cpp                 \
@@ -48,6 +49,7 @@ LOCAL_SRC_FILES:=                         \
         OMXClient.cpp                     \
         OggExtractor.cpp                  \
         ProcessInfo.cpp                   \
+        ReadaheadSource.cpp               \
         SampleIterator.cpp                \
         SampleTable.cpp                   \
         SimpleDecodingSource.cpp          \
@@ -78,6 +80,7 @@ LOCAL_C_INCLUDES:= \
 LOCAL_SHARED_LIBRARIES := \
         libbinder \
         libcamera_client \
+        libcrypto \
         libcutils \
         libdl \
         libdrmframework \
@@ -23,6 +23,7 @@
 #include "include/DRMExtractor.h"
 #include "include/FLACExtractor.h"
 #include "include/HTTPBase.h"
+#include "include/HTTPDiskCache.h"
 #include "include/MidiExtractor.h"
 #include "include/MP3Extractor.h"
 #include "include/MPEG2PSExtractor.h"
@@ -50,14 +51,27 @@
 
 namespace android {
 
+ssize_t DataSource::readOrBorrowAt(
+        off64_t offset, size_t size, void *scratch, const void **data) {
+    ssize_t n = borrowAt(offset, size, data);
+    if (n != ERROR_UNSUPPORTED) {
+        return n;
+    }
+
+    *data = scratch;
+    return readAt(offset, scratch, size);
+}
+
 bool DataSource::getUInt16(off64_t offset, uint16_t *x) {
     *x = 0;
 
-    uint8_t byte[2];
-    if (readAt(offset, byte, 2) != 2) {
+    uint8_t tmp[2];
+    const void *data;
+    if (readOrBorrowAt(offset, 2, tmp, &data) != 2) {
         return false;
     }
 
+    const uint8_t *byte = (const uint8_t *)data;
     *x = (byte[0] << 8) | byte[1];
 
     return true;
@@ -66,11 +80,13 @@ bool DataSource::getUInt16(off64_t offset, uint16_t *x) {
 bool DataSource::getUInt24(off64_t offset, uint32_t *x) {
     *x = 0;
 
-    uint8_t byte[3];
-    if (readAt(offset, byte, 3) != 3) {
+    uint8_t tmp[3];
+    const void *data;
+    if (readOrBorrowAt(offset, 3, tmp, &data) != 3) {
         return false;
     }
 
+    const uint8_t *byte = (const uint8_t *)data;
     *x = (byte[0] << 16) | (byte[1] << 8) | byte[2];
 
     return true;
@@ -80,10 +96,15 @@ bool DataSource::getUInt32(off64_t offset, uint32_t *x) {
     *x = 0;
 
     uint32_t tmp;
-    if (readAt(offset, &tmp, 4) != 4) {
+    const void *data;
+    if (readOrBorrowAt(offset, 4, &tmp, &data) != 4) {
         return false;
     }
 
+    if (data != &tmp) {
+        // a borrowed span may not be aligned
+        memcpy(&tmp, data, 4);
+    }
     *x = ntohl(tmp);
 
     return true;
@@ -93,10 +114,15 @@ bool DataSource::getUInt64(off64_t offset, uint64_t *x) {
     *x = 0;
 
     uint64_t tmp;
-    if (readAt(offset, &tmp, 8) != 8) {
+    const void *data;
+    if (readOrBorrowAt(offset, 8, &tmp, &data) != 8) {
         return false;
     }
 
+    if (data != &tmp) {
+        // a borrowed span may not be aligned
+        memcpy(&tmp, data, 8);
+    }
     *x = ntoh64(tmp);
 
     return true;
@@ -246,10 +272,25 @@ sp<DataSource> DataSource::CreateFromURI(
                 *contentType = httpSource->getMIMEType();
             }
 
+            // The pages fetched may be kept on disk, keyed by the request;
+            // not those of private requests.
+            String8 diskCacheKey;
+            const bool mayCache =
+                HTTPDiskCache::MayCache(uri, nonCacheSpecificHeaders);
+            if (mayCache) {
+                diskCacheKey = uri;
+                for (size_t i = 0; i < nonCacheSpecificHeaders.size(); ++i) {
+                    diskCacheKey.appendFormat("\n%s: %s",
+                            nonCacheSpecificHeaders.keyAt(i).string(),
+                            nonCacheSpecificHeaders.valueAt(i).string());
+                }
+            }
+
             source = NuCachedSource2::Create(
                     httpSource,
                     cacheConfig.isEmpty() ? NULL : cacheConfig.string(),
-                    disconnectAtHighwatermark);
+                    disconnectAtHighwatermark,
+                    mayCache ? diskCacheKey.string() : NULL);
         } else {
             // We do not want that prefetching, caching, datasource wrapper
             // in the widevine:// case.
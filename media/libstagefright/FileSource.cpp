@@ -18,10 +18,12 @@
 #define LOG_TAG "FileSource"
 #include <utils/Log.h>
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/FileSource.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -36,12 +38,17 @@ FileSource::FileSource(const char *filename)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mMapping(NULL),
+      mMappingSize(0),
+      mMappedData(NULL),
+      mMappedSize(0) {
 
     mFd = open(filename, O_LARGEFILE | O_RDONLY);
 
     if (mFd >= 0) {
         mLength = lseek64(mFd, 0, SEEK_END);
+        map();
     } else {
         ALOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
     }
@@ -55,12 +62,63 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mMapping(NULL),
+      mMappingSize(0),
+      mMappedData(NULL),
+      mMappedSize(0) {
     CHECK(offset >= 0);
     CHECK(length >= 0);
+
+    map();
+}
+
+// The content is memory mapped if media.stagefright.mmap-file is set, so that
+// reads are copies from memory rather than system calls. It is off by default
+// as the owner of a file can truncate it while mapped, and an access to the
+// pages beyond its new end then raises SIGBUS.
+void FileSource::map() {
+    if (!property_get_bool("media.stagefright.mmap-file", false)) {
+        return;
+    }
+
+    struct stat st;
+    if (mFd < 0 || mLength <= 0 || fstat(mFd, &st) != 0
+            || !S_ISREG(st.st_mode) || mOffset >= st.st_size) {
+        return;
+    }
+
+    int64_t size = mLength;
+    if (size > st.st_size - mOffset) {
+        size = st.st_size - mOffset;
+    }
+    // leave room in the address space of 32-bit processes
+    if ((uint64_t)size > SIZE_MAX / 8) {
+        return;
+    }
+
+    // the offset of a mapping must be a multiple of the page size
+    const int64_t pageSize = sysconf(_SC_PAGESIZE);
+    const int64_t start = mOffset - mOffset % pageSize;
+    const size_t mappingSize = size + (mOffset - start);
+    void *mapping = mmap64(NULL, mappingSize, PROT_READ, MAP_SHARED, mFd, start);
+    if (mapping == MAP_FAILED) {
+        ALOGW("Failed to map %zu bytes (%s), using pread", mappingSize, strerror(errno));
+        return;
+    }
+
+    mMapping = mapping;
+    mMappingSize = mappingSize;
+    mMappedData = (const uint8_t *)mapping + (mOffset - start);
+    mMappedSize = size;
 }
 
 FileSource::~FileSource() {
+    if (mMapping != NULL) {
+        munmap(mMapping, mMappingSize);
+        mMapping = NULL;
+    }
+
     if (mFd >= 0) {
         close(mFd);
         mFd = -1;
@@ -93,8 +151,6 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
         return NO_INIT;
     }
 
-    Mutex::Autolock autoLock(mLock);
-
     if (mLength >= 0) {
         if (offset >= mLength) {
             return 0;  // read beyond EOF.
@@ -107,21 +163,44 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
 
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
+        Mutex::Autolock autoLock(mLock);
         return readAtDRM(offset, data, size);
-   } else {
-        off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-        if (result == -1) {
-            ALOGE("seek to %lld failed", (long long)(offset + mOffset));
-            return UNKNOWN_ERROR;
-        }
+    }
 
-        return ::read(mFd, data, size);
+    if (offset >= 0 && (uint64_t)offset < mMappedSize
+            && size <= mMappedSize - offset) {
+        memcpy(data, mMappedData + offset, size);
+        return size;
     }
+
+    // pread() does not move the file offset, so concurrent reads need no lock
+    return pread64(mFd, data, size, offset + mOffset);
 }
 
-status_t FileSource::getSize(off64_t *size) {
-    Mutex::Autolock autoLock(mLock);
+ssize_t FileSource::borrowAt(off64_t offset, size_t size, const void **data) {
+    if (mMappedData == NULL || mDecryptHandle != NULL) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    if (offset < 0) {
+        return UNKNOWN_ERROR;
+    }
+    if ((uint64_t)offset >= mMappedSize) {
+        if (offset < mLength) {
+            // the file is shorter than the content
+            return ERROR_UNSUPPORTED;
+        }
+        return 0;  // borrow beyond EOF.
+    }
+    if (size > mMappedSize - offset) {
+        size = mMappedSize - offset;
+    }
 
+    *data = mMappedData + offset;
+    return size;
+}
+
+status_t FileSource::getSize(off64_t *size) {
     if (mFd < 0) {
         return NO_INIT;
     }
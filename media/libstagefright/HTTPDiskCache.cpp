@@ -0,0 +1,521 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "HTTPDiskCache"
+#include <utils/Log.h>
+
+#include "include/HTTPDiskCache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/sha.h>
+#include <strings.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/threads.h>
+
+namespace android {
+
+static const char *kDefaultDir = "/data/misc/media/httpcache";
+static const char *kDataSuffix = ".data";
+static const char *kIndexSuffix = ".index";
+static const uint32_t kIndexMagic = 'hdc2';
+
+// The headers of a request carrying credentials.
+static const char *kPrivateHeaders[] = {
+    "Authorization",
+    "Cookie",
+    "Proxy-Authorization",
+};
+
+// The index file is this header, followed by the MIME type and the bitmap of
+// the blocks cached. The key is not stored, as it may hold private URLs.
+struct IndexHeader {
+    uint32_t mMagic;
+    uint32_t mBlockSize;
+    int64_t mSize;
+    uint8_t mKeyDigest[SHA256_DIGEST_LENGTH];
+    uint32_t mMimeTypeLength;
+};
+
+// Serializes the opening, closing and trimming of the entries of the process.
+static Mutex gLock;
+
+// The name of an entry is the start of its key digest, the whole digest is
+// checked against the one in the index.
+static String8 EntryName(const uint8_t *digest) {
+    String8 name;
+    for (size_t i = 0; i < 8; ++i) {
+        name.appendFormat("%02x", digest[i]);
+    }
+    return name;
+}
+
+static bool ReadFully(int fd, void *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(read(fd, data, size));
+        if (n <= 0) {
+            return false;
+        }
+        data = (uint8_t *)data + n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool WriteFully(int fd, const void *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(write(fd, data, size));
+        if (n <= 0) {
+            return false;
+        }
+        data = (const uint8_t *)data + n;
+        size -= n;
+    }
+    return true;
+}
+
+// static
+bool HTTPDiskCache::MayCache(
+        const char *uri, const KeyedVector<String8, String8> &headers) {
+    return MayCache(uri, headers,
+            property_get_bool("media.stagefright.http-cache-private", false));
+}
+
+// static
+bool HTTPDiskCache::MayCache(
+        const char *uri, const KeyedVector<String8, String8> &headers,
+        bool cachePrivate) {
+    bool isPrivate = !strncasecmp(uri, "https://", 8);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        const char *name = headers.keyAt(i).string();
+        if (!strcasecmp(name, "x-hide-urls-from-log")) {
+            return false;
+        }
+        for (size_t j = 0; j < NELEM(kPrivateHeaders); ++j) {
+            if (!strcasecmp(name, kPrivateHeaders[j])) {
+                isPrivate = true;
+            }
+        }
+    }
+    return !isPrivate || cachePrivate;
+}
+
+// static
+sp<HTTPDiskCache> HTTPDiskCache::Open(
+        const String8 &key, off64_t size, const String8 &mimeType) {
+    int32_t maxMBytes = property_get_int32("media.stagefright.http-cache-mb", 0);
+    if (maxMBytes <= 0) {
+        return NULL;
+    }
+
+    char dir[PROPERTY_VALUE_MAX];
+    property_get("media.stagefright.http-cache-dir", dir, kDefaultDir);
+
+    return Open(dir, (size_t)maxMBytes * 1024 * 1024, kDefaultBlockSize,
+            key, size, mimeType);
+}
+
+// static
+sp<HTTPDiskCache> HTTPDiskCache::Open(
+        const char *dir, size_t maxBytes, size_t blockSize,
+        const String8 &key, off64_t size, const String8 &mimeType) {
+    if (size <= 0 || blockSize == 0 || maxBytes < blockSize) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(gLock);
+
+    sp<HTTPDiskCache> cache =
+        new HTTPDiskCache(dir, maxBytes, blockSize, key, size, mimeType);
+
+    status_t err = cache->init();
+    if (err != OK) {
+        ALOGV("cannot open the entry %s (%d)", cache->mName.string(), err);
+        return NULL;
+    }
+
+    Trim(dir, maxBytes, cache->mName);
+
+    ALOGV("opened the entry %s, %zu blocks cached",
+          cache->mName.string(), cache->mNumBlocksCached);
+
+    return cache;
+}
+
+HTTPDiskCache::HTTPDiskCache(
+        const char *dir, size_t maxBytes, size_t blockSize,
+        const String8 &key, off64_t size, const String8 &mimeType)
+    : mDir(dir),
+      mFd(-1),
+      mMaxBytes(maxBytes),
+      mBlockSize(blockSize),
+      mSize(size),
+      mMimeType(mimeType),
+      mNumBlocksCached(0),
+      mNumBlocksDirty(0),
+      mValidated(false) {
+    SHA256((const uint8_t *)key.string(), key.length(), mKeyDigest);
+    mName = EntryName(mKeyDigest);
+    mDataPath = String8::format(
+            "%s/%s%s", dir, mName.string(), kDataSuffix);
+    mIndexPath = String8::format(
+            "%s/%s%s", dir, mName.string(), kIndexSuffix);
+}
+
+HTTPDiskCache::~HTTPDiskCache() {
+    if (mFd < 0) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(gLock);
+
+    flush();
+    Trim(mDir.string(), mMaxBytes, mName);
+
+    // Closing the file releases the entry.
+    close(mFd);
+    mFd = -1;
+}
+
+status_t HTTPDiskCache::init() {
+    if (mkdir(mDir.string(), 0700) != 0 && errno != EEXIST) {
+        return -errno;
+    }
+
+    mFd = open(mDataPath.string(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (mFd < 0) {
+        return -errno;
+    }
+
+    // Another instance may be playing the same resource.
+    if (flock(mFd, LOCK_EX | LOCK_NB) != 0) {
+        status_t err = -errno;
+        close(mFd);
+        mFd = -1;
+        return err;
+    }
+
+    size_t numBlocks = (mSize + mBlockSize - 1) / mBlockSize;
+    mBlocks.insertAt((uint8_t)0, 0, (numBlocks + 7) / 8);
+
+    if (readIndex()) {
+        // The entry is the most recently used one.
+        utimes(mIndexPath.string(), NULL);
+    } else {
+        reset();
+    }
+
+    // There is nothing to check an empty entry against.
+    mValidated = (mNumBlocksCached == 0);
+
+    return OK;
+}
+
+bool HTTPDiskCache::readIndex() {
+    int fd = open(mIndexPath.string(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    IndexHeader header;
+    bool valid = ReadFully(fd, &header, sizeof(header))
+            && header.mMagic == kIndexMagic
+            && header.mBlockSize == mBlockSize
+            && header.mSize == mSize
+            && !memcmp(header.mKeyDigest, mKeyDigest, sizeof(mKeyDigest))
+            && header.mMimeTypeLength == mMimeType.length();
+
+    if (valid) {
+        Vector<char> mimeType;
+        mimeType.insertAt((char)0, 0, mMimeType.length());
+
+        valid = ReadFully(fd, mimeType.editArray(), mimeType.size())
+                && !memcmp(mimeType.array(),
+                           mMimeType.string(), mMimeType.length())
+                && ReadFully(fd, mBlocks.editArray(), mBlocks.size());
+    }
+
+    close(fd);
+
+    if (!valid) {
+        ALOGI("dropping the stale entry %s", mName.string());
+        return false;
+    }
+
+    mNumBlocksCached = 0;
+    for (size_t i = 0; i < mBlocks.size(); ++i) {
+        mNumBlocksCached += __builtin_popcount(mBlocks[i]);
+    }
+
+    return true;
+}
+
+void HTTPDiskCache::reset() {
+    // The index goes first, it must never list a block not in the data file.
+    unlink(mIndexPath.string());
+    ftruncate(mFd, 0);
+
+    for (size_t i = 0; i < mBlocks.size(); ++i) {
+        mBlocks.editItemAt(i) = 0;
+    }
+    mNumBlocksCached = 0;
+    mNumBlocksDirty = 0;
+}
+
+void HTTPDiskCache::flush() {
+    if (mNumBlocksDirty == 0) {
+        return;
+    }
+
+    // The blocks listed by the new index must be on disk before it.
+    fdatasync(mFd);
+
+    String8 tmpPath = mIndexPath;
+    tmpPath.append(".tmp");
+
+    int fd = open(tmpPath.string(),
+            O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        ALOGW("cannot write the index of %s (%d)", mName.string(), -errno);
+        return;
+    }
+
+    IndexHeader header;
+    header.mMagic = kIndexMagic;
+    header.mBlockSize = mBlockSize;
+    header.mSize = mSize;
+    memcpy(header.mKeyDigest, mKeyDigest, sizeof(mKeyDigest));
+    header.mMimeTypeLength = mMimeType.length();
+
+    bool success = WriteFully(fd, &header, sizeof(header))
+            && WriteFully(fd, mMimeType.string(), mMimeType.length())
+            && WriteFully(fd, mBlocks.array(), mBlocks.size())
+            && fsync(fd) == 0;
+
+    close(fd);
+
+    if (!success || rename(tmpPath.string(), mIndexPath.string()) != 0) {
+        ALOGW("cannot write the index of %s", mName.string());
+        unlink(tmpPath.string());
+        return;
+    }
+
+    mNumBlocksDirty = 0;
+}
+
+bool HTTPDiskCache::isCached(size_t block) const {
+    return mBlocks[block / 8] & (1 << (block % 8));
+}
+
+size_t HTTPDiskCache::blockLength(size_t block) const {
+    off64_t remaining = mSize - (off64_t)block * mBlockSize;
+    return remaining < (off64_t)mBlockSize ? remaining : mBlockSize;
+}
+
+ssize_t HTTPDiskCache::read(off64_t offset, void *data, size_t size) {
+    if (!mValidated || offset < 0) {
+        return 0;
+    }
+
+    size_t copied = 0;
+    while (copied < size) {
+        off64_t position = offset + copied;
+        if (position >= mSize) {
+            break;
+        }
+
+        size_t block = position / mBlockSize;
+        if (!isCached(block)) {
+            break;
+        }
+
+        size_t skip = position - (off64_t)block * mBlockSize;
+        size_t n = blockLength(block) - skip;
+        if (n > size - copied) {
+            n = size - copied;
+        }
+
+        ssize_t result = pread64(mFd, (uint8_t *)data + copied, n, position);
+        if (result != (ssize_t)n) {
+            ALOGW("cannot read block %zu of %s", block, mName.string());
+            break;
+        }
+
+        copied += n;
+    }
+
+    return copied;
+}
+
+void HTTPDiskCache::write(off64_t offset, const void *data, size_t size) {
+    if (offset < 0) {
+        return;
+    }
+
+    const off64_t end = offset + size;
+
+    // the first block starting in the range
+    size_t block = (offset + mBlockSize - 1) / mBlockSize;
+
+    for (; (off64_t)block * mBlockSize < mSize; ++block) {
+        const off64_t blockOffset = (off64_t)block * mBlockSize;
+        const size_t length = blockLength(block);
+        if (blockOffset + (off64_t)length > end) {
+            break;
+        }
+
+        const uint8_t *blockData = (const uint8_t *)data + (blockOffset - offset);
+
+        if (isCached(block)) {
+            if (mValidated) {
+                continue;
+            }
+
+            validate(block, blockData);
+            if (isCached(block)) {
+                continue;
+            }
+        }
+
+        if ((mNumBlocksCached + 1) * mBlockSize > mMaxBytes) {
+            break;
+        }
+
+        if (pwrite64(mFd, blockData, length, blockOffset) != (ssize_t)length) {
+            ALOGW("cannot write block %zu of %s (%d)",
+                  block, mName.string(), -errno);
+            break;
+        }
+
+        mBlocks.editItemAt(block / 8) |= 1 << (block % 8);
+        ++mNumBlocksCached;
+        ++mNumBlocksDirty;
+    }
+
+    if (mNumBlocksDirty >= kFlushBlocks) {
+        flush();
+    }
+}
+
+void HTTPDiskCache::validate(size_t block, const uint8_t *data) {
+    const size_t length = blockLength(block);
+
+    Vector<uint8_t> cached;
+    cached.insertAt((uint8_t)0, 0, length);
+
+    const off64_t blockOffset = (off64_t)block * mBlockSize;
+    if (pread64(mFd, cached.editArray(), length, blockOffset) == (ssize_t)length
+            && !memcmp(cached.array(), data, length)) {
+        ALOGV("entry %s validated by block %zu", mName.string(), block);
+    } else {
+        ALOGI("the resource of %s changed, dropping it", mName.string());
+        reset();
+    }
+
+    mValidated = true;
+}
+
+// static
+void HTTPDiskCache::Trim(
+        const char *dir, size_t maxBytes, const String8 &except) {
+    struct Entry {
+        String8 mName;
+        off64_t mBytes;
+        time_t mLastUse;
+    };
+
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        return;
+    }
+
+    Vector<Entry> entries;
+    off64_t totalBytes = 0;
+
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        const size_t length = strlen(ent->d_name);
+        const size_t suffixLength = strlen(kDataSuffix);
+        if (length <= suffixLength
+                || strcmp(ent->d_name + length - suffixLength, kDataSuffix)) {
+            continue;
+        }
+
+        Entry entry;
+        entry.mName.setTo(ent->d_name, length - suffixLength);
+
+        struct stat64 st;
+        String8 path = String8::format("%s/%s", dir, ent->d_name);
+        if (stat64(path.string(), &st) != 0) {
+            continue;
+        }
+
+        // The data file is sparse, only the blocks stored count.
+        entry.mBytes = (off64_t)st.st_blocks * 512;
+        entry.mLastUse = st.st_mtime;
+
+        path = String8::format("%s/%s%s", dir, entry.mName.string(), kIndexSuffix);
+        if (stat64(path.string(), &st) == 0 && st.st_mtime > entry.mLastUse) {
+            entry.mLastUse = st.st_mtime;
+        }
+
+        totalBytes += entry.mBytes;
+        if (entry.mName != except) {
+            entries.push_back(entry);
+        }
+    }
+
+    closedir(d);
+
+    while (totalBytes > (off64_t)maxBytes && !entries.isEmpty()) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < entries.size(); ++i) {
+            if (entries[i].mLastUse < entries[oldest].mLastUse) {
+                oldest = i;
+            }
+        }
+
+        const Entry &entry = entries[oldest];
+        String8 dataPath = String8::format(
+                "%s/%s%s", dir, entry.mName.string(), kDataSuffix);
+
+        int fd = open(dataPath.string(), O_RDWR | O_CLOEXEC);
+        if (fd >= 0) {
+            if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+                ALOGV("removing the entry %s, %lld bytes",
+                      entry.mName.string(), (long long)entry.mBytes);
+
+                unlink(String8::format("%s/%s%s",
+                        dir, entry.mName.string(), kIndexSuffix).string());
+                unlink(dataPath.string());
+                totalBytes -= entry.mBytes;
+            }
+            close(fd);
+        }
+
+        entries.removeAt(oldest);
+    }
+}
+
+}  // namespace android
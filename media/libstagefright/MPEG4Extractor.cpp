@@ -26,6 +26,7 @@
 #include <utils/Log.h>
 
 #include "include/MPEG4Extractor.h"
+#include "include/ReadaheadSource.h"
 #include "include/SampleTable.h"
 #include "include/ESDS.h"
 
@@ -60,7 +61,8 @@ public:
                 const sp<SampleTable> &sampleTable,
                 Vector<SidxEntry> &sidx,
                 const Trex *trex,
-                off64_t firstMoofOffset);
+                off64_t firstMoofOffset,
+                const sp<ReadaheadSource> &readahead);
 
     virtual status_t start(MetaData *params = NULL);
     virtual status_t stop();
@@ -120,7 +122,14 @@ private:
 
     uint8_t *mSrcBuffer;
 
+    // If set, mDataSource too; the samples up to kReadaheadUs after the one
+    // being read are announced to it
+    sp<ReadaheadSource> mReadahead;
+    // the next sample to announce
+    uint32_t mReadaheadIndex;
+
     size_t parseNALSize(const uint8_t *data) const;
+    void readahead(uint32_t decodingTime);
     status_t parseChunk(off64_t *offset);
     status_t parseTrackFragmentHeader(off64_t offset, off64_t size);
     status_t parseTrackFragmentRun(off64_t offset, off64_t size);
@@ -176,6 +185,7 @@ struct MPEG4DataSource : public DataSource {
 
     virtual status_t initCheck() const;
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+    virtual ssize_t borrowAt(off64_t offset, size_t size, const void **data);
     virtual status_t getSize(off64_t *size);
     virtual uint32_t flags();
 
@@ -234,6 +244,18 @@ ssize_t MPEG4DataSource::readAt(off64_t offset, void *data, size_t size) {
     return mSource->readAt(offset, data, size);
 }
 
+ssize_t MPEG4DataSource::borrowAt(off64_t offset, size_t size, const void **data) {
+    Mutex::Autolock autoLock(mLock);
+
+    // the cache is only set once, when the source is created
+    if (isInRange(mCachedOffset, mCachedSize, offset, size)) {
+        *data = &mCache[offset - mCachedOffset];
+        return size;
+    }
+
+    return mSource->borrowAt(offset, size, data);
+}
+
 status_t MPEG4DataSource::getSize(off64_t *size) {
     return mSource->getSize(size);
 }
@@ -271,6 +293,9 @@ status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
 
 static const bool kUseHexDump = false;
 
+// How far ahead of the sample being read MPEG4Source reads local files
+static const int64_t kReadaheadUs = 1000000ll;
+
 static void hexdump(const void *_data, size_t size) {
     const uint8_t *data = (const uint8_t *)_data;
     size_t offset = 0;
@@ -1700,35 +1725,47 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         {
             *offset += chunk_size;
 
-            sp<ABuffer> buffer = new ABuffer(chunk_data_size);
+            // the box is copied into the metadata, read it in place if possible
+            const void *data;
+            sp<ABuffer> buffer;
+            if (mDataSource->borrowAt(data_offset, chunk_data_size, &data) < chunk_data_size) {
+                buffer = new ABuffer(chunk_data_size);
 
-            if (mDataSource->readAt(
-                        data_offset, buffer->data(), chunk_data_size) < chunk_data_size) {
-                return ERROR_IO;
+                if (mDataSource->readAt(
+                            data_offset, buffer->data(), chunk_data_size) < chunk_data_size) {
+                    return ERROR_IO;
+                }
+                data = buffer->data();
             }
 
             if (mLastTrack == NULL)
                 return ERROR_MALFORMED;
 
             mLastTrack->meta->setData(
-                    kKeyAVCC, kTypeAVCC, buffer->data(), chunk_data_size);
+                    kKeyAVCC, kTypeAVCC, data, chunk_data_size);
 
             break;
         }
         case FOURCC('h', 'v', 'c', 'C'):
         {
-            sp<ABuffer> buffer = new ABuffer(chunk_data_size);
+            // the box is copied into the metadata, read it in place if possible
+            const void *data;
+            sp<ABuffer> buffer;
+            if (mDataSource->borrowAt(data_offset, chunk_data_size, &data) < chunk_data_size) {
+                buffer = new ABuffer(chunk_data_size);
 
-            if (mDataSource->readAt(
-                        data_offset, buffer->data(), chunk_data_size) < chunk_data_size) {
-                return ERROR_IO;
+                if (mDataSource->readAt(
+                            data_offset, buffer->data(), chunk_data_size) < chunk_data_size) {
+                    return ERROR_IO;
+                }
+                data = buffer->data();
             }
 
             if (mLastTrack == NULL)
                 return ERROR_MALFORMED;
 
             mLastTrack->meta->setData(
-                    kKeyHVCC, kTypeHVCC, buffer->data(), chunk_data_size);
+                    kKeyHVCC, kTypeHVCC, data, chunk_data_size);
 
             *offset += chunk_size;
             break;
@@ -2855,9 +2892,24 @@ sp<MediaSource> MPEG4Extractor::getTrack(size_t index) {
 
     ALOGV("getTrack called, pssh: %zu", mPssh.size());
 
+    // Local files read the samples of their tracks ahead, so that the tracks
+    // do not seek back and forth in the file for each sample. Mapped files
+    // lend their bytes instead, and are paged in by the kernel.
+    const void *data;
+    if (mReadahead == NULL && mMoofOffset == 0
+            && !(mDataSource->flags() & (DataSource::kWantsPrefetching
+                    | DataSource::kIsCachingDataSource
+                    | DataSource::kIsHTTPBasedSource))
+            && mDataSource->borrowAt(0, 1, &data) == ERROR_UNSUPPORTED) {
+        size_t budget = ReadaheadSource::DefaultBudgetBytes();
+        if (budget > 0) {
+            mReadahead = new ReadaheadSource(mDataSource, budget);
+        }
+    }
+
     return new MPEG4Source(this,
             track->meta, mDataSource, track->timescale, track->sampleTable,
-            mSidxEntries, trex, mMoofOffset);
+            mSidxEntries, trex, mMoofOffset, mReadahead);
 }
 
 // static
@@ -3242,7 +3294,8 @@ MPEG4Source::MPEG4Source(
         const sp<SampleTable> &sampleTable,
         Vector<SidxEntry> &sidx,
         const Trex *trex,
-        off64_t firstMoofOffset)
+        off64_t firstMoofOffset,
+        const sp<ReadaheadSource> &readahead)
     : mOwner(owner),
       mFormat(format),
       mDataSource(dataSource),
@@ -3266,7 +3319,13 @@ MPEG4Source::MPEG4Source(
       mGroup(NULL),
       mBuffer(NULL),
       mWantsNALFragments(false),
-      mSrcBuffer(NULL) {
+      mSrcBuffer(NULL),
+      mReadahead(readahead),
+      mReadaheadIndex(0) {
+
+    if (mReadahead != NULL) {
+        mDataSource = mReadahead;
+    }
 
     memset(&mTrackFragmentHeaderInfo, 0, sizeof(mTrackFragmentHeaderInfo));
 
@@ -3978,6 +4037,28 @@ size_t MPEG4Source::parseNALSize(const uint8_t *data) const {
     return 0;
 }
 
+void MPEG4Source::readahead(uint32_t decodingTime) {
+    if (mReadaheadIndex <= mCurrentSampleIndex) {
+        mReadaheadIndex = mCurrentSampleIndex + 1;
+    }
+
+    const uint64_t horizon =
+        decodingTime + (uint64_t)mTimescale * kReadaheadUs / 1000000;
+    const uint32_t numSamples = mSampleTable->countSamples();
+    while (mReadaheadIndex < numSamples) {
+        off64_t offset;
+        size_t size;
+        uint32_t time;
+        if (mSampleTable->getSampleAhead(
+                    mReadaheadIndex, &offset, &size, &time) != OK
+                || time > horizon
+                || !mReadahead->prefetch(offset, size)) {
+            break;
+        }
+        ++mReadaheadIndex;
+    }
+}
+
 status_t MPEG4Source::read(
         MediaBuffer **out, const ReadOptions *options) {
     Mutex::Autolock autoLock(mLock);
@@ -3991,10 +4072,12 @@ status_t MPEG4Source::read(
     *out = NULL;
 
     int64_t targetSampleTimeUs = -1;
+    bool seeking = false;
 
     int64_t seekTimeUs;
     ReadOptions::SeekMode mode;
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
+        seeking = true;
         uint32_t findFlags = 0;
         switch (mode) {
             case ReadOptions::SEEK_PREVIOUS_SYNC:
@@ -4066,6 +4149,7 @@ status_t MPEG4Source::read(
 #endif
 
         mCurrentSampleIndex = syncSampleIndex;
+        mReadaheadIndex = 0;
         if (mBuffer != NULL) {
             mBuffer->release();
             mBuffer = NULL;
@@ -4076,7 +4160,7 @@ status_t MPEG4Source::read(
 
     off64_t offset;
     size_t size;
-    uint32_t cts, stts;
+    uint32_t cts, stts, dts;
     bool isSyncSample;
     bool newBuffer = false;
     if (mBuffer == NULL) {
@@ -4084,12 +4168,18 @@ status_t MPEG4Source::read(
 
         status_t err =
             mSampleTable->getMetaDataForSample(
-                    mCurrentSampleIndex, &offset, &size, &cts, &isSyncSample, &stts);
+                    mCurrentSampleIndex, &offset, &size, &cts, &isSyncSample, &stts, &dts);
 
         if (err != OK) {
             return err;
         }
 
+        // not on a seek, which may only be to read a thumbnail. The horizon is
+        // in decoding time, as are the times of the samples read ahead.
+        if (mReadahead != NULL && !seeking) {
+            readahead(dts);
+        }
+
         err = mGroup->acquire_buffer(&mBuffer);
 
         if (err != OK) {
@@ -684,7 +684,8 @@ status_t MediaCodec::queueInputBuffer(
         errorDetailMsg->clear();
     }
 
-    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffer, this);
+    // with the replyID
+    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffer, this, 7);
     msg->setSize("index", index);
     msg->setSize("offset", offset);
     msg->setSize("size", size);
@@ -711,7 +712,8 @@ status_t MediaCodec::queueSecureInputBuffer(
         errorDetailMsg->clear();
     }
 
-    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffer, this);
+    // with the replyID
+    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffer, this, 11);
     msg->setSize("index", index);
     msg->setSize("offset", offset);
     msg->setPointer("subSamples", (void *)subSamples);
@@ -770,7 +772,7 @@ status_t MediaCodec::dequeueOutputBuffer(
 }
 
 status_t MediaCodec::renderOutputBufferAndRelease(size_t index) {
-    sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this);
+    sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this, 3);
     msg->setSize("index", index);
     msg->setInt32("render", true);
 
@@ -779,7 +781,7 @@ status_t MediaCodec::renderOutputBufferAndRelease(size_t index) {
 }
 
 status_t MediaCodec::renderOutputBufferAndRelease(size_t index, int64_t timestampNs) {
-    sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this);
+    sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this, 4);
     msg->setSize("index", index);
     msg->setInt32("render", true);
     msg->setInt64("timestampNs", timestampNs);
@@ -789,7 +791,7 @@ status_t MediaCodec::renderOutputBufferAndRelease(size_t index, int64_t timestam
 }
 
 status_t MediaCodec::releaseOutputBuffer(size_t index) {
-    sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this);
+    sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this, 2);
     msg->setSize("index", index);
 
     sp<AMessage> response;
@@ -22,65 +22,98 @@
 
 #include "include/NuCachedSource2.h"
 #include "include/HTTPBase.h"
+#include "include/HTTPDiskCache.h"
 
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaErrors.h>
+#include <utils/Vector.h>
 
 namespace android {
 
+// The bytes behind the last read kept cached in the window, for the reads
+// going back a little.
+static const off64_t kGrayArea = 1024 * 1024;
+
+// The pages cached, possibly from several disjoint regions of the source. The
+// pages do not overlap, and are kept sorted by offset so that the page holding
+// an offset is found with a binary search. Each access to a page stamps it, so
+// that the least recently used pages are released first.
 struct PageCache {
     explicit PageCache(size_t pageSize);
     ~PageCache();
 
     struct Page {
+        off64_t mOffset;
         void *mData;
         size_t mSize;
+        uint64_t mLastUse;
     };
 
     Page *acquirePage();
     void releasePage(Page *page);
 
-    void appendPage(Page *page);
-    size_t releaseFromStart(size_t maxBytes);
+    // The page must hold page->mSize bytes from offset, and not overlap any
+    // page cached.
+    void insertPage(off64_t offset, Page *page);
+
+    // Releases the least recently used pages not overlapping [keepFrom, keepTo)
+    // until at least maxBytes are released, or no such page is left.
+    size_t releaseLeastRecentlyUsed(
+            size_t maxBytes, off64_t keepFrom, off64_t keepTo);
 
     size_t totalSize() const {
         return mTotalSize;
     }
 
-    void copy(size_t from, void *data, size_t size);
+    // Returns the number of bytes cached contiguously from offset, up to
+    // maxSize.
+    size_t contiguousSize(off64_t offset, size_t maxSize = SIZE_MAX) const;
+
+    // Returns the number of bytes from offset, which is not cached, to the
+    // next page cached, up to maxSize.
+    size_t gapSize(off64_t offset, size_t maxSize) const;
+
+    // The range must be cached contiguously.
+    void copy(off64_t from, void *data, size_t size);
 
 private:
     size_t mPageSize;
     size_t mTotalSize;
+    uint64_t mUseCount;
 
-    List<Page *> mActivePages;
+    Vector<Page *> mActivePages;
     List<Page *> mFreePages;
 
-    void freePages(List<Page *> *list);
+    // Returns the index of the first page starting after offset.
+    size_t upperBound(off64_t offset) const;
+    // Returns the index of the page holding offset, or -1.
+    ssize_t findPage(off64_t offset) const;
 
     DISALLOW_EVIL_CONSTRUCTORS(PageCache);
 };
 
 PageCache::PageCache(size_t pageSize)
     : mPageSize(pageSize),
-      mTotalSize(0) {
+      mTotalSize(0),
+      mUseCount(0) {
 }
 
 PageCache::~PageCache() {
-    freePages(&mActivePages);
-    freePages(&mFreePages);
-}
+    for (size_t i = 0; i < mActivePages.size(); ++i) {
+        Page *page = mActivePages[i];
 
-void PageCache::freePages(List<Page *> *list) {
-    List<Page *>::iterator it = list->begin();
-    while (it != list->end()) {
+        free(page->mData);
+        delete page;
+    }
+
+    List<Page *>::iterator it = mFreePages.begin();
+    while (it != mFreePages.end()) {
         Page *page = *it;
 
         free(page->mData);
         delete page;
-        page = NULL;
 
         ++it;
     }
@@ -96,8 +129,10 @@ PageCache::Page *PageCache::acquirePage() {
     }
 
     Page *page = new Page;
+    page->mOffset = 0;
     page->mData = malloc(mPageSize);
     page->mSize = 0;
+    page->mLastUse = 0;
 
     return page;
 }
@@ -107,28 +142,77 @@ void PageCache::releasePage(Page *page) {
     mFreePages.push_back(page);
 }
 
-void PageCache::appendPage(Page *page) {
+size_t PageCache::upperBound(off64_t offset) const {
+    size_t lo = 0;
+    size_t hi = mActivePages.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (mActivePages[mid]->mOffset <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+ssize_t PageCache::findPage(off64_t offset) const {
+    size_t index = upperBound(offset);
+    if (index == 0) {
+        return -1;
+    }
+
+    const Page *page = mActivePages[index - 1];
+    if (offset < page->mOffset + (off64_t)page->mSize) {
+        return index - 1;
+    }
+    return -1;
+}
+
+void PageCache::insertPage(off64_t offset, Page *page) {
+    size_t index = upperBound(offset);
+
+    CHECK(index == 0
+            || mActivePages[index - 1]->mOffset
+                + (off64_t)mActivePages[index - 1]->mSize <= offset);
+    CHECK(index == mActivePages.size()
+            || offset + (off64_t)page->mSize <= mActivePages[index]->mOffset);
+
+    page->mOffset = offset;
+    page->mLastUse = ++mUseCount;
+
+    mActivePages.insertAt(page, index);
     mTotalSize += page->mSize;
-    mActivePages.push_back(page);
 }
 
-size_t PageCache::releaseFromStart(size_t maxBytes) {
+size_t PageCache::releaseLeastRecentlyUsed(
+        size_t maxBytes, off64_t keepFrom, off64_t keepTo) {
     size_t bytesReleased = 0;
 
-    while (maxBytes > 0 && !mActivePages.empty()) {
-        List<Page *>::iterator it = mActivePages.begin();
-
-        Page *page = *it;
+    while (bytesReleased < maxBytes) {
+        ssize_t oldest = -1;
+        for (size_t i = 0; i < mActivePages.size(); ++i) {
+            const Page *page = mActivePages[i];
+            if (page->mOffset < keepTo
+                    && page->mOffset + (off64_t)page->mSize > keepFrom) {
+                continue;
+            }
+            if (oldest < 0 || page->mLastUse < mActivePages[oldest]->mLastUse) {
+                oldest = i;
+            }
+        }
 
-        if (maxBytes < page->mSize) {
+        if (oldest < 0) {
             break;
         }
 
-        mActivePages.erase(it);
+        Page *page = mActivePages[oldest];
+        mActivePages.removeAt(oldest);
 
-        maxBytes -= page->mSize;
-        bytesReleased += page->mSize;
+        ALOGV("releasing %zu bytes at %lld",
+              page->mSize, (long long)page->mOffset);
 
+        bytesReleased += page->mSize;
         releasePage(page);
     }
 
@@ -136,44 +220,63 @@ size_t PageCache::releaseFromStart(size_t maxBytes) {
     return bytesReleased;
 }
 
-void PageCache::copy(size_t from, void *data, size_t size) {
-    ALOGV("copy from %zu size %zu", from, size);
+size_t PageCache::contiguousSize(off64_t offset, size_t maxSize) const {
+    ssize_t index = findPage(offset);
+    if (index < 0) {
+        return 0;
+    }
 
-    if (size == 0) {
-        return;
+    const Page *page = mActivePages[index];
+    off64_t end = page->mOffset + page->mSize;
+    while ((size_t)(end - offset) < maxSize
+            && (size_t)++index < mActivePages.size()
+            && mActivePages[index]->mOffset == end) {
+        end += mActivePages[index]->mSize;
     }
 
-    CHECK_LE(from + size, mTotalSize);
+    size_t size = end - offset;
+    return size < maxSize ? size : maxSize;
+}
 
-    size_t offset = 0;
-    List<Page *>::iterator it = mActivePages.begin();
-    while (from >= offset + (*it)->mSize) {
-        offset += (*it)->mSize;
-        ++it;
+size_t PageCache::gapSize(off64_t offset, size_t maxSize) const {
+    size_t index = upperBound(offset);
+    if (index == mActivePages.size()) {
+        return maxSize;
     }
 
-    size_t delta = from - offset;
-    size_t avail = (*it)->mSize - delta;
+    off64_t gap = mActivePages[index]->mOffset - offset;
+    return gap < (off64_t)maxSize ? gap : maxSize;
+}
 
-    if (avail >= size) {
-        memcpy(data, (const uint8_t *)(*it)->mData + delta, size);
+void PageCache::copy(off64_t from, void *data, size_t size) {
+    ALOGV("copy from %lld size %zu", (long long)from, size);
+
+    if (size == 0) {
         return;
     }
 
-    memcpy(data, (const uint8_t *)(*it)->mData + delta, avail);
-    ++it;
-    data = (uint8_t *)data + avail;
-    size -= avail;
+    ssize_t index = findPage(from);
+    CHECK_GE(index, 0);
 
     while (size > 0) {
-        size_t copy = (*it)->mSize;
+        CHECK_LT((size_t)index, mActivePages.size());
+
+        Page *page = mActivePages[index];
+        CHECK_LE(page->mOffset, from);
+
+        size_t delta = from - page->mOffset;
+        size_t copy = page->mSize - delta;
         if (copy > size) {
             copy = size;
         }
-        memcpy(data, (*it)->mData, copy);
+
+        memcpy(data, (const uint8_t *)page->mData + delta, copy);
+        page->mLastUse = ++mUseCount;
+
         data = (uint8_t *)data + copy;
+        from += copy;
         size -= copy;
-        ++it;
+        ++index;
     }
 }
 
@@ -182,12 +285,14 @@ void PageCache::copy(size_t from, void *data, size_t size) {
 NuCachedSource2::NuCachedSource2(
         const sp<DataSource> &source,
         const char *cacheConfig,
-        bool disconnectAtHighwatermark)
+        bool disconnectAtHighwatermark,
+        const char *diskCacheKey)
     : mSource(source),
       mReflector(new AHandlerReflector<NuCachedSource2>(this)),
       mLooper(new ALooper),
       mCache(new PageCache(kPageSize)),
       mCacheOffset(0),
+      mCacheEnd(0),
       mFinalStatus(OK),
       mLastAccessPos(0),
       mFetching(true),
@@ -197,7 +302,9 @@ NuCachedSource2::NuCachedSource2(
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
-      mDisconnectAtHighwatermark(disconnectAtHighwatermark) {
+      mDisconnectAtHighwatermark(disconnectAtHighwatermark),
+      mDiskCacheKey(diskCacheKey != NULL ? diskCacheKey : ""),
+      mDiskCacheOpened(false) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
     // and we are not guaranteeing support for client-specified cache
     // parameters. Both of these are temporary measures to solve a specific
@@ -238,9 +345,10 @@ NuCachedSource2::~NuCachedSource2() {
 sp<NuCachedSource2> NuCachedSource2::Create(
         const sp<DataSource> &source,
         const char *cacheConfig,
-        bool disconnectAtHighwatermark) {
+        bool disconnectAtHighwatermark,
+        const char *diskCacheKey) {
     sp<NuCachedSource2> instance = new NuCachedSource2(
-            source, cacheConfig, disconnectAtHighwatermark);
+            source, cacheConfig, disconnectAtHighwatermark, diskCacheKey);
     Mutex::Autolock autoLock(instance->mLock);
     (new AMessage(kWhatFetchMore, instance->mReflector))->post();
     return instance;
@@ -333,8 +441,13 @@ void NuCachedSource2::fetchInternal() {
     }
 
     if (reconnect) {
-        status_t err =
-            mSource->reconnectAtOffset(mCacheOffset + mCache->totalSize());
+        off64_t offset;
+        {
+            Mutex::Autolock autoLock(mLock);
+            offset = mCacheEnd;
+        }
+
+        status_t err = mSource->reconnectAtOffset(offset);
 
         Mutex::Autolock autoLock(mLock);
 
@@ -355,10 +468,31 @@ void NuCachedSource2::fetchInternal() {
         }
     }
 
-    PageCache::Page *page = mCache->acquirePage();
+    off64_t offset;
+    size_t size;
+    PageCache::Page *page;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        // Extend the window, up to the next region cached if any, which it
+        // then joins.
+        offset = mCacheEnd;
+        size = mCache->gapSize(offset, kPageSize);
+
+        if (mDiskCache != NULL) {
+            // Only whole blocks are stored, so the fetches are aligned.
+            size_t blockSize = mDiskCache->blockSize();
+            size_t toBoundary = blockSize - offset % blockSize;
+            if (size > toBoundary) {
+                size = toBoundary;
+            }
+        }
 
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+        trimCache_l(size);
+        page = mCache->acquirePage();
+    }
+
+    ssize_t n = fetchPage(offset, page->mData, size);
 
     Mutex::Autolock autoLock(mLock);
 
@@ -387,10 +521,65 @@ void NuCachedSource2::fetchInternal() {
         mFinalStatus = OK;
 
         page->mSize = n;
-        mCache->appendPage(page);
+        mCache->insertPage(offset, page);
+        updateCacheEnd_l();
     }
 }
 
+ssize_t NuCachedSource2::fetchPage(off64_t offset, void *data, size_t size) {
+    if (!mDiskCacheOpened) {
+        mDiskCacheOpened = true;
+
+        off64_t sourceSize;
+        if (!mDiskCacheKey.isEmpty() && mSource->getSize(&sourceSize) == OK) {
+            mDiskCache = HTTPDiskCache::Open(
+                    mDiskCacheKey, sourceSize, mSource->getMIMEType());
+        }
+    }
+
+    if (mDiskCache == NULL) {
+        return mSource->readAt(offset, data, size);
+    }
+
+    ssize_t n = mDiskCache->read(offset, data, size);
+    if (n > 0) {
+        return n;
+    }
+
+    n = mSource->readAt(offset, data, size);
+    if (n > 0) {
+        mDiskCache->write(offset, data, n);
+    }
+    return n;
+}
+
+void NuCachedSource2::updateCacheEnd_l() {
+    mCacheEnd = mCacheOffset + mCache->contiguousSize(mCacheOffset);
+}
+
+void NuCachedSource2::advanceWindow_l() {
+    // The pages behind the gray area are no longer part of the window.
+    if (mLastAccessPos - kGrayArea > mCacheOffset) {
+        mCacheOffset = mLastAccessPos - kGrayArea;
+        if (mCacheOffset > mCacheEnd) {
+            mCacheOffset = mCacheEnd;
+        }
+    }
+}
+
+void NuCachedSource2::trimCache_l(size_t size) {
+    if (mCache->totalSize() + size <= mHighwaterThresholdBytes) {
+        return;
+    }
+
+    advanceWindow_l();
+
+    // Any other region, and the pages behind the window, may go.
+    mCache->releaseLeastRecentlyUsed(
+            mCache->totalSize() + size - mHighwaterThresholdBytes,
+            mCacheOffset, mCacheEnd);
+}
+
 void NuCachedSource2::onFetch() {
     ALOGV("onFetch");
 
@@ -414,7 +603,16 @@ void NuCachedSource2::onFetch() {
 
         mLastFetchTimeUs = ALooper::GetNowUs();
 
-        if (mFetching && mCache->totalSize() >= mHighwaterThresholdBytes) {
+        bool full;
+        {
+            // The rest of the cache may be released to extend the window, so
+            // it is only full once the window itself fills it.
+            Mutex::Autolock autoLock(mLock);
+            advanceWindow_l();
+            full = mCacheEnd - mCacheOffset >= (off64_t)mHighwaterThresholdBytes;
+        }
+
+        if (mFetching && full) {
             ALOGI("Cache full, done prefetching for now");
             mFetching = false;
 
@@ -480,31 +678,23 @@ void NuCachedSource2::onRead(const sp<AMessage> &msg) {
 
 void NuCachedSource2::restartPrefetcherIfNecessary_l(
         bool ignoreLowWaterThreshold, bool force) {
-    static const size_t kGrayArea = 1024 * 1024;
-
     if (mFetching || (mFinalStatus != OK && mNumRetriesLeft == 0)) {
         return;
     }
 
     if (!ignoreLowWaterThreshold && !force
-            && mCacheOffset + mCache->totalSize() - mLastAccessPos
-                >= mLowwaterThresholdBytes) {
+            && mCacheEnd - mLastAccessPos >= (off64_t)mLowwaterThresholdBytes) {
         return;
     }
 
-    size_t maxBytes = mLastAccessPos - mCacheOffset;
-
-    if (!force) {
-        if (maxBytes < kGrayArea) {
-            return;
-        }
+    // The pages are released as the window is extended, as long as it does
+    // not fill the cache by itself.
+    advanceWindow_l();
 
-        maxBytes -= kGrayArea;
+    if (!force && mCacheEnd - mCacheOffset >= (off64_t)mHighwaterThresholdBytes) {
+        return;
     }
 
-    size_t actualBytes = mCache->releaseFromStart(maxBytes);
-    mCacheOffset += actualBytes;
-
     ALOGI("restarting prefetcher, totalSize = %zu", mCache->totalSize());
     mFetching = true;
 }
@@ -521,12 +711,16 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
 
     // If the request can be completely satisfied from the cache, do so.
 
-    if (offset >= mCacheOffset
-            && offset + size <= mCacheOffset + mCache->totalSize()) {
-        size_t delta = offset - mCacheOffset;
-        mCache->copy(delta, data, size);
+    if (mCache->contiguousSize(offset, size) >= size) {
+        // A hit in another region cached only marks its pages as used, the
+        // window is moved by readInternal() on a miss. An extractor reading
+        // its header or index in between samples would otherwise restart the
+        // prefetch elsewhere each time.
+        mCache->copy(offset, data, size);
 
-        mLastAccessPos = offset + size;
+        if (offset >= mCacheOffset && offset <= mCacheEnd) {
+            mLastAccessPos = offset + size;
+        }
 
         return size;
     }
@@ -562,7 +756,7 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
 
 size_t NuCachedSource2::cachedSize() {
     Mutex::Autolock autoLock(mLock);
-    return mCacheOffset + mCache->totalSize();
+    return mCacheEnd;
 }
 
 size_t NuCachedSource2::approxDataRemaining(status_t *finalStatus) const {
@@ -578,7 +772,7 @@ size_t NuCachedSource2::approxDataRemaining_l(status_t *finalStatus) const {
         *finalStatus = OK;
     }
 
-    off64_t lastBytePosCached = mCacheOffset + mCache->totalSize();
+    off64_t lastBytePosCached = mCacheEnd;
     if (mLastAccessPos < lastBytePosCached) {
         return lastBytePosCached - mLastAccessPos;
     }
@@ -606,39 +800,37 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
                 true); // force
     }
 
-    if (offset < mCacheOffset
-            || offset >= (off64_t)(mCacheOffset + mCache->totalSize())) {
+    if (offset < mCacheOffset || offset >= mCacheEnd) {
         static const off64_t kPadding = 256 * 1024;
 
-        // In the presence of multiple decoded streams, once of them will
-        // trigger this seek request, the other one will request data "nearby"
-        // soon, adjust the seek position so that that subsequent request
-        // does not trigger another seek.
-        off64_t seekOffset = (offset > kPadding) ? offset - kPadding : 0;
+        if (mCache->contiguousSize(offset, 1) > 0) {
+            // Another region cached holds the start of the request, extend it.
+            seekInternal_l(offset);
+        } else {
+            // In the presence of multiple decoded streams, once of them will
+            // trigger this seek request, the other one will request data
+            // "nearby" soon, adjust the seek position so that that subsequent
+            // request does not trigger another seek.
+            off64_t seekOffset = (offset > kPadding) ? offset - kPadding : 0;
 
-        seekInternal_l(seekOffset);
+            seekInternal_l(seekOffset);
+        }
     }
 
-    size_t delta = offset - mCacheOffset;
+    size_t avail = mCache->contiguousSize(offset, size);
 
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
-        if (delta >= mCache->totalSize()) {
+        if (avail == 0) {
             return mFinalStatus;
         }
 
-        size_t avail = mCache->totalSize() - delta;
-
-        if (avail > size) {
-            avail = size;
-        }
-
-        mCache->copy(delta, data, avail);
+        mCache->copy(offset, data, avail);
 
         return avail;
     }
 
-    if (offset + size <= mCacheOffset + mCache->totalSize()) {
-        mCache->copy(delta, data, size);
+    if (avail >= size) {
+        mCache->copy(offset, data, size);
 
         return size;
     }
@@ -651,18 +843,21 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
 status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     mLastAccessPos = offset;
 
-    if (offset >= mCacheOffset
-            && offset <= (off64_t)(mCacheOffset + mCache->totalSize())) {
+    if (offset >= mCacheOffset && offset <= mCacheEnd) {
         return OK;
     }
 
     ALOGI("new range: offset= %lld", (long long)offset);
 
+    // The regions cached are kept until their room is needed, a later seek
+    // back to one of them does not fetch it again.
     mCacheOffset = offset;
+    updateCacheEnd_l();
 
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
-
+    if (mFinalStatus == ERROR_END_OF_STREAM && !mDisconnecting) {
+        // The end of the stream was reached by the previous window.
+        mFinalStatus = OK;
+    }
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
 
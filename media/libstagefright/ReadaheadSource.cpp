@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ReadaheadSource"
+#include <utils/Log.h>
+
+#include "include/ReadaheadSource.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+static const int32_t kDefaultBudgetKBytes = 8192;
+
+ReadaheadSource::ReadaheadSource(const sp<DataSource> &source, size_t budgetBytes)
+    : mSource(source),
+      mBudgetBytes(budgetBytes),
+      mReflector(new AHandlerReflector<ReadaheadSource>(this)),
+      mLooper(new ALooper),
+      mIsReading(false),
+      mFetching(false),
+      mLastReadEnd(0),
+      mUsedBytes(0) {
+    mReading.mOffset = 0;
+    mReading.mSize = 0;
+
+    mLooper->setName("ReadaheadSource");
+    mLooper->registerHandler(mReflector);
+    mLooper->start();
+}
+
+ReadaheadSource::~ReadaheadSource() {
+    mLooper->stop();
+    mLooper->unregisterHandler(mReflector->id());
+}
+
+// static
+size_t ReadaheadSource::DefaultBudgetBytes() {
+    int32_t kbytes = property_get_int32(
+            "media.stagefright.readahead-kb", kDefaultBudgetKBytes);
+    return kbytes > 0 ? (size_t)kbytes * 1024 : 0;
+}
+
+status_t ReadaheadSource::initCheck() const {
+    return mSource->initCheck();
+}
+
+ssize_t ReadaheadSource::borrowAt(off64_t offset, size_t size, const void **data) {
+    return mSource->borrowAt(offset, size, data);
+}
+
+status_t ReadaheadSource::getSize(off64_t *size) {
+    return mSource->getSize(size);
+}
+
+uint32_t ReadaheadSource::flags() {
+    return mSource->flags();
+}
+
+sp<DecryptHandle> ReadaheadSource::DrmInitialization(const char *mime) {
+    return mSource->DrmInitialization(mime);
+}
+
+void ReadaheadSource::getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client) {
+    mSource->getDrmInfo(handle, client);
+}
+
+String8 ReadaheadSource::getUri() {
+    return mSource->getUri();
+}
+
+String8 ReadaheadSource::getMIMEType() const {
+    return mSource->getMIMEType();
+}
+
+bool ReadaheadSource::prefetch(off64_t offset, size_t size) {
+    if (offset < 0 || size == 0) {
+        return true;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = findBlock_l(offset);
+    if (index >= 0) {
+        const Block &block = mBlocks[index];
+        if (offset + (off64_t)size <= block.mOffset + (off64_t)block.mData->size()) {
+            return true;
+        }
+    }
+    if (mIsReading && offset >= mReading.mOffset
+            && offset + size <= mReading.mOffset + mReading.mSize) {
+        return true;
+    }
+
+    if (mUsedBytes + size > mBudgetBytes) {
+        dropIdleBlocks_l();
+        if (mUsedBytes + size > mBudgetBytes) {
+            return false;
+        }
+    }
+
+    queue_l(offset, size);
+
+    if (!mFetching) {
+        mFetching = true;
+        (new AMessage(kWhatFetch, mReflector))->post();
+    }
+    return true;
+}
+
+void ReadaheadSource::queue_l(off64_t offset, size_t size) {
+    off64_t end = offset + size;
+
+    // merge with the ranges it overlaps or touches, as long as the read
+    // stays small enough
+    size_t i = 0;
+    while (i < mPending.size()
+            && mPending[i].mOffset + (off64_t)mPending[i].mSize < offset) {
+        ++i;
+    }
+    while (i < mPending.size() && mPending[i].mOffset <= end) {
+        const Range &range = mPending[i];
+        off64_t start = range.mOffset < offset ? range.mOffset : offset;
+        off64_t stop = range.mOffset + (off64_t)range.mSize;
+        if (stop < end) {
+            stop = end;
+        }
+        if (stop - start > kMaxReadSize) {
+            break;
+        }
+        offset = start;
+        end = stop;
+        mUsedBytes -= range.mSize;
+        mPending.removeAt(i);
+    }
+
+    Range range;
+    range.mOffset = offset;
+    range.mSize = end - offset;
+    i = 0;
+    while (i < mPending.size() && mPending[i].mOffset <= offset) {
+        ++i;
+    }
+    mPending.insertAt(range, i);
+    mUsedBytes += range.mSize;
+}
+
+ssize_t ReadaheadSource::findBlock_l(off64_t offset) const {
+    // the last block starting at or before offset
+    size_t lo = 0;
+    size_t hi = mBlocks.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (mBlocks[mid].mOffset <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return -1;
+    }
+
+    const Block &block = mBlocks[lo - 1];
+    if (offset < block.mOffset + (off64_t)block.mData->size()) {
+        return lo - 1;
+    }
+    return -1;
+}
+
+void ReadaheadSource::cancelPending_l(off64_t offset, size_t size) {
+    // The range is read directly, so do not read it ahead anymore. Only the
+    // start of a pending range is trimmed, the rest of it may be someone
+    // else's.
+    const off64_t end = offset + size;
+    for (size_t i = 0; i < mPending.size(); ) {
+        Range &range = mPending.editItemAt(i);
+        if (range.mOffset >= end) {
+            break;
+        }
+        const off64_t rangeEnd = range.mOffset + (off64_t)range.mSize;
+        if (range.mOffset >= offset && rangeEnd > offset) {
+            const size_t trimmed = rangeEnd <= end ? range.mSize : end - range.mOffset;
+            mUsedBytes -= trimmed;
+            if (trimmed == range.mSize) {
+                mPending.removeAt(i);
+                continue;
+            }
+            range.mOffset += trimmed;
+            range.mSize -= trimmed;
+        }
+        ++i;
+    }
+}
+
+void ReadaheadSource::dropIdleBlocks_l() {
+    const int64_t nowUs = ALooper::GetNowUs();
+    for (size_t i = 0; i < mBlocks.size(); ) {
+        const Block &block = mBlocks[i];
+        if (nowUs - block.mFetchTimeUs > kMaxIdleUs) {
+            ALOGV("dropping %zu bytes at %lld not read",
+                    block.mData->size() - block.mConsumed, (long long)block.mOffset);
+            mUsedBytes -= block.mData->size();
+            mBlocks.removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+ssize_t ReadaheadSource::readAt(off64_t offset, void *data, size_t size) {
+    uint8_t *dst = (uint8_t *)data;
+    size_t copied = 0;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        while (copied < size) {
+            const off64_t position = offset + copied;
+            ssize_t index = findBlock_l(position);
+            if (index >= 0) {
+                Block &block = mBlocks.editItemAt(index);
+                const size_t skip = position - block.mOffset;
+                size_t n = block.mData->size() - skip;
+                if (n > size - copied) {
+                    n = size - copied;
+                }
+                memcpy(dst + copied, block.mData->data() + skip, n);
+                copied += n;
+
+                // the block may hold the samples of several tracks, so it is
+                // only dropped once all its bytes are read
+                block.mConsumed += n;
+                if (block.mConsumed >= block.mData->size()) {
+                    mUsedBytes -= block.mData->size();
+                    mBlocks.removeAt(index);
+                }
+                continue;
+            }
+
+            if (mIsReading && position >= mReading.mOffset
+                    && position < mReading.mOffset + (off64_t)mReading.mSize) {
+                // rather than seeking away from the read in progress
+                mCondition.wait(mLock);
+                continue;
+            }
+            break;
+        }
+
+        if (copied == size) {
+            return size;
+        }
+        cancelPending_l(offset + copied, size - copied);
+    }
+
+    ssize_t n = mSource->readAt(offset + copied, dst + copied, size - copied);
+    if (n < 0) {
+        return copied > 0 ? (ssize_t)copied : n;
+    }
+    return copied + n;
+}
+
+void ReadaheadSource::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatFetch:
+        {
+            onFetch();
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+void ReadaheadSource::onFetch() {
+    Range range;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mPending.isEmpty()) {
+            mFetching = false;
+            return;
+        }
+
+        // Sweep the pending ranges in ascending order of offset, starting
+        // over from the lowest one at the end.
+        size_t i = 0;
+        while (i < mPending.size() && mPending[i].mOffset < mLastReadEnd) {
+            ++i;
+        }
+        if (i == mPending.size()) {
+            i = 0;
+        }
+        range = mPending[i];
+        mPending.removeAt(i);
+        mReading = range;
+        mIsReading = true;
+    }
+
+    sp<ABuffer> data = new ABuffer(range.mSize);
+    ssize_t n = mSource->readAt(range.mOffset, data->data(), range.mSize);
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        mIsReading = false;
+        mUsedBytes -= range.mSize;
+        mLastReadEnd = range.mOffset + range.mSize;
+
+        if (n > 0) {
+            data->setRange(0, n);
+
+            Block block;
+            block.mOffset = range.mOffset;
+            block.mData = data;
+            block.mConsumed = 0;
+            block.mFetchTimeUs = ALooper::GetNowUs();
+
+            size_t i = mBlocks.size();
+            while (i > 0 && mBlocks[i - 1].mOffset > block.mOffset) {
+                --i;
+            }
+            mBlocks.insertAt(block, i);
+            mUsedBytes += n;
+        } else {
+            ALOGW("read of %zu bytes at %lld failed (%zd)",
+                    range.mSize, (long long)range.mOffset, n);
+        }
+
+        mCondition.broadcast();
+    }
+
+    (new AMessage(kWhatFetch, mReflector))->post();
+}
+
+}  // namespace android
@@ -30,8 +30,9 @@
 
 namespace android {
 
-SampleIterator::SampleIterator(SampleTable *table)
+SampleIterator::SampleIterator(SampleTable *table, bool decodingTime)
     : mTable(table),
+      mDecodingTime(decodingTime),
       mInitialized(false),
       mTimeToSampleIndex(0),
       mTTSSampleIndex(0),
@@ -315,7 +316,9 @@ status_t SampleIterator::findSampleTimeAndDuration(
 
     *time = mTTSSampleTime + mTTSDuration * (sampleIndex - mTTSSampleIndex);
 
-    *time += mTable->getCompositionTimeOffset(sampleIndex);
+    if (!mDecodingTime) {
+        *time += mTable->getCompositionTimeOffset(sampleIndex);
+    }
 
     *duration = mTTSDuration;
 
@@ -131,6 +131,7 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mNumSyncSamples(0),
       mSyncSamples(NULL),
       mLastSyncSampleIndex(0),
+      mSampleAheadIterator(NULL),
       mSampleToChunkEntries(NULL) {
     mSampleIterator = new SampleIterator(this);
 }
@@ -156,6 +157,9 @@ SampleTable::~SampleTable() {
 
     delete mSampleIterator;
     mSampleIterator = NULL;
+
+    delete mSampleAheadIterator;
+    mSampleAheadIterator = NULL;
 }
 
 bool SampleTable::isValid() const {
@@ -794,7 +798,8 @@ status_t SampleTable::getMetaDataForSample(
         size_t *size,
         uint32_t *compositionTime,
         bool *isSyncSample,
-        uint32_t *sampleDuration) {
+        uint32_t *sampleDuration,
+        uint32_t *decodingTime) {
     Mutex::Autolock autoLock(mLock);
 
     status_t err;
@@ -840,6 +845,36 @@ status_t SampleTable::getMetaDataForSample(
         *sampleDuration = mSampleIterator->getSampleDuration();
     }
 
+    if (decodingTime) {
+        *decodingTime = mSampleIterator->getSampleTime()
+                - getCompositionTimeOffset(sampleIndex);
+    }
+
+    return OK;
+}
+
+status_t SampleTable::getSampleAhead(
+        uint32_t sampleIndex,
+        off64_t *offset,
+        size_t *size,
+        uint32_t *decodingTime) {
+    Mutex::Autolock autoLock(mLock);
+
+    // The composition time offsets are left out, as their lookup only goes
+    // forward quickly, and is shared with mSampleIterator.
+    if (mSampleAheadIterator == NULL) {
+        mSampleAheadIterator = new SampleIterator(this, true /* decodingTime */);
+    }
+
+    status_t err;
+    if ((err = mSampleAheadIterator->seekTo(sampleIndex)) != OK) {
+        return err;
+    }
+
+    *offset = mSampleAheadIterator->getSampleOffset();
+    *size = mSampleAheadIterator->getSampleSize();
+    *decodingTime = mSampleAheadIterator->getSampleTime();
+
     return OK;
 }
 
@@ -51,17 +51,41 @@ status_t AReplyToken::setReply(const sp<AMessage> &reply) {
 AMessage::AMessage(void)
     : mWhat(0),
       mTarget(0),
-      mNumItems(0) {
+      mItems(NULL),
+      mIndex(NULL),
+      mNumItems(0),
+      mMaxNumItems(0) {
 }
 
 AMessage::AMessage(uint32_t what, const sp<const AHandler> &handler)
     : mWhat(what),
-      mNumItems(0) {
+      mItems(NULL),
+      mIndex(NULL),
+      mNumItems(0),
+      mMaxNumItems(0) {
     setTarget(handler);
 }
 
+AMessage::AMessage(
+        uint32_t what, const sp<const AHandler> &handler, size_t numItems)
+    : mWhat(what),
+      mItems(NULL),
+      mIndex(NULL),
+      mNumItems(0),
+      mMaxNumItems(0) {
+    setTarget(handler);
+
+    if (numItems > 0) {
+        reserve(numItems, 1);
+    }
+}
+
 AMessage::~AMessage() {
     clear();
+
+    free(mItems);
+    mItems = NULL;
+    mIndex = NULL;
 }
 
 void AMessage::setWhat(uint32_t what) {
@@ -87,11 +111,14 @@ void AMessage::setTarget(const sp<const AHandler> &handler) {
 void AMessage::clear() {
     for (size_t i = 0; i < mNumItems; ++i) {
         Item *item = &mItems[i];
-        delete[] item->mName;
-        item->mName = NULL;
+        item->freeName();
         freeItemValue(item);
     }
     mNumItems = 0;
+
+    if (mIndex != NULL) {
+        memset(mIndex, 0, 2 * mMaxNumItems);
+    }
 }
 
 void AMessage::freeItemValue(Item *item) {
@@ -147,20 +174,31 @@ static void reportStats() {
 }
 #endif
 
-inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
+inline size_t AMessage::findItemIndex(
+        const char *name, size_t len, uint32_t hash) const {
 #ifdef DUMP_STATS
     size_t memchecks = 0;
+    size_t checks = 0;
 #endif
-    size_t i = 0;
-    for (; i < mNumItems; i++) {
-        if (len != mItems[i].mNameLength) {
-            continue;
-        }
+    size_t i = mNumItems;
+    if (mNumItems > 0) {
+        const size_t mask = 2 * mMaxNumItems - 1;
+        for (size_t slot = hash & mask; mIndex[slot] != 0;
+                slot = (slot + 1) & mask) {
+            const Item &item = mItems[mIndex[slot] - 1];
 #ifdef DUMP_STATS
-        ++memchecks;
+            ++checks;
 #endif
-        if (!memcmp(mItems[i].mName, name, len)) {
-            break;
+            if (item.mNameHash != hash || item.mNameLength != len) {
+                continue;
+            }
+#ifdef DUMP_STATS
+            ++memchecks;
+#endif
+            if (!memcmp(item.name(), name, len)) {
+                i = mIndex[slot] - 1;
+                break;
+            }
         }
     }
 #ifdef DUMP_STATS
@@ -169,23 +207,71 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
         ++gFindItemCalls;
         gAverageNumItems += mNumItems;
         gAverageNumMemChecks += memchecks;
-        gAverageNumChecks += i;
+        gAverageNumChecks += checks;
         reportStats();
     }
 #endif
     return i;
 }
 
-// assumes item's name was uninitialized or NULL
-void AMessage::Item::setName(const char *name, size_t len) {
+// The keys are short, so the name is usually copied within the item, without
+// an allocation.
+//
+// assumes item's name was uninitialized or freed
+void AMessage::Item::setName(const char *name, size_t len, uint32_t hash) {
     mNameLength = len;
-    mName = new char[len + 1];
-    memcpy((void*)mName, name, len + 1);
+    mNameHash = hash;
+    if (len <= kMaxInlineNameLength) {
+        mNameCopy = NULL;
+        memcpy(mInlineName, name, len + 1);
+    } else {
+        mNameCopy = new char[len + 1];
+        memcpy(mNameCopy, name, len + 1);
+    }
+}
+
+void AMessage::Item::freeName() {
+    delete[] mNameCopy;
+    mNameCopy = NULL;
+}
+
+void AMessage::reserve(size_t numItems, size_t minNumItems) {
+    size_t maxNumItems = minNumItems;
+    while (maxNumItems < numItems && maxNumItems < kMaxNumItems) {
+        maxNumItems *= 2;
+    }
+
+    if (maxNumItems <= mMaxNumItems) {
+        return;
+    }
+
+    // The items are plain data, they are moved along; the index is rebuilt.
+    void *data = realloc(mItems, maxNumItems * (sizeof(Item) + 2));
+    CHECK(data != NULL);
+
+    mItems = static_cast<Item *>(data);
+    mIndex = reinterpret_cast<uint8_t *>(mItems + maxNumItems);
+    mMaxNumItems = maxNumItems;
+
+    memset(mIndex, 0, 2 * mMaxNumItems);
+    for (size_t i = 0; i < mNumItems; ++i) {
+        indexItem(i);
+    }
+}
+
+void AMessage::indexItem(size_t index) {
+    const size_t mask = 2 * mMaxNumItems - 1;
+    size_t slot = mItems[index].mNameHash & mask;
+    while (mIndex[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    mIndex[slot] = index + 1;
 }
 
 AMessage::Item *AMessage::allocateItem(const char *name) {
-    size_t len = strlen(name);
-    size_t i = findItemIndex(name, len);
+    size_t len;
+    uint32_t hash = AAtomizer::Hash(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     Item *item;
 
     if (i < mNumItems) {
@@ -193,9 +279,13 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         freeItemValue(item);
     } else {
         CHECK(mNumItems < kMaxNumItems);
+        if (mNumItems == mMaxNumItems) {
+            reserve(mNumItems * 2);
+        }
         i = mNumItems++;
         item = &mItems[i];
-        item->setName(name, len);
+        item->setName(name, len, hash);
+        indexItem(i);
     }
 
     return item;
@@ -203,7 +293,9 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t len;
+    uint32_t hash = AAtomizer::Hash(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     if (i < mNumItems) {
         const Item *item = &mItems[i];
         return item->mType == type ? item : NULL;
@@ -213,7 +305,9 @@ const AMessage::Item *AMessage::findItem(
 }
 
 bool AMessage::contains(const char *name) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t len;
+    uint32_t hash = AAtomizer::Hash(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     return i < mNumItems;
 }
 
@@ -413,7 +507,11 @@ bool AMessage::senderAwaitsResponse(sp<AReplyToken> *replyToken) {
 }
 
 sp<AMessage> AMessage::dup() const {
+    // The copies, of notifications in particular, usually get more items.
     sp<AMessage> msg = new AMessage(mWhat, mHandler.promote());
+    if (mNumItems > 0) {
+        msg->reserve(mNumItems);
+    }
     msg->mNumItems = mNumItems;
 
 #ifdef DUMP_STATS
@@ -429,7 +527,7 @@ sp<AMessage> AMessage::dup() const {
         const Item *from = &mItems[i];
         Item *to = &msg->mItems[i];
 
-        to->setName(from->mName, from->mNameLength);
+        to->setName(from->name(), from->mNameLength, from->mNameHash);
         to->mType = from->mType;
 
         switch (from->mType) {
@@ -464,6 +562,8 @@ sp<AMessage> AMessage::dup() const {
                 break;
             }
         }
+
+        msg->indexItem(i);
     }
 
     return msg;
@@ -514,65 +614,65 @@ AString AMessage::debugString(int32_t indent) const {
         switch (item.mType) {
             case kTypeInt32:
                 tmp = AStringPrintf(
-                        "int32_t %s = %d", item.mName, item.u.int32Value);
+                        "int32_t %s = %d", item.name(), item.u.int32Value);
                 break;
             case kTypeInt64:
                 tmp = AStringPrintf(
-                        "int64_t %s = %lld", item.mName, item.u.int64Value);
+                        "int64_t %s = %lld", item.name(), item.u.int64Value);
                 break;
             case kTypeSize:
                 tmp = AStringPrintf(
-                        "size_t %s = %d", item.mName, item.u.sizeValue);
+                        "size_t %s = %d", item.name(), item.u.sizeValue);
                 break;
             case kTypeFloat:
                 tmp = AStringPrintf(
-                        "float %s = %f", item.mName, item.u.floatValue);
+                        "float %s = %f", item.name(), item.u.floatValue);
                 break;
             case kTypeDouble:
                 tmp = AStringPrintf(
-                        "double %s = %f", item.mName, item.u.doubleValue);
+                        "double %s = %f", item.name(), item.u.doubleValue);
                 break;
             case kTypePointer:
                 tmp = AStringPrintf(
-                        "void *%s = %p", item.mName, item.u.ptrValue);
+                        "void *%s = %p", item.name(), item.u.ptrValue);
                 break;
             case kTypeString:
                 tmp = AStringPrintf(
                         "string %s = \"%s\"",
-                        item.mName,
+                        item.name(),
                         item.u.stringValue->c_str());
                 break;
             case kTypeObject:
                 tmp = AStringPrintf(
-                        "RefBase *%s = %p", item.mName, item.u.refValue);
+                        "RefBase *%s = %p", item.name(), item.u.refValue);
                 break;
             case kTypeBuffer:
             {
                 sp<ABuffer> buffer = static_cast<ABuffer *>(item.u.refValue);
 
                 if (buffer != NULL && buffer->data() != NULL && buffer->size() <= 64) {
-                    tmp = AStringPrintf("Buffer %s = {\n", item.mName);
+                    tmp = AStringPrintf("Buffer %s = {\n", item.name());
                     hexdump(buffer->data(), buffer->size(), indent + 4, &tmp);
                     appendIndent(&tmp, indent + 2);
                     tmp.append("}");
                 } else {
                     tmp = AStringPrintf(
-                            "Buffer *%s = %p", item.mName, buffer.get());
+                            "Buffer *%s = %p", item.name(), buffer.get());
                 }
                 break;
             }
             case kTypeMessage:
                 tmp = AStringPrintf(
                         "AMessage %s = %s",
-                        item.mName,
+                        item.name(),
                         static_cast<AMessage *>(
                             item.u.refValue)->debugString(
-                                indent + strlen(item.mName) + 14).c_str());
+                                indent + strlen(item.name()) + 14).c_str());
                 break;
             case kTypeRect:
                 tmp = AStringPrintf(
                         "Rect %s(%d, %d, %d, %d)",
-                        item.mName,
+                        item.name(),
                         item.u.rectValue.mLeft,
                         item.u.rectValue.mTop,
                         item.u.rectValue.mRight,
@@ -600,12 +700,17 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
     sp<AMessage> msg = new AMessage();
     msg->setWhat(what);
 
-    msg->mNumItems = static_cast<size_t>(parcel.readInt32());
-    if (msg->mNumItems > kMaxNumItems) {
+    size_t numItems = static_cast<size_t>(parcel.readInt32());
+    if (numItems > kMaxNumItems) {
         ALOGE("Too large number of items clipped.");
-        msg->mNumItems = kMaxNumItems;
+        numItems = kMaxNumItems;
     }
 
+    if (numItems > 0) {
+        msg->reserve(numItems);
+    }
+    msg->mNumItems = numItems;
+
     for (size_t i = 0; i < msg->mNumItems; ++i) {
         Item *item = &msg->mItems[i];
 
@@ -617,8 +722,8 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
         }
 
         item->mType = static_cast<Type>(parcel.readInt32());
-        // setName() happens below so that we don't leak memory when parsing
-        // is aborted in the middle.
+        // The name is copied once the value is read, so that an item dropped
+        // when parsing is aborted holds no name to free.
         switch (item->mType) {
             case kTypeInt32:
             {
@@ -681,7 +786,13 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
             }
         }
 
-        item->setName(name, strlen(name));
+        size_t len;
+        uint32_t hash = AAtomizer::Hash(name, &len);
+        item->setName(name, len, hash);
+    }
+
+    for (size_t i = 0; i < msg->mNumItems; ++i) {
+        msg->indexItem(i);
     }
 
     return msg;
@@ -694,7 +805,7 @@ void AMessage::writeToParcel(Parcel *parcel) const {
     for (size_t i = 0; i < mNumItems; ++i) {
         const Item &item = mItems[i];
 
-        parcel->writeCString(item.mName);
+        parcel->writeCString(item.name());
         parcel->writeInt32(static_cast<int32_t>(item.mType));
 
         switch (item.mType) {
@@ -762,7 +873,7 @@ const char *AMessage::getEntryNameAt(size_t index, Type *type) const {
 
     *type = mItems[index].mType;
 
-    return mItems[index].mName;
+    return mItems[index].name();
 }
 
 }  // namespace android
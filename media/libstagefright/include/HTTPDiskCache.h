@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HTTP_DISK_CACHE_H_
+
+#define HTTP_DISK_CACHE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/KeyedVector.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// A persistent cache of the blocks of an HTTP resource fetched by
+// NuCachedSource2, so that replays and seeks reuse the blocks fetched earlier.
+//
+// Each resource cached is an entry of the cache directory: a sparse data file
+// holding the blocks cached at their offset in the resource, and an index
+// file listing them. The entry is keyed by the URI and the request headers,
+// of which only a SHA-256 digest is stored, and is only valid for a resource
+// of the same size and MIME type. The
+// response headers, and so the ETag and Last-Modified validators, are not
+// exposed by IMediaHTTPConnection; the first block fetched from the network
+// that is also cached is compared with it instead, and the entry is dropped
+// if they differ. No block is read from the cache before then.
+//
+// The total size of the entries is bounded; the least recently opened entries
+// are removed when an entry is opened or closed, and an entry stops growing
+// once it reaches the bound by itself.
+//
+// An entry is used by a single instance at a time, which is not thread safe.
+struct HTTPDiskCache : public RefBase {
+    // Opens the entry of the resource identified by key in the cache directory
+    // set by the system property media.stagefright.http-cache-dir, bounded by
+    // media.stagefright.http-cache-mb. Returns NULL if the cache is disabled,
+    // which is the default, or the entry cannot be opened.
+    static sp<HTTPDiskCache> Open(
+            const String8 &key, off64_t size, const String8 &mimeType);
+
+    static sp<HTTPDiskCache> Open(
+            const char *dir, size_t maxBytes, size_t blockSize,
+            const String8 &key, off64_t size, const String8 &mimeType);
+
+    // Returns whether the resource requested may be cached. Requests over
+    // https, or carrying credentials (Cookie, Authorization or
+    // Proxy-Authorization headers), are private and only cached if the system
+    // property media.stagefright.http-cache-private is set, those hiding
+    // their URL from the logs never.
+    static bool MayCache(
+            const char *uri, const KeyedVector<String8, String8> &headers);
+
+    static bool MayCache(
+            const char *uri, const KeyedVector<String8, String8> &headers,
+            bool cachePrivate);
+
+    size_t blockSize() const {
+        return mBlockSize;
+    }
+
+    // Copies the bytes cached contiguously from offset, up to size. Returns
+    // the number of bytes copied, 0 if the block holding offset is not cached.
+    ssize_t read(off64_t offset, void *data, size_t size);
+
+    // Stores the blocks fully covered by the range fetched from the network,
+    // or up to the end of the resource.
+    void write(off64_t offset, const void *data, size_t size);
+
+    // Writes the index, so that the blocks stored so far survive a crash.
+    void flush();
+
+protected:
+    virtual ~HTTPDiskCache();
+
+private:
+    enum {
+        kDefaultBlockSize   = 65536,
+
+        // The size of a SHA-256 digest
+        kKeyDigestSize      = 32,
+
+        // The index is written every kFlushBlocks new blocks.
+        kFlushBlocks        = 64,
+    };
+
+    const String8 mDir;
+    uint8_t mKeyDigest[kKeyDigestSize];
+    String8 mName;
+    String8 mDataPath;
+    String8 mIndexPath;
+    int mFd;
+    const size_t mMaxBytes;
+    const size_t mBlockSize;
+    const off64_t mSize;
+    const String8 mMimeType;
+
+    // One bit per block of the resource, set if the block is cached
+    Vector<uint8_t> mBlocks;
+    size_t mNumBlocksCached;
+    size_t mNumBlocksDirty;
+    bool mValidated;
+
+    HTTPDiskCache(
+            const char *dir, size_t maxBytes, size_t blockSize,
+            const String8 &key, off64_t size, const String8 &mimeType);
+
+    status_t init();
+    bool readIndex();
+    void reset();
+
+    bool isCached(size_t block) const;
+    size_t blockLength(size_t block) const;
+    void validate(size_t block, const uint8_t *data);
+
+    // Removes the least recently opened entries of dir, but the one named
+    // except and those in use, until their total size is at most maxBytes.
+    static void Trim(const char *dir, size_t maxBytes, const String8 &except);
+
+    DISALLOW_EVIL_CONSTRUCTORS(HTTPDiskCache);
+};
+
+}  // namespace android
+
+#endif  // HTTP_DISK_CACHE_H_
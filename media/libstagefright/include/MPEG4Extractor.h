@@ -31,6 +31,7 @@ namespace android {
 
 struct AMessage;
 class DataSource;
+struct ReadaheadSource;
 class SampleTable;
 class String8;
 
@@ -91,6 +92,8 @@ private:
     Vector<Trex> mTrex;
 
     sp<DataSource> mDataSource;
+    // reads ahead the samples of the tracks of local files, if enabled
+    sp<ReadaheadSource> mReadahead;
     status_t mInitCheck;
     bool mHasVideo;
     uint32_t mHeaderTimescale;
@@ -25,13 +25,17 @@
 namespace android {
 
 struct ALooper;
+struct HTTPDiskCache;
 struct PageCache;
 
 struct NuCachedSource2 : public DataSource {
+    // If diskCacheKey is not NULL, the pages fetched are also kept in the
+    // entry of the HTTPDiskCache with that key, if the disk cache is enabled.
     static sp<NuCachedSource2> Create(
             const sp<DataSource> &source,
             const char *cacheConfig = NULL,
-            bool disconnectAtHighwatermark = false);
+            bool disconnectAtHighwatermark = false,
+            const char *diskCacheKey = NULL);
 
     virtual status_t initCheck() const;
 
@@ -75,7 +79,8 @@ private:
     NuCachedSource2(
             const sp<DataSource> &source,
             const char *cacheConfig,
-            bool disconnectAtHighwatermark);
+            bool disconnectAtHighwatermark,
+            const char *diskCacheKey);
 
     enum {
         kPageSize                       = 65536,
@@ -105,7 +110,11 @@ private:
     Condition mCondition;
 
     PageCache *mCache;
+    // The window read and prefetched, the bytes cached contiguously from
+    // mCacheOffset up to mCacheEnd. Other regions may be cached, from earlier
+    // windows.
     off64_t mCacheOffset;
+    off64_t mCacheEnd;
     status_t mFinalStatus;
     off64_t mLastAccessPos;
     sp<AMessage> mAsyncResult;
@@ -123,14 +132,25 @@ private:
 
     bool mDisconnectAtHighwatermark;
 
+    // The disk cache is opened by the first fetch, on the looper thread, as
+    // it needs the size of the source. Only used by the looper thread.
+    String8 mDiskCacheKey;
+    bool mDiskCacheOpened;
+    sp<HTTPDiskCache> mDiskCache;
+
     void onMessageReceived(const sp<AMessage> &msg);
     void onFetch();
     void onRead(const sp<AMessage> &msg);
 
     void fetchInternal();
+    ssize_t fetchPage(off64_t offset, void *data, size_t size);
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
 
+    void updateCacheEnd_l();
+    void advanceWindow_l();
+    void trimCache_l(size_t size);
+
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
     void restartPrefetcherIfNecessary_l(
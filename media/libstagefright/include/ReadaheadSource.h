@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef READAHEAD_SOURCE_H_
+
+#define READAHEAD_SOURCE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AHandlerReflector.h>
+#include <media/stagefright/DataSource.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+struct ALooper;
+
+// Wraps a local DataSource, and reads ahead on a looper thread the ranges an
+// extractor announces with prefetch(), typically the next samples of each of
+// its tracks. The ranges announced are merged with their neighbours into
+// reads of up to kMaxReadSize bytes, which are issued in ascending order of
+// offset, so that interleaved tracks are read in sequential passes instead of
+// seeking back and forth for each sample. readAt() is served from the ranges
+// read ahead, waiting for the one being read if needed, and a range is dropped
+// once all its bytes are read. Everything else goes to the wrapped source,
+// including borrowAt(): a source that lends its bytes needs no read ahead.
+struct ReadaheadSource : public DataSource {
+    // budgetBytes bounds the bytes read ahead and not yet read.
+    ReadaheadSource(const sp<DataSource> &source, size_t budgetBytes);
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+    virtual ssize_t borrowAt(off64_t offset, size_t size, const void **data);
+
+    virtual status_t getSize(off64_t *size);
+    virtual uint32_t flags();
+
+    virtual sp<DecryptHandle> DrmInitialization(const char *mime);
+    virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client);
+    virtual String8 getUri();
+
+    virtual String8 getMIMEType() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Announces that the given range will be read soon. Returns false if the
+    // budget is used up, the range is then not read ahead and should be
+    // announced again later.
+    bool prefetch(off64_t offset, size_t size);
+
+    // Returns the size of the read ahead budget set by the system property
+    // media.stagefright.readahead-kb, 0 if read ahead is disabled.
+    static size_t DefaultBudgetBytes();
+
+protected:
+    virtual ~ReadaheadSource();
+
+private:
+    friend struct AHandlerReflector<ReadaheadSource>;
+
+    enum {
+        kMaxReadSize            = 1024 * 1024,
+
+        // A range read ahead that is still not read after this long has been
+        // skipped by a seek, or the playback is paused; it is dropped if its
+        // room is needed.
+        kMaxIdleUs              = 2000000,
+    };
+
+    enum {
+        kWhatFetch  = 'fetc',
+    };
+
+    struct Range {
+        off64_t mOffset;
+        size_t mSize;
+    };
+
+    struct Block {
+        off64_t mOffset;
+        sp<ABuffer> mData;
+        size_t mConsumed;   // bytes read from the block
+        int64_t mFetchTimeUs;
+    };
+
+    sp<DataSource> mSource;
+    const size_t mBudgetBytes;
+    sp<AHandlerReflector<ReadaheadSource> > mReflector;
+    sp<ALooper> mLooper;
+
+    Mutex mLock;
+    Condition mCondition;
+
+    // Ranges to read, sorted by offset
+    Vector<Range> mPending;
+    // The range being read ahead, if mIsReading
+    Range mReading;
+    bool mIsReading;
+    // A kWhatFetch message is posted
+    bool mFetching;
+    off64_t mLastReadEnd;
+    // Ranges read, sorted by offset
+    Vector<Block> mBlocks;
+    // mPending, mReading and mBlocks bytes
+    size_t mUsedBytes;
+
+    void onMessageReceived(const sp<AMessage> &msg);
+    void onFetch();
+
+    void queue_l(off64_t offset, size_t size);
+    ssize_t findBlock_l(off64_t offset) const;
+    void cancelPending_l(off64_t offset, size_t size);
+    void dropIdleBlocks_l();
+
+    DISALLOW_EVIL_CONSTRUCTORS(ReadaheadSource);
+};
+
+}  // namespace android
+
+#endif  // READAHEAD_SOURCE_H_
@@ -25,7 +25,9 @@ namespace android {
 class SampleTable;
 
 struct SampleIterator {
-    SampleIterator(SampleTable *table);
+    // If decodingTime, getSampleTime() returns the decoding time of the
+    // sample, without its composition time offset.
+    SampleIterator(SampleTable *table, bool decodingTime = false);
 
     status_t seekTo(uint32_t sampleIndex);
 
@@ -41,6 +43,7 @@ struct SampleIterator {
 
 private:
     SampleTable *mTable;
+    bool mDecodingTime;
 
     bool mInitialized;
 
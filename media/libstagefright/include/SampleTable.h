@@ -67,7 +67,17 @@ public:
             size_t *size,
             uint32_t *compositionTime,
             bool *isSyncSample = NULL,
-            uint32_t *sampleDuration = NULL);
+            uint32_t *sampleDuration = NULL,
+            uint32_t *decodingTime = NULL);
+
+    // Returns the offset, size and decoding time of a sample, with an iterator
+    // of its own, so that looking ahead of the sample being read does not make
+    // the next getMetaDataForSample() seek back.
+    status_t getSampleAhead(
+            uint32_t sampleIndex,
+            off64_t *offset,
+            size_t *size,
+            uint32_t *decodingTime);
 
     enum {
         kFlagBefore,
@@ -129,6 +139,7 @@ private:
     size_t mLastSyncSampleIndex;
 
     SampleIterator *mSampleIterator;
+    SampleIterator *mSampleAheadIterator;   // created on first use
 
     struct SampleToChunkEntry {
         uint32_t startChunk;
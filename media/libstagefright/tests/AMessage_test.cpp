@@ -0,0 +1,232 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AMessage_test"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <binder/Parcel.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+
+namespace android {
+
+// The names of the items: short ones are copied within the item, long ones
+// are allocated.
+static AString itemName(size_t i, bool longName = false) {
+    AString name = AStringPrintf("item-%zu", i);
+    if (longName) {
+        name.append("-with-a-name-too-long-to-fit-within-the-item");
+    }
+    return name;
+}
+
+// Checks that the message holds the int32 items 0 .. count - 1, and no other.
+static void checkItems(const sp<AMessage> &msg, size_t count, bool longNames = false) {
+    ASSERT_EQ(count, msg->countEntries());
+    for (size_t i = 0; i < count; ++i) {
+        int32_t value;
+        ASSERT_TRUE(msg->findInt32(itemName(i, longNames).c_str(), &value)) << i;
+        EXPECT_EQ((int32_t)i, value);
+    }
+    EXPECT_FALSE(msg->contains(itemName(count, longNames).c_str()));
+}
+
+static sp<AMessage> newMessage(size_t count, bool longNames = false) {
+    sp<AMessage> msg = new AMessage;
+    for (size_t i = 0; i < count; ++i) {
+        msg->setInt32(itemName(i, longNames).c_str(), i);
+    }
+    return msg;
+}
+
+TEST(AMessageTest, GrowsPastMinimum) {
+    for (size_t count = 1; count < 64; count *= 2) {
+        sp<AMessage> msg = newMessage(count + 1);
+        checkItems(msg, count + 1);
+    }
+
+    // pre-sized for fewer items than set
+    sp<AMessage> msg = new AMessage(0, NULL, 2);
+    for (size_t i = 0; i < 20; ++i) {
+        msg->setInt32(itemName(i).c_str(), i);
+    }
+    checkItems(msg, 20);
+}
+
+TEST(AMessageTest, SetReplacesItem) {
+    sp<AMessage> msg = newMessage(10);
+    msg->setString(itemName(3).c_str(), "three");
+    ASSERT_EQ(10u, msg->countEntries());
+
+    int32_t value;
+    EXPECT_FALSE(msg->findInt32(itemName(3).c_str(), &value));
+    AString s;
+    ASSERT_TRUE(msg->findString(itemName(3).c_str(), &s));
+    EXPECT_STREQ("three", s.c_str());
+}
+
+TEST(AMessageTest, NameIsCopied) {
+    sp<AMessage> msg = new AMessage;
+    char shortName[] = "short";
+    char longName[] = "a-name-long-enough-not-to-fit-within-the-item";
+    msg->setInt32(shortName, 1);
+    msg->setInt32(longName, 2);
+    shortName[0] = 'S';
+    longName[0] = 'A';
+
+    int32_t value;
+    ASSERT_TRUE(msg->findInt32("short", &value));
+    EXPECT_EQ(1, value);
+    ASSERT_TRUE(msg->findInt32("a-name-long-enough-not-to-fit-within-the-item", &value));
+    EXPECT_EQ(2, value);
+    EXPECT_FALSE(msg->contains(shortName));
+    EXPECT_FALSE(msg->contains(longName));
+}
+
+TEST(AMessageTest, HoldsAtMostMaxItems) {
+    sp<AMessage> msg = newMessage(64, true /* longNames */);
+    checkItems(msg, 64, true /* longNames */);
+
+    // the items held can still be set
+    msg->setInt32(itemName(63, true).c_str(), 63);
+    checkItems(msg, 64, true /* longNames */);
+
+    EXPECT_DEATH(msg->setInt32("one-too-many", 64), "");
+}
+
+TEST(AMessageTest, DupCopiesNames) {
+    sp<AMessage> msg = new AMessage;
+    for (size_t i = 0; i < 12; ++i) {
+        msg->setInt32(itemName(i, i % 2).c_str(), i);
+    }
+    sp<AMessage> inner = newMessage(3);
+    msg->setMessage("inner", inner);
+
+    sp<AMessage> copy = msg->dup();
+    // the original goes away first
+    msg.clear();
+
+    ASSERT_EQ(13u, copy->countEntries());
+    for (size_t i = 0; i < 12; ++i) {
+        int32_t value;
+        ASSERT_TRUE(copy->findInt32(itemName(i, i % 2).c_str(), &value)) << i;
+        EXPECT_EQ((int32_t)i, value);
+    }
+    sp<AMessage> innerCopy;
+    ASSERT_TRUE(copy->findMessage("inner", &innerCopy));
+    EXPECT_NE(inner.get(), innerCopy.get());
+    checkItems(innerCopy, 3);
+
+    // the copy grows on its own
+    for (size_t i = 12; i < 40; ++i) {
+        copy->setInt32(itemName(i, i % 2).c_str(), i);
+    }
+    ASSERT_EQ(41u, copy->countEntries());
+    int32_t value;
+    ASSERT_TRUE(copy->findInt32(itemName(1, true).c_str(), &value));
+    EXPECT_EQ(1, value);
+}
+
+TEST(AMessageTest, LookupsAfterClear) {
+    sp<AMessage> msg = newMessage(20);
+    msg->clear();
+    ASSERT_EQ(0u, msg->countEntries());
+    for (size_t i = 0; i < 20; ++i) {
+        EXPECT_FALSE(msg->contains(itemName(i).c_str())) << i;
+    }
+
+    for (size_t i = 0; i < 30; ++i) {
+        msg->setInt32(itemName(i, true).c_str(), i);
+    }
+    checkItems(msg, 30, true /* longNames */);
+    EXPECT_FALSE(msg->contains(itemName(0).c_str()));
+}
+
+TEST(AMessageTest, ParcelRoundTrip) {
+    sp<AMessage> msg = new AMessage;
+    for (size_t i = 0; i < 10; ++i) {
+        msg->setInt32(itemName(i, i % 2).c_str(), i);
+    }
+    msg->setString("string", "value");
+    Parcel parcel;
+    msg->writeToParcel(&parcel);
+    parcel.setDataPosition(0);
+
+    sp<AMessage> read = AMessage::FromParcel(parcel);
+    ASSERT_EQ(11u, read->countEntries());
+    for (size_t i = 0; i < 10; ++i) {
+        int32_t value;
+        ASSERT_TRUE(read->findInt32(itemName(i, i % 2).c_str(), &value)) << i;
+        EXPECT_EQ((int32_t)i, value);
+    }
+    AString s;
+    ASSERT_TRUE(read->findString("string", &s));
+    EXPECT_STREQ("value", s.c_str());
+}
+
+static const uint32_t kWhat = 0x1234;
+
+TEST(AMessageTest, FromParcelStopsAtMissingName) {
+    Parcel parcel;
+    parcel.writeInt32(kWhat);
+    parcel.writeInt32(12);  // but only 10 items
+    for (size_t i = 0; i < 10; ++i) {
+        parcel.writeCString(itemName(i, i % 2).c_str());
+        parcel.writeInt32(AMessage::kTypeInt32);
+        parcel.writeInt32(i);
+    }
+    parcel.setDataPosition(0);
+
+    sp<AMessage> msg = AMessage::FromParcel(parcel);
+    EXPECT_EQ(kWhat, msg->what());
+    ASSERT_EQ(10u, msg->countEntries());
+    for (size_t i = 0; i < 10; ++i) {
+        int32_t value;
+        ASSERT_TRUE(msg->findInt32(itemName(i, i % 2).c_str(), &value)) << i;
+        EXPECT_EQ((int32_t)i, value);
+    }
+
+    // the message can grow
+    msg->setInt32("more", 1);
+    EXPECT_EQ(11u, msg->countEntries());
+    EXPECT_TRUE(msg->contains(itemName(9, true).c_str()));
+}
+
+TEST(AMessageTest, FromParcelStopsAtMissingString) {
+    Parcel parcel;
+    parcel.writeInt32(kWhat);
+    parcel.writeInt32(3);
+    parcel.writeCString("first");
+    parcel.writeInt32(AMessage::kTypeInt32);
+    parcel.writeInt32(1);
+    parcel.writeCString("a-string-whose-value-is-missing");
+    parcel.writeInt32(AMessage::kTypeString);
+    parcel.setDataPosition(0);
+
+    sp<AMessage> msg = AMessage::FromParcel(parcel);
+    ASSERT_EQ(1u, msg->countEntries());
+    int32_t value;
+    ASSERT_TRUE(msg->findInt32("first", &value));
+    EXPECT_EQ(1, value);
+    EXPECT_FALSE(msg->contains("a-string-whose-value-is-missing"));
+}
+
+}  // namespace android
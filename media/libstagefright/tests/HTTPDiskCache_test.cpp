@@ -0,0 +1,232 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "HTTPDiskCache_test"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <utils/KeyedVector.h>
+#include <utils/Log.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+#include "include/HTTPDiskCache.h"
+
+namespace android {
+
+static const size_t kBlockSize = 4096;
+static const char *kMimeType = "video/mp4";
+
+// Stands in for the HTTP server, counting the bytes it serves.
+struct FakeServer {
+    explicit FakeServer(size_t size, uint8_t seed = 0)
+        : mBytesServed(0) {
+        for (size_t i = 0; i < size; ++i) {
+            mContent.push_back((uint8_t)(i * 7 + seed));
+        }
+    }
+
+    ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (offset >= (off64_t)mContent.size()) {
+            return 0;
+        }
+        if (offset + size > mContent.size()) {
+            size = mContent.size() - offset;
+        }
+        memcpy(data, mContent.array() + offset, size);
+        mBytesServed += size;
+        return size;
+    }
+
+    Vector<uint8_t> mContent;
+    size_t mBytesServed;
+};
+
+class HTTPDiskCacheTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        char dir[] = "/data/local/tmp/HTTPDiskCache_test.XXXXXX";
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+        mDir = dir;
+    }
+
+    virtual void TearDown() {
+        system(String8::format("rm -rf %s", mDir.string()).string());
+    }
+
+    sp<HTTPDiskCache> open(
+            const char *key, const FakeServer &server, size_t maxBytes = 1 << 20) {
+        return HTTPDiskCache::Open(mDir.string(), maxBytes, kBlockSize,
+                String8(key), server.mContent.size(), String8(kMimeType));
+    }
+
+    // Reads the range as NuCachedSource2 does, a block at a time, checking
+    // the data.
+    void play(const sp<HTTPDiskCache> &cache, FakeServer *server,
+            off64_t offset, size_t size) {
+        uint8_t data[kBlockSize];
+        while (size > 0) {
+            size_t n = size < kBlockSize ? size : kBlockSize;
+            ssize_t result = cache->read(offset, data, n);
+            if (result <= 0) {
+                result = server->readAt(offset, data, n);
+                ASSERT_GT(result, 0);
+                cache->write(offset, data, result);
+            }
+            ASSERT_EQ(0, memcmp(data, server->mContent.array() + offset, result));
+            offset += result;
+            size -= result;
+        }
+    }
+
+    String8 mDir;
+};
+
+TEST_F(HTTPDiskCacheTest, ReplayIsServedFromDisk) {
+    // not a whole number of blocks
+    FakeServer server(20 * kBlockSize + 100);
+
+    sp<HTTPDiskCache> cache = open("http://host/clip.mp4", server);
+    ASSERT_TRUE(cache != NULL);
+    play(cache, &server, 0, server.mContent.size());
+    ASSERT_EQ(server.mContent.size(), server.mBytesServed);
+    cache.clear();
+
+    server.mBytesServed = 0;
+    cache = open("http://host/clip.mp4", server);
+    ASSERT_TRUE(cache != NULL);
+    play(cache, &server, 0, server.mContent.size());
+
+    // only the first block, which validates the entry
+    ASSERT_EQ(kBlockSize, server.mBytesServed);
+}
+
+TEST_F(HTTPDiskCacheTest, RangesAreKeptApart) {
+    FakeServer server(64 * kBlockSize);
+
+    sp<HTTPDiskCache> cache = open("http://host/clip.mp4", server);
+    ASSERT_TRUE(cache != NULL);
+    play(cache, &server, 0, 2 * kBlockSize);
+    // the header at the end
+    play(cache, &server, 60 * kBlockSize, 4 * kBlockSize);
+    cache.clear();
+
+    server.mBytesServed = 0;
+    cache = open("http://host/clip.mp4", server);
+    ASSERT_TRUE(cache != NULL);
+    play(cache, &server, 0, 2 * kBlockSize);
+    ASSERT_EQ(kBlockSize, server.mBytesServed);
+
+    uint8_t data[kBlockSize];
+    ASSERT_EQ(0, cache->read(30 * kBlockSize, data, kBlockSize));
+
+    play(cache, &server, 60 * kBlockSize + 10, 4 * kBlockSize - 10);
+    ASSERT_EQ(kBlockSize, server.mBytesServed);
+}
+
+TEST_F(HTTPDiskCacheTest, ChangedResourceIsDropped) {
+    FakeServer server(8 * kBlockSize);
+
+    sp<HTTPDiskCache> cache = open("http://host/clip.mp4", server);
+    ASSERT_TRUE(cache != NULL);
+    play(cache, &server, 0, server.mContent.size());
+    cache.clear();
+
+    // same URI and size, other content
+    FakeServer changed(8 * kBlockSize, 1);
+    cache = open("http://host/clip.mp4", changed);
+    ASSERT_TRUE(cache != NULL);
+    play(cache, &changed, 0, changed.mContent.size());
+    ASSERT_EQ(changed.mContent.size(), changed.mBytesServed);
+
+    // other size
+    FakeServer resized(9 * kBlockSize);
+    cache.clear();
+    cache = open("http://host/clip.mp4", resized);
+    ASSERT_TRUE(cache != NULL);
+
+    uint8_t data[kBlockSize];
+    ASSERT_EQ(0, cache->read(0, data, kBlockSize));
+}
+
+TEST_F(HTTPDiskCacheTest, EntryIsUsedOnce) {
+    FakeServer server(8 * kBlockSize);
+
+    sp<HTTPDiskCache> cache = open("http://host/clip.mp4", server);
+    ASSERT_TRUE(cache != NULL);
+    ASSERT_TRUE(open("http://host/clip.mp4", server) == NULL);
+    ASSERT_TRUE(open("http://host/other.mp4", server) != NULL);
+}
+
+TEST_F(HTTPDiskCacheTest, KeyIsNotStored) {
+    FakeServer server(4 * kBlockSize);
+
+    sp<HTTPDiskCache> cache = open("http://host/clip.mp4?token=secret", server);
+    ASSERT_TRUE(cache != NULL);
+    play(cache, &server, 0, server.mContent.size());
+    cache.clear();
+
+    // neither in the names nor in the contents of the files
+    String8 command = String8::format(
+            "ls %s | grep -q secret || grep -rq secret %s", mDir.string(), mDir.string());
+    ASSERT_NE(0, system(command.string()));
+}
+
+TEST_F(HTTPDiskCacheTest, PrivateRequestsAreNotCached) {
+    KeyedVector<String8, String8> headers;
+    headers.add(String8("User-Agent"), String8("stagefright"));
+    ASSERT_TRUE(HTTPDiskCache::MayCache("http://host/clip.mp4", headers, false));
+    ASSERT_FALSE(HTTPDiskCache::MayCache("https://host/clip.mp4", headers, false));
+    ASSERT_TRUE(HTTPDiskCache::MayCache("https://host/clip.mp4", headers, true));
+
+    static const char *kPrivateHeaders[] = { "Cookie", "authorization", "Proxy-Authorization" };
+    for (size_t i = 0; i < NELEM(kPrivateHeaders); ++i) {
+        KeyedVector<String8, String8> privateHeaders = headers;
+        privateHeaders.add(String8(kPrivateHeaders[i]), String8("secret"));
+        ASSERT_FALSE(HTTPDiskCache::MayCache("http://host/clip.mp4", privateHeaders, false));
+        ASSERT_TRUE(HTTPDiskCache::MayCache("http://host/clip.mp4", privateHeaders, true));
+    }
+
+    headers.add(String8("x-hide-urls-from-log"), String8("1"));
+    ASSERT_FALSE(HTTPDiskCache::MayCache("http://host/clip.mp4", headers, true));
+}
+
+TEST_F(HTTPDiskCacheTest, SizeIsBounded) {
+    FakeServer server(16 * kBlockSize);
+    const size_t maxBytes = 24 * kBlockSize;
+
+    sp<HTTPDiskCache> first = open("http://host/first.mp4", server, maxBytes);
+    ASSERT_TRUE(first != NULL);
+    play(first, &server, 0, server.mContent.size());
+    first.clear();
+
+    // replaces the first entry
+    sp<HTTPDiskCache> second = open("http://host/second.mp4", server, maxBytes);
+    ASSERT_TRUE(second != NULL);
+    play(second, &server, 0, server.mContent.size());
+    second.clear();
+
+    server.mBytesServed = 0;
+    first = open("http://host/first.mp4", server, maxBytes);
+    ASSERT_TRUE(first != NULL);
+    play(first, &server, 0, server.mContent.size());
+    ASSERT_EQ(server.mContent.size(), server.mBytesServed);
+}
+
+}  // namespace android
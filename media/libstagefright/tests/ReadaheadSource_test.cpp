@@ -0,0 +1,289 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ReadaheadSource_test"
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaErrors.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include "include/ReadaheadSource.h"
+
+namespace android {
+
+static const size_t kFileSize = 65536;
+
+// A FileSource that logs the reads, and holds those at mHoldOffset until
+// released, to observe a read ahead in progress.
+struct RecordingSource : public DataSource {
+    RecordingSource(const sp<DataSource> &source, const Vector<uint8_t> &content)
+        : mSource(source),
+          mContent(content),
+          mHoldOffset(-1),
+          mHolding(false),
+          mLend(false) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            Range range;
+            range.mOffset = offset;
+            range.mSize = size;
+            mReads.push_back(range);
+            mCondition.broadcast();
+            if (offset == mHoldOffset) {
+                mHolding = true;
+                while (mHoldOffset >= 0) {
+                    mCondition.wait(mLock);
+                }
+                mHolding = false;
+            }
+        }
+        return mSource->readAt(offset, data, size);
+    }
+
+    virtual ssize_t borrowAt(off64_t offset, size_t size, const void **data) {
+        if (!mLend) {
+            return mSource->borrowAt(offset, size, data);
+        }
+        *data = mContent.array() + offset;
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    void hold(off64_t offset) {
+        Mutex::Autolock autoLock(mLock);
+        mHoldOffset = offset;
+    }
+
+    // Waits until the read held has started.
+    void waitHolding() {
+        Mutex::Autolock autoLock(mLock);
+        while (!mHolding) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    // Waits until count reads have started, so that the ranges read ahead
+    // before the last one are read, and the last one is in progress.
+    void waitReads(size_t count) {
+        Mutex::Autolock autoLock(mLock);
+        while (mReads.size() < count) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    void release() {
+        Mutex::Autolock autoLock(mLock);
+        mHoldOffset = -1;
+        mCondition.broadcast();
+    }
+
+    size_t numReads() {
+        Mutex::Autolock autoLock(mLock);
+        return mReads.size();
+    }
+
+    // Returns the number of reads of the range.
+    size_t countReads(off64_t offset, size_t size) {
+        Mutex::Autolock autoLock(mLock);
+        size_t count = 0;
+        for (size_t i = 0; i < mReads.size(); ++i) {
+            if (mReads[i].mOffset == offset && mReads[i].mSize == size) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    struct Range {
+        off64_t mOffset;
+        size_t mSize;
+    };
+
+    sp<DataSource> mSource;
+    const Vector<uint8_t> &mContent;
+    Mutex mLock;
+    Condition mCondition;
+    Vector<Range> mReads;
+    off64_t mHoldOffset;
+    bool mHolding;
+    bool mLend;
+};
+
+class ReadaheadSourceTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        char path[] = "/data/local/tmp/ReadaheadSource_test.XXXXXX";
+        int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        unlink(path);
+        for (size_t i = 0; i < kFileSize; ++i) {
+            mContent.push_back((uint8_t)(i * 7 + i / 251));
+        }
+        ASSERT_EQ((ssize_t)kFileSize, write(fd, mContent.array(), kFileSize));
+
+        // FileSource takes ownership of the fd
+        mSource = new RecordingSource(new FileSource(fd, 0, kFileSize), mContent);
+        ASSERT_EQ(OK, mSource->initCheck());
+    }
+
+    virtual void TearDown() {
+        if (mSource != NULL) {
+            mSource->release();
+        }
+        mReadahead.clear();
+        mSource.clear();
+    }
+
+    // Reads the range, checking the data.
+    void read(off64_t offset, size_t size) {
+        Vector<uint8_t> data;
+        data.insertAt((uint8_t)0, 0, size);
+        ASSERT_EQ((ssize_t)size, mReadahead->readAt(offset, data.editArray(), size));
+        ASSERT_EQ(0, memcmp(data.array(), mContent.array() + offset, size));
+    }
+
+    // Starts the read ahead of a range and holds it, so that the next ranges
+    // are queued behind it.
+    void holdRead(off64_t offset, size_t size) {
+        mSource->hold(offset);
+        ASSERT_TRUE(mReadahead->prefetch(offset, size));
+        mSource->waitHolding();
+    }
+
+    Vector<uint8_t> mContent;
+    sp<RecordingSource> mSource;
+    sp<ReadaheadSource> mReadahead;
+};
+
+TEST_F(ReadaheadSourceTest, NeighboursAreMerged) {
+    mReadahead = new ReadaheadSource(mSource, kFileSize);
+    holdRead(32768, 100);
+
+    // touching and overlapping ranges, then one apart
+    ASSERT_TRUE(mReadahead->prefetch(0, 100));
+    ASSERT_TRUE(mReadahead->prefetch(100, 100));
+    ASSERT_TRUE(mReadahead->prefetch(150, 200));
+    ASSERT_TRUE(mReadahead->prefetch(1000, 100));
+    mSource->release();
+    mSource->waitReads(3);
+
+    read(32768, 100);
+    read(0, 100);
+    read(100, 250);
+    read(1000, 100);
+
+    EXPECT_EQ(1u, mSource->countReads(32768, 100));
+    EXPECT_EQ(1u, mSource->countReads(0, 350));
+    EXPECT_EQ(1u, mSource->countReads(1000, 100));
+    EXPECT_EQ(3u, mSource->numReads());
+}
+
+TEST_F(ReadaheadSourceTest, DirectReadCancelsPending) {
+    mReadahead = new ReadaheadSource(mSource, kFileSize);
+    holdRead(32768, 100);
+
+    ASSERT_TRUE(mReadahead->prefetch(0, 100));
+    ASSERT_TRUE(mReadahead->prefetch(4096, 100));
+    // not read ahead yet, so read directly, and no longer read ahead
+    read(0, 100);
+    EXPECT_EQ(1u, mSource->countReads(0, 100));
+    mSource->release();
+    mSource->waitReads(3);
+
+    read(32768, 100);
+    read(4096, 100);
+    EXPECT_EQ(1u, mSource->countReads(0, 100));
+    EXPECT_EQ(3u, mSource->numReads());
+}
+
+struct DelayedRelease {
+    sp<RecordingSource> mSource;
+    useconds_t mDelayUs;
+};
+
+static void *delayedRelease(void *arg) {
+    DelayedRelease *release = (DelayedRelease *)arg;
+    usleep(release->mDelayUs);
+    release->mSource->release();
+    return NULL;
+}
+
+TEST_F(ReadaheadSourceTest, ReadWaitsForReadInProgress) {
+    mReadahead = new ReadaheadSource(mSource, kFileSize);
+    holdRead(0, 4096);
+
+    DelayedRelease release;
+    release.mSource = mSource;
+    release.mDelayUs = 100000;
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, delayedRelease, &release));
+
+    // within the range being read, so served from it rather than directly
+    read(10, 100);
+    pthread_join(thread, NULL);
+    EXPECT_EQ(1u, mSource->numReads());
+
+    // the rest of the range is kept until read
+    read(110, 4096 - 110);
+    EXPECT_EQ(1u, mSource->numReads());
+}
+
+TEST_F(ReadaheadSourceTest, BudgetIsBounded) {
+    mReadahead = new ReadaheadSource(mSource, 1000);
+    holdRead(0, 600);
+
+    // the range being read counts against the budget
+    EXPECT_FALSE(mReadahead->prefetch(4096, 600));
+    EXPECT_TRUE(mReadahead->prefetch(4096, 400));
+    mSource->release();
+    mSource->waitReads(2);
+
+    read(0, 600);
+    read(4096, 400);
+    // the room of the ranges read is given back
+    EXPECT_TRUE(mReadahead->prefetch(8192, 1000));
+}
+
+TEST_F(ReadaheadSourceTest, BorrowIsForwarded) {
+    mReadahead = new ReadaheadSource(mSource, kFileSize);
+    const void *data;
+    const void *expected;
+    ASSERT_EQ(mSource->borrowAt(0, 100, &expected), mReadahead->borrowAt(0, 100, &data));
+
+    mSource->mLend = true;
+    ASSERT_EQ(100, mReadahead->borrowAt(200, 100, &data));
+    EXPECT_EQ(mContent.array() + 200, data);
+}
+
+}  // namespace android
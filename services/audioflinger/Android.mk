@@ -27,9 +27,12 @@ LOCAL_SRC_FILES:=               \
     SpdifStreamOut.cpp          \
     Effects.cpp                 \
     AudioMixer.cpp.arm          \
+    AudioTimestretcher.cpp      \
     BufferProviders.cpp         \
     PatchPanel.cpp              \
-    StateQueue.cpp
+    StateQueue.cpp              \
+    ThreadCycleStats.cpp        \
+    FastMixerTuner.cpp
 
 LOCAL_C_INCLUDES := \
     $(TOPDIR)frameworks/av/services/audiopolicy \
@@ -351,6 +351,31 @@ void AudioFlinger::dumpInternals(int fd, const Vector<String16>& args __unused)
     write(fd, result.string(), result.size());
 }
 
+// Writes the ThreadCycleStats::Snapshot of each playback and record thread to fd in binary,
+// one after the other, for collection by tools.  Each snapshot starts with its magic,
+// version and size, so that a reader can skip versions it doesn't know.
+void AudioFlinger::dumpCycleStats(int fd)
+{
+    bool locked = dumpTryLock(mLock);
+    if (!locked) {
+        ALOGW("dumpCycleStats: AudioFlinger may be deadlocked");
+    }
+
+    ThreadCycleStats::Snapshot snapshot;
+    for (size_t i = 0; i < mPlaybackThreads.size(); i++) {
+        mPlaybackThreads.valueAt(i)->getCycleStats(&snapshot);
+        write(fd, &snapshot, sizeof(snapshot));
+    }
+    for (size_t i = 0; i < mRecordThreads.size(); i++) {
+        mRecordThreads.valueAt(i)->getCycleStats(&snapshot);
+        write(fd, &snapshot, sizeof(snapshot));
+    }
+
+    if (locked) {
+        mLock.unlock();
+    }
+}
+
 void AudioFlinger::dumpPermissionDenial(int fd, const Vector<String16>& args __unused)
 {
     const size_t SIZE = 256;
@@ -382,6 +407,14 @@ status_t AudioFlinger::dump(int fd, const Vector<String16>& args)
     if (!dumpAllowed()) {
         dumpPermissionDenial(fd, args);
     } else {
+        // binary cycle statistics only, see dumpCycleStats()
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i] == String16("--cycle-stats")) {
+                dumpCycleStats(fd);
+                return NO_ERROR;
+            }
+        }
+
         // get state of hardware lock
         bool hardwareLocked = dumpTryLock(mHardwareLock);
         if (!hardwareLocked) {
@@ -59,6 +59,8 @@
 #include "AudioStreamOut.h"
 #include "SpdifStreamOut.h"
 #include "AudioHwDevice.h"
+#include "ThreadCycleStats.h"
+#include "FastMixerTuner.h"
 
 #include <powermanager/IPowerManager.h>
 
@@ -73,7 +75,11 @@ class AudioMixer;
 class AudioBuffer;
 class AudioResampler;
 class FastMixer;
+class MonoPipe;
+class MonoPipeReader;
 class PassthruBufferProvider;
+class Pipe;
+class PipeReader;
 class ServerProxy;
 
 // ----------------------------------------------------------------------------
@@ -412,6 +418,7 @@ private:
     void dumpPermissionDenial(int fd, const Vector<String16>& args);
     void dumpClients(int fd, const Vector<String16>& args);
     void dumpInternals(int fd, const Vector<String16>& args);
+    void dumpCycleStats(int fd);
 
     // --- Client ---
     class Client : public RefBase {
@@ -513,6 +520,8 @@ private:
         virtual status_t    setParameters(const String8& keyValuePairs);
         virtual status_t    getTimestamp(AudioTimestamp& timestamp);
         virtual void        signal(); // signal playback thread for a change in control block
+        virtual status_t    scheduleAction(int action, bool atPosition, int64_t when,
+                                           float left, float right);
 
         virtual status_t onTransact(
             uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags);
@@ -19,10 +19,14 @@
 //#define LOG_NDEBUG 0
 
 #include "Configuration.h"
+#include <errno.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/prctl.h>
 #include <sys/types.h>
 
 #include <utils/Errors.h>
@@ -85,6 +89,14 @@ static const bool kUseFloat = true;
 // Set to default copy buffer size in frames for input processing.
 static const size_t kCopyBufferFrameCount = 256;
 
+// Minimum number of enabled tracks before process__parallel() is used, if helper threads
+// are configured.  Below this the cost of waking the helpers exceeds the mixing work.
+static const int kParallelMixMinTracks = 4;
+
+// Frames folded down to stereo at a time by track__NoResampleDownmix(), small enough
+// for the folded block to stay in the L1 cache until it is mixed.
+static const size_t kDownmixBlockFrames = 64;
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -95,6 +107,272 @@ T min(const T& a, const T& b)
     return a < b ? a : b;
 }
 
+// Sample type of the mixer engine input, given the engine output type TO
+// (float for a float engine, otherwise int16_t).
+template <typename TO>
+struct MixerInSample {
+    typedef int16_t type;
+};
+
+template <>
+struct MixerInSample<float> {
+    typedef float type;
+};
+
+// ----------------------------------------------------------------------------
+
+/* Helper threads for process__parallel().
+ *
+ * The mixer thread gives each helper a fixed subset of the tracks of one output group.
+ * Each helper mixes its subset into its own partial buffer, using its own resampler
+ * scratch buffer, while the mixer thread mixes the remaining tracks into outputTemp.
+ * The mixer thread then waits for all helpers and sums the partial buffers in helper order.
+ */
+class AudioMixer::HelperThreads {
+public:
+    HelperThreads(uint32_t count, uint32_t cpuMask);
+    ~HelperThreads();
+
+    uint32_t count() const { return mCount; }
+
+    // allocate the per-helper buffers, if not done already
+    void prepare(size_t frameCount);
+
+    // apply the scheduling policy and priority of the calling thread to the helpers
+    void inheritScheduling();
+
+    // hand tracks[n] to helper n, 0 meaning no work; returns immediately
+    void start(state_t* state, const uint32_t* tracks, int64_t pts);
+
+    // block until every helper has finished the work given by start()
+    void wait();
+
+    int32_t* partial(uint32_t index) const { return mHelpers[index].outTemp; }
+
+private:
+    struct helper_t {
+        HelperThreads*  owner;
+        pthread_t       thread;
+        int             cpu;            // -1 if not pinned
+        uint32_t        tracks;         // track subset for the current generation
+        int32_t*        outTemp;        // partial mix buffer
+        int32_t*        resampleTemp;   // scratch buffer for the track hooks
+    };
+
+    static void* threadLoop(void* arg);
+    void loop(helper_t* helper);
+
+    Mutex       mLock;
+    Condition   mWorkCond;      // signaled when mGeneration changes or mExit is set
+    Condition   mDoneCond;      // signaled when mPending reaches 0
+    uint32_t    mGeneration;
+    uint32_t    mPending;
+    bool        mExit;
+    state_t*    mState;
+    int64_t     mPts;
+    uint32_t    mCount;         // number of helper threads actually started
+    int         mPolicy;        // scheduling policy last applied to the helpers
+    int         mPriority;      // scheduling priority last applied to the helpers
+    helper_t    mHelpers[MAX_NUM_HELPER_THREADS];
+};
+
+AudioMixer::HelperThreads::HelperThreads(uint32_t count, uint32_t cpuMask)
+    :   mGeneration(0), mPending(0), mExit(false), mState(NULL), mPts(0), mCount(0),
+        mPolicy(SCHED_OTHER), mPriority(0)
+{
+    uint32_t cpus = cpuMask;
+    for (uint32_t i = 0; i < count && i < MAX_NUM_HELPER_THREADS; ++i) {
+        helper_t& h = mHelpers[i];
+        h.owner = this;
+        h.cpu = -1;
+        if (cpuMask != 0) {
+            if (cpus == 0) {
+                cpus = cpuMask;
+            }
+            h.cpu = __builtin_ctz(cpus);
+            cpus &= ~(1 << h.cpu);
+        }
+        h.tracks = 0;
+        h.outTemp = NULL;
+        h.resampleTemp = NULL;
+        const int err = pthread_create(&h.thread, NULL, threadLoop, &h);
+        if (err != 0) {
+            ALOGE("AudioMixer cannot create helper thread %u: %s", i, strerror(err));
+            break;
+        }
+        mCount++;
+    }
+}
+
+AudioMixer::HelperThreads::~HelperThreads()
+{
+    {
+        Mutex::Autolock _l(mLock);
+        mExit = true;
+        mWorkCond.broadcast();
+    }
+    for (uint32_t i = 0; i < mCount; ++i) {
+        pthread_join(mHelpers[i].thread, NULL);
+        delete [] mHelpers[i].outTemp;
+        delete [] mHelpers[i].resampleTemp;
+    }
+}
+
+void AudioMixer::HelperThreads::prepare(size_t frameCount)
+{
+    for (uint32_t i = 0; i < mCount; ++i) {
+        helper_t& h = mHelpers[i];
+        if (h.outTemp == NULL) {
+            h.outTemp = new int32_t[MAX_NUM_CHANNELS * frameCount];
+        }
+        if (h.resampleTemp == NULL) {
+            h.resampleTemp = new int32_t[MAX_NUM_CHANNELS * frameCount];
+        }
+    }
+}
+
+void AudioMixer::HelperThreads::inheritScheduling()
+{
+    int policy;
+    struct sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) != 0
+            || (policy == mPolicy && param.sched_priority == mPriority)) {
+        return;
+    }
+    for (uint32_t i = 0; i < mCount; ++i) {
+        const int err = pthread_setschedparam(mHelpers[i].thread, policy, &param);
+        if (err != 0) {
+            ALOGW("AudioMixer cannot set helper %u to policy %d priority %d: %s",
+                    i, policy, param.sched_priority, strerror(err));
+        }
+    }
+    mPolicy = policy;
+    mPriority = param.sched_priority;
+}
+
+void AudioMixer::HelperThreads::start(state_t* state, const uint32_t* tracks, int64_t pts)
+{
+    Mutex::Autolock _l(mLock);
+    mState = state;
+    mPts = pts;
+    for (uint32_t i = 0; i < mCount; ++i) {
+        mHelpers[i].tracks = tracks[i];
+    }
+    mPending = mCount;
+    mGeneration++;
+    mWorkCond.broadcast();
+}
+
+void AudioMixer::HelperThreads::wait()
+{
+    Mutex::Autolock _l(mLock);
+    while (mPending > 0) {
+        mDoneCond.wait(mLock);
+    }
+}
+
+void* AudioMixer::HelperThreads::threadLoop(void* arg)
+{
+    helper_t* helper = static_cast<helper_t*>(arg);
+    helper->owner->loop(helper);
+    return NULL;
+}
+
+void AudioMixer::HelperThreads::loop(helper_t* helper)
+{
+    prctl(PR_SET_NAME, (unsigned long)"AudioMixerHelper", 0, 0, 0);
+    if (helper->cpu >= 0) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(helper->cpu, &cpuSet);
+        if (sched_setaffinity(0 /* calling thread */, sizeof(cpuSet), &cpuSet) != 0) {
+            ALOGW("AudioMixer cannot pin helper to cpu %d: %s", helper->cpu, strerror(errno));
+        }
+    }
+
+    uint32_t generation = 0;
+    mLock.lock();
+    for (;;) {
+        while (!mExit && mGeneration == generation) {
+            mWorkCond.wait(mLock);
+        }
+        if (mExit) {
+            break;
+        }
+        generation = mGeneration;
+        state_t* const state = mState;
+        const int64_t pts = mPts;
+        const uint32_t tracks = helper->tracks;
+        mLock.unlock();
+
+        if (tracks != 0) {
+            const track_t& t1 = state->tracks[31 - __builtin_clz(tracks)];
+            memset(helper->outTemp, 0,
+                    sizeof(*helper->outTemp) * t1.mMixerChannelCount * state->frameCount);
+            mixTrackGroup(state, tracks, helper->outTemp, helper->resampleTemp, pts);
+        }
+
+        mLock.lock();
+        if (--mPending == 0) {
+            mDoneCond.signal();
+        }
+    }
+    mLock.unlock();
+}
+
+// ----------------------------------------------------------------------------
+
+/* A group of resampled tracks sharing one resampler, see groupResamplers().
+ *
+ * The group is the buffer provider of its resampler.  It reads each member track at the
+ * common source rate and mixes it, with the member's volume or volume ramp, into a float
+ * buffer which is then resampled once into the mix.
+ */
+class AudioMixer::ResampleGroup : public AudioBufferProvider {
+public:
+    ResampleGroup(state_t* state, const track_t& t);
+    virtual ~ResampleGroup();
+
+    // true if track t can be resampled by this group, except for the main buffer
+    bool matches(const track_t& t) const;
+
+    int32_t* mainBuffer() const { return mMainBuffer; }
+    void addMember(int name, int32_t* mainBuffer) {
+        mMembers |= 1 << name;
+        mMainBuffer = mainBuffer;
+    }
+    void clearMembers() { mMembers = 0; }
+    uint32_t members() const { return mMembers; }
+
+    void setPTS(int64_t pts) { mResampler->setPTS(pts); }
+    // resample and accumulate frameCount frames of the group mix into out
+    void resample(int32_t* out, size_t frameCount);
+    size_t getUnreleasedFrames() const {
+        return mResampler->getUnreleasedFrames() + mAvailable;
+    }
+
+    // AudioBufferProvider interface, called by mResampler
+    virtual status_t getNextBuffer(Buffer* buffer, int64_t pts);
+    virtual void releaseBuffer(Buffer* buffer);
+
+private:
+    // mix frameCount frames of every member into mBuffer, returns false if all underran
+    bool fill(size_t frameCount, int64_t pts);
+
+    state_t* const          mState;
+    int32_t*                mMainBuffer;
+    const uint32_t          mSampleRate;        // source sample rate of the members
+    const uint32_t          mChannelCount;      // mixer channel count
+    const audio_format_t    mMixerInFormat;
+    const audio_format_t    mMixerFormat;
+    const AudioResampler::src_quality mQuality;
+    AudioResampler*         mResampler;
+    uint32_t                mMembers;           // bitmask of member track names
+    float*                  mBuffer;            // kCopyBufferFrameCount frames
+    size_t                  mOffset;            // first frame not released in mBuffer
+    size_t                  mAvailable;         // frames not released in mBuffer
+};
+
 // ----------------------------------------------------------------------------
 
 // Ensure mConfiguredNames bitmask is initialized properly on all architectures.
@@ -119,7 +397,11 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
     mState.outputTemp   = NULL;
     mState.resampleTemp = NULL;
     mState.mLog         = &mDummyLog;
-    // mState.reserved
+    mState.helpers      = NULL;
+    mState.sampleRate   = sampleRate;
+    mState.groupResampling = false;
+    memset(mState.resampleGroups, 0, sizeof(mState.resampleGroups));
+    atomic_init(&mTrackParamsChanged, (uint_least32_t)0);
 
     // FIXME Most of the following initialization is probably redundant since
     // tracks[i] should only be referenced if (mTrackNames & (1 << i)) != 0
@@ -130,6 +412,7 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
         t->downmixerBufferProvider = NULL;
         t->mReformatBufferProvider = NULL;
         t->mTimestretchBufferProvider = NULL;
+        t->mResampleGroup = NULL;
         t++;
     }
 
@@ -137,6 +420,10 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
 
 AudioMixer::~AudioMixer()
 {
+    delete mState.helpers;
+    for (unsigned i = 0; i < MAX_NUM_TRACKS; i++) {
+        delete mState.resampleGroups[i];
+    }
     track_t* t = mState.tracks;
     for (unsigned i=0 ; i < MAX_NUM_TRACKS ; i++) {
         delete t->resampler;
@@ -154,6 +441,36 @@ void AudioMixer::setLog(NBLog::Writer *log)
     mState.mLog = log;
 }
 
+uint32_t AudioMixer::setHelperThreads(uint32_t helperCount, uint32_t cpuMask)
+{
+    if (helperCount > MAX_NUM_HELPER_THREADS) {
+        ALOGW("setHelperThreads: %u helpers requested, limiting to %u",
+                helperCount, MAX_NUM_HELPER_THREADS);
+        helperCount = MAX_NUM_HELPER_THREADS;
+    }
+    delete mState.helpers;
+    mState.helpers = NULL;
+    if (helperCount > 0) {
+        mState.helpers = new HelperThreads(helperCount, cpuMask);
+        if (mState.helpers->count() == 0) {
+            delete mState.helpers;
+            mState.helpers = NULL;
+        }
+    }
+    // reselect the process hook on the next process()
+    invalidateState(mState.enabledTracks);
+    return mState.helpers != NULL ? mState.helpers->count() : 0;
+}
+
+void AudioMixer::setResampleGrouping(bool enabled)
+{
+    if (mState.groupResampling != enabled) {
+        mState.groupResampling = enabled;
+        // regroup the tracks on the next process()
+        invalidateState(mState.enabledTracks);
+    }
+}
+
 static inline audio_format_t selectMixerInFormat(audio_format_t inputFormat __unused) {
     return kUseFloat && kUseNewMixer ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
 }
@@ -213,6 +530,7 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask,
         t->hook = NULL;
         t->in = NULL;
         t->resampler = NULL;
+        t->mResampleGroup = NULL;
         t->sampleRate = mSampleRate;
         // setParameter(name, TRACK, MAIN_BUFFER, mixBuffer) is required before enable(name)
         t->mainBuffer = NULL;
@@ -222,6 +540,8 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask,
         t->downmixerBufferProvider = NULL;
         t->mPostDownmixReformatBufferProvider = NULL;
         t->mTimestretchBufferProvider = NULL;
+        t->mDownmixInMixer = false;
+        t->mReformatInMixer = false;
         t->mMixerFormat = AUDIO_FORMAT_PCM_16_BIT;
         t->mFormat = format;
         t->mMixerInFormat = selectMixerInFormat(format);
@@ -230,6 +550,20 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask,
                 AUDIO_CHANNEL_REPRESENTATION_POSITION, AUDIO_CHANNEL_OUT_STEREO);
         t->mMixerChannelCount = audio_channel_count_from_out_mask(t->mMixerChannelMask);
         t->mPlaybackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
+        // params published by setParameter() start out as the volumes above
+        track_params_t params;
+        for (uint32_t i = 0; i <= MAX_NUM_VOLUMES; i++) {
+            track_volume_t& v = params.volume[i];
+            v.volume = i < MAX_NUM_VOLUMES ? UNITY_GAIN_FLOAT : 0.;
+            v.rampFrom = v.volume;
+            v.serial = 0;
+            v.rampSerial = 0;
+            v.ramp = false;
+            t->mVolumeSerial[i] = 0;
+        }
+        params.sampleRate = 0;
+        mTrackParams[n].reset(params);
+        atomic_fetch_and_explicit(&mTrackParamsChanged, ~(1u << n), memory_order_relaxed);
         // Check the downmixing (or upmixing) requirements.
         status_t status = t->prepareForDownmix();
         if (status != OK) {
@@ -286,7 +620,8 @@ bool AudioMixer::setChannelMasks(int name,
             "prepareForDownmix error %d, track channel mask %#x, mixer channel mask %#x",
             status, track.channelMask, track.mMixerChannelMask);
 
-    if (prevDownmixerFormat != track.mDownmixRequiresFormat) {
+    // a new downmixer may also need the conversion that the track hook did.
+    if (prevDownmixerFormat != track.mDownmixRequiresFormat || track.mReformatInMixer) {
         track.prepareForReformat(); // because of downmixer, track format may change!
     }
 
@@ -305,6 +640,7 @@ bool AudioMixer::setChannelMasks(int name,
 void AudioMixer::track_t::unprepareForDownmix() {
     ALOGV("AudioMixer::unprepareForDownmix(%p)", this);
 
+    mDownmixInMixer = false;
     mDownmixRequiresFormat = AUDIO_FORMAT_INVALID;
     if (downmixerBufferProvider != NULL) {
         // this track had previously been configured with a downmixer, delete it
@@ -331,6 +667,21 @@ status_t AudioMixer::track_t::prepareForDownmix()
                     && mMixerChannelMask == AUDIO_CHANNEL_OUT_STEREO)) {
         return NO_ERROR;
     }
+    // Quad, 5.1 and 7.1 to stereo is folded down by the track hook while mixing, which
+    // saves the downmixer pass and the format conversions around it.  The hook folds
+    // as the AOSP downmix effect does, so a downmixer of another implementor is
+    // kept.  The resampler and timestretcher read the track at the mixer channel
+    // count, so they need the downmixer; see prepareForProviderConversion().
+    if (DownmixerBufferProvider::isDefaultDownmixer()
+            && mMixerChannelMask == AUDIO_CHANNEL_OUT_STEREO
+            && (channelMask == AUDIO_CHANNEL_OUT_QUAD
+                    || channelMask == AUDIO_CHANNEL_OUT_5POINT1
+                    || channelMask == AUDIO_CHANNEL_OUT_7POINT1)
+            && resampler == NULL && mTimestretchBufferProvider == NULL) {
+        ALOGV("downmix of channel mask %#x done by the track hook", channelMask);
+        mDownmixInMixer = true;
+        return NO_ERROR;
+    }
     // DownmixerBufferProvider is only used for position masks.
     if (audio_channel_mask_get_representation(channelMask)
                 == AUDIO_CHANNEL_REPRESENTATION_POSITION
@@ -358,6 +709,18 @@ status_t AudioMixer::track_t::prepareForDownmix()
     return NO_ERROR;
 }
 
+// Called once a resampler or timestretcher is added to a track that the track hook
+// downmixes or converts: the conversion moves to the buffer providers, ahead of them.
+void AudioMixer::track_t::prepareForProviderConversion()
+{
+    if (mDownmixInMixer) {
+        prepareForDownmix();
+        prepareForReformat(); // the downmixer may require a different format
+    } else if (mReformatInMixer) {
+        prepareForReformat();
+    }
+}
+
 void AudioMixer::track_t::unprepareForReformat() {
     ALOGV("AudioMixer::unprepareForReformat(%p)", this);
     bool requiresReconfigure = false;
@@ -384,8 +747,16 @@ status_t AudioMixer::track_t::prepareForReformat()
     // only configure reformatters as needed
     const audio_format_t targetFormat = mDownmixRequiresFormat != AUDIO_FORMAT_INVALID
             ? mDownmixRequiresFormat : mMixerInFormat;
+    // PCM_16_BIT read straight from the track by the track hook is converted to float
+    // as it is mixed, which saves the reformat pass and its copy buffer.  The resampler,
+    // timestretcher and downmixer read the mixer engine format, so they need the
+    // reformatter; see prepareForProviderConversion().
+    mReformatInMixer = mFormat == AUDIO_FORMAT_PCM_16_BIT
+            && mMixerInFormat == AUDIO_FORMAT_PCM_FLOAT
+            && downmixerBufferProvider == NULL
+            && resampler == NULL && mTimestretchBufferProvider == NULL;
     bool requiresReconfigure = false;
-    if (mFormat != targetFormat) {
+    if (mFormat != targetFormat && !mReformatInMixer) {
         mReformatBufferProvider = new ReformatBufferProvider(
                 audio_channel_count_from_out_mask(channelMask),
                 mFormat,
@@ -449,6 +820,8 @@ void AudioMixer::deleteTrackName(int name)
     // delete the timestretch provider
     delete track.mTimestretchBufferProvider;
     track.mTimestretchBufferProvider = NULL;
+    // drop params not yet applied
+    atomic_fetch_and_explicit(&mTrackParamsChanged, ~(1u << name), memory_order_relaxed);
     mTrackNames &= ~(1<<name);
 }
 
@@ -676,7 +1049,14 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
         switch (param) {
         case SAMPLE_RATE:
             ALOG_ASSERT(valueInt > 0, "bad sample rate %d", valueInt);
-            if (track.setResampler(uint32_t(valueInt), mSampleRate)) {
+            if (track.doesResample()) {
+                // only the resampler's ratio changes, process() picks it up.
+                track_params_t& params = mTrackParams[name].pending();
+                if (params.sampleRate != uint32_t(valueInt)) {
+                    params.sampleRate = uint32_t(valueInt);
+                    publishTrackParams(name);
+                }
+            } else if (track.setResampler(uint32_t(valueInt), mSampleRate)) {
                 ALOGV("setParameter(RESAMPLE, SAMPLE_RATE, %u)",
                         uint32_t(valueInt));
                 invalidateState(1 << name);
@@ -686,48 +1066,57 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
             track.resetResampler();
             invalidateState(1 << name);
             break;
-        case REMOVE:
+        case REMOVE: {
             delete track.resampler;
             track.resampler = NULL;
             track.sampleRate = mSampleRate;
+            // a sample rate not yet applied belonged to the removed resampler
+            track_params_t& params = mTrackParams[name].pending();
+            if (params.sampleRate != 0) {
+                params.sampleRate = 0;
+                publishTrackParams(name);
+            }
             invalidateState(1 << name);
-            break;
+            } break;
         default:
             LOG_ALWAYS_FATAL("setParameter resample: bad param %d", param);
         }
         break;
 
     case RAMP_VOLUME:
-    case VOLUME:
+    case VOLUME: {
+        // The ramp is computed by process() from the volume it has reached,
+        // see applyTrackParams().
+        uint32_t index;
         switch (param) {
         case AUXLEVEL:
-            if (setVolumeRampVariables(*reinterpret_cast<float*>(value),
-                    target == RAMP_VOLUME ? mState.frameCount : 0,
-                    &track.auxLevel, &track.prevAuxLevel, &track.auxInc,
-                    &track.mAuxLevel, &track.mPrevAuxLevel, &track.mAuxInc)) {
-                ALOGV("setParameter(%s, AUXLEVEL: %04x)",
-                        target == VOLUME ? "VOLUME" : "RAMP_VOLUME", track.auxLevel);
-                invalidateState(1 << name);
-            }
+            index = MAX_NUM_VOLUMES;
             break;
         default:
             if ((unsigned)param >= VOLUME0 && (unsigned)param < VOLUME0 + MAX_NUM_VOLUMES) {
-                if (setVolumeRampVariables(*reinterpret_cast<float*>(value),
-                        target == RAMP_VOLUME ? mState.frameCount : 0,
-                        &track.volume[param - VOLUME0], &track.prevVolume[param - VOLUME0],
-                        &track.volumeInc[param - VOLUME0],
-                        &track.mVolume[param - VOLUME0], &track.mPrevVolume[param - VOLUME0],
-                        &track.mVolumeInc[param - VOLUME0])) {
-                    ALOGV("setParameter(%s, VOLUME%d: %04x)",
-                            target == VOLUME ? "VOLUME" : "RAMP_VOLUME", param - VOLUME0,
-                                    track.volume[param - VOLUME0]);
-                    invalidateState(1 << name);
-                }
+                index = param - VOLUME0;
             } else {
                 LOG_ALWAYS_FATAL("setParameter volume: bad param %d", param);
             }
         }
-        break;
+        track_volume_t& v = mTrackParams[name].pending().volume[index];
+        const float newVolume = *reinterpret_cast<float*>(value);
+        if (v.volume != newVolume) {
+            if (target == RAMP_VOLUME) {
+                if (!v.ramp) {
+                    v.rampFrom = v.volume;
+                    v.rampSerial = v.serial;
+                }
+                v.ramp = true;
+            } else {
+                v.rampSerial = 0;
+                v.ramp = false;
+            }
+            v.volume = newVolume;
+            v.serial++;
+            publishTrackParams(name);
+        }
+        } break;
         case TIMESTRETCH:
             switch (param) {
             case PLAYBACK_RATE: {
@@ -756,6 +1145,101 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
     }
 }
 
+void AudioMixer::TrackParams::reset(const track_params_t& params)
+{
+    mPending = params;
+    mParams[0] = params;
+    mParams[1] = params;
+    atomic_store_explicit(&mSequence, (uint_least32_t)0, memory_order_relaxed);
+}
+
+void AudioMixer::TrackParams::publish()
+{
+    const uint_least32_t sequence = atomic_load_explicit(&mSequence, memory_order_relaxed);
+    // the reader moves to mParams[1] while mParams[0] is written,
+    atomic_store_explicit(&mSequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    mParams[0] = mPending;
+    // then back to mParams[0] while mParams[1] is written.
+    atomic_store_explicit(&mSequence, sequence + 2, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    mParams[1] = mPending;
+}
+
+void AudioMixer::TrackParams::read(track_params_t* params) const
+{
+    uint_least32_t sequence;
+    do {
+        sequence = atomic_load_explicit(&mSequence, memory_order_acquire);
+        *params = mParams[sequence & 1];
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&mSequence, memory_order_relaxed) != sequence);
+}
+
+void AudioMixer::publishTrackParams(int name)
+{
+    mTrackParams[name].publish();
+    atomic_fetch_or_explicit(&mTrackParamsChanged, 1u << name, memory_order_release);
+}
+
+void AudioMixer::applyTrackParams(int name)
+{
+    track_params_t params;
+    mTrackParams[name].read(&params);
+    track_t& t = mState.tracks[name];
+
+    bool volumeChanged = false;
+    for (uint32_t i = 0; i <= MAX_NUM_VOLUMES; i++) {
+        const track_volume_t& v = params.volume[i];
+        if (v.serial == t.mVolumeSerial[i]) {
+            continue;
+        }
+        const bool aux = i == MAX_NUM_VOLUMES;
+        int16_t *pIntSetVolume = aux ? &t.auxLevel : &t.volume[i];
+        int32_t *pIntPrevVolume = aux ? &t.prevAuxLevel : &t.prevVolume[i];
+        int32_t *pIntVolumeInc = aux ? &t.auxInc : &t.volumeInc[i];
+        float *pSetVolume = aux ? &t.mAuxLevel : &t.mVolume[i];
+        float *pPrevVolume = aux ? &t.mPrevAuxLevel : &t.mPrevVolume[i];
+        float *pVolumeInc = aux ? &t.mAuxInc : &t.mVolumeInc[i];
+        // a VOLUME set not applied yet is where the ramp starts
+        if (v.ramp && (int32_t)(v.rampSerial - t.mVolumeSerial[i]) > 0) {
+            volumeChanged |= setVolumeRampVariables(v.rampFrom, 0,
+                    pIntSetVolume, pIntPrevVolume, pIntVolumeInc,
+                    pSetVolume, pPrevVolume, pVolumeInc);
+        }
+        if (setVolumeRampVariables(v.volume, v.ramp ? mState.frameCount : 0,
+                pIntSetVolume, pIntPrevVolume, pIntVolumeInc,
+                pSetVolume, pPrevVolume, pVolumeInc)) {
+            ALOGV("applyTrackParams(%s, %s %u: %04x)", v.ramp ? "RAMP_VOLUME" : "VOLUME",
+                    aux ? "AUXLEVEL" : "VOLUME", i, *pIntSetVolume);
+            volumeChanged = true;
+        }
+        t.mVolumeSerial[i] = v.serial;
+    }
+    if (volumeChanged && t.enabled) {
+        // The hooks depend on the volume only through the mute and aux states they were
+        // selected for, and the legacy single track hook, which cannot ramp.
+        // Disabled tracks get their hooks when enabled.
+        const bool muted = !t.doesResample() && t.volumeRL == 0;
+        const bool needsAux = t.auxLevel != 0 && t.auxBuffer != NULL;
+        if (muted != ((t.needs & NEEDS_MUTE) != 0)
+                || needsAux != ((t.needs & NEEDS_AUX) != 0)
+                || (t.needsRamp() && mState.hook == process__OneTrack16BitsStereoNoResampling)) {
+            invalidateState(1 << name);
+        }
+    }
+
+    // setParameter() only publishes the sample rate of a track that has a resampler.
+    if (params.sampleRate != 0 && t.doesResample()
+            && t.setResampler(params.sampleRate, mSampleRate)) {
+        ALOGV("applyTrackParams(RESAMPLE, SAMPLE_RATE, %u)", params.sampleRate);
+        // resample groups share a source sample rate
+        if (t.mResampleGroup != NULL) {
+            invalidateState(1 << name);
+        }
+    }
+}
+
 bool AudioMixer::track_t::setResampler(uint32_t trackSampleRate, uint32_t devSampleRate)
 {
     if (trackSampleRate != devSampleRate || resampler != NULL) {
@@ -775,10 +1259,7 @@ bool AudioMixer::track_t::setResampler(uint32_t trackSampleRate, uint32_t devSam
                     quality = AudioResampler::DYN_LOW_QUALITY;
                 }
 
-                // TODO: Remove MONO_HACK. Resampler sees #channels after the downmixer
-                // but if none exists, it is the channel count (1 for mono).
-                const int resamplerChannelCount = downmixerBufferProvider != NULL
-                        ? mMixerChannelCount : channelCount;
+                const int resamplerChannelCount = this->resamplerChannelCount();
                 ALOGVV("Creating resampler:"
                         " format(%#x) channels(%d) devSampleRate(%u) quality(%d)\n",
                         mMixerInFormat, resamplerChannelCount, devSampleRate, quality);
@@ -787,6 +1268,7 @@ bool AudioMixer::track_t::setResampler(uint32_t trackSampleRate, uint32_t devSam
                         resamplerChannelCount,
                         devSampleRate, quality);
                 resampler->setLocalTimeFreq(sLocalTimeFreq);
+                prepareForProviderConversion();
             }
             return true;
         }
@@ -806,11 +1288,12 @@ bool AudioMixer::track_t::setPlaybackRate(const AudioPlaybackRate &playbackRate)
     if (mTimestretchBufferProvider == NULL) {
         // TODO: Remove MONO_HACK. Resampler sees #channels after the downmixer
         // but if none exists, it is the channel count (1 for mono).
-        const int timestretchChannelCount = downmixerBufferProvider != NULL
+        const int timestretchChannelCount = downmixerBufferProvider != NULL || mDownmixInMixer
                 ? mMixerChannelCount : channelCount;
         mTimestretchBufferProvider = new TimestretchBufferProvider(timestretchChannelCount,
                 mMixerInFormat, sampleRate, playbackRate);
         reconfigureBufferProviders();
+        prepareForProviderConversion();
     } else {
         reinterpret_cast<TimestretchBufferProvider*>(mTimestretchBufferProvider)
                 ->setPlaybackRate(playbackRate);
@@ -874,6 +1357,14 @@ inline void AudioMixer::track_t::adjustVolumeRamp(bool aux, bool useFloat)
     }
 }
 
+size_t AudioMixer::track_t::getUnreleasedFrames() const
+{
+    if (mResampleGroup != NULL) {
+        return mResampleGroup->getUnreleasedFrames();
+    }
+    return resampler != NULL ? resampler->getUnreleasedFrames() : 0;
+}
+
 size_t AudioMixer::getUnreleasedFrames(int name) const
 {
     name -= TRACK0;
@@ -908,6 +1399,15 @@ void AudioMixer::setBufferProvider(int name, AudioBufferProvider* bufferProvider
 
 void AudioMixer::process(int64_t pts)
 {
+    if (atomic_load_explicit(&mTrackParamsChanged, memory_order_relaxed) != 0) {
+        uint32_t changed = atomic_exchange_explicit(&mTrackParamsChanged, (uint_least32_t)0,
+                memory_order_acquire);
+        while (changed) {
+            const int i = 31 - __builtin_clz(changed);
+            changed &= ~(1u << i);
+            applyTrackParams(i);
+        }
+    }
     mState.hook(&mState, pts);
 }
 
@@ -975,9 +1475,13 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
                 all16BitsStereoNoResample = false;
                 resampling = true;
                 t.hook = getTrackHook(TRACKTYPE_RESAMPLE, t.mMixerChannelCount,
-                        t.mMixerInFormat, t.mMixerFormat);
+                        t.hookInFormat(), t.mMixerInFormat, t.mMixerFormat);
                 ALOGV_IF((n & NEEDS_CHANNEL_COUNT__MASK) > NEEDS_CHANNEL_2,
                         "Track %d needs downmix + resample", i);
+            } else if (t.mDownmixInMixer) {
+                all16BitsStereoNoResample = false;
+                t.hook = getTrackHook(TRACKTYPE_NORESAMPLEDOWNMIX, t.channelCount,
+                        t.hookInFormat(), t.mMixerInFormat, t.mMixerFormat);
             } else {
                 if ((n & NEEDS_CHANNEL_COUNT__MASK) == NEEDS_CHANNEL_1){
                     t.hook = getTrackHook(
@@ -985,12 +1489,12 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
                                     && t.channelMask == AUDIO_CHANNEL_OUT_MONO)
                                 ? TRACKTYPE_NORESAMPLEMONO : TRACKTYPE_NORESAMPLE,
                             t.mMixerChannelCount,
-                            t.mMixerInFormat, t.mMixerFormat);
+                            t.hookInFormat(), t.mMixerInFormat, t.mMixerFormat);
                     all16BitsStereoNoResample = false;
                 }
                 if ((n & NEEDS_CHANNEL_COUNT__MASK) >= NEEDS_CHANNEL_2){
                     t.hook = getTrackHook(TRACKTYPE_NORESAMPLE, t.mMixerChannelCount,
-                            t.mMixerInFormat, t.mMixerFormat);
+                            t.hookInFormat(), t.mMixerInFormat, t.mMixerFormat);
                     ALOGV_IF((n & NEEDS_CHANNEL_COUNT__MASK) > NEEDS_CHANNEL_2,
                             "Track %d needs downmix", i);
                 }
@@ -998,17 +1502,27 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
         }
     }
 
+    groupResamplers(state);
+
     // select the processing hooks
     state->hook = process__nop;
     if (countActiveTracks > 0) {
-        if (resampling) {
+        const bool parallel = state->helpers != NULL
+                && countActiveTracks >= kParallelMixMinTracks;
+        if (resampling || parallel) {
             if (!state->outputTemp) {
                 state->outputTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
             if (!state->resampleTemp) {
                 state->resampleTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
-            state->hook = process__genericResampling;
+            if (parallel) {
+                state->helpers->prepare(state->frameCount);
+                state->helpers->inheritScheduling();
+                state->hook = process__parallel;
+            } else {
+                state->hook = process__genericResampling;
+            }
         } else {
             if (state->outputTemp) {
                 delete [] state->outputTemp;
@@ -1030,7 +1544,8 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
                         // special case handling due to implicit channel duplication.
                         // Stereo or Multichannel should actually be fine here.
                         state->hook = getProcessHook(PROCESSTYPE_NORESAMPLEONETRACK,
-                                t.mMixerChannelCount, t.mMixerInFormat, t.mMixerFormat);
+                                t.mMixerChannelCount, t.hookInFormat(),
+                                t.mMixerInFormat, t.mMixerFormat);
                     }
                 }
             }
@@ -1038,9 +1553,12 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     }
 
     ALOGV("mixer configuration change: %d activeTracks (%08x) "
-        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d",
+        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d, parallel=%d",
         countActiveTracks, state->enabledTracks,
-        all16BitsStereoNoResample, resampling, volumeRamp);
+        all16BitsStereoNoResample, resampling, volumeRamp,
+        state->hook == process__parallel);
+    state->mLog->logFormat(NBLog::FORMAT_MIXER_CONFIG, countActiveTracks, state->enabledTracks,
+            resampling, volumeRamp, state->hook == process__parallel);
 
    state->hook(state, pts);
 
@@ -1068,12 +1586,99 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
                 track_t& t = state->tracks[i];
                 // Muted single tracks handled by allMuted above.
                 state->hook = getProcessHook(PROCESSTYPE_NORESAMPLEONETRACK,
-                        t.mMixerChannelCount, t.mMixerInFormat, t.mMixerFormat);
+                        t.mMixerChannelCount, t.hookInFormat(),
+                        t.mMixerInFormat, t.mMixerFormat);
             }
         }
     }
 }
 
+/* Assigns the enabled resampled tracks to resample groups, if grouping is enabled.
+ *
+ * Float tracks without an aux buffer are grouped by main buffer, source sample rate,
+ * resampler quality and mixer channel count.  Mono tracks to a stereo mix are expanded
+ * into the group mix, otherwise the resampler input must already have the mixer channels.
+ * Groups outlive revalidation so that their resampler history is kept as members come
+ * and go, or as the main buffer moves; a group is deleted once it has no members left.
+ * The highest numbered member of each group resamples for the whole group, the others
+ * get track__nop.
+ */
+void AudioMixer::groupResamplers(state_t* state)
+{
+    for (unsigned j = 0; j < MAX_NUM_TRACKS; j++) {
+        state->tracks[j].mResampleGroup = NULL;
+        if (state->resampleGroups[j] != NULL) {
+            state->resampleGroups[j]->clearMembers();
+        }
+    }
+
+    uint32_t en = state->groupResampling ? state->enabledTracks : 0;
+    while (en) {
+        const int i = 31 - __builtin_clz(en);
+        en &= ~(1<<i);
+        track_t& t = state->tracks[i];
+        const uint32_t channels = t.resamplerChannelCount();
+        if (!(t.needs & NEEDS_RESAMPLE) || t.auxBuffer != NULL
+                || t.mMixerInFormat != AUDIO_FORMAT_PCM_FLOAT
+                || (channels != t.mMixerChannelCount
+                        && !(channels == 1 && t.mMixerChannelCount == FCC_2))) {
+            continue;
+        }
+        // prefer a group on the same main buffer, then an unclaimed compatible group.
+        ResampleGroup* group = NULL;
+        ResampleGroup* unclaimed = NULL;
+        ResampleGroup** unused = NULL;
+        for (unsigned j = 0; j < MAX_NUM_TRACKS; j++) {
+            ResampleGroup* g = state->resampleGroups[j];
+            if (g == NULL) {
+                if (unused == NULL) {
+                    unused = &state->resampleGroups[j];
+                }
+            } else if (g->matches(t)) {
+                if (g->mainBuffer() == t.mainBuffer) {
+                    group = g;
+                    break;
+                }
+                if (unclaimed == NULL && g->members() == 0) {
+                    unclaimed = g;
+                }
+            }
+        }
+        if (group == NULL) {
+            group = unclaimed;
+        }
+        if (group == NULL) {
+            if (unused == NULL) {
+                continue; // all slots held by groups pending deletion, resample on its own
+            }
+            group = new ResampleGroup(state, t);
+            *unused = group;
+        }
+        group->addMember(i, t.mainBuffer);
+        t.mResampleGroup = group;
+    }
+
+    for (unsigned j = 0; j < MAX_NUM_TRACKS; j++) {
+        ResampleGroup* group = state->resampleGroups[j];
+        if (group == NULL) {
+            continue;
+        }
+        uint32_t members = group->members();
+        if (members == 0) {
+            delete group;
+            state->resampleGroups[j] = NULL;
+            continue;
+        }
+        const int leader = 31 - __builtin_clz(members);
+        members &= ~(1<<leader);
+        state->tracks[leader].hook = track__ResampleGroup;
+        while (members) {
+            const int i = 31 - __builtin_clz(members);
+            members &= ~(1<<i);
+            state->tracks[i].hook = track__nop;
+        }
+    }
+}
 
 void AudioMixer::track__genericResample(track_t* t, int32_t* out, size_t outFrameCount,
         int32_t* temp, int32_t* aux)
@@ -1114,6 +1719,14 @@ void AudioMixer::track__nop(track_t* t __unused, int32_t* out __unused,
 {
 }
 
+// called for one member of each resample group, the other members use track__nop
+void AudioMixer::track__ResampleGroup(track_t* t, int32_t* out, size_t outFrameCount,
+        int32_t* temp __unused, int32_t* aux __unused)
+{
+    ALOGVV("track__ResampleGroup\n");
+    t->mResampleGroup->resample(out, outFrameCount);
+}
+
 void AudioMixer::volumeRampStereo(track_t* t, int32_t* out, size_t frameCount, int32_t* temp,
         int32_t* aux)
 {
@@ -1548,46 +2161,138 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
         e0 &= ~(e1);
         int32_t *out = t1.mainBuffer;
         memset(outTemp, 0, sizeof(*outTemp) * t1.mMixerChannelCount * state->frameCount);
-        while (e1) {
-            const int i = 31 - __builtin_clz(e1);
-            e1 &= ~(1<<i);
-            track_t& t = state->tracks[i];
-            int32_t *aux = NULL;
-            if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
-                aux = t.auxBuffer;
-            }
+        mixTrackGroup(state, e1, outTemp, state->resampleTemp, pts);
+        convertMixerFormat(out, t1.mMixerFormat,
+                outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
+    }
+}
 
-            // this is a little goofy, on the resampling case we don't
-            // acquire/release the buffers because it's done by
-            // the resampler.
-            if (t.needs & NEEDS_RESAMPLE) {
-                t.resampler->setPTS(pts);
-                t.hook(&t, outTemp, numFrames, state->resampleTemp, aux);
-            } else {
+// mix a group of tracks sharing the same main buffer into outTemp, which must be cleared
+// by the caller.  Each track is processed over the whole frame count before the next one.
+void AudioMixer::mixTrackGroup(state_t* state, uint32_t mask, int32_t* outTemp,
+        int32_t* resampleTemp, int64_t pts)
+{
+    const size_t numFrames = state->frameCount;
+    while (mask) {
+        const int i = 31 - __builtin_clz(mask);
+        mask &= ~(1<<i);
+        track_t& t = state->tracks[i];
+        int32_t *aux = NULL;
+        if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
+            aux = t.auxBuffer;
+        }
 
-                size_t outFrames = 0;
+        // this is a little goofy, on the resampling case we don't
+        // acquire/release the buffers because it's done by
+        // the resampler.
+        if (t.needs & NEEDS_RESAMPLE) {
+            t.resampler->setPTS(pts);
+            // only the group leader runs the group resampler; with helper
+            // threads the other members may be mixed concurrently.
+            if (t.hook == track__ResampleGroup) {
+                t.mResampleGroup->setPTS(pts);
+            }
+            t.hook(&t, outTemp, numFrames, resampleTemp, aux);
+        } else {
 
-                while (outFrames < numFrames) {
-                    t.buffer.frameCount = numFrames - outFrames;
-                    int64_t outputPTS = calculateOutputPTS(t, pts, outFrames);
-                    t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
-                    t.in = t.buffer.raw;
-                    // t.in == NULL can happen if the track was flushed just after having
-                    // been enabled for mixing.
-                    if (t.in == NULL) break;
+            size_t outFrames = 0;
 
-                    if (CC_UNLIKELY(aux != NULL)) {
-                        aux += outFrames;
-                    }
-                    t.hook(&t, outTemp + outFrames * t.mMixerChannelCount, t.buffer.frameCount,
-                            state->resampleTemp, aux);
-                    outFrames += t.buffer.frameCount;
-                    t.bufferProvider->releaseBuffer(&t.buffer);
+            while (outFrames < numFrames) {
+                t.buffer.frameCount = numFrames - outFrames;
+                int64_t outputPTS = calculateOutputPTS(t, pts, outFrames);
+                t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
+                t.in = t.buffer.raw;
+                // t.in == NULL can happen if the track was flushed just after having
+                // been enabled for mixing.
+                if (t.in == NULL) break;
+
+                if (CC_UNLIKELY(aux != NULL)) {
+                    aux += outFrames;
                 }
+                t.hook(&t, outTemp + outFrames * t.mMixerChannelCount, t.buffer.frameCount,
+                        resampleTemp, aux);
+                outFrames += t.buffer.frameCount;
+                t.bufferProvider->releaseBuffer(&t.buffer);
             }
         }
-        convertMixerFormat(out, t1.mMixerFormat,
-                outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
+    }
+}
+
+template <typename T>
+static inline void accumulatePartial(T* out, const T* in, size_t sampleCount)
+{
+    for (size_t i = 0; i < sampleCount; ++i) {
+        out[i] += in[i];
+    }
+}
+
+// generic code with the tracks split across the helper threads.
+//
+// The tracks of each output group are dealt round-robin, in decreasing track name order,
+// to the mixer thread and the helpers.  Tracks sending to an aux buffer stay on the
+// mixer thread, since aux buffers may be shared between tracks.  The assignment depends
+// only on the enabled track set and the partial sums are added in helper order,
+// so the output is identical from run to run.
+void AudioMixer::process__parallel(state_t* state, int64_t pts)
+{
+    ALOGVV("process__parallel\n");
+    HelperThreads* const helpers = state->helpers;
+    const uint32_t partitions = helpers->count() + 1;
+    int32_t* const outTemp = state->outputTemp;
+    const size_t numFrames = state->frameCount;
+
+    uint32_t e0 = state->enabledTracks;
+    while (e0) {
+        // process by group of tracks with same output buffer
+        uint32_t e1 = e0, e2 = e0;
+        int j = 31 - __builtin_clz(e1);
+        track_t& t1 = state->tracks[j];
+        e2 &= ~(1<<j);
+        while (e2) {
+            j = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<j);
+            track_t& t2 = state->tracks[j];
+            if (CC_UNLIKELY(t2.mainBuffer != t1.mainBuffer)) {
+                e1 &= ~(1<<j);
+            }
+        }
+        e0 &= ~(e1);
+
+        // tracks[0] is mixed on this thread, tracks[n + 1] by helper n.
+        uint32_t tracks[MAX_NUM_HELPER_THREADS + 1];
+        memset(tracks, 0, sizeof(tracks));
+        uint32_t next = 0;
+        e2 = e1;
+        while (e2) {
+            const int i = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<i);
+            if (state->tracks[i].needs & NEEDS_AUX) {
+                tracks[0] |= 1<<i;
+            } else {
+                tracks[next] |= 1<<i;
+                next = (next + 1) % partitions;
+            }
+        }
+
+        helpers->start(state, tracks + 1, pts);
+        const size_t sampleCount = numFrames * t1.mMixerChannelCount;
+        memset(outTemp, 0, sizeof(*outTemp) * sampleCount);
+        mixTrackGroup(state, tracks[0], outTemp, state->resampleTemp, pts);
+        helpers->wait();
+
+        for (uint32_t n = 1; n < partitions; ++n) {
+            if (tracks[n] == 0) {
+                continue;
+            }
+            if (t1.mMixerInFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                accumulatePartial((float*)outTemp, (const float*)helpers->partial(n - 1),
+                        sampleCount);
+            } else {
+                accumulatePartial(outTemp, helpers->partial(n - 1), sampleCount);
+            }
+        }
+        convertMixerFormat(t1.mainBuffer, t1.mMixerFormat,
+                outTemp, t1.mMixerInFormat, sampleCount);
     }
 }
 
@@ -1789,6 +2494,140 @@ static void volumeMulti(uint32_t channels, TO* out, size_t frameCount,
     }
 }
 
+// ----------------------------------------------------------------------------
+
+AudioMixer::ResampleGroup::ResampleGroup(state_t* state, const track_t& t)
+    :   mState(state), mMainBuffer(t.mainBuffer), mSampleRate(t.sampleRate),
+        mChannelCount(t.mMixerChannelCount), mMixerInFormat(t.mMixerInFormat),
+        mMixerFormat(t.mMixerFormat), mQuality(t.resampler->getQuality()),
+        mResampler(NULL), mMembers(0),
+        mBuffer(new float[kCopyBufferFrameCount * t.mMixerChannelCount]),
+        mOffset(0), mAvailable(0)
+{
+    ALOGV("ResampleGroup(%p) %u Hz, %u channels, quality %d",
+            this, mSampleRate, mChannelCount, mQuality);
+    mResampler = AudioResampler::create(mMixerInFormat, mChannelCount,
+            state->sampleRate, mQuality);
+    mResampler->setLocalTimeFreq(sLocalTimeFreq);
+    mResampler->setSampleRate(mSampleRate);
+    mResampler->setVolume(UNITY_GAIN_FLOAT, UNITY_GAIN_FLOAT);
+}
+
+AudioMixer::ResampleGroup::~ResampleGroup()
+{
+    ALOGV("~ResampleGroup(%p)", this);
+    delete mResampler;
+    delete [] mBuffer;
+}
+
+bool AudioMixer::ResampleGroup::matches(const track_t& t) const
+{
+    return t.sampleRate == mSampleRate
+            && t.mMixerChannelCount == mChannelCount
+            && t.mMixerInFormat == mMixerInFormat
+            && t.mMixerFormat == mMixerFormat
+            && t.resampler->getQuality() == mQuality;
+}
+
+void AudioMixer::ResampleGroup::resample(int32_t* out, size_t frameCount)
+{
+    mResampler->resample(out, frameCount, this);
+
+    // the member volume ramps were applied while filling, finish them as volumeMix() does.
+    uint32_t members = mMembers;
+    while (members) {
+        const int i = 31 - __builtin_clz(members);
+        members &= ~(1<<i);
+        track_t& t = mState->tracks[i];
+        if (t.needsRamp()) {
+            t.adjustVolumeRamp(false /* aux */, true /* useFloat */);
+        }
+    }
+}
+
+bool AudioMixer::ResampleGroup::fill(size_t frameCount, int64_t pts)
+{
+    memset(mBuffer, 0, frameCount * mChannelCount * sizeof(float));
+    // the volume increments are per output frame, but are applied here at the source rate.
+    const float rampScale = (float)mState->sampleRate / mSampleRate;
+    bool filled = false;
+    uint32_t members = mMembers;
+    while (members) {
+        const int i = 31 - __builtin_clz(members);
+        members &= ~(1<<i);
+        track_t& t = mState->tracks[i];
+        const bool ramp = t.needsRamp();
+        const bool expand = t.resamplerChannelCount() != mChannelCount;
+        float volumeInc[MAX_NUM_VOLUMES];
+        for (uint32_t v = 0; v < MAX_NUM_VOLUMES; v++) {
+            volumeInc[v] = t.mVolumeInc[v] * rampScale;
+        }
+        size_t frames = 0;
+        while (frames < frameCount) {
+            t.buffer.frameCount = frameCount - frames;
+            t.bufferProvider->getNextBuffer(&t.buffer, pts);
+            if (t.buffer.raw == NULL) {
+                break; // underrun: the rest of this member is silent
+            }
+            float* out = mBuffer + frames * mChannelCount;
+            const float* in = static_cast<const float*>(t.buffer.raw);
+            const size_t n = t.buffer.frameCount;
+            if (ramp) {
+                if (expand) {
+                    volumeRampMulti<MIXTYPE_MONOEXPAND>(mChannelCount, out, n, in,
+                            (int32_t*)NULL, t.mPrevVolume, volumeInc,
+                            &t.prevAuxLevel, t.auxInc);
+                } else {
+                    volumeRampMulti<MIXTYPE_MULTI>(mChannelCount, out, n, in,
+                            (int32_t*)NULL, t.mPrevVolume, volumeInc,
+                            &t.prevAuxLevel, t.auxInc);
+                }
+            } else {
+                if (expand) {
+                    volumeMulti<MIXTYPE_MONOEXPAND>(mChannelCount, out, n, in,
+                            (int32_t*)NULL, t.mVolume, t.auxLevel);
+                } else {
+                    volumeMulti<MIXTYPE_MULTI>(mChannelCount, out, n, in,
+                            (int32_t*)NULL, t.mVolume, t.auxLevel);
+                }
+            }
+            frames += n;
+            t.bufferProvider->releaseBuffer(&t.buffer);
+            filled = true;
+        }
+    }
+    return filled;
+}
+
+status_t AudioMixer::ResampleGroup::getNextBuffer(Buffer* buffer, int64_t pts)
+{
+    if (mAvailable == 0) {
+        const size_t frames = min(buffer->frameCount, kCopyBufferFrameCount);
+        if (frames == 0 || !fill(frames, pts)) {
+            buffer->raw = NULL;
+            buffer->frameCount = 0;
+            return NOT_ENOUGH_DATA;
+        }
+        mOffset = 0;
+        mAvailable = frames;
+    }
+    buffer->raw = mBuffer + mOffset * mChannelCount;
+    buffer->frameCount = min(buffer->frameCount, mAvailable);
+    return OK;
+}
+
+void AudioMixer::ResampleGroup::releaseBuffer(Buffer* buffer)
+{
+    ALOG_ASSERT(buffer->frameCount <= mAvailable, "releaseBuffer %zu > available %zu",
+            buffer->frameCount, mAvailable);
+    mOffset += buffer->frameCount;
+    mAvailable -= buffer->frameCount;
+    buffer->raw = NULL;
+    buffer->frameCount = 0;
+}
+
+// ----------------------------------------------------------------------------
+
 /* MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
  * USEFLOATVOL (set to true if float volume is used)
  * ADJUSTVOL   (set to true if volume ramp parameters needs adjustment afterwards)
@@ -1831,11 +2670,12 @@ void AudioMixer::volumeMix(TO *out, size_t outFrames,
  * TODO: Update the hook selection: this can properly handle aux and ramp.
  *
  * MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
- * TO: int32_t (Q4.27) or float
- * TI: int32_t (Q4.27) or int16_t (Q0.15) or float
+ * USEFLOATVOL (set for a float mixer engine, including int16_t tracks it converts)
+ * TO: int16_t (Q.15) or float
+ * TI: int16_t (Q0.15) or float
  * TA: int32_t (Q4.27)
  */
-template <int MIXTYPE, typename TO, typename TI, typename TA>
+template <int MIXTYPE, bool USEFLOATVOL, typename TO, typename TI, typename TA>
 void AudioMixer::process_NoResampleOneTrack(state_t* state, int64_t pts)
 {
     ALOGVV("process_NoResampleOneTrack\n");
@@ -1868,7 +2708,7 @@ void AudioMixer::process_NoResampleOneTrack(state_t* state, int64_t pts)
         }
 
         const size_t outFrames = b.frameCount;
-        volumeMix<MIXTYPE, is_same<TI, float>::value, false> (
+        volumeMix<MIXTYPE, USEFLOATVOL, false> (
                 out, outFrames, in, aux, ramp, t);
 
         out += outFrames * channels;
@@ -1881,7 +2721,7 @@ void AudioMixer::process_NoResampleOneTrack(state_t* state, int64_t pts)
         t->bufferProvider->releaseBuffer(&b);
     }
     if (ramp) {
-        t->adjustVolumeRamp(aux != NULL, is_same<TI, float>::value);
+        t->adjustVolumeRamp(aux != NULL, USEFLOATVOL);
     }
 }
 
@@ -1922,6 +2762,7 @@ void AudioMixer::track__Resample(track_t* t, TO* out, size_t outFrameCount, TO*
  * MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
  * TO: int32_t (Q4.27) or float
  * TI: int32_t (Q4.27) or int16_t (Q0.15) or float
+ *     (int16_t with float TO is converted as it is mixed, see mReformatInMixer)
  * TA: int32_t (Q4.27)
  */
 template <int MIXTYPE, typename TO, typename TI, typename TA>
@@ -1931,7 +2772,7 @@ void AudioMixer::track__NoResample(track_t* t, TO* out, size_t frameCount,
     ALOGVV("track__NoResample\n");
     const TI *in = static_cast<const TI *>(t->in);
 
-    volumeMix<MIXTYPE, is_same<TI, float>::value, true>(
+    volumeMix<MIXTYPE, is_same<TO, float>::value, true>(
             out, frameCount, in, aux, t->needsRamp(), t);
 
     // MIXTYPE_MONOEXPAND reads a single input channel and expands to NCHAN output channels.
@@ -1940,6 +2781,44 @@ void AudioMixer::track__NoResample(track_t* t, TO* out, size_t frameCount,
     t->in = in;
 }
 
+/* This track hook is called to mix a quad, 5.1 or 7.1 track into a stereo mix,
+ * when no resampling is required.  The input is folded down to stereo a block
+ * at a time, as the downmix effect would, and the block is mixed while in cache.
+ * The input buffer should be present in t->in.
+ *
+ * NCHAN: 4, 6 or 8 input channels (see downmixToStereo() in AudioMixerOps.h)
+ * TO: int32_t (Q4.27) or float
+ * TI: int16_t (Q0.15) or float
+ *     (int16_t with float TO is folded down in float, see mReformatInMixer)
+ * TA: int32_t (Q4.27)
+ */
+template <int NCHAN, typename TO, typename TI, typename TA>
+void AudioMixer::track__NoResampleDownmix(track_t* t, TO* out, size_t frameCount,
+        TO* temp __unused, TA* aux)
+{
+    ALOGVV("track__NoResampleDownmix\n");
+    const TI *in = static_cast<const TI *>(t->in);
+    const bool ramp = t->needsRamp();
+    typename MixerInSample<TO>::type stereo[kDownmixBlockFrames * FCC_2];
+
+    while (frameCount) {
+        const size_t frames = min(frameCount, kDownmixBlockFrames);
+        downmixToStereo<NCHAN>(stereo, in, frames);
+        volumeMix<MIXTYPE_MULTI, is_same<TO, float>::value, false>(
+                out, frames, stereo, aux, ramp, t);
+        in += frames * NCHAN;
+        out += frames * FCC_2;
+        if (aux != NULL) {
+            aux += frames;
+        }
+        frameCount -= frames;
+    }
+    if (ramp) {
+        t->adjustVolumeRamp(aux != NULL, is_same<TO, float>::value);
+    }
+    t->in = in;
+}
+
 /* The Mixer engine generates either int32_t (Q4_27) or float data.
  * We use this function to convert the engine buffers
  * to the desired mixer output format, either int16_t (Q.15) or float.
@@ -1982,10 +2861,17 @@ void AudioMixer::convertMixerFormat(void *out, audio_format_t mixerOutFormat,
 }
 
 /* Returns the proper track hook to use for mixing the track into the output buffer.
+ * For a float mixer engine, trackFormat may be AUDIO_FORMAT_PCM_16_BIT if the hook
+ * does the conversion; otherwise it must match mixerInFormat.
  */
 AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount,
-        audio_format_t mixerInFormat, audio_format_t mixerOutFormat __unused)
+        audio_format_t trackFormat, audio_format_t mixerInFormat,
+        audio_format_t mixerOutFormat __unused)
 {
+    const bool convert = trackFormat != mixerInFormat;
+    LOG_ALWAYS_FATAL_IF(convert && (trackFormat != AUDIO_FORMAT_PCM_16_BIT
+            || mixerInFormat != AUDIO_FORMAT_PCM_FLOAT || trackType == TRACKTYPE_RESAMPLE),
+            "bad trackFormat: %#x for mixerInFormat: %#x", trackFormat, mixerInFormat);
     if (!kUseNewMixer && channelCount == FCC_2 && mixerInFormat == AUDIO_FORMAT_PCM_16_BIT) {
         switch (trackType) {
         case TRACKTYPE_NOP:
@@ -2021,6 +2907,10 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
     case TRACKTYPE_NORESAMPLEMONO:
         switch (mixerInFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
+            if (convert) {
+                return (AudioMixer::hook_t)
+                        track__NoResample<MIXTYPE_MONOEXPAND, float, int16_t, int32_t>;
+            }
             return (AudioMixer::hook_t)
                     track__NoResample<MIXTYPE_MONOEXPAND, float, float, int32_t>;
         case AUDIO_FORMAT_PCM_16_BIT:
@@ -2034,6 +2924,10 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
     case TRACKTYPE_NORESAMPLE:
         switch (mixerInFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
+            if (convert) {
+                return (AudioMixer::hook_t)
+                        track__NoResample<MIXTYPE_MULTI, float, int16_t, int32_t>;
+            }
             return (AudioMixer::hook_t)
                     track__NoResample<MIXTYPE_MULTI, float, float, int32_t>;
         case AUDIO_FORMAT_PCM_16_BIT:
@@ -2044,6 +2938,51 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
             break;
         }
         break;
+    case TRACKTYPE_NORESAMPLEDOWNMIX: // channelCount is the track channel count
+        switch (mixerInFormat) {
+        case AUDIO_FORMAT_PCM_FLOAT:
+            switch (channelCount) {
+            case 4:
+                return convert ? (AudioMixer::hook_t)
+                        track__NoResampleDownmix<4, float, int16_t, int32_t>
+                        : (AudioMixer::hook_t)
+                        track__NoResampleDownmix<4, float, float, int32_t>;
+            case 6:
+                return convert ? (AudioMixer::hook_t)
+                        track__NoResampleDownmix<6, float, int16_t, int32_t>
+                        : (AudioMixer::hook_t)
+                        track__NoResampleDownmix<6, float, float, int32_t>;
+            case 8:
+                return convert ? (AudioMixer::hook_t)
+                        track__NoResampleDownmix<8, float, int16_t, int32_t>
+                        : (AudioMixer::hook_t)
+                        track__NoResampleDownmix<8, float, float, int32_t>;
+            default:
+                LOG_ALWAYS_FATAL("bad downmix channelCount: %u", channelCount);
+                break;
+            }
+            break;
+        case AUDIO_FORMAT_PCM_16_BIT:
+            switch (channelCount) {
+            case 4:
+                return (AudioMixer::hook_t)
+                        track__NoResampleDownmix<4, int32_t, int16_t, int32_t>;
+            case 6:
+                return (AudioMixer::hook_t)
+                        track__NoResampleDownmix<6, int32_t, int16_t, int32_t>;
+            case 8:
+                return (AudioMixer::hook_t)
+                        track__NoResampleDownmix<8, int32_t, int16_t, int32_t>;
+            default:
+                LOG_ALWAYS_FATAL("bad downmix channelCount: %u", channelCount);
+                break;
+            }
+            break;
+        default:
+            LOG_ALWAYS_FATAL("bad mixerInFormat: %#x", mixerInFormat);
+            break;
+        }
+        break;
     default:
         LOG_ALWAYS_FATAL("bad trackType: %d", trackType);
         break;
@@ -2057,9 +2996,12 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
  * TODO: Due to the special mixing considerations of duplicating to
  * a stereo output track, the input track cannot be MONO.  This should be
  * prevented by the caller.
+ *
+ * trackFormat is as for getTrackHook().
  */
 AudioMixer::process_hook_t AudioMixer::getProcessHook(int processType, uint32_t channelCount,
-        audio_format_t mixerInFormat, audio_format_t mixerOutFormat)
+        audio_format_t trackFormat, audio_format_t mixerInFormat,
+        audio_format_t mixerOutFormat)
 {
     if (processType != PROCESSTYPE_NORESAMPLEONETRACK) { // Only NORESAMPLEONETRACK
         LOG_ALWAYS_FATAL("bad processType: %d", processType);
@@ -2071,12 +3013,26 @@ AudioMixer::process_hook_t AudioMixer::getProcessHook(int processType, uint32_t
     LOG_ALWAYS_FATAL_IF(channelCount > MAX_NUM_CHANNELS);
     switch (mixerInFormat) {
     case AUDIO_FORMAT_PCM_FLOAT:
+        if (trackFormat == AUDIO_FORMAT_PCM_16_BIT) { // converted by the hook
+            switch (mixerOutFormat) {
+            case AUDIO_FORMAT_PCM_FLOAT:
+                return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, true,
+                        float, int16_t, int32_t>;
+            case AUDIO_FORMAT_PCM_16_BIT:
+                return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, true,
+                        int16_t, int16_t, int32_t>;
+            default:
+                LOG_ALWAYS_FATAL("bad mixerOutFormat: %#x", mixerOutFormat);
+                break;
+            }
+            break;
+        }
         switch (mixerOutFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
-            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY,
+            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, true /*USEFLOATVOL*/,
                     float /*TO*/, float /*TI*/, int32_t /*TA*/>;
         case AUDIO_FORMAT_PCM_16_BIT:
-            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY,
+            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, true,
                     int16_t, float, int32_t>;
         default:
             LOG_ALWAYS_FATAL("bad mixerOutFormat: %#x", mixerOutFormat);
@@ -2086,10 +3042,10 @@ AudioMixer::process_hook_t AudioMixer::getProcessHook(int processType, uint32_t
     case AUDIO_FORMAT_PCM_16_BIT:
         switch (mixerOutFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
-            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY,
+            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, false,
                     float, int16_t, int32_t>;
         case AUDIO_FORMAT_PCM_16_BIT:
-            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY,
+            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, false,
                     int16_t, int16_t, int32_t>;
         default:
             LOG_ALWAYS_FATAL("bad mixerOutFormat: %#x", mixerOutFormat);
@@ -18,6 +18,7 @@
 #ifndef ANDROID_AUDIO_MIXER_H
 #define ANDROID_AUDIO_MIXER_H
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -58,6 +59,8 @@ public:
     static const uint32_t MAX_NUM_VOLUMES = 2; // stereo volume only
     // maximum number of channels supported for the content
     static const uint32_t MAX_NUM_CHANNELS_TO_DOWNMIX = AUDIO_CHANNEL_COUNT_MAX;
+    // maximum number of helper threads for parallel mixing, see setHelperThreads()
+    static const uint32_t MAX_NUM_HELPER_THREADS = 7;
 
     static const uint16_t UNITY_GAIN_INT = 0x1000;
     static const CONSTEXPR float UNITY_GAIN_FLOAT = 1.0f;
@@ -123,6 +126,11 @@ public:
     void        enable(int name);
     void        disable(int name);
 
+    // VOLUME, RAMP_VOLUME and the SAMPLE_RATE of a track that already resamples are
+    // published to the next process() without a lock, and only cause the track and
+    // process hooks to be reselected if the change makes the current hooks unsuitable.
+    // Those parameters may be set from one thread other than the one calling process();
+    // all other parameters must be set on the thread calling process().
     void        setParameter(int name, int target, int param, void *value);
 
     void        setBufferProvider(int name, AudioBufferProvider* bufferProvider);
@@ -132,6 +140,21 @@ public:
 
     size_t      getUnreleasedFrames(int name) const;
 
+    // Split the mix of many enabled tracks across helperCount additional threads,
+    // up to MAX_NUM_HELPER_THREADS.  Each helper mixes a fixed subset of the tracks
+    // into its own partial buffer, and the partial buffers are summed in a fixed order
+    // before format conversion, so the output is reproducible for a given helper count.
+    // If cpuMask is non-zero, helper n is pinned to the n-th CPU set in cpuMask (wrapping).
+    // 0 (the default) mixes all tracks serially on the thread calling process().
+    // Must not be called concurrently with process().  Returns the number of helpers started.
+    uint32_t    setHelperThreads(uint32_t helperCount, uint32_t cpuMask = 0);
+
+    // When enabled, resampled float tracks sharing main buffer, sample rate, resampler quality
+    // and channel layout are mixed together at their source rate, each with its own volume,
+    // and the sum is resampled once.  Tracks with an aux buffer keep their own resampler.
+    // Disabled by default.
+    void        setResampleGrouping(bool enabled);
+
     static inline bool isValidPcmTrackFormat(audio_format_t format) {
         switch (format) {
         case AUDIO_FORMAT_PCM_8_BIT:
@@ -165,6 +188,8 @@ private:
 
     struct state_t;
     struct track_t;
+    class HelperThreads;
+    class ResampleGroup;
 
     typedef void (*hook_t)(track_t* t, int32_t* output, size_t numOutFrames, int32_t* temp,
                            int32_t* aux);
@@ -232,12 +257,22 @@ private:
          * 4) mPostDownmixReformatBufferProvider: If not NULL, performs reformatting from
          *    the downmixer requirements to the mixer engine input requirements.
          * 5) mTimestretchBufferProvider: Adds timestretching for playback rate
+         *
+         * Quad, 5.1 and 7.1 tracks mixed to stereo without resampling or timestretching
+         * have no downmixerBufferProvider: mDownmixInMixer is set and the track hook
+         * folds the track down to stereo as it mixes.
+         *
+         * Likewise PCM_16_BIT tracks to a float mixer without resampling, timestretching
+         * or downmixerBufferProvider have no mReformatBufferProvider: mReformatInMixer is
+         * set and the track hook converts the track to float as it mixes.
          */
         AudioBufferProvider*     mInputBufferProvider;    // externally provided buffer provider.
         PassthruBufferProvider*  mReformatBufferProvider; // provider wrapper for reformatting.
         PassthruBufferProvider*  downmixerBufferProvider; // wrapper for channel conversion.
         PassthruBufferProvider*  mPostDownmixReformatBufferProvider;
         PassthruBufferProvider*  mTimestretchBufferProvider;
+        bool                     mDownmixInMixer;         // track hook downmixes to stereo
+        bool                     mReformatInMixer;        // track hook converts to float
 
         int32_t     sessionId;
 
@@ -262,22 +297,78 @@ private:
 
         AudioPlaybackRate    mPlaybackRate;
 
+        ResampleGroup*       mResampleGroup; // non-NULL if resampled as part of a group
+
+        // track_volume_t::serial last applied, for each volume and the aux level
+        uint32_t             mVolumeSerial[MAX_NUM_VOLUMES + 1];
+
         bool        needsRamp() { return (volumeInc[0] | volumeInc[1] | auxInc) != 0; }
         bool        setResampler(uint32_t trackSampleRate, uint32_t devSampleRate);
         bool        doesResample() const { return resampler != NULL; }
         void        resetResampler() { if (resampler != NULL) resampler->reset(); }
         void        adjustVolumeRamp(bool aux, bool useFloat = false);
-        size_t      getUnreleasedFrames() const { return resampler != NULL ?
-                                                    resampler->getUnreleasedFrames() : 0; };
+        size_t      getUnreleasedFrames() const;
+        // channel count of the data read by the resampler
+        uint32_t    resamplerChannelCount() const {
+                        // TODO: Remove MONO_HACK. Resampler sees #channels after the downmixer
+                        // but if none exists, it is the channel count (1 for mono).
+                        return downmixerBufferProvider != NULL || mDownmixInMixer
+                                ? mMixerChannelCount : channelCount;
+                    }
+        // format of the data read by the track hook
+        audio_format_t hookInFormat() const {
+                        return mReformatInMixer ? mFormat : mMixerInFormat;
+                    }
 
         status_t    prepareForDownmix();
         void        unprepareForDownmix();
+        void        prepareForProviderConversion();
         status_t    prepareForReformat();
         void        unprepareForReformat();
         bool        setPlaybackRate(const AudioPlaybackRate &playbackRate);
         void        reconfigureBufferProviders();
     };
 
+    // A volume or aux level as last set by setParameter().
+    // Sets are counted so that process() applies each once, however many it sees at a time.
+    // A ramp set after a VOLUME set starts from the VOLUME set value, even if process()
+    // has not applied it.
+    struct track_volume_t {
+        float       volume;
+        float       rampFrom;   // volume set before the ramp
+        uint32_t    serial;     // number of sets
+        uint32_t    rampSerial; // serial of the set of rampFrom, 0 if none
+        bool        ramp;       // RAMP_VOLUME: ramp to volume
+    };
+
+    // Volumes, aux level and sample rate of a track as last set by setParameter().
+    // Formats, channel masks and buffers are not published this way: changing
+    // them changes the hooks and buffer providers, so they still invalidate the
+    // state and are set under the thread's lock as before.
+    struct track_params_t {
+        track_volume_t  volume[MAX_NUM_VOLUMES + 1];    // the last one is the aux level
+        uint32_t        sampleRate; // 0 unless set while the track has a resampler
+    };
+
+    // Double-buffered track_params_t, written by setParameter() and read by process().
+    // The writer updates the two copies in turn and bumps mSequence before each, so
+    // the reader always takes the copy not being written, selected by the low bit of
+    // mSequence; it only retries if a complete write overtook it.
+    class TrackParams {
+    public:
+                    TrackParams() { atomic_init(&mSequence, (uint_least32_t)0); }
+        void        reset(const track_params_t& params);   // not concurrently with read()
+        // writer side
+        track_params_t& pending() { return mPending; }
+        void        publish();
+        // reader side
+        void        read(track_params_t* params) const;
+    private:
+        track_params_t          mPending;   // writer's copy
+        atomic_uint_least32_t   mSequence;
+        track_params_t          mParams[2];
+    };
+
     typedef void (*process_hook_t)(state_t* state, int64_t pts);
 
     // pad to 32-bytes to fill cache line
@@ -289,7 +380,10 @@ private:
         int32_t         *outputTemp;
         int32_t         *resampleTemp;
         NBLog::Writer*  mLog;
-        int32_t         reserved[1];
+        HelperThreads*  helpers;    // NULL unless parallel mixing is enabled
+        uint32_t        sampleRate; // mixer sample rate
+        bool            groupResampling;
+        ResampleGroup*  resampleGroups[MAX_NUM_TRACKS]; // NULL if unused
         // FIXME allocate dynamically to save some memory when maxNumTracks < MAX_NUM_TRACKS
         track_t         tracks[MAX_NUM_TRACKS] __attribute__((aligned(32)));
     };
@@ -304,6 +398,9 @@ private:
     const uint32_t  mSampleRate;
 
     NBLog::Writer   mDummyLog;
+
+    TrackParams             mTrackParams[MAX_NUM_TRACKS];
+    atomic_uint_least32_t   mTrackParamsChanged; // bitmask of track names with params to apply
 public:
     void            setLog(NBLog::Writer* log);
 private:
@@ -316,9 +413,16 @@ private:
     bool setChannelMasks(int name,
             audio_channel_mask_t trackChannelMask, audio_channel_mask_t mixerChannelMask);
 
+    // publish the pending params of a track to process()
+    void publishTrackParams(int name);
+    // apply the params published for a track, called by process() before mixing
+    void applyTrackParams(int name);
+
     static void track__genericResample(track_t* t, int32_t* out, size_t numFrames, int32_t* temp,
             int32_t* aux);
     static void track__nop(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
+    static void track__ResampleGroup(track_t* t, int32_t* out, size_t numFrames, int32_t* temp,
+            int32_t* aux);
     static void track__16BitsStereo(track_t* t, int32_t* out, size_t numFrames, int32_t* temp,
             int32_t* aux);
     static void track__16BitsMono(track_t* t, int32_t* out, size_t numFrames, int32_t* temp,
@@ -329,12 +433,18 @@ private:
             int32_t* aux);
 
     static void process__validate(state_t* state, int64_t pts);
+    static void groupResamplers(state_t* state);
     static void process__nop(state_t* state, int64_t pts);
     static void process__genericNoResampling(state_t* state, int64_t pts);
     static void process__genericResampling(state_t* state, int64_t pts);
+    static void process__parallel(state_t* state, int64_t pts);
     static void process__OneTrack16BitsStereoNoResampling(state_t* state,
                                                           int64_t pts);
 
+    // mix the tracks in mask, all sharing one main buffer, over the full frame count
+    static void mixTrackGroup(state_t* state, uint32_t mask, int32_t* outTemp,
+                              int32_t* resampleTemp, int64_t pts);
+
     static int64_t calculateOutputPTS(const track_t& t, int64_t basePTS,
                                       int outputFrameIndex);
 
@@ -358,7 +468,7 @@ private:
             const TI *in, TA *aux, bool ramp, AudioMixer::track_t *t);
 
     // multi-format process hooks
-    template <int MIXTYPE, typename TO, typename TI, typename TA>
+    template <int MIXTYPE, bool USEFLOATVOL, typename TO, typename TI, typename TA>
     static void process_NoResampleOneTrack(state_t* state, int64_t pts);
 
     // multi-format track hooks
@@ -368,6 +478,9 @@ private:
     template <int MIXTYPE, typename TO, typename TI, typename TA>
     static void track__NoResample(track_t* t, TO* out, size_t frameCount,
             TO* temp __unused, TA* aux);
+    template <int NCHAN, typename TO, typename TI, typename TA>
+    static void track__NoResampleDownmix(track_t* t, TO* out, size_t frameCount,
+            TO* temp __unused, TA* aux);
 
     static void convertMixerFormat(void *out, audio_format_t mixerOutFormat,
             void *in, audio_format_t mixerInFormat, size_t sampleCount);
@@ -381,13 +494,17 @@ private:
         TRACKTYPE_RESAMPLE,
         TRACKTYPE_NORESAMPLE,
         TRACKTYPE_NORESAMPLEMONO,
+        TRACKTYPE_NORESAMPLEDOWNMIX,
     };
 
     // functions for determining the proper process and track hooks.
+    // trackFormat is the format read by the hook, see track_t::hookInFormat().
     static process_hook_t getProcessHook(int processType, uint32_t channelCount,
-            audio_format_t mixerInFormat, audio_format_t mixerOutFormat);
+            audio_format_t trackFormat, audio_format_t mixerInFormat,
+            audio_format_t mixerOutFormat);
     static hook_t getTrackHook(int trackType, uint32_t channelCount,
-            audio_format_t mixerInFormat, audio_format_t mixerOutFormat);
+            audio_format_t trackFormat, audio_format_t mixerInFormat,
+            audio_format_t mixerOutFormat);
 };
 
 // ----------------------------------------------------------------------------
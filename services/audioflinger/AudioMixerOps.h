@@ -17,6 +17,19 @@
 #ifndef ANDROID_AUDIO_MIXER_OPS_H
 #define ANDROID_AUDIO_MIXER_OPS_H
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_MIXER_SIMD (true)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define USE_MIXER_SIMD (true)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_MIXER_SIMD (true)
+#else
+#define USE_MIXER_SIMD (false)
+#endif
+
 namespace android {
 
 /* Behavior of is_same<>::value is true if the types are identical,
@@ -163,7 +176,6 @@ inline int32_t MixMul<int32_t, int16_t, float>(int16_t value, float volume) {
 
 template <>
 inline int16_t MixMul<int16_t, int16_t, float>(int16_t value, float volume) {
-    LOG_ALWAYS_FATAL("MixMul<int16_t, int16_t, float> Runtime Should not be here");
     return clamp16_from_float(MixMul<float, int16_t, float>(value, volume));
 }
 
@@ -270,6 +282,260 @@ enum {
  *
  */
 
+/*
+ * Vectorized float mixing.
+ *
+ * volumeMultiSimd() and volumeRampMultiSimd() accelerate the aux-free float
+ * paths of volumeMulti() and volumeRampMulti(), which dominate the float mixer.
+ * The input may be float or int16_t (Q.15); int16_t is converted to float as it
+ * is loaded, with the Q.15 scale folded into the volume.
+ * They return false if the MIXTYPE/NCHAN combination is not vectorized, in which
+ * case the caller uses the per-sample loops.
+ *
+ * The input and output are treated as flat sample arrays, so the volume pattern
+ * (one volume per channel) must repeat within a vector.  This covers mono, stereo,
+ * mono to stereo expansion, and any channel count with a single (MONOVOL) volume.
+ *
+ * For constant volume the results are bit-exact with the per-sample loops,
+ * as multiply and add are kept as separate (unfused) operations, and the Q.15
+ * scale is a power of two.
+ * For volume ramps each lane steps by a multiple of the per-frame increment,
+ * so the volumes may differ from the per-sample loops by float rounding.
+ *
+ * The vector width is chosen at compile time: NEON (4 lanes), AVX2 (8 lanes)
+ * when the build targets it, otherwise SSE2 (4 lanes).
+ */
+
+/* generic version, not vectorized */
+template <int MIXTYPE, int NCHAN, typename TO, typename TI, typename TV>
+inline bool volumeMultiSimd(TO* out __unused, size_t frameCount __unused,
+        const TI* in __unused, const TV *vol __unused)
+{
+    return false;
+}
+
+template <int MIXTYPE, int NCHAN, typename TO, typename TI, typename TV>
+inline bool volumeRampMultiSimd(TO* out __unused, size_t frameCount __unused,
+        const TI* in __unused, TV *vol __unused, const TV *volinc __unused)
+{
+    return false;
+}
+
+#if USE_MIXER_SIMD
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+typedef float32x4_t mix_vec_t;
+static const size_t kMixVecLanes = 4;
+
+static inline mix_vec_t mixVecLoad(const float* p) { return vld1q_f32(p); }
+static inline void mixVecStore(float* p, mix_vec_t v) { vst1q_f32(p, v); }
+static inline mix_vec_t mixVecAdd(mix_vec_t a, mix_vec_t b) { return vaddq_f32(a, b); }
+static inline mix_vec_t mixVecMul(mix_vec_t a, mix_vec_t b) { return vmulq_f32(a, b); }
+
+// loads kMixVecLanes / 2 mono samples and duplicates each one.
+static inline mix_vec_t mixVecExpand(const float* p) {
+    float32x2_t x = vld1_f32(p);
+    float32x2x2_t z = vzip_f32(x, x);
+    return vcombine_f32(z.val[0], z.val[1]);
+}
+
+static inline mix_vec_t mixVecLoad(const int16_t* p) {
+    return vcvtq_f32_s32(vmovl_s16(vld1_s16(p)));
+}
+
+static inline mix_vec_t mixVecExpand(const int16_t* p) {
+    float32x2_t x = vcvt_f32_s32(vset_lane_s32(p[1], vdup_n_s32(p[0]), 1));
+    float32x2x2_t z = vzip_f32(x, x);
+    return vcombine_f32(z.val[0], z.val[1]);
+}
+#elif defined(__AVX2__)
+typedef __m256 mix_vec_t;
+static const size_t kMixVecLanes = 8;
+
+static inline mix_vec_t mixVecLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void mixVecStore(float* p, mix_vec_t v) { _mm256_storeu_ps(p, v); }
+static inline mix_vec_t mixVecAdd(mix_vec_t a, mix_vec_t b) { return _mm256_add_ps(a, b); }
+static inline mix_vec_t mixVecMul(mix_vec_t a, mix_vec_t b) { return _mm256_mul_ps(a, b); }
+
+static inline mix_vec_t mixVecExpand(const float* p) {
+    return _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)),
+            _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+}
+
+static inline mix_vec_t mixVecLoad(const int16_t* p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+}
+
+static inline mix_vec_t mixVecExpand(const int16_t* p) {
+    const __m128 x = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+    return _mm256_permutevar8x32_ps(_mm256_castps128_ps256(x),
+            _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+}
+#else // SSE2
+typedef __m128 mix_vec_t;
+static const size_t kMixVecLanes = 4;
+
+static inline mix_vec_t mixVecLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void mixVecStore(float* p, mix_vec_t v) { _mm_storeu_ps(p, v); }
+static inline mix_vec_t mixVecAdd(mix_vec_t a, mix_vec_t b) { return _mm_add_ps(a, b); }
+static inline mix_vec_t mixVecMul(mix_vec_t a, mix_vec_t b) { return _mm_mul_ps(a, b); }
+
+static inline mix_vec_t mixVecExpand(const float* p) {
+    __m128 x = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+    return _mm_unpacklo_ps(x, x);
+}
+
+static inline mix_vec_t mixVecLoad(const int16_t* p) {
+    const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+}
+
+static inline mix_vec_t mixVecExpand(const int16_t* p) {
+    return _mm_cvtepi32_ps(_mm_setr_epi32(p[0], p[0], p[1], p[1]));
+}
+#endif
+
+// scale from the input sample format to float [-1,1]
+static inline float mixVecInputScale(const float*) { return 1.f; }
+static inline float mixVecInputScale(const int16_t*) { return 1.f / (1 << 15); }
+
+template <int MIXTYPE, int NCHAN>
+struct MixSimdTraits {
+    static const bool expand = MIXTYPE == MIXTYPE_MONOEXPAND;
+    static const bool saveOnly = MIXTYPE == MIXTYPE_MULTI_SAVEONLY
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+    static const bool monoVol = NCHAN == 1 || MIXTYPE == MIXTYPE_MULTI_MONOVOL
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+    // volume pattern must repeat within a vector, expansion only to stereo.
+    static const bool supported = expand ? NCHAN == 2 : monoVol || NCHAN == 2;
+    // a ramp changes volume per frame, so frames must not straddle vectors.
+    static const bool rampSupported = !monoVol || NCHAN == 1 ? supported : false;
+};
+
+// the kernels for float or int16_t input, see mixVecInputScale().
+template <int MIXTYPE, int NCHAN, typename TI>
+inline bool volumeMultiVec(float* out, size_t frameCount, const TI* in, const float *vol)
+{
+    typedef MixSimdTraits<MIXTYPE, NCHAN> traits;
+    if (!traits::supported) {
+        return false;
+    }
+    const float scale = mixVecInputScale(in);
+    float pattern[kMixVecLanes];
+    for (size_t i = 0; i < kMixVecLanes; ++i) {
+        pattern[i] = vol[traits::monoVol ? 0 : i % NCHAN] * scale;
+    }
+    const mix_vec_t volume = mixVecLoad(pattern);
+    size_t samples = frameCount * NCHAN; // output samples
+    for (; samples >= kMixVecLanes; samples -= kMixVecLanes) {
+        mix_vec_t x;
+        if (traits::expand) {
+            x = mixVecExpand(in);
+            in += kMixVecLanes / 2;
+        } else {
+            x = mixVecLoad(in);
+            in += kMixVecLanes;
+        }
+        x = mixVecMul(x, volume);
+        if (!traits::saveOnly) {
+            x = mixVecAdd(mixVecLoad(out), x);
+        }
+        mixVecStore(out, x);
+        out += kMixVecLanes;
+    }
+    // tail: out is still aligned to the volume pattern.
+    for (size_t i = 0; i < samples; ++i) {
+        const float y = (traits::expand ? in[i >> 1] : in[i]) * pattern[i];
+        out[i] = traits::saveOnly ? y : out[i] + y;
+    }
+    return true;
+}
+
+template <int MIXTYPE, int NCHAN, typename TI>
+inline bool volumeRampMultiVec(float* out, size_t frameCount, const TI* in,
+        float *vol, const float *volinc)
+{
+    typedef MixSimdTraits<MIXTYPE, NCHAN> traits;
+    if (!traits::rampSupported) {
+        return false;
+    }
+    const float scale = mixVecInputScale(in);
+    const size_t framesPerVec = kMixVecLanes / NCHAN;
+    float pattern[kMixVecLanes];
+    float step[kMixVecLanes];
+    for (size_t i = 0; i < kMixVecLanes; ++i) {
+        const size_t c = i % NCHAN;
+        pattern[i] = (vol[c] + (i / NCHAN) * volinc[c]) * scale;
+        step[i] = framesPerVec * volinc[c] * scale;
+    }
+    mix_vec_t volume = mixVecLoad(pattern);
+    const mix_vec_t volumeInc = mixVecLoad(step);
+    for (; frameCount >= framesPerVec; frameCount -= framesPerVec) {
+        mix_vec_t x;
+        if (traits::expand) {
+            x = mixVecExpand(in);
+            in += kMixVecLanes / 2;
+        } else {
+            x = mixVecLoad(in);
+            in += kMixVecLanes;
+        }
+        x = mixVecMul(x, volume);
+        if (!traits::saveOnly) {
+            x = mixVecAdd(mixVecLoad(out), x);
+        }
+        mixVecStore(out, x);
+        out += kMixVecLanes;
+        volume = mixVecAdd(volume, volumeInc);
+    }
+    // the first frame of the volume vector is the volume for the next frame.
+    mixVecStore(pattern, volume);
+    for (int c = 0; c < NCHAN; ++c) {
+        vol[c] = pattern[c] / scale;
+    }
+    for (; frameCount; --frameCount) {
+        for (int c = 0; c < NCHAN; ++c) {
+            const float y = (traits::expand ? *in : *in++) * vol[c] * scale;
+            *out = traits::saveOnly ? y : *out + y;
+            ++out;
+            vol[c] += volinc[c];
+        }
+        if (traits::expand) {
+            ++in;
+        }
+    }
+    return true;
+}
+
+template <int MIXTYPE, int NCHAN>
+inline bool volumeMultiSimd(float* out, size_t frameCount, const float* in, const float *vol)
+{
+    return volumeMultiVec<MIXTYPE, NCHAN>(out, frameCount, in, vol);
+}
+
+template <int MIXTYPE, int NCHAN>
+inline bool volumeMultiSimd(float* out, size_t frameCount, const int16_t* in, const float *vol)
+{
+    return volumeMultiVec<MIXTYPE, NCHAN>(out, frameCount, in, vol);
+}
+
+template <int MIXTYPE, int NCHAN>
+inline bool volumeRampMultiSimd(float* out, size_t frameCount, const float* in,
+        float *vol, const float *volinc)
+{
+    return volumeRampMultiVec<MIXTYPE, NCHAN>(out, frameCount, in, vol, volinc);
+}
+
+template <int MIXTYPE, int NCHAN>
+inline bool volumeRampMultiSimd(float* out, size_t frameCount, const int16_t* in,
+        float *vol, const float *volinc)
+{
+    return volumeRampMultiVec<MIXTYPE, NCHAN>(out, frameCount, in, vol, volinc);
+}
+
+#endif // USE_MIXER_SIMD
+
 template <int MIXTYPE, int NCHAN,
         typename TO, typename TI, typename TV, typename TA, typename TAV>
 inline void volumeRampMulti(TO* out, size_t frameCount,
@@ -322,6 +588,9 @@ inline void volumeRampMulti(TO* out, size_t frameCount,
             vola[0] += volainc;
         } while (--frameCount);
     } else {
+        if (volumeRampMultiSimd<MIXTYPE, NCHAN>(out, frameCount, in, vol, volinc)) {
+            return;
+        }
         do {
             switch (MIXTYPE) {
             case MIXTYPE_MULTI:
@@ -409,6 +678,9 @@ inline void volumeMulti(TO* out, size_t frameCount,
             *aux++ += MixMul<TA, TA, TAV>(auxaccum, vola);
         } while (--frameCount);
     } else {
+        if (volumeMultiSimd<MIXTYPE, NCHAN>(out, frameCount, in, vol)) {
+            return;
+        }
         do {
             switch (MIXTYPE) {
             case MIXTYPE_MULTI:
@@ -445,6 +717,88 @@ inline void volumeMulti(TO* out, size_t frameCount,
     }
 }
 
+/*
+ * The downmixToStereo() functions fold a quad, 5.1 or 7.1 frame down to stereo
+ * in the same way as the downmix effect does in DOWNMIX_TYPE_FOLD mode:
+ *
+ * left  = (FL + BL + SL + (FC + LFE) * -3dB) / 2
+ * right = (FR + BR + SR + (FC + LFE) * -3dB) / 2
+ *
+ * NCHAN is the input channel count: 4 (FL FR BL BR), 6 (FL FR FC LFE BL BR)
+ * or 8 (FL FR FC LFE BL BR SL SR), which is the canonical order of the
+ * AUDIO_CHANNEL_OUT_QUAD, AUDIO_CHANNEL_OUT_5POINT1 and AUDIO_CHANNEL_OUT_7POINT1
+ * position masks.
+ *
+ * The int16_t version uses the Q19.12 arithmetic and clamping of the effect,
+ * so its output is identical.  The float version also accepts int16_t (Q.15)
+ * input, which it converts to float without clamping the fold.
+ */
+
+template <int NCHAN, typename TI>
+inline void downmixToStereo(float* out, const TI* in, size_t frameCount)
+{
+    static const float kMinus3dB = 0.70710678f;
+    static const float half = is_same<TI, int16_t>::value ? 0.5f / (1 << 15) : 0.5f;
+    for (; frameCount; --frameCount) {
+        float left, right;
+        switch (NCHAN) {
+        case 4:
+            left = in[0] + in[2];
+            right = in[1] + in[3];
+            break;
+        case 6: {
+            const float center = (in[2] + in[3]) * kMinus3dB;
+            left = in[0] + center + in[4];
+            right = in[1] + center + in[5];
+        } break;
+        case 8: {
+            const float center = (in[2] + in[3]) * kMinus3dB;
+            left = in[0] + center + in[4] + in[6];
+            right = in[1] + center + in[5] + in[7];
+        } break;
+        default:
+            LOG_ALWAYS_FATAL("invalid downmix channel count %d", NCHAN);
+            break;
+        }
+        out[0] = left * half;
+        out[1] = right * half;
+        out += 2;
+        in += NCHAN;
+    }
+}
+
+template <int NCHAN>
+inline void downmixToStereo(int16_t* out, const int16_t* in, size_t frameCount)
+{
+    static const int32_t kMinus3dBQ19_12 = 2896; // 0.707 * 2^12
+    for (; frameCount; --frameCount) {
+        int32_t left, right;
+        switch (NCHAN) {
+        case 4:
+            left = (in[0] + in[2]) << 12;
+            right = (in[1] + in[3]) << 12;
+            break;
+        case 6: {
+            const int32_t center = in[2] * kMinus3dBQ19_12 + in[3] * kMinus3dBQ19_12;
+            left = (in[0] << 12) + center + (in[4] << 12);
+            right = (in[1] << 12) + center + (in[5] << 12);
+        } break;
+        case 8: {
+            const int32_t center = in[2] * kMinus3dBQ19_12 + in[3] * kMinus3dBQ19_12;
+            left = (in[0] << 12) + center + (in[6] << 12) + (in[4] << 12);
+            right = (in[1] << 12) + center + (in[7] << 12) + (in[5] << 12);
+        } break;
+        default:
+            LOG_ALWAYS_FATAL("invalid downmix channel count %d", NCHAN);
+            break;
+        }
+        out[0] = clamp16(left >> 13);
+        out[1] = clamp16(right >> 13);
+        out += 2;
+        in += NCHAN;
+    }
+}
+
 };
 
 #endif /* ANDROID_AUDIO_MIXER_OPS_H */
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <dlfcn.h>
 #include <math.h>
+#include <pthread.h>
 
 #include <cutils/compiler.h>
 #include <cutils/properties.h>
@@ -29,9 +30,10 @@
 #include <utils/Log.h>
 #include <audio_utils/primitives.h>
 
-#include "AudioResamplerFirOps.h" // USE_NEON and USE_INLINE_ASSEMBLY defined here
+#include "AudioResamplerFirOps.h" // USE_NEON, USE_SSE and USE_INLINE_ASSEMBLY defined here
 #include "AudioResamplerFirProcess.h"
 #include "AudioResamplerFirProcessNeon.h"
+#include "AudioResamplerFirProcessSSE.h"
 #include "AudioResamplerFirGen.h" // requires math.h
 #include "AudioResamplerDyn.h"
 
@@ -162,6 +164,180 @@ void AudioResamplerDyn<TC, TI, TO>::Constants::set(
     mHalfNumCoefs = halfNumCoefs;
 }
 
+/*
+ * FilterCache shares the polyphase filter banks designed by AudioResamplerDyn.
+ *
+ * A filter bank depends only on the input and output sample rates, the quality
+ * and the coefficient type, so all resamplers doing the same conversion can use
+ * one read-only copy.  Entries are reference counted by the resamplers using them.
+ * Unused entries are kept so that track creation and rate changes find the filter
+ * already designed, until the cache exceeds kMaxEntries or kMaxBytes; then they are
+ * evicted least recently used first.  A filter that does not fit is owned by its
+ * resampler alone and freed on release.
+ */
+class FilterCache {
+public:
+    enum coef_type {
+        COEF_S16,
+        COEF_S32,
+        COEF_FLOAT,
+    };
+
+    struct Key {
+        int32_t inSampleRate;
+        int32_t outSampleRate;
+        AudioResampler::src_quality quality;
+        coef_type coefType;
+
+        bool operator==(const Key& other) const {
+            return inSampleRate == other.inSampleRate
+                    && outSampleRate == other.outSampleRate
+                    && quality == other.quality
+                    && coefType == other.coefType;
+        }
+    };
+
+    // returns a referenced filter matching key, or NULL if it must be designed.
+    static const void* acquire(const Key& key);
+
+    // takes ownership of a newly designed filter of size bytes (allocated with malloc)
+    // and returns the referenced filter to use, which is coefs unless another thread
+    // inserted the same filter first.
+    static const void* insert(const Key& key, void* coefs, size_t size);
+
+    // drops a reference obtained from acquire() or insert().  NULL is ignored.
+    static void release(const void* coefs);
+
+private:
+    static const size_t kMaxEntries = 16;
+    static const size_t kMaxBytes = 256 * 1024;
+
+    struct Entry {
+        Key key;
+        void* coefs;            // NULL if the entry is free
+        size_t size;
+        uint32_t refCount;
+        uint32_t lastUse;       // for LRU eviction of unused entries
+    };
+
+    static bool evictLocked();
+
+    static pthread_mutex_t sLock;
+    static Entry sEntries[kMaxEntries];
+    static size_t sBytes;       // total size of the cached filters
+    static uint32_t sUseCount;
+};
+
+pthread_mutex_t FilterCache::sLock = PTHREAD_MUTEX_INITIALIZER;
+FilterCache::Entry FilterCache::sEntries[FilterCache::kMaxEntries];
+size_t FilterCache::sBytes = 0;
+uint32_t FilterCache::sUseCount = 0;
+
+const void* FilterCache::acquire(const Key& key)
+{
+    const void* coefs = NULL;
+    pthread_mutex_lock(&sLock);
+    for (size_t i = 0; i < kMaxEntries; ++i) {
+        Entry& e = sEntries[i];
+        if (e.coefs != NULL && e.key == key) {
+            ++e.refCount;
+            e.lastUse = ++sUseCount;
+            coefs = e.coefs;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+    return coefs;
+}
+
+const void* FilterCache::insert(const Key& key, void* coefs, size_t size)
+{
+    pthread_mutex_lock(&sLock);
+    Entry* slot = NULL;
+    for (size_t i = 0; i < kMaxEntries; ++i) {
+        Entry& e = sEntries[i];
+        if (e.coefs == NULL) {
+            if (slot == NULL) {
+                slot = &e;
+            }
+        } else if (e.key == key) {
+            // designed concurrently by another resampler; share the cached copy.
+            ++e.refCount;
+            e.lastUse = ++sUseCount;
+            pthread_mutex_unlock(&sLock);
+            free(coefs);
+            return e.coefs;
+        }
+    }
+    while ((slot == NULL || sBytes + size > kMaxBytes) && evictLocked()) {
+        if (slot == NULL) {
+            for (size_t i = 0; i < kMaxEntries; ++i) {
+                if (sEntries[i].coefs == NULL) {
+                    slot = &sEntries[i];
+                    break;
+                }
+            }
+        }
+    }
+    if (slot != NULL && sBytes + size <= kMaxBytes) {
+        slot->key = key;
+        slot->coefs = coefs;
+        slot->size = size;
+        slot->refCount = 1;
+        slot->lastUse = ++sUseCount;
+        sBytes += size;
+        ALOGV("cached filter %d->%d quality %d type %d: %zu bytes, %zu total",
+                key.inSampleRate, key.outSampleRate, key.quality, key.coefType, size, sBytes);
+    } else {
+        ALOGV("filter %d->%d quality %d type %d not cached: %zu bytes, %zu in use",
+                key.inSampleRate, key.outSampleRate, key.quality, key.coefType, size, sBytes);
+    }
+    pthread_mutex_unlock(&sLock);
+    return coefs;
+}
+
+void FilterCache::release(const void* coefs)
+{
+    if (coefs == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&sLock);
+    for (size_t i = 0; i < kMaxEntries; ++i) {
+        Entry& e = sEntries[i];
+        if (e.coefs == coefs) {
+            LOG_ALWAYS_FATAL_IF(e.refCount == 0, "filter cache entry %zu released twice", i);
+            --e.refCount; // kept for reuse until evicted
+            pthread_mutex_unlock(&sLock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+    free(const_cast<void*>(coefs)); // not cached, owned by the caller
+}
+
+// frees the least recently used unreferenced entry; returns false if there is none.
+bool FilterCache::evictLocked()
+{
+    Entry* victim = NULL;
+    for (size_t i = 0; i < kMaxEntries; ++i) {
+        Entry& e = sEntries[i];
+        if (e.coefs != NULL && e.refCount == 0
+                && (victim == NULL || (int32_t)(e.lastUse - victim->lastUse) < 0)) {
+            victim = &e;
+        }
+    }
+    if (victim == NULL) {
+        return false;
+    }
+    ALOGV("evicting filter %d->%d quality %d type %d",
+            victim->key.inSampleRate, victim->key.outSampleRate,
+            victim->key.quality, victim->key.coefType);
+    free(victim->coefs);
+    victim->coefs = NULL;
+    sBytes -= victim->size;
+    return true;
+}
+
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
         int inChannelCount, int32_t sampleRate, src_quality quality)
@@ -180,7 +356,7 @@ AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::~AudioResamplerDyn()
 {
-    free(mCoefBuffer);
+    FilterCache::release(mCoefBuffer);
 }
 
 template<typename TC, typename TI, typename TO>
@@ -227,10 +403,6 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
     // create and set filter
     firKaiserGen(buf, c.mL, c.mHalfNumCoefs, stopBandAtten, fcr, atten);
     c.mFirCoefs = buf;
-    if (mCoefBuffer) {
-        free(mCoefBuffer);
-    }
-    mCoefBuffer = buf;
 #ifdef DEBUG_RESAMPLER
     // print basic filter stats
     printf("L:%d  hnc:%d  stopBandAtten:%lf  fcr:%lf  atten:%lf  tbw:%lf\n",
@@ -379,10 +551,23 @@ void AudioResamplerDyn<TC, TI, TO>::setSampleRate(int32_t inSampleRate)
             phases = 127;
         }
 
-        // create the filter
+        // create the filter, or share it if another resampler already designed it.
         mConstants.set(phases, halfLength, inSampleRate, mSampleRate);
-        createKaiserFir(mConstants, stopBandAtten,
-                inSampleRate, mSampleRate, tbwCheat);
+        const FilterCache::Key key = {
+            inSampleRate, mSampleRate, mFilterQuality,
+            is_same<TC, float>::value ? FilterCache::COEF_FLOAT :
+                    is_same<TC, int32_t>::value ? FilterCache::COEF_S32 : FilterCache::COEF_S16,
+        };
+        const void* coefs = FilterCache::acquire(key);
+        if (coefs == NULL) {
+            createKaiserFir(mConstants, stopBandAtten,
+                    inSampleRate, mSampleRate, tbwCheat);
+            coefs = FilterCache::insert(key, const_cast<TC*>(mConstants.mFirCoefs),
+                    (mConstants.mL + 1) * mConstants.mHalfNumCoefs * sizeof(TC));
+        }
+        FilterCache::release(mCoefBuffer);
+        mCoefBuffer = coefs;
+        mConstants.mFirCoefs = static_cast<const TC*>(coefs);
     } // End Kaiser filter
 
     // update phase and state based on the new filter.
@@ -413,7 +598,7 @@ void AudioResamplerDyn<TC, TI, TO>::setSampleRate(int32_t inSampleRate)
     LOG_ALWAYS_FATAL_IF(stride < 16, "Resampler stride must be 16 or more");
     LOG_ALWAYS_FATAL_IF(mChannelCount < 1 || mChannelCount > 8,
             "Resampler channels(%d) must be between 1 to 8", mChannelCount);
-    // stride 16 (falls back to stride 2 for machines that do not support NEON)
+    // stride 16 (falls back to stride 2 for machines that do not support NEON or SSE4.1)
     if (locked) {
         switch (mChannelCount) {
         case 1:
@@ -32,6 +32,15 @@ namespace android {
 #define USE_NEON (false)
 #endif
 
+// x86 kernels are compiled with per-function target attributes and
+// selected at runtime, so they do not depend on the global -m flags.
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__GNUC__) || defined(__clang__))
+#define USE_SSE (true)
+#include <immintrin.h>
+#else
+#define USE_SSE (false)
+#endif
+
 template<typename T, typename U>
 struct is_same
 {
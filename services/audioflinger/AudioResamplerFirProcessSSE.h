@@ -0,0 +1,952 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_SSE_H
+#define ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_SSE_H
+
+namespace android {
+
+// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h
+
+#if USE_SSE
+
+//
+// x86 SSE4.1 and AVX2 specializations for Process() and ProcessL() in
+// AudioResamplerFirProcess.h, mirroring the NEON variants in
+// AudioResamplerFirProcessNeon.h.
+//
+// The kernels are compiled with function target attributes so that a single
+// binary runs on any x86 CPU. The kernel is picked at runtime from the CPU
+// features; a CPU without SSE4.1 falls back to ProcessBase().
+//
+// As with NEON, only the stride 16 mono and stereo cases are accelerated,
+// so count must be a multiple of 8.
+//
+
+#define SSE41_TARGET __attribute__((target("sse4.1")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+enum {
+    RESAMPLER_SIMD_NONE  = 0,
+    RESAMPLER_SIMD_SSE41 = 1,
+    RESAMPLER_SIMD_AVX2  = 2,
+};
+
+static inline int detectResamplerSimdLevel()
+{
+    // required if called before constructors have run.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return RESAMPLER_SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return RESAMPLER_SIMD_SSE41;
+    }
+    return RESAMPLER_SIMD_NONE;
+}
+
+// evaluated once at load time; read on every output frame.
+static const int gResamplerSimdLevel = detectResamplerSimdLevel();
+
+// Helpers for the final accumulate, which is done once per output frame.
+// These match the NEON vqrdmulh_s32 and vqadd_s32 behavior.
+
+static inline int32_t qrdmulhS32(int32_t a, int32_t b)
+{
+    if (a == INT32_MIN && b == INT32_MIN) {
+        return INT32_MAX;
+    }
+    return static_cast<int32_t>(
+            (static_cast<int64_t>(a) * b + (static_cast<int64_t>(1) << 30)) >> 31);
+}
+
+static inline int32_t qaddS32(int32_t a, int32_t b)
+{
+    int64_t sum = static_cast<int64_t>(a) + b;
+    return sum > INT32_MAX ? INT32_MAX : sum < INT32_MIN ? INT32_MIN : static_cast<int32_t>(sum);
+}
+
+template <int CHANNELS>
+static inline void accumulateResult(int32_t* out, int32_t l, int32_t r,
+        const int32_t* volumeLR)
+{
+    if (CHANNELS == 1) {
+        r = l;
+    }
+    out[0] = qaddS32(out[0], qrdmulhS32(l, volumeLR[0]));
+    out[1] = qaddS32(out[1], qrdmulhS32(r, volumeLR[1]));
+}
+
+template <int CHANNELS>
+static inline void accumulateResult(float* out, float l, float r, const float* volumeLR)
+{
+    if (CHANNELS == 1) {
+        r = l;
+    }
+    out[0] += l * volumeLR[0];
+    out[1] += r * volumeLR[1];
+}
+
+// ----------------------------------------------------------------------------
+// SSE4.1 building blocks (also used by the AVX2 kernels for 128 bit lanes).
+
+// horizontal sum of 4 int32
+static inline SSE41_TARGET int32_t hsumEpi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+// horizontal sum of 2 int64
+static inline SSE41_TARGET int64_t hsumEpi64(__m128i v)
+{
+    v = _mm_add_epi64(v, _mm_unpackhi_epi64(v, v));
+#if defined(__x86_64__)
+    return _mm_cvtsi128_si64(v);
+#else
+    int64_t result;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(&result), v);
+    return result;
+#endif
+}
+
+// horizontal sum of 4 float
+static inline SSE41_TARGET float hsumPs(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+// (a * b) >> 31 per int32 lane, for Q31 coefficient interpolation.
+// The result must fit in 32 bits, which holds for lerp in [0, 1).
+static inline SSE41_TARGET __m128i mulQ31Epi32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_srli_epi64(_mm_mul_epi32(a, b), 31);
+    __m128i odd = _mm_srli_epi64(
+            _mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)), 31);
+    return _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+}
+
+// reverse 8 mono int16 frames.
+static inline SSE41_TARGET __m128i reverseMonoEpi16(__m128i v)
+{
+    const __m128i kReverse = _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9,
+            6, 7, 4, 5, 2, 3, 0, 1);
+    return _mm_shuffle_epi8(v, kReverse);
+}
+
+// deinterleave 8 stereo int16 frames into L and R.
+static inline SSE41_TARGET void deinterleaveStereoEpi16(const int16_t* s,
+        __m128i& left, __m128i& right)
+{
+    const __m128i kDeinterleave = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13,
+            2, 3, 6, 7, 10, 11, 14, 15);
+    __m128i a = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), kDeinterleave);
+    __m128i b = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 8)), kDeinterleave);
+    left = _mm_unpacklo_epi64(a, b);
+    right = _mm_unpackhi_epi64(a, b);
+}
+
+// deinterleave 8 stereo int16 frames into L and R, in reverse frame order.
+static inline SSE41_TARGET void deinterleaveReverseStereoEpi16(const int16_t* s,
+        __m128i& left, __m128i& right)
+{
+    const __m128i kDeinterleaveReverse = _mm_setr_epi8(12, 13, 8, 9, 4, 5, 0, 1,
+            14, 15, 10, 11, 6, 7, 2, 3);
+    __m128i a = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), kDeinterleaveReverse);
+    __m128i b = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 8)), kDeinterleaveReverse);
+    left = _mm_unpacklo_epi64(b, a);
+    right = _mm_unpackhi_epi64(b, a);
+}
+
+// int16 x int32 dot product of 4 lanes into 2 int64 partial sums.
+static inline SSE41_TARGET __m128i macEpi16Epi32(__m128i accum, __m128i samp16,
+        __m128i coef32)
+{
+    __m128i samp = _mm_cvtepi16_epi32(samp16);
+    accum = _mm_add_epi64(accum, _mm_mul_epi32(samp, coef32));
+    return _mm_add_epi64(accum, _mm_mul_epi32(
+            _mm_srli_epi64(samp, 32), _mm_srli_epi64(coef32, 32)));
+}
+
+// load 8 mono float frames in reverse order (s points to the oldest frame).
+static inline SSE41_TARGET void loadReverseMonoPs(const float* s, __m128& lo, __m128& hi)
+{
+    // lo holds frames 7..4 and hi holds frames 3..0.
+    lo = _mm_shuffle_ps(_mm_loadu_ps(s + 4), _mm_loadu_ps(s + 4), _MM_SHUFFLE(0, 1, 2, 3));
+    hi = _mm_shuffle_ps(_mm_loadu_ps(s), _mm_loadu_ps(s), _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// ----------------------------------------------------------------------------
+// SSE4.1 kernels
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static SSE41_TARGET void ProcessSSEIntrinsic(int32_t* out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* volumeLR,
+        uint32_t lerpP,
+        const int16_t* coefsP1,
+        const int16_t* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS == 1 || CHANNELS == 2);
+
+    sP -= CHANNELS*((STRIDE>>1)-1);
+
+    __m128i interp;
+    if (!FIXED) {
+        interp = _mm_set1_epi16(static_cast<int16_t>(lerpP));
+    }
+    __m128i accum = _mm_setzero_si128();
+    __m128i accum2 = _mm_setzero_si128();
+    do {
+        __m128i posCoef = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsP));
+        coefsP += 8;
+        __m128i negCoef = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsN));
+        coefsN += 8;
+        if (!FIXED) { // interpolate
+            __m128i posCoef1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsP1));
+            coefsP1 += 8;
+            __m128i negCoef1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsN1));
+            coefsN1 += 8;
+
+            posCoef1 = _mm_sub_epi16(posCoef1, posCoef);
+            negCoef = _mm_sub_epi16(negCoef, negCoef1);
+
+            posCoef1 = _mm_mulhrs_epi16(posCoef1, interp);
+            negCoef = _mm_mulhrs_epi16(negCoef, interp);
+
+            posCoef = _mm_add_epi16(posCoef, posCoef1);
+            negCoef = _mm_add_epi16(negCoef, negCoef1);
+        }
+        switch (CHANNELS) {
+        case 1: {
+            __m128i posSamp = reverseMonoEpi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(sP)));
+            __m128i negSamp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sN));
+            sN += 8;
+            sP -= 8;
+
+            // dot product
+            accum = _mm_add_epi32(accum, _mm_madd_epi16(posSamp, posCoef));
+            accum = _mm_add_epi32(accum, _mm_madd_epi16(negSamp, negCoef));
+        } break;
+        case 2: {
+            __m128i posL, posR, negL, negR;
+            deinterleaveReverseStereoEpi16(sP, posL, posR);
+            deinterleaveStereoEpi16(sN, negL, negR);
+            sN += 16;
+            sP -= 16;
+
+            // dot product
+            accum = _mm_add_epi32(accum, _mm_madd_epi16(posL, posCoef));
+            accum = _mm_add_epi32(accum, _mm_madd_epi16(negL, negCoef));
+            accum2 = _mm_add_epi32(accum2, _mm_madd_epi16(posR, posCoef));
+            accum2 = _mm_add_epi32(accum2, _mm_madd_epi16(negR, negCoef));
+        } break;
+        }
+    } while (count -= 8);
+
+    accumulateResult<CHANNELS>(out, hsumEpi32(accum), hsumEpi32(accum2), volumeLR);
+}
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static SSE41_TARGET void ProcessSSEIntrinsic(int32_t* out,
+        int count,
+        const int32_t* coefsP,
+        const int32_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* volumeLR,
+        uint32_t lerpP,
+        const int32_t* coefsP1,
+        const int32_t* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS == 1 || CHANNELS == 2);
+
+    sP -= CHANNELS*((STRIDE>>1)-1);
+
+    __m128i interp;
+    if (!FIXED) {
+        interp = _mm_set1_epi32(static_cast<int32_t>(lerpP));
+    }
+    // 64 bit accumulators; the products are Q15 * Q31, rescaled at the end.
+    __m128i accum = _mm_setzero_si128();
+    __m128i accum2 = _mm_setzero_si128();
+    do {
+        __m128i posCoef0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsP));
+        __m128i posCoef1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsP + 4));
+        coefsP += 8;
+        __m128i negCoef0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsN));
+        __m128i negCoef1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsN + 4));
+        coefsN += 8;
+        if (!FIXED) { // interpolate
+            __m128i posNext0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsP1));
+            __m128i posNext1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsP1 + 4));
+            coefsP1 += 8;
+            __m128i negNext0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsN1));
+            __m128i negNext1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsN1 + 4));
+            coefsN1 += 8;
+
+            posCoef0 = _mm_add_epi32(posCoef0,
+                    mulQ31Epi32(_mm_sub_epi32(posNext0, posCoef0), interp));
+            posCoef1 = _mm_add_epi32(posCoef1,
+                    mulQ31Epi32(_mm_sub_epi32(posNext1, posCoef1), interp));
+            negCoef0 = _mm_add_epi32(negNext0,
+                    mulQ31Epi32(_mm_sub_epi32(negCoef0, negNext0), interp));
+            negCoef1 = _mm_add_epi32(negNext1,
+                    mulQ31Epi32(_mm_sub_epi32(negCoef1, negNext1), interp));
+        }
+        switch (CHANNELS) {
+        case 1: {
+            __m128i posSamp = reverseMonoEpi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(sP)));
+            __m128i negSamp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sN));
+            sN += 8;
+            sP -= 8;
+
+            // dot product
+            accum = macEpi16Epi32(accum, posSamp, posCoef0);
+            accum = macEpi16Epi32(accum, _mm_unpackhi_epi64(posSamp, posSamp), posCoef1);
+            accum = macEpi16Epi32(accum, negSamp, negCoef0);
+            accum = macEpi16Epi32(accum, _mm_unpackhi_epi64(negSamp, negSamp), negCoef1);
+        } break;
+        case 2: {
+            __m128i posL, posR, negL, negR;
+            deinterleaveReverseStereoEpi16(sP, posL, posR);
+            deinterleaveStereoEpi16(sN, negL, negR);
+            sN += 16;
+            sP -= 16;
+
+            // left
+            accum = macEpi16Epi32(accum, posL, posCoef0);
+            accum = macEpi16Epi32(accum, _mm_unpackhi_epi64(posL, posL), posCoef1);
+            accum = macEpi16Epi32(accum, negL, negCoef0);
+            accum = macEpi16Epi32(accum, _mm_unpackhi_epi64(negL, negL), negCoef1);
+
+            // right
+            accum2 = macEpi16Epi32(accum2, posR, posCoef0);
+            accum2 = macEpi16Epi32(accum2, _mm_unpackhi_epi64(posR, posR), posCoef1);
+            accum2 = macEpi16Epi32(accum2, negR, negCoef0);
+            accum2 = macEpi16Epi32(accum2, _mm_unpackhi_epi64(negR, negR), negCoef1);
+        } break;
+        }
+    } while (count -= 8);
+
+    // round back to the Q15 * Q31 >> 16 alignment of the NEON and scalar paths
+    const int64_t round = 1 << 15;
+    accumulateResult<CHANNELS>(out,
+            static_cast<int32_t>((hsumEpi64(accum) + round) >> 16),
+            static_cast<int32_t>((hsumEpi64(accum2) + round) >> 16),
+            volumeLR);
+}
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static SSE41_TARGET void ProcessSSEIntrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS == 1 || CHANNELS == 2);
+
+    sP -= CHANNELS*((STRIDE>>1)-1);
+
+    __m128 interp;
+    if (!FIXED) {
+        interp = _mm_set1_ps(lerpP);
+    }
+    __m128 accum = _mm_setzero_ps();
+    __m128 accum2 = _mm_setzero_ps();
+    do {
+        __m128 posCoef0 = _mm_loadu_ps(coefsP);
+        __m128 posCoef1 = _mm_loadu_ps(coefsP + 4);
+        coefsP += 8;
+        __m128 negCoef0 = _mm_loadu_ps(coefsN);
+        __m128 negCoef1 = _mm_loadu_ps(coefsN + 4);
+        coefsN += 8;
+        if (!FIXED) { // interpolate
+            __m128 posNext0 = _mm_loadu_ps(coefsP1);
+            __m128 posNext1 = _mm_loadu_ps(coefsP1 + 4);
+            coefsP1 += 8;
+            __m128 negNext0 = _mm_loadu_ps(coefsN1);
+            __m128 negNext1 = _mm_loadu_ps(coefsN1 + 4);
+            coefsN1 += 8;
+
+            posCoef0 = _mm_add_ps(posCoef0,
+                    _mm_mul_ps(_mm_sub_ps(posNext0, posCoef0), interp));
+            posCoef1 = _mm_add_ps(posCoef1,
+                    _mm_mul_ps(_mm_sub_ps(posNext1, posCoef1), interp));
+            negCoef0 = _mm_add_ps(negNext0,
+                    _mm_mul_ps(_mm_sub_ps(negCoef0, negNext0), interp)); // rev
+            negCoef1 = _mm_add_ps(negNext1,
+                    _mm_mul_ps(_mm_sub_ps(negCoef1, negNext1), interp)); // rev
+        }
+        switch (CHANNELS) {
+        case 1: {
+            __m128 posSamp0, posSamp1;
+            loadReverseMonoPs(sP, posSamp0, posSamp1);
+            __m128 negSamp0 = _mm_loadu_ps(sN);
+            __m128 negSamp1 = _mm_loadu_ps(sN + 4);
+            sN += 8;
+            sP -= 8;
+
+            accum = _mm_add_ps(accum, _mm_mul_ps(posSamp0, posCoef0));
+            accum = _mm_add_ps(accum, _mm_mul_ps(posSamp1, posCoef1));
+            accum = _mm_add_ps(accum, _mm_mul_ps(negSamp0, negCoef0));
+            accum = _mm_add_ps(accum, _mm_mul_ps(negSamp1, negCoef1));
+        } break;
+        case 2: {
+            // each register holds 2 stereo frames.
+            __m128 p0 = _mm_loadu_ps(sP);
+            __m128 p1 = _mm_loadu_ps(sP + 4);
+            __m128 p2 = _mm_loadu_ps(sP + 8);
+            __m128 p3 = _mm_loadu_ps(sP + 12);
+            __m128 n0 = _mm_loadu_ps(sN);
+            __m128 n1 = _mm_loadu_ps(sN + 4);
+            __m128 n2 = _mm_loadu_ps(sN + 8);
+            __m128 n3 = _mm_loadu_ps(sN + 12);
+            sN += 16;
+            sP -= 16;
+
+            // deinterleave, reversing the frame order of the positive side.
+            __m128 posL0 = _mm_shuffle_ps(p3, p2, _MM_SHUFFLE(0, 2, 0, 2));
+            __m128 posL1 = _mm_shuffle_ps(p1, p0, _MM_SHUFFLE(0, 2, 0, 2));
+            __m128 posR0 = _mm_shuffle_ps(p3, p2, _MM_SHUFFLE(1, 3, 1, 3));
+            __m128 posR1 = _mm_shuffle_ps(p1, p0, _MM_SHUFFLE(1, 3, 1, 3));
+            __m128 negL0 = _mm_shuffle_ps(n0, n1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 negL1 = _mm_shuffle_ps(n2, n3, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 negR0 = _mm_shuffle_ps(n0, n1, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 negR1 = _mm_shuffle_ps(n2, n3, _MM_SHUFFLE(3, 1, 3, 1));
+
+            accum = _mm_add_ps(accum, _mm_mul_ps(negL0, negCoef0));
+            accum = _mm_add_ps(accum, _mm_mul_ps(negL1, negCoef1));
+            accum2 = _mm_add_ps(accum2, _mm_mul_ps(negR0, negCoef0));
+            accum2 = _mm_add_ps(accum2, _mm_mul_ps(negR1, negCoef1));
+
+            accum = _mm_add_ps(accum, _mm_mul_ps(posL0, posCoef0)); // reversed
+            accum = _mm_add_ps(accum, _mm_mul_ps(posL1, posCoef1)); // reversed
+            accum2 = _mm_add_ps(accum2, _mm_mul_ps(posR0, posCoef0)); // reversed
+            accum2 = _mm_add_ps(accum2, _mm_mul_ps(posR1, posCoef1)); // reversed
+        } break;
+        }
+    } while (count -= 8);
+
+    accumulateResult<CHANNELS>(out, hsumPs(accum), hsumPs(accum2), volumeLR);
+}
+
+// ----------------------------------------------------------------------------
+// AVX2 kernels
+//
+// The positive and negative halves are processed together in the two 128 bit
+// lanes of each 256 bit register, which halves the multiply-accumulate count.
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static AVX2_TARGET void ProcessAVX2Intrinsic(int32_t* out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* volumeLR,
+        uint32_t lerpP,
+        const int16_t* coefsP1,
+        const int16_t* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS == 1 || CHANNELS == 2);
+
+    sP -= CHANNELS*((STRIDE>>1)-1);
+
+    __m256i interp;
+    if (!FIXED) {
+        interp = _mm256_set1_epi16(static_cast<int16_t>(lerpP));
+    }
+    __m256i accum = _mm256_setzero_si256();
+    __m256i accum2 = _mm256_setzero_si256();
+    do {
+        // low lane is the positive half, high lane is the negative half.
+        __m256i coef = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsP))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsN)), 1);
+        coefsP += 8;
+        coefsN += 8;
+        if (!FIXED) { // interpolate
+            __m256i coef1 = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsP1))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefsN1)), 1);
+            coefsP1 += 8;
+            coefsN1 += 8;
+
+            // positive: coef + (coef1 - coef) * lerp
+            // negative: coef1 + (coef - coef1) * lerp
+            __m256i base = _mm256_blend_epi32(coef, coef1, 0xF0);
+            __m256i next = _mm256_blend_epi32(coef1, coef, 0xF0);
+            coef = _mm256_add_epi16(base,
+                    _mm256_mulhrs_epi16(_mm256_sub_epi16(next, base), interp));
+        }
+        switch (CHANNELS) {
+        case 1: {
+            __m256i samp = _mm256_inserti128_si256(_mm256_castsi128_si256(reverseMonoEpi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(sP)))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(sN)), 1);
+            sN += 8;
+            sP -= 8;
+
+            accum = _mm256_add_epi32(accum, _mm256_madd_epi16(samp, coef));
+        } break;
+        case 2: {
+            __m128i posL, posR, negL, negR;
+            deinterleaveReverseStereoEpi16(sP, posL, posR);
+            deinterleaveStereoEpi16(sN, negL, negR);
+            sN += 16;
+            sP -= 16;
+
+            __m256i left = _mm256_inserti128_si256(_mm256_castsi128_si256(posL), negL, 1);
+            __m256i right = _mm256_inserti128_si256(_mm256_castsi128_si256(posR), negR, 1);
+            accum = _mm256_add_epi32(accum, _mm256_madd_epi16(left, coef));
+            accum2 = _mm256_add_epi32(accum2, _mm256_madd_epi16(right, coef));
+        } break;
+        }
+    } while (count -= 8);
+
+    accumulateResult<CHANNELS>(out,
+            hsumEpi32(_mm_add_epi32(_mm256_castsi256_si128(accum),
+                    _mm256_extracti128_si256(accum, 1))),
+            hsumEpi32(_mm_add_epi32(_mm256_castsi256_si128(accum2),
+                    _mm256_extracti128_si256(accum2, 1))),
+            volumeLR);
+}
+
+// int16 x int32 dot product of 8 lanes into 4 int64 partial sums.
+static inline AVX2_TARGET __m256i macEpi16Epi32x8(__m256i accum, __m128i samp16,
+        __m256i coef32)
+{
+    __m256i samp = _mm256_cvtepi16_epi32(samp16);
+    accum = _mm256_add_epi64(accum, _mm256_mul_epi32(samp, coef32));
+    return _mm256_add_epi64(accum, _mm256_mul_epi32(
+            _mm256_srli_epi64(samp, 32), _mm256_srli_epi64(coef32, 32)));
+}
+
+// (a * b) >> 31 per int32 lane, see mulQ31Epi32().
+static inline AVX2_TARGET __m256i mulQ31Epi32x8(__m256i a, __m256i b)
+{
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epi32(a, b), 31);
+    __m256i odd = _mm256_srli_epi64(
+            _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32)), 31);
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static AVX2_TARGET void ProcessAVX2Intrinsic(int32_t* out,
+        int count,
+        const int32_t* coefsP,
+        const int32_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* volumeLR,
+        uint32_t lerpP,
+        const int32_t* coefsP1,
+        const int32_t* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS == 1 || CHANNELS == 2);
+
+    sP -= CHANNELS*((STRIDE>>1)-1);
+
+    __m256i interp;
+    if (!FIXED) {
+        interp = _mm256_set1_epi32(static_cast<int32_t>(lerpP));
+    }
+    __m256i accum = _mm256_setzero_si256();
+    __m256i accum2 = _mm256_setzero_si256();
+    do {
+        __m256i posCoef = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(coefsP));
+        coefsP += 8;
+        __m256i negCoef = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(coefsN));
+        coefsN += 8;
+        if (!FIXED) { // interpolate
+            __m256i posCoef1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(coefsP1));
+            coefsP1 += 8;
+            __m256i negCoef1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(coefsN1));
+            coefsN1 += 8;
+
+            posCoef = _mm256_add_epi32(posCoef,
+                    mulQ31Epi32x8(_mm256_sub_epi32(posCoef1, posCoef), interp));
+            negCoef = _mm256_add_epi32(negCoef1,
+                    mulQ31Epi32x8(_mm256_sub_epi32(negCoef, negCoef1), interp));
+        }
+        switch (CHANNELS) {
+        case 1: {
+            __m128i posSamp = reverseMonoEpi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(sP)));
+            __m128i negSamp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sN));
+            sN += 8;
+            sP -= 8;
+
+            accum = macEpi16Epi32x8(accum, posSamp, posCoef);
+            accum = macEpi16Epi32x8(accum, negSamp, negCoef);
+        } break;
+        case 2: {
+            __m128i posL, posR, negL, negR;
+            deinterleaveReverseStereoEpi16(sP, posL, posR);
+            deinterleaveStereoEpi16(sN, negL, negR);
+            sN += 16;
+            sP -= 16;
+
+            accum = macEpi16Epi32x8(accum, posL, posCoef);
+            accum = macEpi16Epi32x8(accum, negL, negCoef);
+            accum2 = macEpi16Epi32x8(accum2, posR, posCoef);
+            accum2 = macEpi16Epi32x8(accum2, negR, negCoef);
+        } break;
+        }
+    } while (count -= 8);
+
+    const int64_t round = 1 << 15;
+    accumulateResult<CHANNELS>(out,
+            static_cast<int32_t>((hsumEpi64(_mm_add_epi64(_mm256_castsi256_si128(accum),
+                    _mm256_extracti128_si256(accum, 1))) + round) >> 16),
+            static_cast<int32_t>((hsumEpi64(_mm_add_epi64(_mm256_castsi256_si128(accum2),
+                    _mm256_extracti128_si256(accum2, 1))) + round) >> 16),
+            volumeLR);
+}
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static AVX2_TARGET void ProcessAVX2Intrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS == 1 || CHANNELS == 2);
+
+    sP -= CHANNELS*((STRIDE>>1)-1);
+
+    // frame order after a lane-local even/odd shuffle of 8 stereo frames is
+    // 0 1 4 5 2 3 6 7; these permutes restore (or reverse) the frame order.
+    const __m256i kOrder = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    const __m256i kReverseOrder = _mm256_setr_epi32(7, 6, 3, 2, 5, 4, 1, 0);
+    const __m256i kReverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    __m256 interp;
+    if (!FIXED) {
+        interp = _mm256_set1_ps(lerpP);
+    }
+    __m256 accum = _mm256_setzero_ps();
+    __m256 accum2 = _mm256_setzero_ps();
+    do {
+        __m256 posCoef = _mm256_loadu_ps(coefsP);
+        coefsP += 8;
+        __m256 negCoef = _mm256_loadu_ps(coefsN);
+        coefsN += 8;
+        if (!FIXED) { // interpolate
+            __m256 posCoef1 = _mm256_loadu_ps(coefsP1);
+            coefsP1 += 8;
+            __m256 negCoef1 = _mm256_loadu_ps(coefsN1);
+            coefsN1 += 8;
+
+            posCoef = _mm256_add_ps(posCoef,
+                    _mm256_mul_ps(_mm256_sub_ps(posCoef1, posCoef), interp));
+            negCoef = _mm256_add_ps(negCoef1,
+                    _mm256_mul_ps(_mm256_sub_ps(negCoef, negCoef1), interp)); // rev
+        }
+        switch (CHANNELS) {
+        case 1: {
+            __m256 posSamp = _mm256_permutevar8x32_ps(_mm256_loadu_ps(sP), kReverse);
+            __m256 negSamp = _mm256_loadu_ps(sN);
+            sN += 8;
+            sP -= 8;
+
+            accum = _mm256_add_ps(accum, _mm256_mul_ps(posSamp, posCoef));
+            accum = _mm256_add_ps(accum, _mm256_mul_ps(negSamp, negCoef));
+        } break;
+        case 2: {
+            __m256 p0 = _mm256_loadu_ps(sP);
+            __m256 p1 = _mm256_loadu_ps(sP + 8);
+            __m256 n0 = _mm256_loadu_ps(sN);
+            __m256 n1 = _mm256_loadu_ps(sN + 8);
+            sN += 16;
+            sP -= 16;
+
+            __m256 posL = _mm256_permutevar8x32_ps(
+                    _mm256_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0)), kReverseOrder);
+            __m256 posR = _mm256_permutevar8x32_ps(
+                    _mm256_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1)), kReverseOrder);
+            __m256 negL = _mm256_permutevar8x32_ps(
+                    _mm256_shuffle_ps(n0, n1, _MM_SHUFFLE(2, 0, 2, 0)), kOrder);
+            __m256 negR = _mm256_permutevar8x32_ps(
+                    _mm256_shuffle_ps(n0, n1, _MM_SHUFFLE(3, 1, 3, 1)), kOrder);
+
+            accum = _mm256_add_ps(accum, _mm256_mul_ps(negL, negCoef));
+            accum2 = _mm256_add_ps(accum2, _mm256_mul_ps(negR, negCoef));
+            accum = _mm256_add_ps(accum, _mm256_mul_ps(posL, posCoef)); // reversed
+            accum2 = _mm256_add_ps(accum2, _mm256_mul_ps(posR, posCoef)); // reversed
+        } break;
+        }
+    } while (count -= 8);
+
+    accumulateResult<CHANNELS>(out,
+            hsumPs(_mm_add_ps(_mm256_castps256_ps128(accum), _mm256_extractf128_ps(accum, 1))),
+            hsumPs(_mm_add_ps(_mm256_castps256_ps128(accum2),
+                    _mm256_extractf128_ps(accum2, 1))),
+            volumeLR);
+}
+
+// ----------------------------------------------------------------------------
+// Runtime dispatch.  The level check is a predictable branch per output frame,
+// small against the 16 to 96 tap dot product.
+
+template <int CHANNELS, bool FIXED, typename TC, typename TI, typename TO, typename TINTERP>
+static inline void ProcessSSEDispatch(TO* const out,
+        int count,
+        const TC* coefsP,
+        const TC* coefsN,
+        const TC* coefsP1,
+        const TC* coefsN1,
+        const TI* sP,
+        const TI* sN,
+        TINTERP lerpP,
+        const TO* const volumeLR)
+{
+    switch (gResamplerSimdLevel) {
+    case RESAMPLER_SIMD_AVX2:
+        ProcessAVX2Intrinsic<CHANNELS, 16, FIXED>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+        break;
+    case RESAMPLER_SIMD_SSE41:
+        ProcessSSEIntrinsic<CHANNELS, 16, FIXED>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+        break;
+    default:
+        if (FIXED) {
+            ProcessBase<CHANNELS, 16, InterpNull>(out, count, coefsP, coefsN, sP, sN, lerpP,
+                    volumeLR);
+        } else {
+            ProcessBase<CHANNELS, 16, InterpCompute>(out, count, coefsP, coefsN, sP, sN, lerpP,
+                    volumeLR);
+        }
+        break;
+    }
+}
+
+template <>
+inline void ProcessL<1, 16>(int32_t* const out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* const volumeLR)
+{
+    ProcessSSEDispatch<1, true>(out, count, coefsP, coefsN,
+            (const int16_t*)NULL /*coefsP1*/, (const int16_t*)NULL /*coefsN1*/,
+            sP, sN, 0U /*lerpP*/, volumeLR);
+}
+
+template <>
+inline void ProcessL<2, 16>(int32_t* const out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* const volumeLR)
+{
+    ProcessSSEDispatch<2, true>(out, count, coefsP, coefsN,
+            (const int16_t*)NULL /*coefsP1*/, (const int16_t*)NULL /*coefsN1*/,
+            sP, sN, 0U /*lerpP*/, volumeLR);
+}
+
+template <>
+inline void Process<1, 16>(int32_t* const out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* coefsP1,
+        const int16_t* coefsN1,
+        const int16_t* sP,
+        const int16_t* sN,
+        uint32_t lerpP,
+        const int32_t* const volumeLR)
+{
+    ProcessSSEDispatch<1, false>(out, count, coefsP, coefsN, coefsP1, coefsN1,
+            sP, sN, lerpP, volumeLR);
+}
+
+template <>
+inline void Process<2, 16>(int32_t* const out,
+        int count,
+        const int16_t* coefsP,
+        const int16_t* coefsN,
+        const int16_t* coefsP1,
+        const int16_t* coefsN1,
+        const int16_t* sP,
+        const int16_t* sN,
+        uint32_t lerpP,
+        const int32_t* const volumeLR)
+{
+    ProcessSSEDispatch<2, false>(out, count, coefsP, coefsN, coefsP1, coefsN1,
+            sP, sN, lerpP, volumeLR);
+}
+
+template <>
+inline void ProcessL<1, 16>(int32_t* const out,
+        int count,
+        const int32_t* coefsP,
+        const int32_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* const volumeLR)
+{
+    ProcessSSEDispatch<1, true>(out, count, coefsP, coefsN,
+            (const int32_t*)NULL /*coefsP1*/, (const int32_t*)NULL /*coefsN1*/,
+            sP, sN, 0U /*lerpP*/, volumeLR);
+}
+
+template <>
+inline void ProcessL<2, 16>(int32_t* const out,
+        int count,
+        const int32_t* coefsP,
+        const int32_t* coefsN,
+        const int16_t* sP,
+        const int16_t* sN,
+        const int32_t* const volumeLR)
+{
+    ProcessSSEDispatch<2, true>(out, count, coefsP, coefsN,
+            (const int32_t*)NULL /*coefsP1*/, (const int32_t*)NULL /*coefsN1*/,
+            sP, sN, 0U /*lerpP*/, volumeLR);
+}
+
+template <>
+inline void Process<1, 16>(int32_t* const out,
+        int count,
+        const int32_t* coefsP,
+        const int32_t* coefsN,
+        const int32_t* coefsP1,
+        const int32_t* coefsN1,
+        const int16_t* sP,
+        const int16_t* sN,
+        uint32_t lerpP,
+        const int32_t* const volumeLR)
+{
+    ProcessSSEDispatch<1, false>(out, count, coefsP, coefsN, coefsP1, coefsN1,
+            sP, sN, lerpP, volumeLR);
+}
+
+template <>
+inline void Process<2, 16>(int32_t* const out,
+        int count,
+        const int32_t* coefsP,
+        const int32_t* coefsN,
+        const int32_t* coefsP1,
+        const int32_t* coefsN1,
+        const int16_t* sP,
+        const int16_t* sN,
+        uint32_t lerpP,
+        const int32_t* const volumeLR)
+{
+    ProcessSSEDispatch<2, false>(out, count, coefsP, coefsN, coefsP1, coefsN1,
+            sP, sN, lerpP, volumeLR);
+}
+
+template<>
+inline void ProcessL<1, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* const volumeLR)
+{
+    ProcessSSEDispatch<1, true>(out, count, coefsP, coefsN,
+            (const float*)NULL /*coefsP1*/, (const float*)NULL /*coefsN1*/,
+            sP, sN, 0.f /*lerpP*/, volumeLR);
+}
+
+template<>
+inline void ProcessL<2, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* const volumeLR)
+{
+    ProcessSSEDispatch<2, true>(out, count, coefsP, coefsN,
+            (const float*)NULL /*coefsP1*/, (const float*)NULL /*coefsN1*/,
+            sP, sN, 0.f /*lerpP*/, volumeLR);
+}
+
+template<>
+inline void Process<1, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* coefsP1,
+        const float* coefsN1,
+        const float* sP,
+        const float* sN,
+        float lerpP,
+        const float* const volumeLR)
+{
+    ProcessSSEDispatch<1, false>(out, count, coefsP, coefsN, coefsP1, coefsN1,
+            sP, sN, lerpP, volumeLR);
+}
+
+template<>
+inline void Process<2, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* coefsP1,
+        const float* coefsN1,
+        const float* sP,
+        const float* sN,
+        float lerpP,
+        const float* const volumeLR)
+{
+    ProcessSSEDispatch<2, false>(out, count, coefsP, coefsN, coefsP1, coefsN1,
+            sP, sN, lerpP, volumeLR);
+}
+
+#endif //USE_SSE
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_SSE_H*/
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioTimestretcher"
+//#define LOG_NDEBUG 0
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <utils/Log.h>
+
+#include "AudioTimestretcher.h"
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// Segment and seek window lengths at speeds of 0.5 and below, and of 2 and above.
+// In between they are interpolated linearly with the speed.
+static const float kSequenceMsSlow = 125.f;
+static const float kSequenceMsFast = 50.f;
+static const float kSeekMsSlow = 25.f;
+static const float kSeekMsFast = 15.f;
+static const float kSpeedSlow = 0.5f;
+static const float kSpeedFast = 2.f;
+static const float kOverlapMs = 8.f;
+
+// The seek window is first searched every kCoarseStep frames, then frame by frame
+// around the best coarse offset.
+static const size_t kCoarseStep = 8;
+
+template <typename T>
+static inline T max(const T& a, const T& b)
+{
+    return a > b ? a : b;
+}
+
+template <typename T>
+static inline T min(const T& a, const T& b)
+{
+    return a < b ? a : b;
+}
+
+static inline size_t framesForMs(float ms, uint32_t sampleRate)
+{
+    return (size_t)(ms * sampleRate / 1000.f + 0.5f);
+}
+
+/* Returns the cross-correlation of a and b over n samples in *corr,
+ * and the energy of b in *energy.
+ */
+static inline void correlate(const float* a, const float* b, size_t n,
+        float* corr, float* energy)
+{
+    float c = 0.f;
+    float e = 0.f;
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+    float32x4_t vc = vdupq_n_f32(0.f);
+    float32x4_t ve = vdupq_n_f32(0.f);
+    for (; n >= 4; n -= 4) {
+        const float32x4_t x = vld1q_f32(a);
+        const float32x4_t y = vld1q_f32(b);
+        vc = vmlaq_f32(vc, x, y);
+        ve = vmlaq_f32(ve, y, y);
+        a += 4;
+        b += 4;
+    }
+    float lanes[4];
+    vst1q_f32(lanes, vc);
+    c = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    vst1q_f32(lanes, ve);
+    e = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__AVX2__)
+    __m256 vc = _mm256_setzero_ps();
+    __m256 ve = _mm256_setzero_ps();
+    for (; n >= 8; n -= 8) {
+        const __m256 x = _mm256_loadu_ps(a);
+        const __m256 y = _mm256_loadu_ps(b);
+        vc = _mm256_add_ps(vc, _mm256_mul_ps(x, y));
+        ve = _mm256_add_ps(ve, _mm256_mul_ps(y, y));
+        a += 8;
+        b += 8;
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, vc);
+    c = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]))
+            + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    _mm256_storeu_ps(lanes, ve);
+    e = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]))
+            + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+#elif defined(__SSE2__)
+    __m128 vc = _mm_setzero_ps();
+    __m128 ve = _mm_setzero_ps();
+    for (; n >= 4; n -= 4) {
+        const __m128 x = _mm_loadu_ps(a);
+        const __m128 y = _mm_loadu_ps(b);
+        vc = _mm_add_ps(vc, _mm_mul_ps(x, y));
+        ve = _mm_add_ps(ve, _mm_mul_ps(y, y));
+        a += 4;
+        b += 4;
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vc);
+    c = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm_storeu_ps(lanes, ve);
+    e = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; n; --n) {
+        c += *a * *b;
+        e += *b * *b;
+        ++a;
+        ++b;
+    }
+    *corr = c;
+    *energy = e;
+}
+
+// ----------------------------------------------------------------------------
+
+AudioTimestretcher::AudioTimestretcher(uint32_t channelCount, uint32_t sampleRate) :
+        mChannelCount(channelCount),
+        mSampleRate(sampleRate),
+        mSpeed(1.f),
+        mSequenceFrames(0),
+        mSeekFrames(0),
+        mOverlapFrames(max(framesForMs(kOverlapMs, sampleRate), (size_t)1)),
+        mRequiredFrames(0),
+        mNominalSkip(0.),
+        mSkipFraction(0.),
+        mPrimed(false)
+{
+    ALOGV("AudioTimestretcher(%p)(%u, %u)", this, channelCount, sampleRate);
+    mInput.data = NULL;
+    mInput.start = 0;
+    mInput.frames = 0;
+    mInput.capacity = 0;
+    mOutput = mInput;
+    mOverlap = (float*)calloc(mOverlapFrames * mChannelCount, sizeof(float));
+    mFadeIn = (float*)malloc(mOverlapFrames * sizeof(float));
+    LOG_ALWAYS_FATAL_IF(mOverlap == NULL || mFadeIn == NULL,
+            "AudioTimestretcher can't allocate overlap");
+    // raised cosine: the fade in and fade out gains sum to one.
+    for (size_t i = 0; i < mOverlapFrames; ++i) {
+        mFadeIn[i] = 0.5f - 0.5f * cosf(M_PI * (i + 0.5f) / mOverlapFrames);
+    }
+    configure();
+    // queue room for the longest segments, so that setSpeed() seldom reallocates.
+    const size_t frames = framesForMs(kSequenceMsSlow + kSeekMsSlow, sampleRate);
+    reserve(&mInput, frames);
+    reserve(&mOutput, frames);
+}
+
+AudioTimestretcher::~AudioTimestretcher()
+{
+    ALOGV("~AudioTimestretcher(%p)", this);
+    free(mInput.data);
+    free(mOutput.data);
+    free(mOverlap);
+    free(mFadeIn);
+}
+
+void AudioTimestretcher::setSpeed(float speed)
+{
+    ALOG_ASSERT(speed > 0.f, "invalid speed %f", speed);
+    if (speed != mSpeed) {
+        mSpeed = speed;
+        configure();
+    }
+}
+
+void AudioTimestretcher::configure()
+{
+    const float t = (min(max(mSpeed, kSpeedSlow), kSpeedFast) - kSpeedSlow)
+            / (kSpeedFast - kSpeedSlow);
+    const float sequenceMs = kSequenceMsSlow + t * (kSequenceMsFast - kSequenceMsSlow);
+    const float seekMs = kSeekMsSlow + t * (kSeekMsFast - kSeekMsSlow);
+    mSequenceFrames = max(framesForMs(sequenceMs, mSampleRate), 2 * mOverlapFrames);
+    mSeekFrames = max(framesForMs(seekMs, mSampleRate), (size_t)1);
+    mNominalSkip = (double)mSpeed * (mSequenceFrames - mOverlapFrames);
+    // a segment reads up to mSeekFrames + mSequenceFrames frames, but at high speed
+    // the input advance may be longer than that.
+    mRequiredFrames = max(mSeekFrames + mSequenceFrames, (size_t)ceil(mNominalSkip));
+    ALOGV("configure speed:%f sequence:%zu seek:%zu overlap:%zu skip:%f",
+            mSpeed, mSequenceFrames, mSeekFrames, mOverlapFrames, mNominalSkip);
+}
+
+bool AudioTimestretcher::reserve(Queue* queue, size_t frames)
+{
+    if (queue->start + frames <= queue->capacity) {
+        return true;
+    }
+    // consume() only advances start, the queued frames move here at most once per append.
+    if (queue->frames != 0 && queue->start != 0) {
+        memmove(queue->data, front(*queue), queue->frames * mChannelCount * sizeof(float));
+    }
+    queue->start = 0;
+    if (frames <= queue->capacity) {
+        return true;
+    }
+    // grow geometrically, as the queues settle at a size set by the caller's block size.
+    const size_t capacity = max(frames, queue->capacity + queue->capacity / 2);
+    float* data = (float*)realloc(queue->data, capacity * mChannelCount * sizeof(float));
+    if (data == NULL) {
+        return false;
+    }
+    queue->data = data;
+    queue->capacity = capacity;
+    return true;
+}
+
+void AudioTimestretcher::consume(Queue* queue, size_t frames)
+{
+    ALOG_ASSERT(frames <= queue->frames, "consume %zu of %zu frames", frames, queue->frames);
+    queue->frames -= frames;
+    queue->start = queue->frames != 0 ? queue->start + frames : 0;
+}
+
+bool AudioTimestretcher::write(const float* in, size_t frameCount)
+{
+    if (!reserve(&mInput, mInput.frames + frameCount)) {
+        ALOGE("write cannot grow input queue to %zu frames", mInput.frames + frameCount);
+        return false;
+    }
+    memcpy(back(mInput), in,
+            frameCount * mChannelCount * sizeof(float));
+    mInput.frames += frameCount;
+    process();
+    return true;
+}
+
+size_t AudioTimestretcher::read(float* out, size_t frameCount)
+{
+    frameCount = min(frameCount, mOutput.frames);
+    memcpy(out, front(mOutput), frameCount * mChannelCount * sizeof(float));
+    consume(&mOutput, frameCount);
+    return frameCount;
+}
+
+void AudioTimestretcher::reset()
+{
+    mInput.start = 0;
+    mInput.frames = 0;
+    mOutput.start = 0;
+    mOutput.frames = 0;
+    mSkipFraction = 0.;
+    mPrimed = false;
+}
+
+// Returns the normalized similarity of the segment starting at in to mOverlap.
+// The sign of the correlation is kept, so an inverted waveform is a poor match.
+float AudioTimestretcher::similarity(const float* in) const
+{
+    float corr, energy;
+    correlate(mOverlap, in, mOverlapFrames * mChannelCount, &corr, &energy);
+    return corr * fabsf(corr) / (energy + 1e-9f);
+}
+
+size_t AudioTimestretcher::seekBestOffset(const float* in) const
+{
+    size_t best = 0;
+    float bestSimilarity = -INFINITY;
+    for (size_t offset = 0; offset < mSeekFrames; offset += kCoarseStep) {
+        const float s = similarity(in + offset * mChannelCount);
+        if (s > bestSimilarity) {
+            bestSimilarity = s;
+            best = offset;
+        }
+    }
+    const size_t coarse = best;
+    const size_t first = coarse > kCoarseStep - 1 ? coarse - (kCoarseStep - 1) : 0;
+    const size_t last = min(coarse + kCoarseStep, mSeekFrames);
+    for (size_t offset = first; offset < last; ++offset) {
+        if (offset == coarse) {
+            continue;
+        }
+        const float s = similarity(in + offset * mChannelCount);
+        if (s > bestSimilarity) {
+            bestSimilarity = s;
+            best = offset;
+        }
+    }
+    return best;
+}
+
+// Moves the input to the output.  After stretched segments, the input first
+// skips to the offset of the seek window that best matches the natural
+// continuation of the last segment, and crossfades with it.
+void AudioTimestretcher::passthrough()
+{
+    const size_t channels = mChannelCount;
+    if (mPrimed) {
+        if (mInput.frames < mSeekFrames + mOverlapFrames) {
+            return;
+        }
+        if (!reserve(&mOutput, mOutput.frames + mOverlapFrames)) {
+            ALOGE("passthrough cannot grow output queue to %zu frames",
+                    mOutput.frames + mOverlapFrames);
+            return;
+        }
+        consume(&mInput, seekBestOffset(front(mInput)));
+        const float* in = front(mInput);
+        float* out = back(mOutput);
+        for (size_t i = 0; i < mOverlapFrames; ++i) {
+            const float fadeIn = mFadeIn[i];
+            const float fadeOut = 1.f - fadeIn;
+            for (size_t c = 0; c < channels; ++c) {
+                const size_t k = i * channels + c;
+                out[k] = mOverlap[k] * fadeOut + in[k] * fadeIn;
+            }
+        }
+        mOutput.frames += mOverlapFrames;
+        consume(&mInput, mOverlapFrames);
+        mSkipFraction = 0.;
+        mPrimed = false;
+    }
+    if (mInput.frames == 0) {
+        return;
+    }
+    if (!reserve(&mOutput, mOutput.frames + mInput.frames)) {
+        ALOGE("passthrough cannot grow output queue to %zu frames",
+                mOutput.frames + mInput.frames);
+        return;
+    }
+    memcpy(back(mOutput), front(mInput), mInput.frames * channels * sizeof(float));
+    mOutput.frames += mInput.frames;
+    consume(&mInput, mInput.frames);
+}
+
+void AudioTimestretcher::process()
+{
+    if (mSpeed == 1.f) {
+        passthrough();
+        return;
+    }
+    const size_t channels = mChannelCount;
+    const size_t overlapSamples = mOverlapFrames * channels;
+    const size_t outputFrames = mSequenceFrames - mOverlapFrames;
+    while (mInput.frames >= mRequiredFrames) {
+        if (!reserve(&mOutput, mOutput.frames + outputFrames)) {
+            ALOGE("process cannot grow output queue to %zu frames",
+                    mOutput.frames + outputFrames);
+            break;
+        }
+        const float* in = front(mInput);
+        size_t offset = 0;
+        if (mPrimed) {
+            offset = seekBestOffset(in);
+        } else {
+            // the first segment crossfades with itself.
+            memcpy(mOverlap, in, overlapSamples * sizeof(float));
+            mPrimed = true;
+        }
+        in += offset * channels;
+        float* out = back(mOutput);
+
+        // crossfade from the natural continuation of the previous segment.
+        for (size_t i = 0; i < mOverlapFrames; ++i) {
+            const float fadeIn = mFadeIn[i];
+            const float fadeOut = 1.f - fadeIn;
+            for (size_t c = 0; c < channels; ++c) {
+                const size_t k = i * channels + c;
+                out[k] = mOverlap[k] * fadeOut + in[k] * fadeIn;
+            }
+        }
+        memcpy(out + overlapSamples, in + overlapSamples,
+                (mSequenceFrames - 2 * mOverlapFrames) * channels * sizeof(float));
+        memcpy(mOverlap, in + outputFrames * channels, overlapSamples * sizeof(float));
+        mOutput.frames += outputFrames;
+
+        mSkipFraction += mNominalSkip;
+        const size_t skip = (size_t)mSkipFraction;
+        mSkipFraction -= skip;
+        consume(&mInput, skip);
+    }
+}
+
+// ----------------------------------------------------------------------------
+} // namespace android
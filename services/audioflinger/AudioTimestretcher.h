@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_TIMESTRETCHER_H
+#define ANDROID_AUDIO_TIMESTRETCHER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+/* AudioTimestretcher
+ *
+ * Changes the speed of interleaved float audio without changing its pitch, using
+ * WSOLA (waveform similarity overlap-add).
+ *
+ * The output is a sequence of segments taken from the input.  Each segment starts
+ * at the input position advanced by speed times the output segment length, moved
+ * within a seek window to the offset whose waveform best matches the natural
+ * continuation of the previous segment.  Consecutive segments are crossfaded over
+ * an overlap.  The match is the normalized cross-correlation over all channels,
+ * computed with SIMD where available.
+ *
+ * Segment and seek window lengths follow the speed: longer for slow playback,
+ * shorter for fast playback, where short segments keep speech intelligible.
+ *
+ * The input is consumed whole by write(); stretched output is produced once enough
+ * input is queued for a segment and its seek window, and is fetched by read().
+ * At speed 1.0 the input passes through unchanged, after a crossfade from the
+ * last stretched segment; once that output is read, isPassthrough() is true and
+ * the caller may copy its frames directly instead.
+ * Not thread safe.
+ */
+class AudioTimestretcher {
+public:
+    AudioTimestretcher(uint32_t channelCount, uint32_t sampleRate);
+    ~AudioTimestretcher();
+
+    // speed > 0, 1.0 is normal speed.
+    void    setSpeed(float speed);
+    float   getSpeed() const { return mSpeed; }
+
+    // Queues frameCount input frames and stretches all complete segments.
+    // Returns false if the input queue could not grow, in which case the input is dropped.
+    bool    write(const float* in, size_t frameCount);
+
+    // Reads up to frameCount stretched frames, returns the number of frames read.
+    size_t  read(float* out, size_t frameCount);
+
+    // Discards queued input and output, the next segment starts afresh.
+    void    reset();
+
+    size_t  inputFramesQueued() const { return mInput.frames; }
+    size_t  outputFramesAvailable() const { return mOutput.frames; }
+
+    // True at speed 1.0 once no frame is queued: the output is then the input.
+    bool    isPassthrough() const {
+        return mSpeed == 1.f && !mPrimed && mInput.frames == 0 && mOutput.frames == 0;
+    }
+
+private:
+    // interleaved frames, consumed from the front by advancing start.
+    struct Queue {
+        float*  data;
+        size_t  start;    // first queued frame
+        size_t  frames;
+        size_t  capacity; // in frames
+    };
+
+    float*  front(const Queue& queue) const { return queue.data + queue.start * mChannelCount; }
+    float*  back(const Queue& queue) const {
+        return queue.data + (queue.start + queue.frames) * mChannelCount;
+    }
+    // makes room to append up to frames - queue->frames frames, compacting the queue first.
+    bool    reserve(Queue* queue, size_t frames);
+    void    consume(Queue* queue, size_t frames);
+    void    configure();
+    void    process();
+    void    passthrough();
+    size_t  seekBestOffset(const float* in) const;
+    float   similarity(const float* in) const;
+
+    const uint32_t  mChannelCount;
+    const uint32_t  mSampleRate;
+    float           mSpeed;
+
+    size_t          mSequenceFrames;   // segment length, including the overlap
+    size_t          mSeekFrames;       // offsets searched for each segment
+    const size_t    mOverlapFrames;    // crossfade length
+    size_t          mRequiredFrames;   // input needed to produce a segment
+    double          mNominalSkip;      // input frames advanced per segment
+    double          mSkipFraction;     // fractional input frames not yet advanced
+
+    Queue           mInput;
+    Queue           mOutput;
+    float*          mOverlap;          // natural continuation of the previous segment
+    float*          mFadeIn;           // crossfade gain of the new segment, per frame
+    bool            mPrimed;           // mOverlap holds a previous segment
+};
+
+// ----------------------------------------------------------------------------
+} // namespace android
+
+#endif // ANDROID_AUDIO_TIMESTRETCHER_H
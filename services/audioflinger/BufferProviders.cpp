@@ -245,6 +245,10 @@ void DownmixerBufferProvider::copyFrames(void *dst, const void *src, size_t fram
     ALOGE_IF(res != OK, "DownmixBufferProvider error %d", res);
 }
 
+// AOSP insert downmix UUID: 93f04452-e4fe-41cc-91f9-e475b6d1d69f
+static const effect_uuid_t kDefaultDownmixUuid =
+        {0x93f04452, 0xe4fe, 0x41cc, 0x91f9, {0xe4, 0x75, 0xb6, 0xd1, 0xd6, 0x9f}};
+
 /* call once in a pthread_once handler. */
 /*static*/ status_t DownmixerBufferProvider::init()
 {
@@ -264,6 +268,8 @@ void DownmixerBufferProvider::copyFrames(void *dst, const void *src, size_t fram
                 ALOGI("found effect \"%s\" from %s",
                         sDwnmFxDesc.name, sDwnmFxDesc.implementor);
                 sIsMultichannelCapable = true;
+                sIsDefaultDownmixer = memcmp(&sDwnmFxDesc.uuid, &kDefaultDownmixUuid,
+                        sizeof(effect_uuid_t)) == 0;
                 break;
             }
         }
@@ -273,6 +279,7 @@ void DownmixerBufferProvider::copyFrames(void *dst, const void *src, size_t fram
 }
 
 /*static*/ bool DownmixerBufferProvider::sIsMultichannelCapable = false;
+/*static*/ bool DownmixerBufferProvider::sIsDefaultDownmixer = false;
 /*static*/ effect_descriptor_t DownmixerBufferProvider::sDwnmFxDesc;
 
 RemixBufferProvider::RemixBufferProvider(audio_channel_mask_t inputChannelMask,
@@ -332,6 +339,8 @@ TimestretchBufferProvider::TimestretchBufferProvider(int32_t channelCount,
         mLocalBufferData(NULL),
         mRemaining(0),
         mSonicStream(sonicCreateStream(sampleRate, mChannelCount)),
+        mTimestretcher(format == AUDIO_FORMAT_PCM_FLOAT
+                ? new AudioTimestretcher(channelCount, sampleRate) : NULL),
         mFallbackFailErrorShown(false),
         mAudioPlaybackRateValid(false)
 {
@@ -349,6 +358,7 @@ TimestretchBufferProvider::~TimestretchBufferProvider()
 {
     ALOGV("~TimestretchBufferProvider(%p)", this);
     sonicDestroyStream(mSonicStream);
+    delete mTimestretcher;
     if (mBuffer.frameCount != 0) {
         mTrackBufferProvider->releaseBuffer(&mBuffer);
     }
@@ -455,6 +465,9 @@ void TimestretchBufferProvider::releaseBuffer(AudioBufferProvider::Buffer *pBuff
 void TimestretchBufferProvider::reset()
 {
     mRemaining = 0;
+    if (mTimestretcher != NULL) {
+        mTimestretcher->reset();
+    }
 }
 
 status_t TimestretchBufferProvider::setPlaybackRate(const AudioPlaybackRate &playbackRate)
@@ -462,10 +475,12 @@ status_t TimestretchBufferProvider::setPlaybackRate(const AudioPlaybackRate &pla
     mPlaybackRate = playbackRate;
     mFallbackFailErrorShown = false;
     sonicSetSpeed(mSonicStream, mPlaybackRate.mSpeed);
+    mAudioPlaybackRateValid = isAudioPlaybackRateValid(mPlaybackRate);
+    if (mTimestretcher != NULL && mAudioPlaybackRateValid) {
+        mTimestretcher->setSpeed(mPlaybackRate.mSpeed);
+    }
     //TODO: pitch is ignored for now
     //TODO: optimize: if parameters are the same, don't do any extra computation.
-
-    mAudioPlaybackRateValid = isAudioPlaybackRateValid(mPlaybackRate);
     return OK;
 }
 
@@ -519,11 +534,17 @@ void TimestretchBufferProvider::processFrames(void *dstBuffer, size_t *dstFrames
     } else {
         switch (mFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
-            if (sonicWriteFloatToStream(mSonicStream, (float*)srcBuffer, *srcFrames) != 1) {
-                ALOGE("sonicWriteFloatToStream cannot realloc");
+            if (mTimestretcher->isPassthrough()) {
+                // normal speed, and the stretched frames have all been read.
+                *dstFrames = min(*dstFrames, *srcFrames);
+                *srcFrames = *dstFrames;
+                memcpy(dstBuffer, srcBuffer, *dstFrames * mFrameSize);
+                break;
+            }
+            if (!mTimestretcher->write((const float*)srcBuffer, *srcFrames)) {
                 *srcFrames = 0; // cannot consume all of srcBuffer
             }
-            *dstFrames = sonicReadFloatFromStream(mSonicStream, (float*)dstBuffer, *dstFrames);
+            *dstFrames = mTimestretcher->read((float*)dstBuffer, *dstFrames);
             break;
         case AUDIO_FORMAT_PCM_16_BIT:
             if (sonicWriteShortToStream(mSonicStream, (short*)srcBuffer, *srcFrames) != 1) {
@@ -25,6 +25,8 @@
 #include <system/audio.h>
 #include <sonic.h>
 
+#include "AudioTimestretcher.h"
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -100,6 +102,9 @@ public:
     bool isValid() const { return mDownmixHandle != NULL; }
     static status_t init();
     static bool isMultichannelCapable() { return sIsMultichannelCapable; }
+    // true if the downmix effect found is the AOSP one, whose fold the mixer
+    // track hooks reproduce
+    static bool isDefaultDownmixer() { return sIsDefaultDownmixer; }
 
 protected:
     effect_handle_t    mDownmixHandle;
@@ -109,6 +114,8 @@ protected:
     static effect_descriptor_t sDwnmFxDesc;
     // indicates whether a downmix effect has been found and is usable by this mixer
     static bool                sIsMultichannelCapable;
+    // indicates whether that downmix effect is the AOSP one
+    static bool                sIsDefaultDownmixer;
     // FIXME: should we allow effects outside of the framework?
     // We need to here. A special ioId that must be <= -2 so it does not map to a session.
     static const int32_t SESSION_ID_INVALID_AND_IGNORED = -2;
@@ -147,7 +154,8 @@ protected:
     const audio_format_t mOutputFormat;
 };
 
-// TimestretchBufferProvider derives from PassthruBufferProvider for time stretching
+// TimestretchBufferProvider derives from PassthruBufferProvider for time stretching.
+// Float data is stretched by AudioTimestretcher, PCM 16 bit data by Sonic.
 class TimestretchBufferProvider : public PassthruBufferProvider {
 public:
     TimestretchBufferProvider(int32_t channelCount,
@@ -187,6 +195,7 @@ private:
     size_t               mRemaining;              // remaining data in local buffer
     sonicStream          mSonicStream;            // handle to sonic timestretch object
     //FIXME: this dependency should be abstracted out
+    AudioTimestretcher  *mTimestretcher;          // float timestretch, NULL if PCM 16 bit
     bool                 mFallbackFailErrorShown; // log fallback error only once
     bool                 mAudioPlaybackRateValid; // flag for current parameters validity
 };
@@ -20,6 +20,7 @@
 //#define LOG_NDEBUG 0
 
 #include "Configuration.h"
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <audio_effects/effect_visualizer.h>
 #include <audio_utils/primitives.h>
@@ -29,6 +30,12 @@
 #include "AudioFlinger.h"
 #include "ServiceUtilities.h"
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // ----------------------------------------------------------------------------
 
 // Note: the following macro is used for extremely verbose logging message.  In
@@ -48,6 +55,32 @@
 
 namespace android {
 
+// ----------------------------------------------------------------------------
+
+// Accumulates count samples of in onto out, with saturation
+static void accumulate_i16(int16_t *out, const int16_t *in, size_t count)
+{
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+    for (; count >= 8; count -= 8) {
+        vst1q_s16(out, vqaddq_s16(vld1q_s16(out), vld1q_s16(in)));
+        out += 8;
+        in += 8;
+    }
+#elif defined(__SSE2__)
+    for (; count >= 8; count -= 8) {
+        const __m128i sum = _mm_adds_epi16(_mm_loadu_si128((const __m128i *) out),
+                _mm_loadu_si128((const __m128i *) in));
+        _mm_storeu_si128((__m128i *) out, sum);
+        out += 8;
+        in += 8;
+    }
+#endif
+    for (; count > 0; count--) {
+        *out = clamp16((int32_t) *out + (int32_t) *in++);
+        out++;
+    }
+}
+
 // ----------------------------------------------------------------------------
 //  EffectModule implementation
 // ----------------------------------------------------------------------------
@@ -69,9 +102,14 @@ AudioFlinger::EffectModule::EffectModule(ThreadBase *thread,
       // mMaxDisableWaitCnt is set by configure() and not used before then
       // mDisableWaitCnt is set by process() and updateState() and not used before then
       mSuspended(false),
-      mAudioFlinger(thread->mAudioFlinger)
+      mAudioFlinger(thread->mAudioFlinger),
+      mBudgetBypass(property_get_bool("af.effect.budget_bypass", false)),
+      mBypassed(false), mBypassCount(0), mCpuBudgetNs(0),
+      mOverBudgetCalls(0), mWindowCalls(0), mWindowOverBudgetCalls(0), mWindowTotalNs(0),
+      mWindowMaxNs(0), mLastWindowMeanNs(0), mLastWindowMaxNs(0)
 {
     ALOGV("Constructor %p", this);
+    mProcessNs.reset();
     int lStatus;
 
     // create effect engine from effect factory
@@ -268,7 +306,12 @@ void AudioFlinger::EffectModule::process()
         return;
     }
 
-    if (isProcessEnabled()) {
+    if (mBypassed && mState == STOPPED) {
+        // a bypassed effect has no tail to render when disabled
+        mDisableWaitCnt = 1;
+    }
+
+    if (isProcessEnabled() && !mBypassed) {
         // do 32 bit to 16 bit conversion for auxiliary effect input buffer
         if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY) {
             ditherAndClamp(mConfig.inputCfg.buffer.s32,
@@ -277,9 +320,12 @@ void AudioFlinger::EffectModule::process()
         }
 
         // do the actual processing in the effect engine
+        const nsecs_t startNs = systemTime();
         int ret = (*mEffectInterface)->process(mEffectInterface,
                                                &mConfig.inputCfg.buffer,
                                                &mConfig.outputCfg.buffer);
+        const nsecs_t processNs = systemTime() - startNs;
+        accountProcessTime_l(processNs < UINT32_MAX ? (uint32_t) processNs : UINT32_MAX);
 
         // force transition to IDLE state when engine is ready
         if (mState == STOPPED && ret == -ENODATA) {
@@ -291,22 +337,57 @@ void AudioFlinger::EffectModule::process()
             memset(mConfig.inputCfg.buffer.raw, 0,
                    mConfig.inputCfg.buffer.frameCount*sizeof(int32_t));
         }
+    } else if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY) {
+        if (mBypassed) {
+            // clear auxiliary effect input buffer, as the engine would have
+            memset(mConfig.inputCfg.buffer.raw, 0,
+                   mConfig.inputCfg.buffer.frameCount*sizeof(int32_t));
+        }
     } else if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT &&
                 mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
-        // If an insert effect is idle and input buffer is different from output buffer,
-        // accumulate input onto output
+        // If an insert effect is idle or bypassed and input buffer is different from output
+        // buffer, accumulate input onto output
         sp<EffectChain> chain = mChain.promote();
         if (chain != 0 && chain->activeTrackCnt() != 0) {
             size_t frameCnt = mConfig.inputCfg.buffer.frameCount * 2;  //always stereo here
-            int16_t *in = mConfig.inputCfg.buffer.s16;
-            int16_t *out = mConfig.outputCfg.buffer.s16;
-            for (size_t i = 0; i < frameCnt; i++) {
-                out[i] = clamp16((int32_t)out[i] + (int32_t)in[i]);
-            }
+            accumulate_i16(mConfig.outputCfg.buffer.s16, mConfig.inputCfg.buffer.s16, frameCnt);
         }
     }
 }
 
+void AudioFlinger::EffectModule::accountProcessTime_l(uint32_t processNs)
+{
+    mProcessNs.add(processNs);
+    mWindowTotalNs += processNs;
+    if (processNs > mWindowMaxNs) {
+        mWindowMaxNs = processNs;
+    }
+    if (mCpuBudgetNs > 0 && processNs > mCpuBudgetNs) {
+        mOverBudgetCalls++;
+        mWindowOverBudgetCalls++;
+    }
+    if (++mWindowCalls < kCpuBudgetWindowCalls) {
+        return;
+    }
+    mLastWindowMeanNs = (uint32_t) (mWindowTotalNs / mWindowCalls);
+    mLastWindowMaxNs = mWindowMaxNs;
+    if (mWindowOverBudgetCalls >= kMaxOverBudgetCalls) {
+        ALOGW("effect %s (id %d, session %d) over its budget of %u us in %u of %u calls, "
+                "mean %u us, max %u us%s", mDescriptor.name, mId, mSessionId,
+                mCpuBudgetNs / 1000, mWindowOverBudgetCalls, mWindowCalls,
+                mLastWindowMeanNs / 1000, mLastWindowMaxNs / 1000,
+                mBudgetBypass ? ", bypassing it" : "");
+        if (mBudgetBypass) {
+            mBypassed = true;
+            mBypassCount++;
+        }
+    }
+    mWindowCalls = 0;
+    mWindowOverBudgetCalls = 0;
+    mWindowTotalNs = 0;
+    mWindowMaxNs = 0;
+}
+
 void AudioFlinger::EffectModule::reset_l()
 {
     if (mStatus != NO_ERROR || mEffectInterface == NULL) {
@@ -423,6 +504,24 @@ status_t AudioFlinger::EffectModule::configure()
     mMaxDisableWaitCnt = (MAX_DISABLE_TIME_MS * mConfig.outputCfg.samplingRate) /
             (1000 * mConfig.outputCfg.buffer.frameCount);
 
+    if (mConfig.inputCfg.samplingRate > 0) {
+        const uint64_t bufferNs = (uint64_t) mConfig.inputCfg.buffer.frameCount * 1000000000 /
+                mConfig.inputCfg.samplingRate;
+        // cpuLoad / 10 MIPS of kCpuLoadReferenceMips, in percent
+        uint64_t budgetPercent = mDescriptor.cpuLoad == 0 ? kUndeclaredCpuBudgetPercent :
+                (uint64_t) mDescriptor.cpuLoad * 10 / kCpuLoadReferenceMips;
+        if (budgetPercent < kMinCpuBudgetPercent) {
+            budgetPercent = kMinCpuBudgetPercent;
+        } else if (budgetPercent > 100) {
+            budgetPercent = 100;
+        }
+        mCpuBudgetNs = (uint32_t) (bufferNs * budgetPercent / 100);
+    }
+    mWindowCalls = 0;
+    mWindowOverBudgetCalls = 0;
+    mWindowTotalNs = 0;
+    mWindowMaxNs = 0;
+
 exit:
     mStatus = status;
     return status;
@@ -488,6 +587,8 @@ status_t AudioFlinger::EffectModule::start_l()
         status = cmdStatus;
     }
     if (status == 0) {
+        // give an effect bypassed by the budget policy another chance
+        mBypassed = false;
         addEffectToHal_l();
         sp<EffectChain> chain = mChain.promote();
         if (chain != 0) {
@@ -961,6 +1062,20 @@ void AudioFlinger::EffectModule::dump(int fd, const Vector<String16>& args __unu
             mSessionId, mStatus, mState, mEffectInterface);
     result.append(buffer);
 
+    const uint32_t calls = (uint32_t) mProcessNs.total();
+    snprintf(buffer, SIZE, "\t\tCPU: budget %.3f ms per call (declared load %u), %u calls, "
+            "p99 %.3f ms, max %.3f ms\n",
+            mCpuBudgetNs * 1e-6, mDescriptor.cpuLoad, calls,
+            mProcessNs.percentileNs(0.99) * 1e-6, mProcessNs.mMaxNs * 1e-6);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\t\t     last %u calls: mean %.3f ms, max %.3f ms\n",
+            kCpuBudgetWindowCalls, mLastWindowMeanNs * 1e-6, mLastWindowMaxNs * 1e-6);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\t\t     %u calls over budget, bypass %s%s, bypassed %u times\n",
+            mOverBudgetCalls, mBudgetBypass ? "enabled" : "disabled",
+            mBypassed ? " (bypassed now)" : "", mBypassCount);
+    result.append(buffer);
+
     result.append("\t\tDescriptor:\n");
     snprintf(buffer, SIZE, "\t\t- UUID: %08X-%04X-%04X-%04X-%02X%02X%02X%02X%02X%02X\n",
             mDescriptor.uuid.timeLow, mDescriptor.uuid.timeMid, mDescriptor.uuid.timeHiAndVersion,
@@ -1952,6 +2067,18 @@ bool AudioFlinger::EffectChain::isNonOffloadableEnabled()
     return false;
 }
 
+bool AudioFlinger::EffectChain::isProcessEnabled()
+{
+    Mutex::Autolock _l(mLock);
+    size_t size = mEffects.size();
+    for (size_t i = 0; i < size; i++) {
+        if (mEffects[i]->isProcessEnabled() && !mEffects[i]->isBypassed()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void AudioFlinger::EffectChain::setThread(const sp<ThreadBase>& thread)
 {
     Mutex::Autolock _l(mLock);
@@ -123,6 +123,20 @@ public:
 
     void             dump(int fd, const Vector<String16>& args);
 
+    // The processing time of the engine is budgeted per call from the CPU load declared in the
+    // descriptor, which is in 0.1 MIPS of the reference core kCpuLoadReferenceMips: the share
+    // of that core becomes the share of the buffer duration.  The budget is at least
+    // kMinCpuBudgetPercent of the buffer duration, and kUndeclaredCpuBudgetPercent if no load
+    // is declared.  With af.effect.budget_bypass, an effect that exceeds its budget in at least
+    // kMaxOverBudgetCalls of kCpuBudgetWindowCalls calls is bypassed until it is started again.
+    static const uint32_t kCpuLoadReferenceMips = 200;
+    static const uint32_t kMinCpuBudgetPercent = 5;
+    static const uint32_t kUndeclaredCpuBudgetPercent = 25;
+    static const uint32_t kCpuBudgetWindowCalls = 64;
+    static const uint32_t kMaxOverBudgetCalls = kCpuBudgetWindowCalls / 4;
+
+    bool             isBypassed() const { return mBypassed; }
+
 protected:
     friend class AudioFlinger;      // for mHandles
     bool                mPinned;
@@ -136,6 +150,8 @@ protected:
     status_t start_l();
     status_t stop_l();
     status_t remove_effect_from_hal_l();
+    // Accounts a call to the engine that took processNs, and applies the budget policy
+    void     accountProcessTime_l(uint32_t processNs);
 
 mutable Mutex               mLock;      // mutex for process, commands and handles list protection
     wp<ThreadBase>      mThread;    // parent thread
@@ -155,6 +171,20 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     bool     mSuspended;            // effect is suspended: temporarily disabled by framework
     bool     mOffloaded;            // effect is currently offloaded to the audio DSP
     wp<AudioFlinger>    mAudioFlinger;
+
+    // Processing time of the engine, written by process() and read by dump()
+    const bool          mBudgetBypass;  // af.effect.budget_bypass
+    bool                mBypassed;      // by the budget policy
+    uint32_t            mBypassCount;   // times the budget policy bypassed the effect
+    uint32_t            mCpuBudgetNs;   // per call, set by configure()
+    CycleHistogram      mProcessNs;     // wall clock time of each call to the engine
+    uint32_t            mOverBudgetCalls;   // since creation
+    uint32_t            mWindowCalls;   // in the current window of kCpuBudgetWindowCalls
+    uint32_t            mWindowOverBudgetCalls;
+    uint64_t            mWindowTotalNs;
+    uint32_t            mWindowMaxNs;
+    uint32_t            mLastWindowMeanNs;  // of the last complete window
+    uint32_t            mLastWindowMaxNs;
 };
 
 // The EffectHandle class implements the IEffect interface. It provides resources
@@ -319,6 +349,10 @@ public:
     // At least one non offloadable effect in the chain is enabled
     bool isNonOffloadableEnabled();
 
+    // At least one effect in the chain processes audio, see EffectModule::isProcessEnabled(),
+    // and is not bypassed
+    bool isProcessEnabled();
+
     // use release_cas because we don't care about the observed value, just want to make sure the
     // new value is observable.
     void forceVolume() { android_atomic_release_cas(false, true, &mForceVolume); }
@@ -150,6 +150,7 @@ void FastCapture::onStateChange()
         }
         mReadBufferState = -1;
         dumpState->mFrameCount = frameCount;
+        mLogWriter->logFormat(NBLog::FORMAT_CAPTURE_STATE, mSampleRate, (uint32_t) frameCount);
     }
 
 }
@@ -177,6 +178,8 @@ void FastCapture::onWork()
             mReadBufferState = framesRead;
         } else {
             dumpState->mReadErrors++;
+            mLogWriter->logFormat(NBLog::FORMAT_CAPTURE_READ_ERROR, (int32_t) framesRead,
+                    (uint32_t) frameCount);
             mReadBufferState = 0;
         }
         // FIXME rename to attemptedIO
@@ -193,6 +196,11 @@ void FastCapture::onWork()
         }
         if (mReadBufferState > 0) {
             ssize_t framesWritten = mPipeSink->write(mReadBuffer, mReadBufferState);
+            if (framesWritten != mReadBufferState) {
+                // the pipe has blocking readers which are behind
+                mLogWriter->logFormat(NBLog::FORMAT_CAPTURE_SHORT_WRITE, (int32_t) framesWritten,
+                        (uint32_t) mReadBufferState);
+            }
             // FIXME This supports at most one fast capture client.
             //       To handle multiple clients this could be converted to an array,
             //       or with a lot more work the control block could be shared by all clients.
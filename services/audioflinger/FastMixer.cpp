@@ -185,6 +185,7 @@ void FastMixer::onStateChange()
             //       implementation; it would be better to have normal mixer allocate for us
             //       to avoid blocking here and to prevent possible priority inversion
             mMixer = new AudioMixer(frameCount, mSampleRate, FastMixerState::kMaxFastTracks);
+            mMixer->setLog(mLogWriter);
             const size_t mixerFrameSize = mSinkChannelCount
                     * audio_bytes_per_sample(mMixerBufferFormat);
             mMixerBufferSize = mixerFrameSize * frameCount;
@@ -322,6 +323,8 @@ void FastMixer::onStateChange()
         mFastTracksGen = current->mFastTracksGen;
 
         dumpState->mNumTracks = popcount(currentTrackMask);
+        mLogWriter->logFormat(NBLog::FORMAT_MIXER_STATE, (uint32_t) popcount(currentTrackMask),
+                currentTrackMask, (uint32_t) frameCount);
     }
 }
 
@@ -458,6 +461,8 @@ void FastMixer::onWork()
             //}
         } else {
             dumpState->mWriteErrors++;
+            mLogWriter->logFormat(NBLog::FORMAT_MIXER_WRITE_ERROR, (int32_t) framesWritten,
+                    (uint32_t) frameCount);
         }
         mAttemptedWrite = true;
         // FIXME count # of writes blocked excessively, CPU usage, etc. for dump
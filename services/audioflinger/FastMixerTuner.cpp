@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FastMixerTuner"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <utils/Log.h>
+#include "FastMixerTuner.h"
+
+namespace android {
+
+FastMixerTuner::FastMixerTuner()
+    : mEnabled(false), mHalFrameCount(0), mNormalFrameCount(0), mSampleRate(0),
+      mMaxMultiplier(1), mMinPipeFrames(0), mMaxPipeFrames(0),
+      mMultiplier(1), mPipeFrames(0), mChanges(0),
+      mWindowStartNs(0), mSettling(false), mWindowUnderruns(0), mWindowPipeUnderruns(0),
+      mObservedBounds(0), mMaxCycleNs(0), mMaxLoadNs(0), mQuietWindows(0)
+{
+}
+
+void FastMixerTuner::configure(bool enabled, size_t halFrameCount, size_t normalFrameCount,
+        size_t pipeMaxFrames, uint32_t sampleRate, uint32_t maxPeriodMs)
+{
+    mHalFrameCount = halFrameCount;
+    mNormalFrameCount = normalFrameCount;
+    mSampleRate = sampleRate;
+    mMultiplier = 1;
+    mMinPipeFrames = normalFrameCount * 2;
+    mPipeFrames = mMinPipeFrames;
+    mMaxPipeFrames = (pipeMaxFrames * 7) / 8;
+    if (mMaxPipeFrames < mMinPipeFrames) {
+        mMaxPipeFrames = mMinPipeFrames;
+    }
+    // The period is bounded by the latency requested, and by the normal mixer period so that
+    // the pipe always holds at least 2 fast mixer periods.
+    mMaxMultiplier = 1;
+    if (halFrameCount > 0) {
+        const size_t maxPeriodFrames = (size_t) maxPeriodMs * sampleRate / 1000;
+        while (mMaxMultiplier * 2 <= kMaxMultiplier &&
+                halFrameCount * mMaxMultiplier * 2 <= maxPeriodFrames &&
+                halFrameCount * mMaxMultiplier * 2 <= normalFrameCount) {
+            mMaxMultiplier *= 2;
+        }
+    }
+    mEnabled = enabled && sampleRate > 0 &&
+            (mMaxMultiplier > 1 || mMaxPipeFrames > mMinPipeFrames);
+    ALOGV("configure enabled=%d maxMultiplier=%u pipe %zu to %zu frames",
+            mEnabled, mMaxMultiplier, mMinPipeFrames, mMaxPipeFrames);
+}
+
+/*static*/
+uint32_t FastMixerTuner::pipeUnderruns(const FastMixerDumpState& dumpState)
+{
+    // the normal mixer submix is always fast track 0
+    const FastTrackUnderruns underruns = dumpState.mTracks[0].mUnderruns;
+    return underruns.mBitFields.mPartial + underruns.mBitFields.mEmpty;
+}
+
+void FastMixerTuner::startWindow(const FastMixerDumpState& dumpState, nsecs_t now)
+{
+    mWindowStartNs = now;
+    mWindowUnderruns = dumpState.mUnderruns;
+    mWindowPipeUnderruns = pipeUnderruns(dumpState);
+    mMaxCycleNs = 0;
+    mMaxLoadNs = 0;
+}
+
+bool FastMixerTuner::update(const FastMixerDumpState& dumpState, bool fastClients)
+{
+    if (!mEnabled) {
+        return false;
+    }
+    const uint32_t oldMultiplier = mMultiplier;
+    const size_t oldPipeFrames = mPipeFrames;
+    const nsecs_t now = systemTime();
+    if (mWindowStartNs == 0) {
+        startWindow(dumpState, now);
+    }
+
+    // client fast tracks are sized for the HAL frame count
+    if (fastClients && mMultiplier > 1) {
+        mMultiplier = 1;
+    }
+
+#ifdef FAST_THREAD_STATISTICS
+    // take in the cycles measured since the previous update; the dump state is written
+    // without barriers, so a sample may be stale, which only matters for a cycle
+    const uint32_t samplingN = dumpState.mSamplingN;
+    const uint32_t bounds = dumpState.mBounds;
+    const uint32_t newest = bounds & 0xFFFF;
+    const uint32_t valid = (newest - (bounds >> 16)) & 0xFFFF;
+    uint32_t count = (newest - mObservedBounds) & 0xFFFF;
+    if (count > valid) {
+        count = valid;
+    }
+    if (count > samplingN) {
+        count = samplingN;
+    }
+    for (uint32_t i = (newest - count) & 0xFFFF; i != newest; i = (i + 1) & 0xFFFF) {
+        const uint32_t index = i & (samplingN - 1);
+        const uint32_t cycleNs = dumpState.mMonotonicNs[index];
+        const uint32_t loadNs = dumpState.mLoadNs[index];
+        if (cycleNs > mMaxCycleNs) {
+            mMaxCycleNs = cycleNs;
+        }
+        if (loadNs > mMaxLoadNs) {
+            mMaxLoadNs = loadNs;
+        }
+    }
+    mObservedBounds = newest;
+#endif
+
+    if (now - mWindowStartNs >= kWindowNs) {
+        const uint32_t underruns = dumpState.mUnderruns - mWindowUnderruns;
+        const uint32_t pipeUnderrunCount =
+                (pipeUnderruns(dumpState) - mWindowPipeUnderruns) & UNDERRUN_MASK;
+        const uint64_t periodNs = (uint64_t) periodFrames() * 1000000000 / mSampleRate;
+        const bool late = mMaxCycleNs > periodNs * 3 / 2;
+        const bool heavy = mMaxLoadNs > periodNs * 3 / 4;
+        const bool stressed = underruns > 0 || pipeUnderrunCount > 0 || late || heavy;
+        const bool quiet = !stressed && mMaxCycleNs <= periodNs * 5 / 4 &&
+                mMaxLoadNs <= periodNs / 2;
+        ALOGV("window: underruns=%u pipeUnderruns=%u maxCycle=%u maxLoad=%u period=%llu%s",
+                underruns, pipeUnderrunCount, mMaxCycleNs, mMaxLoadNs,
+                (unsigned long long) periodNs, mSettling ? " (settling)" : "");
+        if (mSettling) {
+            // the cycles around a period change are not representative
+            mSettling = false;
+        } else if (stressed) {
+            mQuietWindows = 0;
+            if (pipeUnderrunCount > 0 && mPipeFrames < mMaxPipeFrames) {
+                mPipeFrames += mNormalFrameCount;
+                if (mPipeFrames > mMaxPipeFrames) {
+                    mPipeFrames = mMaxPipeFrames;
+                }
+            }
+            if ((underruns > 0 || late || heavy) && !fastClients &&
+                    mMultiplier < mMaxMultiplier) {
+                mMultiplier *= 2;
+            }
+        } else if (quiet) {
+            if (++mQuietWindows >= kQuietWindows) {
+                mQuietWindows = 0;
+                if (mMultiplier > 1) {
+                    mMultiplier /= 2;
+                } else if (mPipeFrames > mMinPipeFrames) {
+                    mPipeFrames = mPipeFrames - mMinPipeFrames > mNormalFrameCount ?
+                            mPipeFrames - mNormalFrameCount : mMinPipeFrames;
+                }
+            }
+        } else {
+            mQuietWindows = 0;
+        }
+        startWindow(dumpState, now);
+    }
+
+    if (mMultiplier != oldMultiplier) {
+        mSettling = true;
+    }
+    if (mMultiplier != oldMultiplier || mPipeFrames != oldPipeFrames) {
+        mChanges++;
+        return true;
+    }
+    return false;
+}
+
+void FastMixerTuner::dump(int fd) const
+{
+    if (!mEnabled) {
+        return;
+    }
+    const size_t period = periodFrames();
+    dprintf(fd, "  Adaptive fast mixer: period %zu frames (%.2f ms, max %zu frames), "
+            "pipe fill %zu frames (%zu to %zu), %u changes\n",
+            period, period * 1000.0 / mSampleRate, mHalFrameCount * mMaxMultiplier,
+            mPipeFrames, mMinPipeFrames, mMaxPipeFrames, mChanges);
+}
+
+}   // namespace android
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FAST_MIXER_TUNER_H
+#define ANDROID_AUDIO_FAST_MIXER_TUNER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <utils/Timers.h>
+#include "FastMixerDumpState.h"
+
+namespace android {
+
+// FastMixerTuner adapts the period of a FastMixer, and the fill level of the MonoPipe from the
+// normal mixer, to how well the fast mixer keeps up.  It is used by the normal mixer thread,
+// which observes the FastMixerDumpState over windows of kWindowNs:
+//  - the period is a power of 2 multiple of the HAL frame count.  It is doubled when the fast
+//    mixer underruns or its cycles are late or heavy, up to a maximum in ms, and halved after
+//    kQuietWindows quiet windows.  It is always the HAL frame count while there are fast
+//    tracks of clients, as their buffers are sized for it.
+//  - the pipe fill level starts at 2 normal mixer periods, as before, and grows by a normal
+//    period when the fast mixer finds the pipe empty, up to 7/8 of the pipe.  It shrinks back
+//    after quiet windows once the period is back to the HAL frame count.
+// When disabled, the period and the fill level are those of a non-adaptive MixerThread.
+// It is only used by the normal mixer thread, but dump() may be called from any thread.
+class FastMixerTuner {
+public:
+    FastMixerTuner();
+
+    // halFrameCount is the HAL buffer size, normalFrameCount the normal mixer period,
+    // pipeMaxFrames the size of the MonoPipe; maxPeriodMs bounds the adaptive period.
+    void        configure(bool enabled, size_t halFrameCount, size_t normalFrameCount,
+                        size_t pipeMaxFrames, uint32_t sampleRate, uint32_t maxPeriodMs);
+
+    // Called by the normal mixer thread once per cycle, with whether the fast mixer has fast
+    // tracks of clients in the state about to be pushed.  Returns true if periodFrames() or
+    // pipeFrames() changed.
+    bool        update(const FastMixerDumpState& dumpState, bool fastClients);
+
+    size_t      periodFrames() const { return mHalFrameCount * mMultiplier; }
+    size_t      pipeFrames() const { return mPipeFrames; }
+
+    void        dump(int fd) const;
+
+    static const nsecs_t  kWindowNs = 1000000000;
+    static const uint32_t kQuietWindows = 10;
+    static const uint32_t kMaxMultiplier = 4;
+
+private:
+    // Restarts the observation window at time now
+    void        startWindow(const FastMixerDumpState& dumpState, nsecs_t now);
+    // Returns the number of times the fast mixer found the pipe from the normal mixer empty
+    static uint32_t pipeUnderruns(const FastMixerDumpState& dumpState);
+
+    bool        mEnabled;
+    size_t      mHalFrameCount;
+    size_t      mNormalFrameCount;
+    uint32_t    mSampleRate;
+    uint32_t    mMaxMultiplier;     // power of 2
+    size_t      mMinPipeFrames;
+    size_t      mMaxPipeFrames;
+
+    uint32_t    mMultiplier;        // period in HAL frame counts, power of 2
+    size_t      mPipeFrames;
+    uint32_t    mChanges;           // number of changes of the period or pipe fill level
+
+    // the current observation window
+    nsecs_t     mWindowStartNs;
+    bool        mSettling;          // the period changed during the window
+    uint32_t    mWindowUnderruns;   // dumpState.mUnderruns at the start of the window
+    uint32_t    mWindowPipeUnderruns;
+    uint32_t    mObservedBounds;    // newest cycle sample already observed
+    uint32_t    mMaxCycleNs;        // longest cycle in the window
+    uint32_t    mMaxLoadNs;         // highest CPU time of a cycle in the window
+    uint32_t    mQuietWindows;      // consecutive quiet windows
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_FAST_MIXER_TUNER_H
@@ -251,6 +251,10 @@ bool FastThread::threadLoop()
                         mIsWarm = true;
                         mDumpState->mMeasuredWarmupTs = mMeasuredWarmupTs;
                         mDumpState->mWarmupCycles = mWarmupCycles;
+                        mLogWriter->logTimestamp(newTs);
+                        mLogWriter->logFormat(NBLog::FORMAT_WARMUP, mWarmupCycles,
+                                (uint32_t) (mMeasuredWarmupTs.tv_sec * 1000000 +
+                                        mMeasuredWarmupTs.tv_nsec / 1000));
                     }
                 }
                 mSleepNs = -1;
@@ -260,6 +264,9 @@ bool FastThread::threadLoop()
                         // FIXME only log occasionally
                         ALOGV("underrun: time since last cycle %d.%03ld sec",
                                 (int) sec, nsec / 1000000L);
+                        mLogWriter->logTimestamp(newTs);
+                        mLogWriter->logFormat(NBLog::FORMAT_UNDERRUN,
+                                (uint32_t) (sec * 1000000 + nsec / 1000));
                         mDumpState->mUnderruns++;
                         mIgnoreNextOverrun = true;
                     } else if (nsec < mOverrunNs) {
@@ -269,6 +276,9 @@ bool FastThread::threadLoop()
                             // FIXME only log occasionally
                             ALOGV("overrun: time since last cycle %d.%03ld sec",
                                     (int) sec, nsec / 1000000L);
+                            mLogWriter->logTimestamp(newTs);
+                            mLogWriter->logFormat(NBLog::FORMAT_OVERRUN,
+                                    (uint32_t) (sec * 1000000 + nsec / 1000));
                             mDumpState->mOverruns++;
                         }
                         // This forces a minimum cycle time. It:
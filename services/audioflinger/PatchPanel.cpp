@@ -21,11 +21,16 @@
 
 #include "Configuration.h"
 #include <utils/Log.h>
+#include <cutils/properties.h>
 #include <audio_utils/primitives.h>
 
 #include "AudioFlinger.h"
 #include "ServiceUtilities.h"
 #include <media/AudioParameter.h>
+#include <media/AudioResamplerPublic.h>
+#include <media/nbaio/MonoPipe.h>
+#include <media/nbaio/MonoPipeReader.h>
+#include <mediautils/SchedulingPolicyService.h>
 
 // ----------------------------------------------------------------------------
 
@@ -44,6 +49,9 @@
 
 namespace android {
 
+// Priority of the thread of a direct route for requestPriority, as for the fast mixer
+static const int kPriorityRouteThread = 3;
+
 /* List connected audio ports and their attributes */
 status_t AudioFlinger::listAudioPorts(unsigned int *num_ports,
                                 struct audio_port *ports)
@@ -111,7 +119,9 @@ status_t AudioFlinger::setAudioPortConfig(const struct audio_port_config *config
 
 
 AudioFlinger::PatchPanel::PatchPanel(const sp<AudioFlinger>& audioFlinger)
-                                   : mAudioFlinger(audioFlinger)
+                                   : mAudioFlinger(audioFlinger),
+                                     mDirectRoute(property_get_bool("af.patch.direct_route",
+                                                                    false))
 {
 }
 
@@ -211,6 +221,15 @@ status_t AudioFlinger::PatchPanel::createAudioPatch(const struct audio_patch *pa
                     ((patch->sinks[0].ext.device.hw_module != srcModule) ||
                     (audioHwDevice->version() < AUDIO_DEVICE_API_VERSION_3_0) ||
                     (patch->num_sources == 2))) {
+                if (patch->num_sources == 1 && mDirectRoute) {
+                    status = createDirectRoute(newPatch, patch);
+                    if (status == NO_ERROR) {
+                        break;
+                    }
+                    ALOGW("createAudioPatch() direct route failed with status %d, "
+                          "using a software bridge", status);
+                    status = NO_ERROR;
+                }
                 if (patch->num_sources == 2) {
                     if (patch->sources[1].type != AUDIO_PORT_TYPE_MIX ||
                             patch->sinks[0].ext.device.hw_module !=
@@ -454,6 +473,96 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
     return status;
 }
 
+status_t AudioFlinger::PatchPanel::createDirectRoute(Patch *patch,
+                                                     const struct audio_patch *audioPatch)
+{
+    sp<AudioFlinger> audioflinger = mAudioFlinger.promote();
+    if (audioflinger == 0) {
+        return NO_INIT;
+    }
+    const struct audio_port_config *source = &audioPatch->sources[0];
+    const struct audio_port_config *sink = &audioPatch->sinks[0];
+
+    AudioHwDevice *outHwDev = audioflinger->findSuitableHwDev_l(sink->ext.device.hw_module,
+                                                                sink->ext.device.type);
+    AudioHwDevice *inHwDev = audioflinger->findSuitableHwDev_l(source->ext.device.hw_module,
+                                                               source->ext.device.type);
+    if (outHwDev == NULL || inHwDev == NULL) {
+        return BAD_VALUE;
+    }
+
+    // open the output with its default configuration, as for a software bridge
+    audio_config_t config = AUDIO_CONFIG_INITIALIZER;
+    AudioStreamOut *output = NULL;
+    status_t status = outHwDev->openOutputStream(&output,
+                                                 audioflinger->nextUniqueId(),
+                                                 sink->ext.device.type,
+                                                 AUDIO_OUTPUT_FLAG_NONE,
+                                                 &config,
+                                                 sink->ext.device.address);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    if (!audio_is_linear_pcm(output->getFormat())) {
+        output->hwDev()->close_output_stream(output->hwDev(), output->stream);
+        delete output;
+        return INVALID_OPERATION;
+    }
+
+    // capture in the configuration of the output, or in the one proposed by the HAL,
+    // which the route then converts
+    uint32_t channelCount = audio_channel_count_from_out_mask(output->getChannelMask());
+    config.sample_rate = output->getSampleRate();
+    config.channel_mask = audio_channel_in_mask_from_count(channelCount);
+    config.format = output->getFormat();
+    audio_config_t halConfig = config;
+    audio_hw_device_t *inHwHal = inHwDev->hwDevice();
+    audio_io_handle_t input = audioflinger->nextUniqueId();
+    audio_stream_in_t *inStream = NULL;
+    status = inHwHal->open_input_stream(inHwHal, input, source->ext.device.type, &halConfig,
+                                        &inStream, AUDIO_INPUT_FLAG_NONE,
+                                        source->ext.device.address, AUDIO_SOURCE_MIC);
+    if (status == BAD_VALUE &&
+            audio_is_linear_pcm(halConfig.format) &&
+            (halConfig.sample_rate <= AUDIO_RESAMPLER_DOWN_RATIO_MAX * config.sample_rate) &&
+            (audio_channel_count_from_in_mask(halConfig.channel_mask) <= FCC_2) &&
+            (channelCount <= FCC_2)) {
+        ALOGV("createDirectRoute() reopening input with proposed sampling rate %u format %#x "
+              "channel mask %#x", halConfig.sample_rate, halConfig.format,
+              halConfig.channel_mask);
+        inStream = NULL;
+        status = inHwHal->open_input_stream(inHwHal, input, source->ext.device.type, &halConfig,
+                                            &inStream, AUDIO_INPUT_FLAG_NONE,
+                                            source->ext.device.address, AUDIO_SOURCE_MIC);
+    }
+    if (status != NO_ERROR || inStream == NULL) {
+        output->hwDev()->close_output_stream(output->hwDev(), output->stream);
+        delete output;
+        return status != NO_ERROR ? status : NO_INIT;
+    }
+
+    patch->mRouteThread = new RouteThread(new AudioStreamIn(inHwDev, inStream), output);
+    status = patch->mRouteThread->initCheck();
+    if (status != NO_ERROR) {
+        patch->mRouteThread.clear();
+        return status;
+    }
+    status = patch->mRouteThread->run("PatchRoute", ANDROID_PRIORITY_URGENT_AUDIO);
+    if (status != NO_ERROR) {
+        patch->mRouteThread.clear();
+        return status;
+    }
+    pid_t tid = patch->mRouteThread->getTid();
+    if (tid != -1) {
+        // the thread does not wait for SCHED_FIFO, as the fast threads
+        requestPriority(getpid_cached, tid, kPriorityRouteThread, true /*asynchronous*/);
+    }
+    ALOGV("createDirectRoute() input rate %u format %#x mask %#x, output rate %u format %#x "
+          "mask %#x", halConfig.sample_rate, halConfig.format, halConfig.channel_mask,
+          output->getSampleRate(), output->getFormat(), output->getChannelMask());
+    return NO_ERROR;
+}
+
 void AudioFlinger::PatchPanel::clearPatchConnections(Patch *patch)
 {
     sp<AudioFlinger> audioflinger = mAudioFlinger.promote();
@@ -461,6 +570,13 @@ void AudioFlinger::PatchPanel::clearPatchConnections(Patch *patch)
         return;
     }
 
+    if (patch->mRouteThread != 0) {
+        ALOGV("clearPatchConnections() stopping direct route");
+        patch->mRouteThread->requestExitAndWait();
+        // closes the streams
+        patch->mRouteThread.clear();
+    }
+
     ALOGV("clearPatchConnections() patch->mRecordPatchHandle %d patch->mPlaybackPatchHandle %d",
           patch->mRecordPatchHandle, patch->mPlaybackPatchHandle);
 
@@ -508,6 +624,185 @@ void AudioFlinger::PatchPanel::clearPatchConnections(Patch *patch)
 
 }
 
+AudioFlinger::PatchPanel::RouteThread::RouteThread(AudioStreamIn *input,
+                                                   AudioStreamOut *output)
+    :   Thread(false /*canCallJava*/),
+        mInput(input), mOutput(output), mStatus(NO_INIT),
+        mInputFrameSize(0), mInputFrames(0), mOutputFrameSize(0), mOutputFrames(0),
+        mInputPeriodUs(0), mReadBuffer(NULL), mConverter(NULL), mConvertBuffer(NULL),
+        mConvertFrames(0), mWriteBuffer(NULL),
+        mReadErrors(0), mWriteErrors(0), mOverrunFrames(0)
+{
+    audio_stream_in_t *in = mInput->stream;
+    const uint32_t inSampleRate = in->common.get_sample_rate(&in->common);
+    const audio_format_t inFormat = in->common.get_format(&in->common);
+    const audio_channel_mask_t inChannelMask = in->common.get_channels(&in->common);
+    mInputFrameSize = audio_stream_in_frame_size(in);
+    if (mInputFrameSize == 0 || inSampleRate == 0) {
+        ALOGE("RouteThread() invalid input configuration");
+        return;
+    }
+    mInputFrames = in->common.get_buffer_size(&in->common) / mInputFrameSize;
+
+    const uint32_t outSampleRate = mOutput->getSampleRate();
+    const audio_format_t outFormat = mOutput->getFormat();
+    const uint32_t outChannelCount =
+            audio_channel_count_from_out_mask(mOutput->getChannelMask());
+    mOutputFrameSize = mOutput->getFrameSize();
+    mOutputFrames = mOutput->stream->common.get_buffer_size(&mOutput->stream->common) /
+            mOutputFrameSize;
+    if (mInputFrames == 0 || mOutputFrames == 0) {
+        ALOGE("RouteThread() invalid period of %zu input frames, %zu output frames",
+              mInputFrames, mOutputFrames);
+        return;
+    }
+    mInputPeriodUs = (uint32_t) ((uint64_t) mInputFrames * 1000000 / inSampleRate);
+
+    // the converter only takes input channel masks
+    const audio_channel_mask_t outChannelMask = audio_channel_in_mask_from_count(outChannelCount);
+    mConvertFrames = mInputFrames;
+    if (inSampleRate != outSampleRate || inFormat != outFormat || inChannelMask != outChannelMask) {
+        mConverter = new RecordThread::RecordBufferConverter(
+                inChannelMask, inFormat, inSampleRate,
+                outChannelMask, outFormat, outSampleRate);
+        if (mConverter->initCheck() != NO_ERROR) {
+            ALOGE("RouteThread() cannot convert from rate %u format %#x mask %#x "
+                  "to rate %u format %#x mask %#x", inSampleRate, inFormat, inChannelMask,
+                  outSampleRate, outFormat, outChannelMask);
+            return;
+        }
+        // room for all the frames the resampler can produce from a read, so that it never
+        // holds on to the read buffer across reads
+        mConvertFrames = (size_t) ((uint64_t) mInputFrames * outSampleRate / inSampleRate) + 16;
+        (void)posix_memalign(&mConvertBuffer, 32, mConvertFrames * mOutputFrameSize);
+    }
+
+    (void)posix_memalign(&mReadBuffer, 32, mInputFrames * mInputFrameSize);
+    (void)posix_memalign(&mWriteBuffer, 32, mOutputFrames * mOutputFrameSize);
+    if (mReadBuffer == NULL || mWriteBuffer == NULL ||
+            (mConverter != NULL && mConvertBuffer == NULL)) {
+        mStatus = NO_MEMORY;
+        return;
+    }
+
+    // the pipe regroups the frames of the reads into periods of the output
+    const NBAIO_Format format = Format_from_SR_C(outSampleRate, outChannelCount, outFormat);
+    const NBAIO_Format offers[1] = {format};
+    size_t numCounterOffers = 0;
+    mPipe = new MonoPipe(roundup((mConvertFrames + mOutputFrames) * 2), format,
+                         false /*writeCanBlock*/);
+    ssize_t index = mPipe->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    mPipeReader = new MonoPipeReader(mPipe.get());
+    numCounterOffers = 0;
+    index = mPipeReader->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    (void) index;
+    mStatus = NO_ERROR;
+}
+
+AudioFlinger::PatchPanel::RouteThread::~RouteThread()
+{
+    ALOGV("~RouteThread() read errors %u write errors %u overrun frames %llu",
+          mReadErrors, mWriteErrors, (unsigned long long) mOverrunFrames);
+    mPipeReader.clear();
+    mPipe.clear();
+    delete mConverter;
+    free(mReadBuffer);
+    free(mConvertBuffer);
+    free(mWriteBuffer);
+    mInput->hwDev()->close_input_stream(mInput->hwDev(), mInput->stream);
+    delete mInput;
+    mOutput->hwDev()->close_output_stream(mOutput->hwDev(), mOutput->stream);
+    delete mOutput;
+}
+
+bool AudioFlinger::PatchPanel::RouteThread::threadLoop()
+{
+    // the read blocks for a period of the input, and paces the route
+    ssize_t bytes = mInput->stream->read(mInput->stream, mReadBuffer,
+                                         mInputFrames * mInputFrameSize);
+    if (bytes <= 0) {
+        if (mReadErrors++ == 0) {
+            ALOGW("RouteThread read error %zd", bytes);
+        }
+        usleep(mInputPeriodUs);
+        return true;
+    }
+    const size_t frames = bytes / mInputFrameSize;
+    if (mConverter != NULL) {
+        mReadProvider.set(mReadBuffer, mInputFrameSize, frames);
+        write(mConvertBuffer, mConverter->convert(mConvertBuffer, &mReadProvider,
+                                                  mConvertFrames));
+    } else {
+        write(mReadBuffer, frames);
+    }
+    return true;
+}
+
+void AudioFlinger::PatchPanel::RouteThread::write(const void *buffer, size_t frames)
+{
+    if (frames > 0) {
+        ssize_t written = mPipe->write(buffer, frames);
+        if (written < (ssize_t) frames) {
+            // the output is not keeping up: drop the rest, the pipe holds less than a period
+            mOverrunFrames += frames - (written > 0 ? written : 0);
+        }
+    }
+    while (mPipeReader->availableToRead() >= (ssize_t) mOutputFrames) {
+        ssize_t read = mPipeReader->read(mWriteBuffer, mOutputFrames,
+                                         AudioBufferProvider::kInvalidPTS);
+        if (read <= 0) {
+            break;
+        }
+        ssize_t bytes = mOutput->write(mWriteBuffer, read * mOutputFrameSize);
+        if (bytes < 0) {
+            if (mWriteErrors++ == 0) {
+                ALOGW("RouteThread write error %zd", bytes);
+            }
+            break;
+        }
+    }
+}
+
+void AudioFlinger::PatchPanel::RouteThread::ReadBufferProvider::set(void *buffer,
+                                                                    size_t frameSize,
+                                                                    size_t frames)
+{
+    mBuffer = buffer;
+    mFrameSize = frameSize;
+    mFrames = frames;
+    mConsumed = 0;
+}
+
+status_t AudioFlinger::PatchPanel::RouteThread::ReadBufferProvider::getNextBuffer(
+        AudioBufferProvider::Buffer* buffer, int64_t pts __unused)
+{
+    size_t frames = mFrames - mConsumed;
+    if (frames > buffer->frameCount) {
+        frames = buffer->frameCount;
+    }
+    if (frames == 0) {
+        buffer->raw = NULL;
+        buffer->frameCount = 0;
+        return NOT_ENOUGH_DATA;
+    }
+    buffer->raw = (uint8_t *) mBuffer + mConsumed * mFrameSize;
+    buffer->frameCount = frames;
+    return NO_ERROR;
+}
+
+void AudioFlinger::PatchPanel::RouteThread::ReadBufferProvider::releaseBuffer(
+        AudioBufferProvider::Buffer* buffer)
+{
+    mConsumed += buffer->frameCount;
+    if (mConsumed > mFrames) {
+        mConsumed = mFrames;
+    }
+    buffer->raw = NULL;
+    buffer->frameCount = 0;
+}
+
 /* Disconnect a patch */
 status_t AudioFlinger::PatchPanel::releaseAudioPatch(audio_patch_handle_t handle)
 {
@@ -544,7 +839,8 @@ status_t AudioFlinger::PatchPanel::releaseAudioPatch(audio_patch_handle_t handle
             }
 
             if (removedPatch->mRecordPatchHandle != AUDIO_PATCH_HANDLE_NONE ||
-                    removedPatch->mPlaybackPatchHandle != AUDIO_PATCH_HANDLE_NONE) {
+                    removedPatch->mPlaybackPatchHandle != AUDIO_PATCH_HANDLE_NONE ||
+                    removedPatch->mRouteThread != 0) {
                 clearPatchConnections(removedPatch);
                 break;
             }
@@ -52,6 +52,70 @@ public:
                                     const struct audio_patch *audioPatch);
     void clearPatchConnections(Patch *patch);
 
+    /* Create a direct route for a device to device patch, see RouteThread */
+    status_t createDirectRoute(Patch *patch, const struct audio_patch *audioPatch);
+
+    // A direct route moves the frames of a device to device patch from an input stream to an
+    // output stream in a single thread, instead of bridging a RecordThread and a PlaybackThread
+    // with a PatchRecord and a PatchTrack.  Each cycle it reads one period of the input, converts
+    // it to the format, channel count and sample rate of the output if they differ, and writes
+    // it to a MonoPipe which regroups the frames into periods of the output.  The thread owns
+    // both streams, which are routed to the patch devices when opened, and closes them when
+    // destroyed.
+    class RouteThread : public Thread {
+    public:
+        RouteThread(AudioStreamIn *input, AudioStreamOut *output);
+        virtual ~RouteThread();
+
+        status_t    initCheck() const { return mStatus; }
+
+    private:
+        virtual bool threadLoop();
+
+        // Writes frames in the format of the output to the pipe, and the whole periods of the
+        // output which are then in the pipe to the output stream
+        void        write(const void *buffer, size_t frames);
+
+        // Provides the frames of the last read of the input to the converter
+        class ReadBufferProvider : public AudioBufferProvider {
+        public:
+            ReadBufferProvider() : mBuffer(NULL), mFrameSize(0), mFrames(0), mConsumed(0) {}
+
+            void        set(void *buffer, size_t frameSize, size_t frames);
+
+            virtual status_t getNextBuffer(Buffer* buffer, int64_t pts);
+            virtual void releaseBuffer(Buffer* buffer);
+
+        private:
+            void       *mBuffer;
+            size_t      mFrameSize;
+            size_t      mFrames;
+            size_t      mConsumed;
+        };
+
+        AudioStreamIn * const       mInput;
+        AudioStreamOut * const      mOutput;
+        status_t                    mStatus;
+        size_t                      mInputFrameSize;
+        size_t                      mInputFrames;       // period of the input
+        size_t                      mOutputFrameSize;
+        size_t                      mOutputFrames;      // period of the output
+        uint32_t                    mInputPeriodUs;
+        void                       *mReadBuffer;        // one period of the input
+        // NULL if the input is already in the format of the output
+        RecordThread::RecordBufferConverter *mConverter;
+        ReadBufferProvider          mReadProvider;
+        void                       *mConvertBuffer;
+        size_t                      mConvertFrames;
+        void                       *mWriteBuffer;       // one period of the output
+        sp<MonoPipe>                mPipe;
+        sp<MonoPipeReader>          mPipeReader;
+        // statistics, only logged
+        uint32_t                    mReadErrors;
+        uint32_t                    mWriteErrors;
+        uint64_t                    mOverrunFrames;     // not accepted by a full pipe
+    };
+
     class Patch {
     public:
         Patch(const struct audio_patch *patch) :
@@ -69,10 +133,14 @@ public:
         sp<RecordThread::PatchRecord>   mPatchRecord;
         audio_patch_handle_t            mRecordPatchHandle;
         audio_patch_handle_t            mPlaybackPatchHandle;
+        // set instead of the threads, tracks and sub patches above for a direct route
+        sp<RouteThread>                 mRouteThread;
 
     };
 
 private:
     const wp<AudioFlinger>      mAudioFlinger;
     SortedVector <Patch *>      mPatches;
+    // device to device software bridges use a direct route when possible
+    const bool                  mDirectRoute;
 };
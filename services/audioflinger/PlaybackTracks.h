@@ -66,6 +66,8 @@ public:
             int         auxEffectId() const { return mAuxEffectId; }
     virtual status_t    getTimestamp(AudioTimestamp& timestamp);
             void        signal();
+            status_t    scheduleAction(int action, bool atPosition, int64_t when,
+                                       float left, float right);
 
 // implement FastMixerState::VolumeProvider interface
     virtual gain_minifloat_packed_t getVolumeLR();
@@ -85,7 +87,7 @@ protected:
     // AudioBufferProvider interface
     virtual status_t getNextBuffer(AudioBufferProvider::Buffer* buffer,
                                    int64_t pts = kInvalidPTS);
-    // releaseBuffer() not overridden
+    virtual void releaseBuffer(AudioBufferProvider::Buffer* buffer);
 
     // ExtendedAudioBufferProvider interface
     virtual size_t framesReady() const;
@@ -102,6 +104,26 @@ protected:
     bool isResumePending();
     void resumeAck();
 
+    // Deferred client wakeups, see PlaybackThread::mBatchWakes
+    void setDeferWake(bool defer, nsecs_t minIntervalNs);
+    void flushWake(nsecs_t now, bool force = false) {
+        (void) mAudioTrackServerProxy->flushWake(now, force);
+    }
+
+    // Scheduled actions, see IAudioTrack::scheduleAction()
+    bool hasScheduledActions_l() const;
+    // Called by the mixer thread once per cycle if hasScheduledActions_l(), before the track
+    // is mixed.  The first frame of the cycle is presented at cycleTimeNs, and the cycle is
+    // cycleFrames at the output sampleRate.  Returns false if the track has a scheduled start
+    // after this cycle, and must not be mixed yet.
+    bool prepareScheduledActions_l(nsecs_t cycleTimeNs, uint32_t sampleRate,
+                                   size_t cycleFrames);
+    // The volume of the track for the mixer: that of the control block, unless a scheduled
+    // volume replaced it
+    gain_minifloat_packed_t volumeLR_l();
+    // Returns true once if the volume of the mixer must step to volumeLR_l() without a ramp
+    bool consumeVolumeStep() { const bool step = mVolumeStep; mVolumeStep = false; return step; }
+
     sp<IMemory> sharedBuffer() const { return mSharedBuffer; }
 
     // framesWritten is cumulative, never reset, and is shared all tracks
@@ -139,6 +161,41 @@ protected:
                                     // audio HAL when this track will be fully rendered
                                     // zero means not monitoring
 private:
+    // Done when a scheduled stop is reached
+    void stopScheduled_l();
+    // Copies frameCount frames from src to mScheduleBuffer, at the gains of a volume switch
+    void applyVolumeSwitch(const void *src, size_t frameCount, uint32_t position);
+
+    struct ScheduledAction {
+        bool        mPending;
+        bool        mAtPosition;
+        int64_t     mWhen;          // CLOCK_MONOTONIC time in ns, or server position in frames
+        float       mLeft;          // volume of SCHEDULE_VOLUME
+        float       mRight;
+    };
+    static const size_t kScheduledActions = IAudioTrack::SCHEDULE_VOLUME + 1;
+    // the actions are applied a buffer of at most this many frames at a time
+    static const size_t kScheduleBufferFrames = 256;
+
+    ScheduledAction     mScheduledActions[kScheduledActions];   // indexed by action
+    // The following fields are set by prepareScheduledActions_l() for the mixer
+    void                *mScheduleBuffer;   // silence before a start, or the frames around
+                                            // a volume switch, allocated on first schedule
+    bool                mScheduleBufferSilent; // mScheduleBuffer is provided as silence
+    size_t              mStartSilenceFrames; // frames of silence before the first frame
+    bool                mStopArmed;         // no frame is provided from mStopPosition on
+    uint32_t            mStopPosition;
+    bool                mStopReached;       // until the next start()
+    bool                mVolumeSwitching;   // the volume switches at mVolumeSwitchPosition
+    uint32_t            mVolumeSwitchPosition;
+    gain_minifloat_packed_t mSwitchVolumeLR; // volume of the mixer during the switch
+    float               mGainBefore[2];     // gains of the frames before and after the switch,
+    float               mGainAfter[2];      // relative to mSwitchVolumeLR
+    bool                mVolumeStep;        // the volume of the mixer is not ramped
+    bool                mVolumeOverride;    // a scheduled volume replaced the client volume
+    gain_minifloat_packed_t mOverrideVolumeLR;
+    gain_minifloat_packed_t mOverriddenVolumeLR; // the client volume when it was replaced
+
     // The following fields are only for fast tracks, and should be in a subclass
     int                 mFastIndex; // index within FastMixerState::mFastTracks[];
                                     // either mFastIndex == -1 if not isFastTrack()
@@ -254,13 +311,17 @@ public:
         void *mBuffer;
     };
 
+                        // If pipe is not NULL, the track is in fan-out mode: it reads the
+                        // frames the source thread writes to pipe, in place, instead of having
+                        // them copied to its own buffer by write().
                         OutputTrack(PlaybackThread *thread,
                                 DuplicatingThread *sourceThread,
                                 uint32_t sampleRate,
                                 audio_format_t format,
                                 audio_channel_mask_t channelMask,
                                 size_t frameCount,
-                                int uid);
+                                int uid,
+                                const sp<Pipe>& pipe);
     virtual             ~OutputTrack();
 
     virtual status_t    start(AudioSystem::sync_event_t event =
@@ -268,10 +329,30 @@ public:
                              int triggerSession = 0);
     virtual void        stop();
             bool        write(void* data, uint32_t frames);
+            // fan-out mode replacement for write(): frames were written to the pipe.
+            void        written(uint32_t frames);
             bool        bufferQueueEmpty() const { return mBufferQueue.size() == 0; }
             bool        isActive() const { return mActive; }
     const wp<ThreadBase>& thread() const { return mThread; }
 
+            bool        isFanOut() const { return mPipeReader != 0; }
+            // fan-out mode only: frames written to the pipe and not yet mixed by the thread,
+            // which the source thread keeps within frameCount() like for write()
+            size_t      framesUnread() const;
+            size_t      frameCount() const { return mFrameCount; }
+            // fan-out mode only, otherwise NULL
+            PipeReader* pipeReader() const { return mPipeReader.get(); }
+
+protected:
+    // AudioBufferProvider interface, overridden for fan-out mode
+    virtual status_t    getNextBuffer(AudioBufferProvider::Buffer* buffer,
+                                      int64_t pts = kInvalidPTS);
+    virtual void        releaseBuffer(AudioBufferProvider::Buffer* buffer);
+
+    // ExtendedAudioBufferProvider interface, overridden for fan-out mode
+    virtual size_t      framesReady() const;
+    virtual size_t      framesReleased() const;
+
 private:
 
     status_t            obtainBuffer(AudioBufferProvider::Buffer* buffer,
@@ -286,6 +367,8 @@ private:
     bool                        mActive;
     DuplicatingThread* const mSourceThread; // for waitTimeMs() in write()
     AudioTrackClientProxy*      mClientProxy;
+    const sp<Pipe>              mPipe;          // fan-out mode only, outlives mPipeReader
+    sp<PipeReader>              mPipeReader;    // fan-out mode only
 };  // end of OutputTrack
 
 // playback track, used by PatchPanel
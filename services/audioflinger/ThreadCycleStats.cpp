@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThreadCycleStats"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <string.h>
+#include <utils/Log.h>
+#include "ThreadCycleStats.h"
+
+namespace android {
+
+void CycleHistogram::reset()
+{
+    memset(mCounts, 0, sizeof(mCounts));
+    mMaxNs = 0;
+}
+
+uint32_t CycleHistogram::lowerBoundNs(uint32_t bucket)
+{
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    const uint32_t shift = (bucket >> kSubBucketBits) - 1;
+    return (kSubBuckets + (bucket & (kSubBuckets - 1))) << shift;
+}
+
+uint32_t CycleHistogram::upperBoundNs(uint32_t bucket)
+{
+    return bucket + 1 < kNumBuckets ? lowerBoundNs(bucket + 1) - 1 : UINT32_MAX;
+}
+
+uint64_t CycleHistogram::total() const
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < kNumBuckets; ++i) {
+        total += mCounts[i];
+    }
+    return total;
+}
+
+uint32_t CycleHistogram::percentileNs(double fraction) const
+{
+    // the counts may be updated while we read them, so read each once.
+    uint32_t counts[kNumBuckets];
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < kNumBuckets; ++i) {
+        counts[i] = mCounts[i];
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const uint32_t maxNs = mMaxNs;
+    // the rank of the duration wanted, from 1 to total
+    uint64_t rank = (uint64_t)(fraction * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > total) {
+        rank = total;
+    }
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < kNumBuckets; ++i) {
+        count += counts[i];
+        if (count >= rank) {
+            const uint32_t ns = upperBoundNs(i);
+            return ns < maxNs ? ns : maxNs;
+        }
+    }
+    return maxNs;
+}
+
+// ----------------------------------------------------------------------------
+
+ThreadCycleStats::ThreadCycleStats()
+    : mCycles(0), mUnderruns(0), mOverruns(0), mPaused(true), mLastCycleNs(0), mLastCpuNs(0)
+{
+    mWallNs.reset();
+    mCpuNs.reset();
+}
+
+static inline uint32_t clampNs(nsecs_t ns)
+{
+    return ns < 0 ? 0 : ns > (nsecs_t)UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+}
+
+void ThreadCycleStats::cycle()
+{
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    const nsecs_t cpu = systemTime(SYSTEM_TIME_THREAD);
+    if (mPaused) {
+        mPaused = false;
+    } else {
+        mWallNs.add(clampNs(now - mLastCycleNs));
+        mCpuNs.add(clampNs(cpu - mLastCpuNs));
+        mCycles++;
+    }
+    mLastCycleNs = now;
+    mLastCpuNs = cpu;
+}
+
+void ThreadCycleStats::getSnapshot(Snapshot *snapshot) const
+{
+    snapshot->mMagic = Snapshot::kMagic;
+    snapshot->mVersion = Snapshot::kVersion;
+    snapshot->mSize = sizeof(Snapshot);
+    snapshot->mIoHandle = 0;
+    snapshot->mThreadType = 0;
+    snapshot->mCycles = mCycles;
+    snapshot->mUnderruns = mUnderruns;
+    snapshot->mOverruns = mOverruns;
+    snapshot->mWallNs = mWallNs;
+    snapshot->mCpuNs = mCpuNs;
+}
+
+void ThreadCycleStats::dump(int fd) const
+{
+    // percentiles are taken on a copy, which is consistent enough for statistics
+    Snapshot snapshot;
+    getSnapshot(&snapshot);
+    dprintf(fd, "  Cycle statistics: cycles=%u underruns=%u overruns=%u\n",
+            snapshot.mCycles, snapshot.mUnderruns, snapshot.mOverruns);
+    if (snapshot.mWallNs.total() == 0) {
+        return;
+    }
+    const CycleHistogram& wall = snapshot.mWallNs;
+    const CycleHistogram& cpu = snapshot.mCpuNs;
+    dprintf(fd, "    wall clock time in ms per cycle:\n"
+                "      p50=%.2f p90=%.2f p99=%.2f p99.9=%.2f max=%.2f\n",
+            wall.percentileNs(0.5) * 1e-6, wall.percentileNs(0.9) * 1e-6,
+            wall.percentileNs(0.99) * 1e-6, wall.percentileNs(0.999) * 1e-6,
+            wall.mMaxNs * 1e-6);
+    dprintf(fd, "    thread CPU time in us per cycle:\n"
+                "      p50=%.0f p90=%.0f p99=%.0f p99.9=%.0f max=%.0f\n",
+            cpu.percentileNs(0.5) * 1e-3, cpu.percentileNs(0.9) * 1e-3,
+            cpu.percentileNs(0.99) * 1e-3, cpu.percentileNs(0.999) * 1e-3,
+            cpu.mMaxNs * 1e-3);
+}
+
+}   // namespace android
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_THREAD_CYCLE_STATS_H
+#define ANDROID_AUDIO_THREAD_CYCLE_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// CycleHistogram counts durations in nanoseconds in logarithmic buckets.
+// Each power of 2 is split into kSubBuckets linear buckets, so that a bucket is at most
+// 1/kSubBuckets (12.5%) of its lower bound wide, from 1 ns up to the 32-bit limit of 4.29 s.
+// Durations below kSubBuckets ns have a bucket each.
+// Only POD types are permitted, so that it can be copied out as is.
+struct CycleHistogram {
+    static const uint32_t kSubBucketBits = 3;
+    static const uint32_t kSubBuckets = 1 << kSubBucketBits;
+    static const uint32_t kNumBuckets = (32 - kSubBucketBits + 1) * kSubBuckets;
+
+    uint32_t    mCounts[kNumBuckets];
+    uint32_t    mMaxNs;                 // longest duration counted
+
+    void        reset();
+
+    void        add(uint32_t ns) {
+                    mCounts[bucketOf(ns)]++;
+                    if (ns > mMaxNs) {
+                        mMaxNs = ns;
+                    }
+                }
+
+    static uint32_t bucketOf(uint32_t ns) {
+                    if (ns < kSubBuckets) {
+                        return ns;
+                    }
+                    const uint32_t shift = (31 - __builtin_clz(ns)) - kSubBucketBits;
+                    return ((shift + 1) << kSubBucketBits) + ((ns >> shift) & (kSubBuckets - 1));
+                }
+    static uint32_t lowerBoundNs(uint32_t bucket);
+    static uint32_t upperBoundNs(uint32_t bucket);
+
+    uint64_t    total() const;
+    // Returns an upper bound of the given fraction (0 to 1) of the durations counted,
+    // with the resolution of the buckets, or 0 if nothing was counted.
+    uint32_t    percentileNs(double fraction) const;
+};
+
+// ThreadCycleStats keeps continuous statistics of the loop cycles of an AudioFlinger thread:
+// histograms of the wall clock time and the thread CPU time of each cycle, and counts of
+// underruns and overruns.  Its memory is fixed, and it runs for the lifetime of the thread,
+// so the tails (p99, p99.9) of field devices can be read by dumpsys at any time.
+//
+// It is written by the thread it measures without lock or barrier.  Each individual native
+// word-sized field is accessed atomically, but the overall structure is non-atomic,
+// that is a reader may see the fields of one cycle partially updated.
+class ThreadCycleStats {
+public:
+    ThreadCycleStats();
+
+    // Called by the measured thread at the same point of each loop cycle,
+    // counts the cycle since the previous call.
+    void        cycle();
+    // Called by the measured thread before it waits for an unbounded time, e.g. for work
+    // in standby; the next cycle() then starts measuring afresh.
+    void        pause() { mPaused = true; }
+    void        underrun() { mUnderruns++; }
+    void        overrun() { mOverruns++; }
+
+    // A copy of the statistics that can be written out in binary as is,
+    // see AudioFlinger::dumpCycleStats().  Fields are in host byte order.
+    struct Snapshot {
+        static const uint32_t kMagic = 0x43594353;  // "SCYC" in little endian memory
+        static const uint32_t kVersion = 1;
+
+        uint32_t        mMagic;
+        uint32_t        mVersion;
+        uint32_t        mSize;          // sizeof(Snapshot)
+        int32_t         mIoHandle;      // audio_io_handle_t of the thread
+        uint32_t        mThreadType;    // ThreadBase::type_t of the thread
+        uint32_t        mCycles;
+        uint32_t        mUnderruns;
+        uint32_t        mOverruns;
+        CycleHistogram  mWallNs;        // wall clock time per cycle
+        CycleHistogram  mCpuNs;         // thread CPU time per cycle
+    };
+
+    // Fills in all fields of the snapshot but mIoHandle and mThreadType.
+    void        getSnapshot(Snapshot *snapshot) const;
+
+    void        dump(int fd) const;
+
+private:
+    CycleHistogram  mWallNs;
+    CycleHistogram  mCpuNs;
+    uint32_t        mCycles;
+    uint32_t        mUnderruns;
+    uint32_t        mOverruns;
+
+    // only used by the measured thread
+    bool            mPaused;            // the next cycle() starts measuring afresh
+    nsecs_t         mLastCycleNs;       // monotonic time at the previous cycle()
+    nsecs_t         mLastCpuNs;         // thread CPU time at the previous cycle()
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_THREAD_CYCLE_STATS_H
@@ -137,6 +137,10 @@ static const uint32_t kMinNormalCaptureBufferSizeMs = 12;
 // Offloaded output thread standby delay: allows track transition without going to standby
 static const nsecs_t kOffloadStandbyDelayNs = seconds(1);
 
+// Size of the DuplicatingThread pipe in fan-out mode, in DuplicatingThread periods.
+// With the triple buffering of OutputTracks, it fits outputs whose period is up to twice as long.
+static const size_t kFanOutPipePeriods = 8;
+
 // Whether to use fast mixer
 static const enum {
     FastMixer_Never,    // never initialize or use: for debugging only
@@ -154,6 +158,15 @@ static const enum {
     //  up large writes into smaller ones, and the wrapper would need to deal with scheduler.
 } kUseFastMixer = FastMixer_Static;
 
+// Default upper bound of the fast mixer period when it adapts to the load, in ms.
+// Adapting writes up to FastMixerTuner::kMaxMultiplier HAL buffers at once, so as for
+// FastMixer_Dynamic above, af.fast_mixer.adaptive should only be set for HALs that support it.
+static const int32_t kFastMixerMaxPeriodMs = 10;
+
+// Default minimum interval between two wakeups of the client of a normal track, in ms,
+// when the wakeups are batched.  A track may lower it, see Track::setDeferWake().
+static const int32_t kMinWakeIntervalMs = 5;
+
 // Whether to use fast capture
 static const enum {
     FastCapture_Never,  // never initialize or use: for debugging only
@@ -208,6 +221,35 @@ static void sFastTrackMultiplierInit()
 
 // ----------------------------------------------------------------------------
 
+// Applies the optional AudioMixer modes of a MixerThread:
+// af.mixer.helper_threads is the number of helper threads used to mix many tracks in parallel,
+// see AudioMixer::setHelperThreads().  0 (the default) mixes serially.
+// af.mixer.group_resample enables AudioMixer::setResampleGrouping() (default false).
+static void configureAudioMixer(AudioMixer* mixer)
+{
+    const int32_t helperThreads = property_get_int32("af.mixer.helper_threads", 0);
+    mixer->setHelperThreads(helperThreads > 0 ? (uint32_t) helperThreads : 0);
+    mixer->setResampleGrouping(property_get_bool("af.mixer.group_resample", false));
+}
+
+// ----------------------------------------------------------------------------
+
+// Dumps the statistics of a reader of a Pipe, see PipeReader::getStats().
+static void dumpPipeReader(int fd, const char *name, const PipeReader *reader)
+{
+    PipeReader::Stats stats;
+    reader->getStats(&stats);
+    dprintf(fd, "  %s: %s, %zu frames read, %zu unread, %zu lost in %zu overruns\n", name,
+            reader->policy() == PipeReader::BLOCKING ? "blocking" : "non-blocking",
+            stats.mFramesRead, stats.mFramesUnread, stats.mFramesOverrun, stats.mOverruns);
+    if (stats.mLatencyNs >= 0) {
+        dprintf(fd, "    latency: %.2f ms, max %.2f ms\n",
+                stats.mLatencyNs * 1e-6, stats.mMaxLatencyNs * 1e-6);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 #ifdef ADD_BATTERY_DATA
 // To collect the amplifier usage
 static void addBatteryData(uint32_t params) {
@@ -848,12 +890,20 @@ void AudioFlinger::ThreadBase::dumpBase(int fd, const Vector<String16>& args __u
     dprintf(fd, "  Output device: %#x (%s)\n", mOutDevice, devicesToString(mOutDevice).string());
     dprintf(fd, "  Input device: %#x (%s)\n", mInDevice, devicesToString(mInDevice).string());
     dprintf(fd, "  Audio source: %d (%s)\n", mAudioSource, sourceToString(mAudioSource));
+    mCycleStats.dump(fd);
 
     if (locked) {
         mLock.unlock();
     }
 }
 
+void AudioFlinger::ThreadBase::getCycleStats(ThreadCycleStats::Snapshot *snapshot) const
+{
+    mCycleStats.getSnapshot(snapshot);
+    snapshot->mIoHandle = mId;
+    snapshot->mThreadType = mType;
+}
+
 void AudioFlinger::ThreadBase::dumpEffectChains(int fd, const Vector<String16>& args)
 {
     const size_t SIZE = 256;
@@ -1429,7 +1479,9 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
                                              type_t type,
                                              bool systemReady)
     :   ThreadBase(audioFlinger, id, device, AUDIO_DEVICE_NONE, type, systemReady),
-        mNormalFrameCount(0), mSinkBuffer(NULL),
+        mNormalFrameCount(0),
+        mBatchWakes(false), mMinWakeIntervalNs(0),
+        mSinkBuffer(NULL),
         mMixerBufferEnabled(AudioFlinger::kEnableExtendedPrecision),
         mMixerBuffer(NULL),
         mMixerBufferSize(0),
@@ -1455,6 +1507,7 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         mDrainSequence(0),
         mSignalPending(false),
         mScreenState(AudioFlinger::mScreenState),
+        mPipeSinkScreenOnFrames(0),
         // index 0 is reserved for normal mixer's submix
         mFastTrackAvailMask(((1 << FastMixerState::kMaxFastTracks) - 1) & ~1),
         mHwSupportsPause(false), mHwPaused(false), mFlushPending(false),
@@ -1803,6 +1856,11 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
         }
         mTracks.add(track);
 
+        // fast tracks are released by the fast mixer, which wakes their clients itself
+        if (mBatchWakes && !track->isFastTrack()) {
+            track->setDeferWake(true, mMinWakeIntervalNs);
+        }
+
         sp<EffectChain> chain = getEffectChain_l(sessionId);
         if (chain != 0) {
             ALOGV("createTrack_l() setting main buffer %p", chain->inBuffer());
@@ -1845,6 +1903,20 @@ uint32_t AudioFlinger::PlaybackThread::latency_l() const
     }
 }
 
+nsecs_t AudioFlinger::PlaybackThread::nextFramePresentationTime_l() const
+{
+    if (mLatchQValid && mNormalSink != 0) {
+        const AudioTimestamp& timestamp = mLatchQ.mTimestamp;
+        const int32_t pendingFrames =
+                (int32_t) ((uint32_t) mNormalSink->framesWritten() - timestamp.mPosition);
+        if (pendingFrames >= 0) {
+            return timestamp.mTime.tv_sec * 1000000000LL + timestamp.mTime.tv_nsec +
+                    (nsecs_t) pendingFrames * 1000000000 / mSampleRate;
+        }
+    }
+    return systemTime() + (nsecs_t) latency_l() * 1000000;
+}
+
 void AudioFlinger::PlaybackThread::setMasterVolume(float value)
 {
     Mutex::Autolock _l(mLock);
@@ -2433,7 +2505,7 @@ ssize_t AudioFlinger::PlaybackThread::threadLoop_write()
             MonoPipe *pipe = (MonoPipe *)mPipeSink.get();
             if (pipe != NULL) {
                 pipe->setAvgFrames((mScreenState & 1) ?
-                        (pipe->maxFrames() * 7) / 8 : mNormalFrameCount * 2);
+                        (pipe->maxFrames() * 7) / 8 : mPipeSinkScreenOnFrames);
             }
         }
         ssize_t framesWritten = mNormalSink->write((char *)mSinkBuffer + offset, count);
@@ -2742,6 +2814,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
     while (!exitPending())
     {
         cpuStats.sample(myName);
+        mCycleStats.cycle();
 
         Vector< sp<EffectChain> > effectChains;
 
@@ -2795,6 +2868,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                 mWakeLockUids.clear();
                 mActiveTracksGeneration++;
                 ALOGV("wait async completion");
+                mCycleStats.pause();
                 mWaitWorkCV.wait(mLock);
                 ALOGV("async completion/wake");
                 if (released) {
@@ -2830,6 +2904,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     mActiveTracksGeneration++;
                     // wait until we have something to do...
                     ALOGV("%s going to sleep", myName.string());
+                    mCycleStats.pause();
                     mWaitWorkCV.wait(mLock);
                     ALOGV("%s waking up", myName.string());
                     acquireWakeLock_l();
@@ -2957,6 +3032,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     nsecs_t delta = now - mLastWriteTime;
                     if (delta > maxPeriod) {
                         mNumDelayedWrites++;
+                        mCycleStats.underrun();
                         if ((now - lastWarning) > kWarningThrottleNs) {
                             ATRACE_NAME("underrun");
                             ALOGW("write blocked for %llu msecs, %d delayed writes, thread %p",
@@ -3009,6 +3085,15 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             }
         }
 
+        // Issue the client wakeups deferred while mixing, all at once
+        if (!mTracksToWake.isEmpty()) {
+            const nsecs_t now = systemTime();
+            for (size_t i = 0; i < mTracksToWake.size(); i++) {
+                mTracksToWake[i]->flushWake(now);
+            }
+            mTracksToWake.clear();
+        }
+
         // Finally let go of removed track(s), without the lock held
         // since we can't guarantee the destructors won't acquire that
         // same lock.  This will also mutate and push a new fast mixer state.
@@ -3054,6 +3139,11 @@ void AudioFlinger::PlaybackThread::removeTracks_l(const Vector< sp<Track> >& tra
             mWakeLockUids.remove(track->uid());
             mActiveTracksGeneration++;
             ALOGV("removeTracks_l removing track on session %d", track->sessionId());
+            if (mBatchWakes) {
+                // the track is no longer mixed, so a wakeup held back by the minimum
+                // interval would stay pending
+                track->flushWake(systemTime(), true /*force*/);
+            }
             sp<EffectChain> chain = getEffectChain_l(track->sessionId());
             if (chain != 0) {
                 ALOGV("stopping track on chain %p for session Id: %d", chain.get(),
@@ -3281,6 +3371,13 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
     mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+    configureAudioMixer(mAudioMixer);
+
+    // af.mixer.batch_wakes defers the client wakeups of normal tracks to the end of each
+    // cycle, and af.mixer.min_wake_interval_ms limits how often each client is woken.
+    mBatchWakes = property_get_bool("af.mixer.batch_wakes", false);
+    mMinWakeIntervalNs = (nsecs_t) property_get_int32("af.mixer.min_wake_interval_ms",
+            kMinWakeIntervalMs) * 1000000;
 
     if (type == DUPLICATING) {
         // The Duplicating thread uses the AudioMixer and delivers data to OutputTracks
@@ -3341,8 +3438,14 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         size_t numCounterOffers = 0;
         ssize_t index = monoPipe->negotiate(offers, 1, NULL, numCounterOffers);
         ALOG_ASSERT(index == 0);
+        // af.fast_mixer.adaptive lets the fast mixer period and the pipe fill level adapt to
+        // the load, see FastMixerTuner; af.fast_mixer.max_period_ms bounds the period.
+        mFastMixerTuner.configure(property_get_bool("af.fast_mixer.adaptive", false),
+                mFrameCount, mNormalFrameCount, monoPipe->maxFrames(), mSampleRate,
+                property_get_int32("af.fast_mixer.max_period_ms", kFastMixerMaxPeriodMs));
+        mPipeSinkScreenOnFrames = mFastMixerTuner.pipeFrames();
         monoPipe->setAvgFrames((mScreenState & 1) ?
-                (monoPipe->maxFrames() * 7) / 8 : mNormalFrameCount * 2);
+                (monoPipe->maxFrames() * 7) / 8 : mPipeSinkScreenOnFrames);
         mPipeSink = monoPipe;
 
 #ifdef TEE_SINK
@@ -3699,6 +3802,9 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
     mMixerBufferValid = false;  // mMixerBuffer has no valid data until appropriate tracks found.
     mEffectBufferValid = false; // mEffectBuffer has no valid data until tracks found.
 
+    // presentation time of the first frame of this cycle, only needed for scheduled actions
+    nsecs_t cycleTimeNs = -1;
+
     for (size_t i=0 ; i<count ; i++) {
         const sp<Track> t = mActiveTracks[i].promote();
         if (t == 0) {
@@ -3860,11 +3966,32 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
 
         {   // local variable scope to avoid goto warning
 
+        if (mBatchWakes) {
+            // the wakeups deferred while mixing this track are issued after the write
+            mTracksToWake.add(t);
+        }
+
         audio_track_cblk_t* cblk = track->cblk();
 
         // The first time a track is added we wait
         // for all its buffers to be filled before processing it
         int name = track->name();
+
+        // A track with a scheduled start is not mixed before the cycle it starts in, but
+        // keeps the output running so that the start is presented on time.
+        if (track->hasScheduledActions_l()) {
+            if (cycleTimeNs < 0) {
+                cycleTimeNs = nextFramePresentationTime_l();
+            }
+            if (!track->prepareScheduledActions_l(cycleTimeNs, mSampleRate, mNormalFrameCount)) {
+                mAudioMixer->disable(name);
+                if (mixerStatus == MIXER_IDLE) {
+                    mixerStatus = MIXER_TRACKS_ENABLED;
+                }
+                continue;
+            }
+        }
+
         // make sure that we have enough frames to mix one full buffer.
         // enforce this condition only once to enable draining the buffer in case the client
         // app does not call stop() and relies on underrun to stop:
@@ -3947,6 +4074,10 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 // do not apply ramp
                 param = AudioMixer::RAMP_VOLUME;
             }
+            // a scheduled volume change is applied by the track within the cycle
+            if (track->consumeVolumeStep()) {
+                param = AudioMixer::VOLUME;
+            }
 
             // compute volume for this track
             uint32_t vl, vr;       // in U8.24 integer format
@@ -3963,7 +4094,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 float typeVolume = mStreamTypes[track->streamType()].volume;
                 float v = masterVolume * typeVolume;
                 AudioTrackServerProxy *proxy = track->mAudioTrackServerProxy;
-                gain_minifloat_packed_t vlr = proxy->getVolumeLR();
+                gain_minifloat_packed_t vlr = track->volumeLR_l();
                 vlf = float_from_gain(gain_minifloat_unpack_left(vlr));
                 vrf = float_from_gain(gain_minifloat_unpack_right(vlr));
                 // track volumes come from shared memory, so can't be trusted and must be clamped
@@ -4154,6 +4285,21 @@ track_is_ready: ;
 
     }
 
+    // Adapt the fast mixer period and the pipe fill level to the load, if enabled
+    if (state != NULL && mFastMixerTuner.update(mFastMixerDumpState, state->mTrackMask > 1)) {
+        const size_t periodFrames = mFastMixerTuner.periodFrames();
+        if (state->mFrameCount != periodFrames) {
+            state->mFrameCount = periodFrames;
+            didModify = true;
+        }
+        mPipeSinkScreenOnFrames = mFastMixerTuner.pipeFrames();
+        if (!(mScreenState & 1)) {
+            ((MonoPipe *)mPipeSink.get())->setAvgFrames(mPipeSinkScreenOnFrames);
+        }
+        mNBLogWriter->logf("fast mixer period %zu frames, pipe fill %zu frames",
+                periodFrames, mPipeSinkScreenOnFrames);
+    }
+
     // Push the new FastMixer state if necessary
     bool pauseAudioWatchdog = false;
     if (didModify) {
@@ -4201,13 +4347,21 @@ track_is_ready: ;
     // remove all the tracks that need to be...
     removeTracks_l(*tracksToRemove);
 
-    if (getEffectChain_l(AUDIO_SESSION_OUTPUT_MIX) != 0) {
+    // The output mix is only routed through the effect buffer if an effect processes it:
+    // with idle effects only, the mix goes straight to the sink buffer, which saves the
+    // conversion to and from the 16 bit effect buffer.  The output stage chain, if any,
+    // always processes the effect buffer.
+    chain = getEffectChain_l(AUDIO_SESSION_OUTPUT_MIX);
+    if (chain != 0 && (chain->isProcessEnabled() ||
+            getEffectChain_l(AUDIO_SESSION_OUTPUT_STAGE) != 0)) {
         mEffectBufferValid = true;
     }
+    chain.clear();
 
-    if (mEffectBufferValid) {
-        // as long as there are effects we should clear the effects buffer, to avoid
-        // passing a non-clean buffer to the effect chain
+    // As long as there are effects we should clear the effects buffer, to avoid
+    // passing a non-clean buffer to the effect chain, unless the copy of the mixer buffer
+    // will overwrite it before the effects are processed.
+    if (mEffectBufferValid && !(mMixerBufferValid && mBytesRemaining == 0)) {
         memset(mEffectBuffer, 0, mEffectBufferSize);
     }
     // sink or mix buffer must be cleared if all tracks are connected to an
@@ -4359,6 +4513,7 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
             readOutputParameters_l();
             delete mAudioMixer;
             mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+            configureAudioMixer(mAudioMixer);
             for (size_t i = 0; i < mTracks.size() ; i++) {
                 int name = getTrackName_l(mTracks[i]->mChannelMask,
                         mTracks[i]->mFormat, mTracks[i]->mSessionId);
@@ -4394,10 +4549,15 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
     PlaybackThread::dumpInternals(fd, args);
     dprintf(fd, "  Thread throttle time (msecs): %u\n", mThreadThrottleTimeMs);
     dprintf(fd, "  AudioMixer tracks: 0x%08x\n", mAudioMixer->trackNames());
+    if (mBatchWakes) {
+        dprintf(fd, "  Batched client wakeups, min interval %.1f ms\n",
+                mMinWakeIntervalNs / 1000000.0);
+    }
 
     // Make a non-atomic copy of fast mixer dump state so it won't change underneath us
     const FastMixerDumpState copy(mFastMixerDumpState);
     copy.dump(fd);
+    mFastMixerTuner.dump(fd);
 
 #ifdef STATE_QUEUE_DUMP
     // Similar for state queue
@@ -5294,6 +5454,14 @@ AudioFlinger::DuplicatingThread::DuplicatingThread(const sp<AudioFlinger>& audio
                     systemReady, DUPLICATING),
         mWaitTimeMs(UINT_MAX)
 {
+    if (property_get_bool("af.duplicating.fanout", false)) {
+        mFanOutPipe = new Pipe(kFanOutPipePeriods * mNormalFrameCount,
+                Format_from_SR_C(mSampleRate, mChannelCount, mFormat));
+        const NBAIO_Format offers[1] = {mFanOutPipe->format()};
+        size_t numCounterOffers = 0;
+        ssize_t index = mFanOutPipe->negotiate(offers, 1, NULL, numCounterOffers);
+        ALOG_ASSERT(index == 0);
+    }
     addOutputTrack(mainThread);
 }
 
@@ -5344,13 +5512,64 @@ void AudioFlinger::DuplicatingThread::threadLoop_sleepTime()
 
 ssize_t AudioFlinger::DuplicatingThread::threadLoop_write()
 {
+    if (mFanOutPipe != 0) {
+        // one copy to the pipe for all the outputs in fan-out mode
+        waitForFanOutRoom(writeFrames);
+        if (writeFrames != 0) {
+            mFanOutPipe->write(mSinkBuffer, writeFrames);
+        }
+    }
     for (size_t i = 0; i < outputTracks.size(); i++) {
-        outputTracks[i]->write(mSinkBuffer, writeFrames);
+        if (outputTracks[i]->isFanOut()) {
+            outputTracks[i]->written(writeFrames);
+        } else {
+            outputTracks[i]->write(mSinkBuffer, writeFrames);
+        }
     }
     mStandby = false;
     return (ssize_t)mSinkBufferSize;
 }
 
+// Waits up to waitTimeMs() until the OutputTracks in fan-out mode have less than their
+// frame count unread, as OutputTrack::write() waits for room in the track buffer.
+// The track buffer can be filled exactly, whereas the frames are written to the pipe a cycle
+// at a time, so up to frames - 1 more can be unread afterwards; addOutputTrack() sizes for that.
+// On timeout the slowest outputs overrun, instead of write() queueing overflow buffers.
+void AudioFlinger::DuplicatingThread::waitForFanOutRoom(size_t frames)
+{
+    if (frames == 0 || mWaitTimeMs == UINT_MAX) {
+        return;
+    }
+    const nsecs_t deadline = systemTime() + milliseconds(mWaitTimeMs);
+    for (;;) {
+        size_t excess = 0;
+        for (size_t i = 0; i < outputTracks.size(); i++) {
+            const sp<OutputTrack>& track = outputTracks[i];
+            if (!track->isFanOut() || !track->isActive()) {
+                continue;
+            }
+            const size_t unread = track->framesUnread();
+            if (unread >= track->frameCount() && unread - track->frameCount() + 1 > excess) {
+                excess = unread - track->frameCount() + 1;
+            }
+        }
+        if (excess == 0) {
+            return;
+        }
+        const nsecs_t now = systemTime();
+        if (now >= deadline) {
+            ALOGV("waitForFanOutRoom() %p timed out, %zu frames in excess", this, excess);
+            return;
+        }
+        // the time for the slowest output to mix the frames in excess, at our sample rate
+        nsecs_t sleepNs = (nsecs_t) excess * 1000000000LL / mSampleRate;
+        if (sleepNs > deadline - now) {
+            sleepNs = deadline - now;
+        }
+        usleep((sleepNs + 999) / 1000);
+    }
+}
+
 void AudioFlinger::DuplicatingThread::threadLoop_standby()
 {
     // DuplicatingThread implements standby by stopping all tracks
@@ -5381,13 +5600,20 @@ void AudioFlinger::DuplicatingThread::addOutputTrack(MixerThread *thread)
     // from different OutputTracks and their associated MixerThreads (e.g. one may
     // nearly empty and the other may be dropping data).
 
+    // In fan-out mode the pipe must hold the track frame count plus the cycle being written.
+    sp<Pipe> pipe = mFanOutPipe;
+    if (pipe != 0 && frameCount + mNormalFrameCount > pipe->maxFrames()) {
+        ALOGW("addOutputTrack() thread %p period too long for fan-out, copying to it", thread);
+        pipe.clear();
+    }
     sp<OutputTrack> outputTrack = new OutputTrack(thread,
                                             this,
                                             mSampleRate,
                                             mFormat,
                                             mChannelMask,
                                             frameCount,
-                                            IPCThreadState::self()->getCallingUid());
+                                            IPCThreadState::self()->getCallingUid(),
+                                            pipe);
     if (outputTrack->cblk() != NULL) {
         thread->setStreamVolume(AUDIO_STREAM_PATCH, 1.0f);
         mOutputTracks.add(outputTrack);
@@ -5455,6 +5681,21 @@ uint32_t AudioFlinger::DuplicatingThread::activeSleepTimeUs() const
     return (mWaitTimeMs * 1000) / 2;
 }
 
+void AudioFlinger::DuplicatingThread::dumpInternals(int fd, const Vector<String16>& args)
+{
+    MixerThread::dumpInternals(fd, args);
+
+    dprintf(fd, "  Fan-out: %s\n", mFanOutPipe != 0 ? "yes" : "no");
+    for (size_t i = 0; i < mOutputTracks.size(); i++) {
+        const PipeReader *reader = mOutputTracks[i]->pipeReader();
+        if (reader != NULL) {
+            sp<ThreadBase> thread = mOutputTracks[i]->thread().promote();
+            String8 name = String8::format("Output thread %p pipe", thread.get());
+            dumpPipeReader(fd, name.string(), reader);
+        }
+    }
+}
+
 void AudioFlinger::DuplicatingThread::cacheParameters_l()
 {
     // updateWaitTime_l() sets mWaitTimeMs, which affects activeSleepTimeUs(), so call it first
@@ -5545,6 +5786,9 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
         ssize_t index = pipe->negotiate(offers, 1, NULL, numCounterOffers);
         ALOG_ASSERT(index == 0);
         mPipeSink = pipe;
+        // Not BLOCKING: fast clients read the pipe memory directly, and we stop reading
+        // while no normal track is active, so holding FastCapture back for us would
+        // starve them.
         PipeReader *pipeReader = new PipeReader(*pipe);
         numCounterOffers = 0;
         index = pipeReader->negotiate(offers, 1, NULL, numCounterOffers);
@@ -5656,6 +5900,8 @@ reacquire_wakelock:
 
     // loop while there is work to do
     for (;;) {
+        mCycleStats.cycle();
+
         Vector< sp<EffectChain> > effectChains;
 
         // sleep with mutex unlocked
@@ -5694,6 +5940,7 @@ reacquire_wakelock:
                 releaseWakeLock_l();
                 ALOGV("RecordThread: loop stopping");
                 // go to sleep
+                mCycleStats.pause();
                 mWaitWorkCV.wait(mLock);
                 ALOGV("RecordThread: loop starting");
                 goto reacquire_wakelock;
@@ -5976,6 +6223,7 @@ reacquire_wakelock:
             switch (overrun) {
             case OVERRUN_TRUE:
                 // client isn't retrieving buffers fast enough
+                mCycleStats.overrun();
                 if (!activeTrack->setOverflow()) {
                     nsecs_t now = systemTime();
                     // FIXME should lastWarning per track?
@@ -6373,6 +6621,11 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
     dprintf(fd, "  Fast capture thread: %s\n", hasFastCapture() ? "yes" : "no");
     dprintf(fd, "  Fast track available: %s\n", mFastTrackAvail ? "yes" : "no");
 
+    // the normal capture reads from the fast capture through the pipe
+    if (mPipeSource != 0) {
+        dumpPipeReader(fd, "Fast capture pipe", static_cast<PipeReader *>(mPipeSource.get()));
+    }
+
     //  Make a non-atomic copy of fast capture dump state so it won't change underneath us
     const FastCaptureDumpState copy(mFastCaptureDumpState);
     copy.dump(fd);
@@ -43,6 +43,8 @@ public:
 
     void dumpBase(int fd, const Vector<String16>& args);
     void dumpEffectChains(int fd, const Vector<String16>& args);
+    // Copies the cycle statistics of the thread, can be called from any thread without lock.
+    void getCycleStats(ThreadCycleStats::Snapshot *snapshot) const;
 
     void clearPowerManager();
 
@@ -457,6 +459,8 @@ protected:
                 static const size_t     kLogSize = 4 * 1024;
                 sp<NBLog::Writer>       mNBLogWriter;
                 bool                    mSystemReady;
+                // written by the thread itself without lock, see ThreadCycleStats
+                ThreadCycleStats        mCycleStats;
 };
 
 // --- PlaybackThread ---
@@ -510,6 +514,11 @@ protected:
     virtual     mixer_state prepareTracks_l(Vector< sp<Track> > *tracksToRemove) = 0;
                 void        removeTracks_l(const Vector< sp<Track> >& tracksToRemove);
 
+                // Returns the expected presentation time of the next frame written to the
+                // normal sink, from the latched timestamp, or from the latency before the
+                // first timestamp
+                nsecs_t     nextFramePresentationTime_l() const;
+
                 void        writeCallback();
                 void        resetWriteBlocked(uint32_t sequence);
                 void        drainCallback();
@@ -621,6 +630,13 @@ protected:
     uint32_t                        mThreadThrottleEndMs;  // notify once per throttling
     uint32_t                        mHalfBufferMs;       // half the buffer size in milliseconds
 
+    // Batched client wakeups, set by the MixerThread: the normal tracks defer their client
+    // wakeups (see ServerProxy::setDeferWake()), prepareTracks_l() collects the tracks mixed
+    // in the cycle, and the thread loop issues their pending wakeups together after the write.
+    bool                            mBatchWakes;
+    nsecs_t                         mMinWakeIntervalNs;  // for each track, at most
+    Vector< sp<Track> >             mTracksToWake;       // only used by the thread loop
+
     void*                           mSinkBuffer;         // frame size aligned sink buffer
 
     // TODO:
@@ -825,6 +841,8 @@ private:
     sp<NBAIO_Source>        mTeeSource;
 #endif
     uint32_t                mScreenState;   // cached copy of gScreenState
+    // mPipeSink fill level while the screen is on, set by the MixerThread
+    size_t                  mPipeSinkScreenOnFrames;
     static const size_t     kFastMixerLogSize = 4 * 1024;
     sp<NBLog::Writer>       mFastMixerNBLogWriter;
 public:
@@ -907,6 +925,9 @@ private:
                 // accessible only within the threadLoop(), no locks required
                 //          mFastMixer->sq()    // for mutating and pushing state
                 int32_t     mFastMixerFutex;    // for cold idle
+                // adapts the fast mixer period and the MonoPipe fill level,
+                // dumped without lock
+                FastMixerTuner mFastMixerTuner;
 
 public:
     virtual     bool        hasFastMixer() const { return mFastMixer != 0; }
@@ -1035,6 +1056,7 @@ protected:
 
 private:
                 bool        outputsReady(const SortedVector< sp<OutputTrack> > &outputTracks);
+                void        waitForFanOutRoom(size_t frames);
 protected:
     // threadLoop snippets
     virtual     void        threadLoop_mix();
@@ -1042,6 +1064,7 @@ protected:
     virtual     ssize_t     threadLoop_write();
     virtual     void        threadLoop_standby();
     virtual     void        cacheParameters_l();
+    virtual     void        dumpInternals(int fd, const Vector<String16>& args);
 
 private:
     // called from threadLoop, addOutputTrack, removeOutputTrack
@@ -1054,6 +1077,9 @@ private:
                 uint32_t    mWaitTimeMs;
     SortedVector < sp<OutputTrack> >  outputTracks;
     SortedVector < sp<OutputTrack> >  mOutputTracks;
+    // If not 0 (af.duplicating.fanout), the sink buffer is written once per cycle to this pipe,
+    // and the OutputTracks in fan-out mode read it in place, see OutputTrack::written().
+    sp<Pipe>                          mFanOutPipe;
 public:
     virtual     bool        hasFastMixer() const { return false; }
 };
@@ -362,6 +362,12 @@ void AudioFlinger::TrackHandle::signal()
     return mTrack->signal();
 }
 
+status_t AudioFlinger::TrackHandle::scheduleAction(int action, bool atPosition, int64_t when,
+        float left, float right)
+{
+    return mTrack->scheduleAction(action, atPosition, when, left, right);
+}
+
 status_t AudioFlinger::TrackHandle::onTransact(
     uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags)
 {
@@ -403,9 +409,24 @@ AudioFlinger::PlaybackThread::Track::Track(
     mCachedVolume(1.0),
     mIsInvalid(false),
     mAudioTrackServerProxy(NULL),
+    mScheduleBuffer(NULL),
+    mScheduleBufferSilent(false),
+    mStartSilenceFrames(0),
+    mStopArmed(false),
+    mStopPosition(0),
+    mStopReached(false),
+    mVolumeSwitching(false),
+    mVolumeSwitchPosition(0),
+    mSwitchVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY),
+    mVolumeStep(false),
+    mVolumeOverride(false),
+    mOverrideVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY),
+    mOverriddenVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY),
     mResumeToStopping(false),
     mFlushHwPending(false)
 {
+    memset(mScheduledActions, 0, sizeof(mScheduledActions));
+
     // client == 0 implies sharedBuffer == 0
     ALOG_ASSERT(!(client == 0 && sharedBuffer != 0));
 
@@ -459,6 +480,7 @@ AudioFlinger::PlaybackThread::Track::~Track()
     if (mSharedBuffer != 0) {
         mSharedBuffer.clear();
     }
+    free(mScheduleBuffer);
 }
 
 status_t AudioFlinger::PlaybackThread::Track::initCheck() const
@@ -486,6 +508,10 @@ void AudioFlinger::PlaybackThread::Track::destroy()
         sp<ThreadBase> thread = mThread.promote();
         if (thread != 0) {
             Mutex::Autolock _l(thread->mLock);
+            // a terminated track applies no scheduled action
+            for (size_t i = 0; i < kScheduledActions; i++) {
+                mScheduledActions[i].mPending = false;
+            }
             PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
             wasActive = playbackThread->destroyTrack_l(this);
         }
@@ -596,17 +622,61 @@ status_t AudioFlinger::PlaybackThread::Track::getNextBuffer(
 {
     ServerProxy::Buffer buf;
     size_t desiredFrames = buffer->frameCount;
+    // scheduled actions, see prepareScheduledActions_l()
+    if (mStartSilenceFrames > 0) {
+        if (desiredFrames > mStartSilenceFrames) {
+            desiredFrames = mStartSilenceFrames;
+        }
+        if (desiredFrames > kScheduleBufferFrames) {
+            desiredFrames = kScheduleBufferFrames;
+        }
+        memset(mScheduleBuffer, 0, desiredFrames * mFrameSize);
+        mScheduleBufferSilent = true;
+        buffer->frameCount = desiredFrames;
+        buffer->raw = mScheduleBuffer;
+        return NO_ERROR;
+    }
+    const uint32_t position = mAudioTrackServerProxy->framesReleased();
+    if (mStopArmed) {
+        const int32_t remaining = (int32_t) (mStopPosition - position);
+        if (remaining <= 0) {
+            buffer->frameCount = 0;
+            buffer->raw = NULL;
+            return NOT_ENOUGH_DATA;
+        }
+        if (desiredFrames > (size_t) remaining) {
+            desiredFrames = remaining;
+        }
+    }
+    if (mVolumeSwitching && desiredFrames > kScheduleBufferFrames) {
+        desiredFrames = kScheduleBufferFrames;
+    }
+
     buf.mFrameCount = desiredFrames;
     status_t status = mServerProxy->obtainBuffer(&buf);
     buffer->frameCount = buf.mFrameCount;
     buffer->raw = buf.mRaw;
     if (buf.mFrameCount == 0) {
         mAudioTrackServerProxy->tallyUnderrunFrames(desiredFrames);
+    } else if (mVolumeSwitching) {
+        applyVolumeSwitch(buf.mRaw, buf.mFrameCount, position);
+        buffer->raw = mScheduleBuffer;
     }
     return status;
 }
 
-// releaseBuffer() is not overridden
+void AudioFlinger::PlaybackThread::Track::releaseBuffer(AudioBufferProvider::Buffer* buffer)
+{
+    if (mScheduleBufferSilent) {
+        // the silence before a scheduled start is not from the client
+        mScheduleBufferSilent = false;
+        mStartSilenceFrames -= buffer->frameCount;
+        buffer->frameCount = 0;
+        buffer->raw = NULL;
+        return;
+    }
+    TrackBase::releaseBuffer(buffer);
+}
 
 // ExtendedAudioBufferProvider interface
 
@@ -615,6 +685,10 @@ status_t AudioFlinger::PlaybackThread::Track::getNextBuffer(
 // Proxy->releaseBuffer(). Also note there is no mutual exclusion in the
 // AudioTrackServerProxy so be especially careful calling with FastTracks.
 size_t AudioFlinger::PlaybackThread::Track::framesReady() const {
+    if (mStopReached) {
+        // the frames after a scheduled stop are not played
+        return 0;
+    }
     if (mSharedBuffer != 0 && (isStopped() || isStopping())) {
         // Static tracks return zero frames immediately upon stopping (for FastTracks).
         // The remainder of the buffer is not drained.
@@ -673,6 +747,8 @@ status_t AudioFlinger::PlaybackThread::Track::start(AudioSystem::sync_event_t ev
         track_state state = mState;
         // here the track could be either new, or restarted
         // in both cases "unstop" the track
+        mStopReached = false;
+        mAudioTrackServerProxy->setStopped(false);
 
         // initial state-stopping. next state-pausing.
         // What if resume is called ?
@@ -732,6 +808,9 @@ void AudioFlinger::PlaybackThread::Track::stop()
     sp<ThreadBase> thread = mThread.promote();
     if (thread != 0) {
         Mutex::Autolock _l(thread->mLock);
+        // an explicit stop cancels the scheduled start and stop
+        mScheduledActions[IAudioTrack::SCHEDULE_START].mPending = false;
+        mScheduledActions[IAudioTrack::SCHEDULE_STOP].mPending = false;
         track_state state = mState;
         if (state == RESUMING || state == ACTIVE || state == PAUSING || state == PAUSED) {
             // If the track is not active (PAUSED and buffers full), flush buffers
@@ -775,6 +854,8 @@ void AudioFlinger::PlaybackThread::Track::pause()
             // fall through...
         case ACTIVE:
         case RESUMING:
+            // the track resumes when told to, not at the scheduled start
+            mScheduledActions[IAudioTrack::SCHEDULE_START].mPending = false;
             mState = PAUSING;
             ALOGV("ACTIVE/RESUMING => PAUSING (%d) on thread %p", mName, thread.get());
             playbackThread->broadcast_l();
@@ -823,6 +904,8 @@ void AudioFlinger::PlaybackThread::Track::flush()
                     mState != PAUSED && mState != PAUSING && mState != IDLE && mState != FLUSHED) {
                 return;
             }
+            // a flush cancels the scheduled start, as stop() does
+            mScheduledActions[IAudioTrack::SCHEDULE_START].mPending = false;
             // No point remaining in PAUSED state after a flush => go to
             // FLUSHED state
             mState = FLUSHED;
@@ -1116,6 +1199,252 @@ void AudioFlinger::PlaybackThread::Track::resumeAck() {
         mResumeToStopping = false;
     }
 }
+
+void AudioFlinger::PlaybackThread::Track::setDeferWake(bool defer, nsecs_t minIntervalNs)
+{
+    // Holding back a wakeup for more than a quarter of the buffer could starve the client
+    // of small buffers, whatever the interval requested for the thread.
+    if (mSampleRate > 0) {
+        const nsecs_t quarterBufferNs = (nsecs_t) mFrameCount * 1000000000 / (4 * mSampleRate);
+        if (minIntervalNs > quarterBufferNs) {
+            minIntervalNs = quarterBufferNs;
+        }
+    }
+    mAudioTrackServerProxy->setDeferWake(defer, minIntervalNs);
+}
+
+status_t AudioFlinger::PlaybackThread::Track::scheduleAction(int action, bool atPosition,
+        int64_t when, float left, float right)
+{
+    // only the normal mixer applies scheduled actions
+    if (isFastTrack() || isOffloaded() || isDirect() || isTimedTrack()) {
+        return INVALID_OPERATION;
+    }
+    if (action < 0 || action >= (int) kScheduledActions) {
+        return BAD_VALUE;
+    }
+    if (when == IAudioTrack::kCancelScheduledAction) {
+        sp<ThreadBase> thread = mThread.promote();
+        if (thread == 0) {
+            return DEAD_OBJECT;
+        }
+        Mutex::Autolock _l(thread->mLock);
+        mScheduledActions[action].mPending = false;
+        return NO_ERROR;
+    }
+    if (action == IAudioTrack::SCHEDULE_START &&
+            (atPosition || when - systemTime() > IAudioTrack::kMaxScheduledStartDelayNs)) {
+        // the position of a track does not advance until it starts, and the output is kept
+        // running until the start
+        return BAD_VALUE;
+    }
+    if (action == IAudioTrack::SCHEDULE_VOLUME &&
+            !(left >= GAIN_FLOAT_ZERO && left <= GAIN_FLOAT_UNITY &&
+              right >= GAIN_FLOAT_ZERO && right <= GAIN_FLOAT_UNITY)) {
+        return BAD_VALUE;
+    }
+    sp<ThreadBase> thread = mThread.promote();
+    if (thread == 0) {
+        return DEAD_OBJECT;
+    }
+    if (thread->type() != ThreadBase::MIXER && thread->type() != ThreadBase::DUPLICATING) {
+        return INVALID_OPERATION;
+    }
+
+    Mutex::Autolock _l(thread->mLock);
+    if (action == IAudioTrack::SCHEDULE_START && (mState == ACTIVE || mState == RESUMING)) {
+        return INVALID_OPERATION;
+    }
+    if (mScheduleBuffer == NULL) {
+        mScheduleBuffer = malloc(kScheduleBufferFrames * mFrameSize);
+        if (mScheduleBuffer == NULL) {
+            return NO_MEMORY;
+        }
+    }
+    ScheduledAction& scheduled = mScheduledActions[action];
+    scheduled.mPending = true;
+    scheduled.mAtPosition = atPosition;
+    scheduled.mWhen = atPosition ? (int64_t) (uint32_t) when : when;
+    scheduled.mLeft = left;
+    scheduled.mRight = right;
+    ALOGV("scheduleAction(%d) action %d at %s %lld", mName, action,
+            atPosition ? "position" : "time", (long long) when);
+    return NO_ERROR;
+}
+
+bool AudioFlinger::PlaybackThread::Track::hasScheduledActions_l() const
+{
+    for (size_t i = 0; i < kScheduledActions; i++) {
+        if (mScheduledActions[i].mPending) {
+            return true;
+        }
+    }
+    // the state of the mixer is cleared after an explicit stop
+    return mStopArmed || mVolumeSwitching;
+}
+
+bool AudioFlinger::PlaybackThread::Track::prepareScheduledActions_l(nsecs_t cycleTimeNs,
+        uint32_t sampleRate, size_t cycleFrames)
+{
+    const uint32_t position = mAudioTrackServerProxy->framesReleased();
+    uint32_t trackSampleRate = mAudioTrackServerProxy->getSampleRate();
+    if (trackSampleRate == 0) {
+        trackSampleRate = sampleRate;
+    }
+    // frames of the track played per ns of output
+    const double framesPerNs = trackSampleRate *
+            mAudioTrackServerProxy->getPlaybackRate().mSpeed / 1000000000.0;
+    const nsecs_t cycleNs = (nsecs_t) cycleFrames * 1000000000 / sampleRate;
+    const int32_t cycleTrackFrames = (int32_t) (cycleNs * framesPerNs) + 1;
+
+    // A start is applied by playing silence until its time, within the cycle it falls in.
+    // Only a track that is started is held back: pause(), flush(), stop() and destroy()
+    // cancel the start, and a track in any other state is handled as usual.
+    ScheduledAction& start = mScheduledActions[IAudioTrack::SCHEDULE_START];
+    if (start.mPending && (mState == ACTIVE || mState == RESUMING) && !isTerminated()) {
+        const nsecs_t delayNs = start.mWhen - cycleTimeNs;
+        if (delayNs >= cycleNs) {
+            return false;
+        }
+        start.mPending = false;
+        mStartSilenceFrames = delayNs > 0 ? (size_t) (delayNs * framesPerNs) : 0;
+        ALOGV("scheduled start(%d) after %zu frames", mName, mStartSilenceFrames);
+    }
+
+    // The actions scheduled at a time are given the position of the frame presented at that
+    // time once it falls in this cycle.  The position is exact for tracks that are not
+    // resampled; otherwise it is off by up to the frames held by the resampler.
+    for (int i = IAudioTrack::SCHEDULE_STOP; i <= IAudioTrack::SCHEDULE_VOLUME; i++) {
+        ScheduledAction& action = mScheduledActions[i];
+        if (action.mPending && !action.mAtPosition) {
+            const nsecs_t delayNs = action.mWhen - cycleTimeNs;
+            if (delayNs < cycleNs) {
+                size_t frames = delayNs > 0 ? (size_t) (delayNs * framesPerNs) : 0;
+                frames = frames > mStartSilenceFrames ? frames - mStartSilenceFrames : 0;
+                action.mAtPosition = true;
+                action.mWhen = (uint32_t) (position + frames);
+            }
+        }
+    }
+
+    // A stop is applied by not providing the frames from its position on.
+    ScheduledAction& stop = mScheduledActions[IAudioTrack::SCHEDULE_STOP];
+    mStopArmed = false;
+    if (stop.mPending && stop.mAtPosition) {
+        if ((int32_t) ((uint32_t) stop.mWhen - position) > 0) {
+            mStopArmed = true;
+            mStopPosition = (uint32_t) stop.mWhen;
+        } else {
+            stop.mPending = false;
+            stopScheduled_l();
+        }
+    }
+
+    // A volume change within the cycle is applied by mixing the cycle at the higher of the
+    // two volumes, and scaling the frames before and after the change to their volume.
+    ScheduledAction& volume = mScheduledActions[IAudioTrack::SCHEDULE_VOLUME];
+    mVolumeSwitching = false;
+    if (volume.mPending && volume.mAtPosition) {
+        const int32_t ahead = (int32_t) ((uint32_t) volume.mWhen - position);
+        if (ahead < cycleTrackFrames) {
+            const gain_minifloat_packed_t oldVolumeLR = volumeLR_l();
+            const gain_minifloat_packed_t newVolumeLR = gain_minifloat_pack(
+                    gain_from_float(volume.mLeft), gain_from_float(volume.mRight));
+            float oldVolume[2], newVolume[2];
+            oldVolume[0] = fminf(float_from_gain(gain_minifloat_unpack_left(oldVolumeLR)),
+                    GAIN_FLOAT_UNITY);
+            oldVolume[1] = fminf(float_from_gain(gain_minifloat_unpack_right(oldVolumeLR)),
+                    GAIN_FLOAT_UNITY);
+            newVolume[0] = float_from_gain(gain_minifloat_unpack_left(newVolumeLR));
+            newVolume[1] = float_from_gain(gain_minifloat_unpack_right(newVolumeLR));
+            // A stereo track is scaled per channel; other tracks only by a common gain.
+            const bool scalable = (mFormat == AUDIO_FORMAT_PCM_16_BIT ||
+                    mFormat == AUDIO_FORMAT_PCM_FLOAT) && (mChannelCount == 2 ||
+                    (oldVolume[0] == oldVolume[1] && newVolume[0] == newVolume[1]));
+            if (ahead > 0 && scalable) {
+                mSwitchVolumeLR = gain_minifloat_pack(
+                        gain_from_float(fmaxf(oldVolume[0], newVolume[0])),
+                        gain_from_float(fmaxf(oldVolume[1], newVolume[1])));
+                const float switchVolume[2] = {
+                    float_from_gain(gain_minifloat_unpack_left(mSwitchVolumeLR)),
+                    float_from_gain(gain_minifloat_unpack_right(mSwitchVolumeLR)),
+                };
+                for (int i = 0; i < 2; i++) {
+                    mGainBefore[i] = switchVolume[i] > 0 ?
+                            fminf(oldVolume[i] / switchVolume[i], 1.0f) : 0;
+                    mGainAfter[i] = switchVolume[i] > 0 ?
+                            fminf(newVolume[i] / switchVolume[i], 1.0f) : 0;
+                }
+                mVolumeSwitching = true;
+                mVolumeSwitchPosition = (uint32_t) volume.mWhen;
+            } else {
+                // the change is due, or is applied at the start of this cycle
+                volume.mPending = false;
+                mVolumeOverride = true;
+                mOverrideVolumeLR = newVolumeLR;
+                mOverriddenVolumeLR = mAudioTrackServerProxy->getVolumeLR();
+            }
+            mVolumeStep = true;
+        }
+    }
+    return true;
+}
+
+void AudioFlinger::PlaybackThread::Track::stopScheduled_l()
+{
+    ALOGV("scheduled stop(%d) at %u", mName, mStopPosition);
+    mStopReached = true;
+    if (mState == RESUMING || mState == ACTIVE || mState == PAUSING || mState == PAUSED) {
+        // as stop() for a normal mixer track: prepareTracks_l() removes the track from the
+        // active list, once its last frames are presented
+        mState = STOPPED;
+        // the client is not told of the stop, and would wait forever for room to write
+        mAudioTrackServerProxy->setStopped(true);
+    }
+}
+
+gain_minifloat_packed_t AudioFlinger::PlaybackThread::Track::volumeLR_l()
+{
+    const gain_minifloat_packed_t vlr = mAudioTrackServerProxy->getVolumeLR();
+    if (mVolumeSwitching) {
+        return mSwitchVolumeLR;
+    }
+    if (mVolumeOverride) {
+        if (vlr == mOverriddenVolumeLR) {
+            return mOverrideVolumeLR;
+        }
+        // the client has set a new volume since, which replaces the scheduled one
+        mVolumeOverride = false;
+    }
+    return vlr;
+}
+
+void AudioFlinger::PlaybackThread::Track::applyVolumeSwitch(const void *src, size_t frameCount,
+        uint32_t position)
+{
+    // frames before the switch
+    int32_t before = (int32_t) (mVolumeSwitchPosition - position);
+    if (before < 0) {
+        before = 0;
+    } else if ((size_t) before > frameCount) {
+        before = frameCount;
+    }
+    const uint32_t channelCount = mChannelCount;
+    for (size_t i = 0; i < frameCount; i++) {
+        const float *gain = (int32_t) i < before ? mGainBefore : mGainAfter;
+        for (uint32_t c = 0; c < channelCount; c++) {
+            // all channels of a track that is not stereo have the same gain
+            const float g = gain[c == 1 ? 1 : 0];
+            const size_t sample = i * channelCount + c;
+            if (mFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                ((float *) mScheduleBuffer)[sample] = ((const float *) src)[sample] * g;
+            } else {
+                ((int16_t *) mScheduleBuffer)[sample] =
+                        (int16_t) (((const int16_t *) src)[sample] * g);
+            }
+        }
+    }
+}
 // ----------------------------------------------------------------------------
 
 sp<AudioFlinger::PlaybackThread::TimedTrack>
@@ -1645,14 +1974,23 @@ AudioFlinger::PlaybackThread::OutputTrack::OutputTrack(
             audio_format_t format,
             audio_channel_mask_t channelMask,
             size_t frameCount,
-            int uid)
+            int uid,
+            const sp<Pipe>& pipe)
     :   Track(playbackThread, NULL, AUDIO_STREAM_PATCH,
               sampleRate, format, channelMask, frameCount,
               NULL, 0, 0, uid, IAudioFlinger::TRACK_DEFAULT, TYPE_OUTPUT),
-    mActive(false), mSourceThread(sourceThread), mClientProxy(NULL)
+    mActive(false), mSourceThread(sourceThread), mClientProxy(NULL), mPipe(pipe)
 {
 
     if (mCblk != NULL) {
+        if (mPipe != 0) {
+            // the reader only sees frames written to the pipe from now on
+            mPipeReader = new PipeReader(*mPipe.get());
+            const NBAIO_Format offers[1] = {mPipe->format()};
+            size_t numCounterOffers = 0;
+            ssize_t index = mPipeReader->negotiate(offers, 1, NULL, numCounterOffers);
+            ALOG_ASSERT(index == 0);
+        }
         mOutBuffer.frameCount = 0;
         playbackThread->mTracks.add(this);
         ALOGV("OutputTrack constructor mCblk %p, mBuffer %p, "
@@ -1675,6 +2013,8 @@ AudioFlinger::PlaybackThread::OutputTrack::~OutputTrack()
 {
     clearBufferQueue();
     delete mClientProxy;
+    // detach from the pipe before releasing our reference to it
+    mPipeReader.clear();
     // superclass destructor will now delete the server proxy and shared memory both refer to
 }
 
@@ -1797,6 +2137,78 @@ bool AudioFlinger::PlaybackThread::OutputTrack::write(void* data, uint32_t frame
     return outputBufferFull;
 }
 
+void AudioFlinger::PlaybackThread::OutputTrack::written(uint32_t frames)
+{
+    ALOG_ASSERT(mPipeReader != 0, "OutputTrack::written() called without pipe");
+    if (!mActive && frames != 0) {
+        (void) start();
+    }
+
+    // Calling written() with 0 frames means that no more data will be written, as for write().
+    if (frames == 0 && mActive) {
+        stop();
+    }
+}
+
+size_t AudioFlinger::PlaybackThread::OutputTrack::framesUnread() const
+{
+    return mPipeReader != 0 ? mPipeReader->framesUnread() : 0;
+}
+
+status_t AudioFlinger::PlaybackThread::OutputTrack::getNextBuffer(
+        AudioBufferProvider::Buffer* buffer, int64_t pts)
+{
+    if (mPipeReader == 0) {
+        return Track::getNextBuffer(buffer, pts);
+    }
+    // The frames are read in place from the pipe shared with the other outputs of the
+    // DuplicatingThread, so they must not be modified.
+    size_t desiredFrames = buffer->frameCount;
+    ssize_t frames = mPipeReader->obtain(&buffer->raw, desiredFrames);
+    if (frames == (ssize_t) OVERRUN) {
+        // the reader skipped ahead, the frames from there on are valid
+        frames = mPipeReader->obtain(&buffer->raw, desiredFrames);
+    }
+    if (frames <= 0) {
+        buffer->raw = NULL;
+        buffer->frameCount = 0;
+        mAudioTrackServerProxy->tallyUnderrunFrames(desiredFrames);
+        return NOT_ENOUGH_DATA;
+    }
+    buffer->frameCount = frames;
+    return NO_ERROR;
+}
+
+void AudioFlinger::PlaybackThread::OutputTrack::releaseBuffer(
+        AudioBufferProvider::Buffer* buffer)
+{
+    if (mPipeReader == 0) {
+        Track::releaseBuffer(buffer);
+        return;
+    }
+    mPipeReader->release(buffer->frameCount);
+    buffer->frameCount = 0;
+    buffer->raw = NULL;
+}
+
+size_t AudioFlinger::PlaybackThread::OutputTrack::framesReady() const {
+    if (mPipeReader == 0) {
+        return Track::framesReady();
+    }
+    // Frames lost to an overrun are only skipped by the next getNextBuffer(),
+    // as this may be called from other threads than the one mixing the track.
+    size_t frames = mPipeReader->framesUnread();
+    return frames < mPipe->maxFrames() ? frames : mPipe->maxFrames();
+}
+
+size_t AudioFlinger::PlaybackThread::OutputTrack::framesReleased() const
+{
+    if (mPipeReader == 0) {
+        return Track::framesReleased();
+    }
+    return mPipeReader->framesRead();
+}
+
 status_t AudioFlinger::PlaybackThread::OutputTrack::obtainBuffer(
         AudioBufferProvider::Buffer* buffer, uint32_t waitTimeMs)
 {
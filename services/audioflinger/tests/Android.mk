@@ -25,6 +25,48 @@ LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_NATIVE_TEST)
 
+#
+# timestretcher unit test
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libutils \
+	libcutils
+
+LOCAL_C_INCLUDES := \
+	frameworks/av/services/audioflinger
+
+LOCAL_SRC_FILES := \
+	timestretcher_tests.cpp \
+	../AudioTimestretcher.cpp
+
+LOCAL_MODULE := timestretcher_tests
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_NATIVE_TEST)
+
+#
+# scheduled track actions unit test
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+	libmedia \
+	libaudioutils \
+	libcutils \
+	libutils \
+	liblog
+
+LOCAL_SRC_FILES := \
+	scheduled_actions_tests.cpp
+
+LOCAL_MODULE := scheduled_actions_tests
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_NATIVE_TEST)
+
 #
 # audio mixer test tool
 #
@@ -33,6 +75,7 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES:= \
 	test-mixer.cpp \
 	../AudioMixer.cpp.arm \
+	../AudioTimestretcher.cpp \
 	../BufferProviders.cpp
 
 LOCAL_C_INCLUDES := \
@@ -63,3 +106,66 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_CXX_STL := libc++
 
 include $(BUILD_EXECUTABLE)
+
+#
+# audio mixer benchmark tool
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	mixer_benchmark.cpp \
+	../AudioMixer.cpp.arm \
+	../AudioTimestretcher.cpp \
+	../BufferProviders.cpp
+
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils) \
+	frameworks/av/services/audioflinger \
+	external/sonic
+
+LOCAL_STATIC_LIBRARIES := \
+	libsndfile
+
+LOCAL_SHARED_LIBRARIES := \
+	libeffects \
+	libnbaio \
+	libcommon_time_client \
+	libaudioresampler \
+	libaudioutils \
+	libdl \
+	libcutils \
+	libutils \
+	liblog \
+	libsonic
+
+LOCAL_MODULE:= mixer-benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CXX_STL := libc++
+
+include $(BUILD_EXECUTABLE)
+
+#
+# track client wakeup benchmark tool
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	track_wake_benchmark.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libmedia \
+	libaudioutils \
+	libcutils \
+	libutils \
+	liblog
+
+LOCAL_MODULE:= track-wake-benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CXX_STL := libc++
+
+include $(BUILD_EXECUTABLE)
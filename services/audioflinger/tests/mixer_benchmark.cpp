@@ -0,0 +1,739 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <math.h>
+#include <malloc.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <audio_utils/primitives.h>
+#include <media/AudioBufferProvider.h>
+#include <sonic.h>
+#include "AudioMixer.h"
+#include "AudioResampler.h"
+#include "AudioTimestretcher.h"
+#include "test_utils.h"
+
+/* Offline benchmark of the AudioMixer and AudioResampler.
+ *
+ * The mixer sweep covers track count, track channel mask, input and mixer formats
+ * (pcm16 and float) and the track rate: no conversion, resampling from 44.1 kHz,
+ * or time stretching at 1.5x speed.  The mixer output is stereo at 48 kHz; the
+ * resampler quality is the default, as chosen by af.resampler.quality.
+ * The resampler sweep runs each resampler quality by itself over channel count,
+ * format and conversion ratio.  The timestretch sweep compares the float time
+ * stretchers, Sonic and AudioTimestretcher, over channel count and speed.
+ *
+ * For each configuration the report gives the mean cost per output frame, the
+ * percentiles of the time taken by each process() or resample() call, and the
+ * heap memory allocated by the mixer or resampler once running (resampler filters
+ * already in the shared filter cache are not counted again).  The report is JSON,
+ * with one result per line.  Given the report of an earlier run with -b, results
+ * whose ns/frame grew by more than the allowed percentage are listed and the
+ * benchmark exits with failure, so it can gate changes before they reach devices.
+ *
+ * Example: mixer-benchmark -F mixer/in:float -o /data/local/tmp/new.json \
+ *                          -b /data/local/tmp/old.json -d 5
+ */
+
+using namespace android;
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-r] [-g] [-f frame-count] [-l loops] [-t max-tracks]"
+                    " [-F filter] [-o json-file] [-b baseline-json-file] [-d percent]\n", name);
+    fprintf(stderr, "    -r    ramp mixer volume on every process() call\n");
+    fprintf(stderr, "    -g    resample mixer tracks sharing a sample rate as a group\n");
+    fprintf(stderr, "    -f    frame count per call (default 256)\n");
+    fprintf(stderr, "    -l    number of calls per measurement (default 500)\n");
+    fprintf(stderr, "    -t    maximum number of mixer tracks, at most %u (default %u)\n",
+            AudioMixer::MAX_NUM_TRACKS, AudioMixer::MAX_NUM_TRACKS);
+    fprintf(stderr, "    -F    only run configurations whose name contains filter\n");
+    fprintf(stderr, "    -o    write the JSON report to json-file (default stdout)\n");
+    fprintf(stderr, "    -b    compare ns/frame against an earlier JSON report\n");
+    fprintf(stderr, "    -d    allowed ns/frame increase over the baseline in percent"
+                    " (default 10)\n");
+}
+
+// Reads the per-thread CPU cycle counter through perf_event_open().
+class CycleCounter {
+public:
+    CycleCounter() : mFd(-1) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        mFd = syscall(__NR_perf_event_open, &attr, 0 /*pid*/, -1 /*cpu*/,
+                -1 /*group_fd*/, 0 /*flags*/);
+    }
+
+    ~CycleCounter() {
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+
+    bool isValid() const { return mFd >= 0; }
+
+    void start() {
+        if (mFd >= 0) {
+            ioctl(mFd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(mFd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    uint64_t stop() {
+        uint64_t cycles = 0;
+        if (mFd >= 0) {
+            ioctl(mFd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(mFd, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+                cycles = 0;
+            }
+        }
+        return cycles;
+    }
+
+private:
+    int mFd;
+};
+
+static int64_t systemTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static size_t heapBytes() {
+    return mallinfo().uordblks;
+}
+
+static const char* formatName(audio_format_t format) {
+    return format == AUDIO_FORMAT_PCM_FLOAT ? "float" : "pcm16";
+}
+
+static const char* channelMaskName(audio_channel_mask_t mask) {
+    switch (mask) {
+    case AUDIO_CHANNEL_OUT_MONO:
+        return "mono";
+    case AUDIO_CHANNEL_OUT_STEREO:
+        return "stereo";
+    case AUDIO_CHANNEL_OUT_5POINT1:
+        return "5.1";
+    case AUDIO_CHANNEL_OUT_7POINT1:
+        return "7.1";
+    default:
+        return "other";
+    }
+}
+
+static const char* qualityName(AudioResampler::src_quality quality) {
+    switch (quality) {
+    case AudioResampler::LOW_QUALITY:
+        return "low";
+    case AudioResampler::MED_QUALITY:
+        return "med";
+    case AudioResampler::HIGH_QUALITY:
+        return "high";
+    case AudioResampler::VERY_HIGH_QUALITY:
+        return "very_high";
+    case AudioResampler::DYN_LOW_QUALITY:
+        return "dyn_low";
+    case AudioResampler::DYN_MED_QUALITY:
+        return "dyn_med";
+    case AudioResampler::DYN_HIGH_QUALITY:
+        return "dyn_high";
+    default:
+        return "default";
+    }
+}
+
+// Times a sequence of calls, each producing frameCount frames.
+class CallTimer {
+public:
+    CallTimer(CycleCounter& counter, size_t loops)
+        : mCounter(counter), mCycles(0), mStartNs(0) {
+        mCallNs.reserve(loops);
+    }
+
+    void start() {
+        mStartNs = systemTimeNs();
+        mCounter.start();
+    }
+
+    void stop() {
+        mCycles += mCounter.stop();
+        mCallNs.push_back(systemTimeNs() - mStartNs);
+    }
+
+    // writes one JSON result line; returns the mean ns per frame.
+    double report(FILE* out, bool& first, const std::string& name,
+            size_t frameCount, size_t heap) {
+        int64_t totalNs = 0;
+        for (size_t i = 0; i < mCallNs.size(); ++i) {
+            totalNs += mCallNs[i];
+        }
+        std::sort(mCallNs.begin(), mCallNs.end());
+        const double frames = (double)mCallNs.size() * frameCount;
+        const double nsPerFrame = totalNs / frames;
+        fprintf(out, "%s    {\"name\": \"%s\", \"ns_per_frame\": %.3f, ",
+                first ? "" : ",\n", name.c_str(), nsPerFrame);
+        if (mCounter.isValid()) {
+            fprintf(out, "\"cycles_per_frame\": %.1f, ", mCycles / frames);
+        }
+        fprintf(out, "\"p50_ns\": %" PRId64 ", \"p90_ns\": %" PRId64 ", \"p99_ns\": %" PRId64
+                ", \"max_ns\": %" PRId64 ", \"heap_bytes\": %zu}",
+                percentile(50), percentile(90), percentile(99), mCallNs.back(), heap);
+        fflush(out);
+        first = false;
+        return nsPerFrame;
+    }
+
+private:
+    int64_t percentile(size_t p) const {
+        return mCallNs[std::min(mCallNs.size() - 1, mCallNs.size() * p / 100)];
+    }
+
+    CycleCounter& mCounter;
+    std::vector<int64_t> mCallNs;
+    uint64_t mCycles;
+    int64_t mStartNs;
+};
+
+struct Options {
+    bool useRamp;
+    bool useResampleGrouping;
+    size_t frameCount;
+    size_t loops;
+    size_t maxTracks;
+    const char* filter;
+};
+
+struct Result {
+    std::string name;
+    double nsPerFrame;
+};
+
+// number of calls that can be made before a provider of frames input frames runs dry.
+static size_t loopsPerRewind(size_t frames, double inputFramesPerLoop) {
+    const size_t loops = frames / inputFramesPerLoop;
+    return loops > 1 ? loops - 1 : 1;
+}
+
+static const size_t kWarmupLoops = 10;
+static const uint32_t kSampleRate = 48000;
+
+struct MixerConfig {
+    audio_format_t inputFormat;
+    audio_format_t mixerFormat;
+    audio_channel_mask_t channelMask;
+    const char* rateName;
+    uint32_t trackSampleRate;
+    float speed;
+    size_t tracks;
+};
+
+static double benchmarkMixer(const Options& options, const MixerConfig& config,
+        const std::string& name, SignalProvider* providers, CycleCounter& counter,
+        FILE* out, bool& first)
+{
+    const size_t frameCount = options.frameCount;
+    const audio_channel_mask_t mixerChannelMask = AUDIO_CHANNEL_OUT_STEREO;
+    const size_t outputSize = frameCount * audio_channel_count_from_out_mask(mixerChannelMask)
+            * audio_bytes_per_sample(config.mixerFormat);
+    void *outputAddr = NULL;
+    (void) posix_memalign(&outputAddr, 32, outputSize);
+    memset(outputAddr, 0, outputSize);
+
+    const size_t channels = audio_channel_count_from_out_mask(config.channelMask);
+    for (size_t i = 0; i < config.tracks; ++i) {
+        const double freq = 200. + 100. * i;
+        if (config.inputFormat == AUDIO_FORMAT_PCM_FLOAT) {
+            providers[i].setSine<float>(channels, freq, config.trackSampleRate, 1. /* seconds */);
+        } else {
+            providers[i].setSine<int16_t>(channels, freq, config.trackSampleRate, 1. /* seconds */);
+        }
+    }
+    const size_t rewind = loopsPerRewind(providers[0].getNumFrames(),
+            (double)frameCount * config.trackSampleRate / kSampleRate * config.speed);
+
+    const size_t heapBefore = heapBytes();
+    AudioMixer *mixer = new AudioMixer(frameCount, kSampleRate);
+    mixer->setResampleGrouping(options.useResampleGrouping);
+    std::vector<int> names(config.tracks);
+    const float volume = AudioMixer::UNITY_GAIN_FLOAT / config.tracks;
+    const AudioPlaybackRate playbackRate = {
+        config.speed, 1.0f /* pitch */,
+        AUDIO_TIMESTRETCH_STRETCH_DEFAULT, AUDIO_TIMESTRETCH_FALLBACK_DEFAULT
+    };
+    for (size_t i = 0; i < config.tracks; ++i) {
+        int name = mixer->getTrackName(config.channelMask, config.inputFormat,
+                AUDIO_SESSION_OUTPUT_MIX);
+        ALOG_ASSERT(name >= 0);
+        names[i] = name;
+        mixer->setBufferProvider(name, &providers[i]);
+        mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER, outputAddr);
+        mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::MIXER_FORMAT,
+                (void *)(uintptr_t)config.mixerFormat);
+        mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::FORMAT,
+                (void *)(uintptr_t)config.inputFormat);
+        mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::MIXER_CHANNEL_MASK,
+                (void *)(uintptr_t)mixerChannelMask);
+        mixer->setParameter(name, AudioMixer::TRACK, AudioMixer::CHANNEL_MASK,
+                (void *)(uintptr_t)config.channelMask);
+        mixer->setParameter(name, AudioMixer::RESAMPLE, AudioMixer::SAMPLE_RATE,
+                (void *)(uintptr_t)config.trackSampleRate);
+        if (config.speed != 1.0f) {
+            mixer->setParameter(name, AudioMixer::TIMESTRETCH, AudioMixer::PLAYBACK_RATE,
+                    (void *)&playbackRate);
+        }
+        mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, (void *)&volume);
+        mixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, (void *)&volume);
+        mixer->enable(name);
+    }
+
+    CallTimer timer(counter, options.loops);
+    size_t heap = 0;
+    for (size_t loop = 0; loop < kWarmupLoops + options.loops; ++loop) {
+        if (loop % rewind == 0) {
+            for (size_t i = 0; i < config.tracks; ++i) {
+                providers[i].reset();
+            }
+        }
+        if (options.useRamp) {
+            // alternate between two volumes so that every call ramps.
+            const float target = (loop & 1) ? volume : volume * 0.5f;
+            for (size_t i = 0; i < config.tracks; ++i) {
+                mixer->setParameter(names[i], AudioMixer::RAMP_VOLUME, AudioMixer::VOLUME0,
+                        (void *)&target);
+                mixer->setParameter(names[i], AudioMixer::RAMP_VOLUME, AudioMixer::VOLUME1,
+                        (void *)&target);
+            }
+        }
+        if (loop < kWarmupLoops) {
+            mixer->process(AudioBufferProvider::kInvalidPTS);
+            // buffers are allocated as the tracks start, so measure the heap once running.
+            heap = heapBytes() - heapBefore;
+            continue;
+        }
+        timer.start();
+        mixer->process(AudioBufferProvider::kInvalidPTS);
+        timer.stop();
+    }
+    delete mixer;
+    free(outputAddr);
+
+    return timer.report(out, first, name, frameCount, heap);
+}
+
+struct ResamplerConfig {
+    AudioResampler::src_quality quality;
+    audio_format_t format;
+    uint32_t channels;
+    uint32_t inSampleRate;
+    uint32_t outSampleRate;
+};
+
+static double benchmarkResampler(const Options& options, const ResamplerConfig& config,
+        const std::string& name, SignalProvider& provider, CycleCounter& counter,
+        FILE* out, bool& first)
+{
+    const size_t frameCount = options.frameCount;
+    if (config.format == AUDIO_FORMAT_PCM_FLOAT) {
+        provider.setSine<float>(config.channels, 1000., config.inSampleRate, 1. /* seconds */);
+    } else {
+        provider.setSine<int16_t>(config.channels, 1000., config.inSampleRate, 1. /* seconds */);
+    }
+    const size_t rewind = loopsPerRewind(provider.getNumFrames(),
+            (double)frameCount * config.inSampleRate / config.outSampleRate);
+
+    // the output is at least stereo, in int32_t or float.
+    const size_t outputSize = frameCount * std::max(config.channels, 2u) * sizeof(int32_t);
+    int32_t* output = (int32_t*)malloc(outputSize);
+
+    const size_t heapBefore = heapBytes();
+    AudioResampler* resampler = AudioResampler::create(config.format, config.channels,
+            config.outSampleRate, config.quality);
+    resampler->setSampleRate(config.inSampleRate);
+    resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+
+    CallTimer timer(counter, options.loops);
+    size_t heap = 0;
+    for (size_t loop = 0; loop < kWarmupLoops + options.loops; ++loop) {
+        if (loop % rewind == 0) {
+            provider.reset();
+        }
+        // resample() accumulates into the output.
+        memset(output, 0, outputSize);
+        if (loop < kWarmupLoops) {
+            resampler->resample(output, frameCount, &provider);
+            heap = heapBytes() - heapBefore;
+            continue;
+        }
+        timer.start();
+        resampler->resample(output, frameCount, &provider);
+        timer.stop();
+    }
+    delete resampler;
+    free(output);
+
+    return timer.report(out, first, name, frameCount, heap);
+}
+
+struct TimestretchConfig {
+    bool sonic;     // Sonic, otherwise AudioTimestretcher
+    uint32_t channels;
+    float speed;
+};
+
+static double benchmarkTimestretch(const Options& options, const TimestretchConfig& config,
+        const std::string& name, CycleCounter& counter, FILE* out, bool& first)
+{
+    const size_t frameCount = options.frameCount;
+    const uint32_t channels = config.channels;
+    // one second of input, a tone per channel, read cyclically.
+    const size_t inputFrames = kSampleRate;
+    std::vector<float> input(inputFrames * channels);
+    for (size_t i = 0; i < inputFrames; ++i) {
+        for (uint32_t c = 0; c < channels; ++c) {
+            input[i * channels + c] = 0.5f * sinf(2. * M_PI * 300. * (c + 1) * i / kSampleRate);
+        }
+    }
+    std::vector<float> output(frameCount * channels);
+
+    const size_t heapBefore = heapBytes();
+    sonicStream stream = NULL;
+    AudioTimestretcher* stretcher = NULL;
+    if (config.sonic) {
+        stream = sonicCreateStream(kSampleRate, channels);
+        sonicSetSpeed(stream, config.speed);
+    } else {
+        stretcher = new AudioTimestretcher(channels, kSampleRate);
+        stretcher->setSpeed(config.speed);
+    }
+
+    CallTimer timer(counter, options.loops);
+    size_t heap = 0;
+    size_t position = 0;
+    double fraction = 0.;
+    for (size_t loop = 0; loop < kWarmupLoops + options.loops; ++loop) {
+        // feed the input for one call worth of output, as TimestretchBufferProvider does.
+        fraction += frameCount * config.speed;
+        size_t frames = (size_t)fraction;
+        fraction -= frames;
+        const bool timed = loop >= kWarmupLoops;
+        if (timed) {
+            timer.start();
+        }
+        while (frames > 0) {
+            const size_t chunk = std::min(frames, inputFrames - position);
+            const float* in = &input[position * channels];
+            if (config.sonic) {
+                sonicWriteFloatToStream(stream, (float*)in, chunk);
+            } else {
+                stretcher->write(in, chunk);
+            }
+            position = (position + chunk) % inputFrames;
+            frames -= chunk;
+        }
+        if (config.sonic) {
+            sonicReadFloatFromStream(stream, &output[0], frameCount);
+        } else {
+            stretcher->read(&output[0], frameCount);
+        }
+        if (timed) {
+            timer.stop();
+        } else {
+            heap = heapBytes() - heapBefore;
+        }
+    }
+    if (config.sonic) {
+        sonicDestroyStream(stream);
+    } else {
+        delete stretcher;
+    }
+
+    return timer.report(out, first, name, frameCount, heap);
+}
+
+// Reads the name and ns_per_frame of each result line of a report written by this program.
+static bool readBaseline(const char* file, std::vector<Result>& baseline) {
+    FILE* in = fopen(file, "r");
+    if (in == NULL) {
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char name[256];
+        double nsPerFrame;
+        const char* p = strstr(line, "{\"name\": \"");
+        if (p != NULL && sscanf(p, "{\"name\": \"%255[^\"]\", \"ns_per_frame\": %lf",
+                name, &nsPerFrame) == 2) {
+            Result result;
+            result.name = name;
+            result.nsPerFrame = nsPerFrame;
+            baseline.push_back(result);
+        }
+    }
+    fclose(in);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    Options options;
+    options.useRamp = false;
+    options.useResampleGrouping = false;
+    options.frameCount = 256;
+    options.loops = 500;
+    options.maxTracks = AudioMixer::MAX_NUM_TRACKS;
+    options.filter = "";
+    const char* outputFile = NULL;
+    const char* baselineFile = NULL;
+    double allowedPercent = 10.;
+
+    for (int ch; (ch = getopt(argc, argv, "rgf:l:t:F:o:b:d:")) != -1;) {
+        switch (ch) {
+        case 'r':
+            options.useRamp = true;
+            break;
+        case 'g':
+            options.useResampleGrouping = true;
+            break;
+        case 'f':
+            options.frameCount = atoi(optarg);
+            break;
+        case 'l':
+            options.loops = atoi(optarg);
+            break;
+        case 't':
+            options.maxTracks = atoi(optarg);
+            break;
+        case 'F':
+            options.filter = optarg;
+            break;
+        case 'o':
+            outputFile = optarg;
+            break;
+        case 'b':
+            baselineFile = optarg;
+            break;
+        case 'd':
+            allowedPercent = atof(optarg);
+            break;
+        case '?':
+        default:
+            usage(progname);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.frameCount == 0 || options.loops == 0 || allowedPercent < 0.
+            || options.maxTracks < 1 || options.maxTracks > AudioMixer::MAX_NUM_TRACKS) {
+        usage(progname);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Result> baseline;
+    if (baselineFile != NULL && !readBaseline(baselineFile, baseline)) {
+        fprintf(stderr, "cannot read baseline %s\n", baselineFile);
+        return EXIT_FAILURE;
+    }
+    FILE* out = stdout;
+    if (outputFile != NULL && (out = fopen(outputFile, "w")) == NULL) {
+        fprintf(stderr, "cannot write %s\n", outputFile);
+        return EXIT_FAILURE;
+    }
+
+    CycleCounter counter;
+    fprintf(out, "{\n  \"frame_count\": %zu,\n  \"loops\": %zu,\n  \"sample_rate\": %u,\n"
+            "  \"ramp\": %s,\n  \"resample_grouping\": %s,\n  \"cycle_counter\": %s,\n"
+            "  \"results\": [\n",
+            options.frameCount, options.loops, kSampleRate,
+            options.useRamp ? "true" : "false",
+            options.useResampleGrouping ? "true" : "false",
+            counter.isValid() ? "true" : "false");
+
+    std::vector<Result> results;
+    bool first = true;
+
+    static const audio_format_t kFormats[] = {
+        AUDIO_FORMAT_PCM_16_BIT,
+        AUDIO_FORMAT_PCM_FLOAT,
+    };
+    static const audio_channel_mask_t kChannelMasks[] = {
+        AUDIO_CHANNEL_OUT_MONO,
+        AUDIO_CHANNEL_OUT_STEREO,
+        AUDIO_CHANNEL_OUT_5POINT1,
+        AUDIO_CHANNEL_OUT_7POINT1,
+    };
+    static const struct {
+        const char* name;
+        uint32_t trackSampleRate;
+        float speed;
+    } kRates[] = {
+        { "none", kSampleRate, 1.0f },
+        { "resample", 44100, 1.0f },
+        { "timestretch", kSampleRate, 1.5f },
+    };
+
+    SignalProvider providers[AudioMixer::MAX_NUM_TRACKS];
+    for (size_t in = 0; in < ARRAY_SIZE(kFormats); ++in) {
+        for (size_t mix = 0; mix < ARRAY_SIZE(kFormats); ++mix) {
+            for (size_t mask = 0; mask < ARRAY_SIZE(kChannelMasks); ++mask) {
+                for (size_t rate = 0; rate < ARRAY_SIZE(kRates); ++rate) {
+                    for (size_t tracks = 1; tracks <= options.maxTracks; tracks <<= 1) {
+                        MixerConfig config;
+                        config.inputFormat = kFormats[in];
+                        config.mixerFormat = kFormats[mix];
+                        config.channelMask = kChannelMasks[mask];
+                        config.rateName = kRates[rate].name;
+                        config.trackSampleRate = kRates[rate].trackSampleRate;
+                        config.speed = kRates[rate].speed;
+                        config.tracks = tracks;
+                        char name[128];
+                        snprintf(name, sizeof(name),
+                                "mixer/in:%s/out:%s/mask:%s/rate:%s/tracks:%zu",
+                                formatName(config.inputFormat), formatName(config.mixerFormat),
+                                channelMaskName(config.channelMask), config.rateName, tracks);
+                        if (strstr(name, options.filter) == NULL) {
+                            continue;
+                        }
+                        Result result;
+                        result.name = name;
+                        result.nsPerFrame = benchmarkMixer(options, config, name, providers,
+                                counter, out, first);
+                        results.push_back(result);
+                    }
+                }
+            }
+        }
+    }
+
+    static const AudioResampler::src_quality kQualities[] = {
+        AudioResampler::LOW_QUALITY,
+        AudioResampler::MED_QUALITY,
+        AudioResampler::HIGH_QUALITY,
+        AudioResampler::VERY_HIGH_QUALITY,
+        AudioResampler::DYN_LOW_QUALITY,
+        AudioResampler::DYN_MED_QUALITY,
+        AudioResampler::DYN_HIGH_QUALITY,
+    };
+    static const uint32_t kChannelCounts[] = { 1, 2, 6, 8 };
+    static const struct {
+        uint32_t in;
+        uint32_t out;
+    } kRatios[] = {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 22050, 48000 },
+    };
+
+    for (size_t q = 0; q < ARRAY_SIZE(kQualities); ++q) {
+        // the original resamplers only take pcm16 mono or stereo.
+        const bool dynamic = kQualities[q] >= AudioResampler::DYN_LOW_QUALITY;
+        for (size_t f = 0; f < ARRAY_SIZE(kFormats); ++f) {
+            if (!dynamic && kFormats[f] != AUDIO_FORMAT_PCM_16_BIT) {
+                continue;
+            }
+            for (size_t c = 0; c < ARRAY_SIZE(kChannelCounts); ++c) {
+                if (!dynamic && kChannelCounts[c] > 2) {
+                    continue;
+                }
+                for (size_t r = 0; r < ARRAY_SIZE(kRatios); ++r) {
+                    ResamplerConfig config;
+                    config.quality = kQualities[q];
+                    config.format = kFormats[f];
+                    config.channels = kChannelCounts[c];
+                    config.inSampleRate = kRatios[r].in;
+                    config.outSampleRate = kRatios[r].out;
+                    char name[128];
+                    snprintf(name, sizeof(name),
+                            "resampler/quality:%s/format:%s/channels:%u/rate:%u-%u",
+                            qualityName(config.quality), formatName(config.format),
+                            config.channels, config.inSampleRate, config.outSampleRate);
+                    if (strstr(name, options.filter) == NULL) {
+                        continue;
+                    }
+                    Result result;
+                    result.name = name;
+                    result.nsPerFrame = benchmarkResampler(options, config, name, providers[0],
+                            counter, out, first);
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    static const float kSpeeds[] = { 0.75f, 1.5f, 2.0f };
+    for (size_t engine = 0; engine < 2; ++engine) {
+        for (size_t c = 0; c < ARRAY_SIZE(kChannelCounts); ++c) {
+            for (size_t sp = 0; sp < ARRAY_SIZE(kSpeeds); ++sp) {
+                TimestretchConfig config;
+                config.sonic = engine == 0;
+                config.channels = kChannelCounts[c];
+                config.speed = kSpeeds[sp];
+                char name[128];
+                snprintf(name, sizeof(name), "timestretch/engine:%s/channels:%u/speed:%.2f",
+                        config.sonic ? "sonic" : "wsola", config.channels, config.speed);
+                if (strstr(name, options.filter) == NULL) {
+                    continue;
+                }
+                Result result;
+                result.name = name;
+                result.nsPerFrame = benchmarkTimestretch(options, config, name, counter,
+                        out, first);
+                results.push_back(result);
+            }
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    int regressions = 0;
+    for (size_t i = 0; i < baseline.size(); ++i) {
+        for (size_t j = 0; j < results.size(); ++j) {
+            if (results[j].name == baseline[i].name) {
+                const double limit = baseline[i].nsPerFrame * (1. + allowedPercent / 100.);
+                if (results[j].nsPerFrame > limit) {
+                    fprintf(stderr, "regression: %s %.3f ns/frame, baseline %.3f ns/frame\n",
+                            results[j].name.c_str(), results[j].nsPerFrame,
+                            baseline[i].nsPerFrame);
+                    ++regressions;
+                }
+                break;
+            }
+        }
+    }
+    if (regressions > 0) {
+        fprintf(stderr, "%d of %zu results are more than %.1f%% slower than %s\n",
+                regressions, results.size(), allowedPercent, baselineFile);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
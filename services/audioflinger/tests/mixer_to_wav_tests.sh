@@ -88,6 +88,25 @@ function createwav() {
     adb pull /sdcard/tm9307gra.wav $2
     adb pull /sdcard/aux9307gra.wav $2
 
+# Test:
+# process__parallel with 3 helper threads, resampled and non-resampled tracks
+# track__Resample / track__genericResample
+# track__NoResample / track__16BitsStereo / track__16BitsMono
+    adb shell test-mixer $1 -t 3 -s 48000 \
+        -o /sdcard/tm48000par.wav \
+        sine:2,4000,7520 chirp:2,9200 sine:1,3000,18000 \
+        sine:2,6000,48000 chirp:2,48000 sine:1,300,48000
+    adb pull /sdcard/tm48000par.wav $2
+
+# Test:
+# process__genericResampling with grouped resampling of same rate tracks
+# track__ResampleGroup
+    adb shell test-mixer $1 -g -s 48000 \
+        -o /sdcard/tm48000grg.wav \
+        sine:2,4000,44100 chirp:2,44100 sine:1,3000,44100 \
+        sine:2,6000,22050 sine:1,300,22050
+    adb pull /sdcard/tm48000grg.wav $2
+
 # Test:
 # process__genericNoResampling
 # track__NoResample / track__16BitsStereo / track__16BitsMono
@@ -107,13 +126,23 @@ function createwav() {
     adb pull /sdcard/aux32000gnra.wav $2
 
 # Test:
-# process__NoResampleOneTrack / process__OneTrack16BitsStereoNoResampling
-# Downmixer
+# process__genericNoResampling
+# track__NoResampleDownmix (5.1 track to stereo)
     adb shell test-mixer $1 -s 32000 \
         -o /sdcard/tm32000nrot.wav \
         sine:6,1000,32000
     adb pull /sdcard/tm32000nrot.wav $2
 
+# Test:
+# process__genericNoResampling
+# track__NoResampleDownmix (quad, 5.1 and 7.1 tracks to stereo)
+# Aux buffer
+    adb shell test-mixer $1 -s 48000 \
+        -a /sdcard/aux48000gnrd.wav -o /sdcard/tm48000gnrd.wav \
+        sine:4,1000,48000 chirp:6,48000 sine:8,300,48000 sine:2,2000,48000
+    adb pull /sdcard/tm48000gnrd.wav $2
+    adb pull /sdcard/aux48000gnrd.wav $2
+
 # Test:
 # process__NoResampleOneTrack / OneTrack16BitsStereoNoResampling
 # Aux buffer
@@ -130,6 +159,7 @@ function createwav() {
 # i_i = integer input track, integer mixer output
 # f_f = float input track,   float mixer output
 # i_f = integer input track, float_mixer output
+#       (non-resampled integer tracks are converted to float by the track hook)
 #
 # If the mixer output is float, then the output WAV file is pcm float.
 #
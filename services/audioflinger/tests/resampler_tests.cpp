@@ -27,13 +27,18 @@
 #include <errno.h>
 #include <time.h>
 #include <math.h>
+#include <algorithm>
 #include <vector>
 #include <utility>
 #include <iostream>
 #include <cutils/log.h>
 #include <gtest/gtest.h>
 #include <media/AudioBufferProvider.h>
+#include <utils/Debug.h>
 #include "AudioResampler.h"
+#include "AudioResamplerFirOps.h"
+#include "AudioResamplerFirProcess.h"
+#include "AudioResamplerFirProcessSSE.h"
 #include "test_utils.h"
 
 void resample(int channels, void *output,
@@ -412,3 +417,191 @@ TEST(audioflinger_resampler, stopbandresponse_float_multichannel) {
     }
 }
 
+
+void resampleAll(size_t channels, bool useFloat, unsigned inputFreq, unsigned outputFreq,
+        android::AudioResampler* resampler, void** output, size_t* outputSize)
+{
+    SignalProvider provider;
+    if (useFloat) {
+        provider.setChirp<float>(channels,
+                0., outputFreq/2., outputFreq, outputFreq/2000.);
+    } else {
+        provider.setChirp<int16_t>(channels,
+                0., outputFreq/2., outputFreq, outputFreq/2000.);
+    }
+    size_t outputFrames = ((int64_t) provider.getNumFrames() * outputFreq) / inputFreq;
+    size_t outputFrameSize = channels * (useFloat ? sizeof(float) : sizeof(int32_t));
+    *outputSize = outputFrameSize * outputFrames;
+    *output = calloc(1, *outputSize);
+    std::vector<size_t> outIncr;
+    outIncr.push_back(outputFrames);
+    resample(channels, *output, outputFrames, outIncr, &provider, resampler);
+}
+
+android::AudioResampler* createResampler(size_t channels, bool useFloat,
+        unsigned inputFreq, unsigned outputFreq,
+        enum android::AudioResampler::src_quality quality)
+{
+    const audio_format_t format = useFloat ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+    android::AudioResampler* resampler =
+            android::AudioResampler::create(format, channels, outputFreq, quality);
+    resampler->setSampleRate(inputFreq);
+    resampler->setVolume(android::AudioResampler::UNITY_GAIN_FLOAT,
+            android::AudioResampler::UNITY_GAIN_FLOAT);
+    return resampler;
+}
+
+/* Resamplers doing the same conversion share one filter through the filter cache.
+ * Check that a shared filter outlives the resampler that designed it, and that
+ * resamplers created after the cache has been churned by many other conversions
+ * produce the same output.
+ */
+void testSharedFilter(bool useFloat, enum android::AudioResampler::src_quality quality)
+{
+    const size_t channels = 2;
+    const unsigned inputFreq = 22050;
+    const unsigned outputFreq = 48000;
+
+    android::AudioResampler* first =
+            createResampler(channels, useFloat, inputFreq, outputFreq, quality);
+    android::AudioResampler* second =
+            createResampler(channels, useFloat, inputFreq, outputFreq, quality);
+    void* reference;
+    size_t referenceSize;
+    resampleAll(channels, useFloat, inputFreq, outputFreq, first, &reference, &referenceSize);
+    delete first;
+
+    // design and release enough filters to evict any unused one.
+    for (unsigned rate = 8000; rate <= 96000; rate += 4000) {
+        delete createResampler(channels, useFloat, rate, outputFreq, quality);
+    }
+
+    void* test;
+    size_t testSize;
+    resampleAll(channels, useFloat, inputFreq, outputFreq, second, &test, &testSize);
+    ASSERT_EQ(referenceSize, testSize);
+    ASSERT_EQ(0, memcmp(reference, test, referenceSize));
+    free(test);
+    delete second;
+
+    android::AudioResampler* third =
+            createResampler(channels, useFloat, inputFreq, outputFreq, quality);
+    resampleAll(channels, useFloat, inputFreq, outputFreq, third, &test, &testSize);
+    ASSERT_EQ(referenceSize, testSize);
+    ASSERT_EQ(0, memcmp(reference, test, referenceSize));
+    free(test);
+    delete third;
+    free(reference);
+}
+
+TEST(audioflinger_resampler, sharedfilter) {
+    // only dynamic quality
+    static const enum android::AudioResampler::src_quality kQualityArray[] = {
+            android::AudioResampler::DYN_LOW_QUALITY,
+            android::AudioResampler::DYN_MED_QUALITY,
+            android::AudioResampler::DYN_HIGH_QUALITY,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(kQualityArray); ++i) {
+        testSharedFilter(false, kQualityArray[i]);
+        testSharedFilter(true, kQualityArray[i]);
+    }
+}
+
+
+#if USE_SSE
+/* x86 SIMD kernel test
+ *
+ * Compares the SSE4.1 and AVX2 Process() kernels against the scalar ProcessBase()
+ * reference over random coefficients, samples and phases.  The kernels round
+ * differently from the scalar code, so a small relative tolerance is allowed.
+ */
+template <typename T>
+static T randomValue(double scale)
+{
+    return static_cast<T>((rand() / (double)RAND_MAX * 2. - 1.) * scale);
+}
+
+// TINTERP is the phase fraction type: Q15 or Q31 in a uint32_t, or float.
+template <int CHANNELS, bool FIXED, typename TC, typename TI, typename TO, typename TINTERP>
+void testSimdKernel(int level, double coefScale, double sampleScale, double lerpScale,
+        double tolerance)
+{
+    const int count = 16; // half the filter length, a multiple of 8
+    TC* coefs = NULL;
+    ASSERT_EQ(0, posix_memalign(reinterpret_cast<void**>(&coefs), 32, 4 * count * sizeof(TC)));
+    std::vector<TI> samples((4 * count + 1) * CHANNELS);
+    TO volumeLR[2] __attribute__ ((aligned (8)));
+    if (android::is_same<TO, float>::value) {
+        volumeLR[0] = 1.;
+        volumeLR[1] = 0.5;
+    } else {
+        volumeLR[0] = 0x10000000; // U4_28 unity gain
+        volumeLR[1] = 0x08000000;
+    }
+
+    double maxDiff = 0.;
+    double maxRef = 0.;
+    for (int trial = 0; trial < 100; ++trial) {
+        for (int i = 0; i < 4 * count; ++i) {
+            coefs[i] = randomValue<TC>(coefScale);
+        }
+        for (size_t i = 0; i < samples.size(); ++i) {
+            samples[i] = randomValue<TI>(sampleScale);
+        }
+        // adjacent polyphases are count coefficients apart, as set up by fir().
+        const TC* coefsP = coefs;
+        const TC* coefsP1 = coefsP + count;
+        const TC* coefsN = coefs + 2 * count;
+        const TC* coefsN1 = coefsN + count;
+        const TI* sP = &samples[2 * count * CHANNELS];
+        const TI* sN = sP + CHANNELS;
+        const TINTERP lerpP = FIXED ? 0 : rand() / ((double)RAND_MAX + 1.) * lerpScale;
+
+        TO ref[2] = {0, 0};
+        TO test[2] = {0, 0};
+        if (FIXED) {
+            android::ProcessBase<CHANNELS, 16, android::InterpNull>(ref, count,
+                    coefsP, coefsN, sP, sN, lerpP, volumeLR);
+        } else {
+            android::ProcessBase<CHANNELS, 16, android::InterpCompute>(ref, count,
+                    coefsP, coefsN, sP, sN, lerpP, volumeLR);
+        }
+        if (level == android::RESAMPLER_SIMD_AVX2) {
+            android::ProcessAVX2Intrinsic<CHANNELS, 16, FIXED>(test, count,
+                    coefsP, coefsN, sP, sN, volumeLR, lerpP, coefsP1, coefsN1);
+        } else {
+            android::ProcessSSEIntrinsic<CHANNELS, 16, FIXED>(test, count,
+                    coefsP, coefsN, sP, sN, volumeLR, lerpP, coefsP1, coefsN1);
+        }
+        for (int i = 0; i < 2; ++i) {
+            maxDiff = std::max(maxDiff, fabs((double)ref[i] - (double)test[i]));
+            maxRef = std::max(maxRef, fabs((double)ref[i]));
+        }
+    }
+    free(coefs);
+    ASSERT_GT(maxRef, 0.);
+    ASSERT_LE(maxDiff, maxRef * tolerance);
+}
+
+template <int CHANNELS, bool FIXED>
+void testSimdKernels(int level)
+{
+    testSimdKernel<CHANNELS, FIXED, int16_t, int16_t, int32_t, uint32_t>(
+            level, 4096., 16384., 1 << 15, 1e-3);
+    testSimdKernel<CHANNELS, FIXED, int32_t, int16_t, int32_t, uint32_t>(
+            level, 1 << 27, 16384., 1U << 31, 1e-4);
+    testSimdKernel<CHANNELS, FIXED, float, float, float, float>(
+            level, 0.1, 1., 1., 1e-5);
+}
+
+TEST(audioflinger_resampler, simdkernels_x86) {
+    for (int level = android::RESAMPLER_SIMD_SSE41;
+            level <= android::gResamplerSimdLevel; ++level) {
+        testSimdKernels<1, true>(level);
+        testSimdKernels<2, true>(level);
+        testSimdKernels<1, false>(level);
+        testSimdKernels<2, false>(level);
+    }
+}
+#endif
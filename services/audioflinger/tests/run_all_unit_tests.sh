@@ -9,3 +9,5 @@ echo "waiting for device"
 adb root && adb wait-for-device remount
 
 adb shell /system/bin/resampler_tests
+adb shell /system/bin/timestretcher_tests
+adb shell /system/bin/scheduled_actions_tests
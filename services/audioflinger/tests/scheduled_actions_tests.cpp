@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_scheduled_actions_tests"
+
+#include <new>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+#include <cutils/atomic.h>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+#include <media/AudioSystem.h>
+#include <media/AudioTrack.h>
+#include <private/media/AudioTrackShared.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+static const size_t kFrameSize = 2 * sizeof(int16_t);
+
+// ----------------------------------------------------------------------------
+// The control block of a track, shared by a client and a server proxy in process.
+
+struct ProxyPair {
+    explicit ProxyPair(size_t frameCount) {
+        const size_t size = sizeof(audio_track_cblk_t) + frameCount * kFrameSize;
+        void *memory = calloc(1, size);
+        mCblk = new (memory) audio_track_cblk_t();
+        void *buffers = (char *) memory + sizeof(audio_track_cblk_t);
+        mClient = new AudioTrackClientProxy(mCblk, buffers, frameCount, kFrameSize,
+                true /*clientInServer*/);
+        mServer = new AudioTrackServerProxy(mCblk, buffers, frameCount, kFrameSize,
+                true /*clientInServer*/, 48000);
+    }
+
+    ~ProxyPair() {
+        mClient.clear();
+        mServer.clear();
+        free(mCblk);
+    }
+
+    // Writes frames as AudioTrack::write() does, returns the status of the last obtainBuffer()
+    status_t write(size_t frames, const struct timespec *requested) {
+        while (frames > 0) {
+            Proxy::Buffer buffer;
+            buffer.mFrameCount = frames;
+            status_t status = mClient->obtainBuffer(&buffer, requested);
+            if (status != NO_ERROR) {
+                return status;
+            }
+            memset(buffer.mRaw, 0, buffer.mFrameCount * kFrameSize);
+            frames -= buffer.mFrameCount;
+            mClient->releaseBuffer(&buffer);
+        }
+        return NO_ERROR;
+    }
+
+    audio_track_cblk_t          *mCblk;
+    sp<AudioTrackClientProxy>   mClient;
+    sp<AudioTrackServerProxy>   mServer;
+};
+
+struct BlockedWrite {
+    ProxyPair   *mProxies;
+    status_t    mStatus;
+};
+
+static void *blockedWriteThread(void *arg)
+{
+    BlockedWrite *write = (BlockedWrite *) arg;
+    write->mStatus = write->mProxies->write(1, &ClientProxy::kForever);
+    return NULL;
+}
+
+/* A scheduled stop releases a client waiting for room in a full buffer, and later
+ * writes do not wait, until the track restarts.
+ */
+TEST(audioflinger_scheduled_actions, stopreleasesblockedwriter) {
+    const size_t frameCount = 1024;
+    ProxyPair proxies(frameCount);
+    ASSERT_EQ(NO_ERROR, proxies.write(frameCount, &ClientProxy::kNonBlocking));
+
+    BlockedWrite write;
+    write.mProxies = &proxies;
+    write.mStatus = NO_ERROR;
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, blockedWriteThread, &write));
+    usleep(50000);  // let the client wait
+
+    proxies.mServer->setStopped(true);
+    pthread_join(thread, NULL);
+    EXPECT_EQ(WOULD_BLOCK, write.mStatus);
+    EXPECT_EQ(WOULD_BLOCK, proxies.write(1, &ClientProxy::kForever));
+
+    // room is still handed out
+    Proxy::Buffer buffer;
+    buffer.mFrameCount = 256;
+    ASSERT_EQ(NO_ERROR, proxies.mServer->obtainBuffer(&buffer));
+    proxies.mServer->releaseBuffer(&buffer);
+    EXPECT_EQ(NO_ERROR, proxies.write(256, &ClientProxy::kForever));
+
+    // restarted, a full buffer makes the client wait again
+    proxies.mServer->setStopped(false);
+    ASSERT_EQ(WOULD_BLOCK, proxies.write(1, &ClientProxy::kNonBlocking));
+    const struct timespec timeout = { 0, 20000000 };
+    EXPECT_EQ(TIMED_OUT, proxies.write(1, &timeout));
+}
+
+// ----------------------------------------------------------------------------
+// The actions applied by the mixer, on an AudioTrack at the output sample rate, so that
+// the frames are not resampled and the positions are exact.
+
+class ScheduledActionsTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        ASSERT_EQ(NO_ERROR, AudioSystem::getOutputSamplingRate(&mSampleRate,
+                AUDIO_STREAM_MUSIC));
+        mTrack = new AudioTrack(AUDIO_STREAM_MUSIC, mSampleRate, AUDIO_FORMAT_PCM_16_BIT,
+                AUDIO_CHANNEL_OUT_STEREO, mSampleRate /*frameCount: 1 s*/);
+        ASSERT_EQ(NO_ERROR, mTrack->initCheck());
+        // a quiet tone, so that the buffer is not taken for silence
+        mData.resize(mSampleRate * 2);
+        for (size_t i = 0; i < mData.size(); ++i) {
+            mData[i] = (i / 2) % 64 < 32 ? 64 : -64;
+        }
+    }
+
+    virtual void TearDown() {
+        if (mTrack != 0) {
+            mTrack->stop();
+            mTrack.clear();
+        }
+    }
+
+    // Fills the buffer of the stopped track, which does not block.
+    void fill() {
+        ASSERT_GT(mTrack->write(&mData[0], mData.size() * sizeof(int16_t), false /*blocking*/),
+                0);
+    }
+
+    // Returns the time the first frame of the track was presented, from its timestamp,
+    // waiting until the track has played for at least waitNs.
+    nsecs_t firstFrameTime(nsecs_t waitNs) {
+        usleep(waitNs / 1000);
+        AudioTimestamp timestamp;
+        for (int i = 0; i < 100 && (mTrack->getTimestamp(timestamp) != NO_ERROR
+                || timestamp.mPosition == 0); ++i) {
+            usleep(10000);
+        }
+        EXPECT_GT(timestamp.mPosition, 0u);
+        return timestamp.mTime.tv_sec * 1000000000LL + timestamp.mTime.tv_nsec
+                - (nsecs_t) timestamp.mPosition * 1000000000LL / mSampleRate;
+    }
+
+    uint32_t            mSampleRate;
+    sp<AudioTrack>      mTrack;
+    std::vector<int16_t> mData;
+};
+
+// A timestamp is only latched once per mix cycle, and may lag by the HAL's own jitter.
+static const nsecs_t kToleranceNs = 5000000;
+
+TEST_F(ScheduledActionsTest, startisontime) {
+    fill();
+    const nsecs_t startNs = systemTime() + 300000000;
+    ASSERT_EQ(NO_ERROR, mTrack->scheduleStart(startNs));
+    usleep(150000);
+    uint32_t position;
+    ASSERT_EQ(NO_ERROR, mTrack->getPosition(&position));
+    EXPECT_EQ(0u, position);    // held back until the start
+    EXPECT_NEAR(startNs, firstFrameTime(startNs + 200000000 - systemTime()), kToleranceNs);
+}
+
+TEST_F(ScheduledActionsTest, startiscancelledbypause) {
+    fill();
+    const nsecs_t startNs = systemTime() + 1000000000;
+    ASSERT_EQ(NO_ERROR, mTrack->scheduleStart(startNs));
+    mTrack->pause();
+    // resumed, the track starts playing now rather than at the scheduled start
+    ASSERT_EQ(NO_ERROR, mTrack->start());
+    EXPECT_LT(firstFrameTime(200000000), startNs - 500000000);
+}
+
+TEST_F(ScheduledActionsTest, startisbounded) {
+    fill();
+    EXPECT_EQ(BAD_VALUE, mTrack->scheduleStart(
+            systemTime() + IAudioTrack::kMaxScheduledStartDelayNs + 1000000000));
+    ASSERT_EQ(NO_ERROR, mTrack->start());
+    // the track is already started
+    EXPECT_EQ(INVALID_OPERATION, mTrack->scheduleStart(systemTime()));
+}
+
+struct Writer {
+    sp<AudioTrack>      mTrack;
+    const int16_t       *mData;
+    size_t              mSize;
+    ssize_t             mResult;    // of the last write
+    volatile bool       mDone;
+};
+
+static void *writerThread(void *arg)
+{
+    Writer *writer = (Writer *) arg;
+    do {
+        writer->mResult = writer->mTrack->write(writer->mData, writer->mSize);
+    } while (writer->mResult > 0);
+    writer->mDone = true;
+    return NULL;
+}
+
+TEST_F(ScheduledActionsTest, stopisatposition) {
+    fill();
+    const uint32_t stopPosition = mSampleRate / 2 + 123;
+    ASSERT_EQ(NO_ERROR, mTrack->start());
+    ASSERT_EQ(NO_ERROR, mTrack->scheduleStop(stopPosition, true /*atPosition*/));
+
+    // a blocking writer must be released by the stop
+    Writer writer;
+    writer.mTrack = mTrack;
+    writer.mData = &mData[0];
+    writer.mSize = mData.size() * sizeof(int16_t) / 4;
+    writer.mResult = 0;
+    writer.mDone = false;
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, writerThread, &writer));
+
+    usleep(1000000);
+    uint32_t position;
+    ASSERT_EQ(NO_ERROR, mTrack->getPosition(&position));
+    EXPECT_EQ(stopPosition, position);
+
+    for (int i = 0; i < 100 && !writer.mDone; ++i) {
+        usleep(10000);
+    }
+    EXPECT_TRUE(writer.mDone);
+    EXPECT_EQ(WOULD_BLOCK, writer.mResult);
+    if (!writer.mDone) {
+        mTrack->stop();     // interrupts the writer
+    }
+    pthread_join(thread, NULL);
+}
+
+static void moreDataCallback(int event, void *user, void *info)
+{
+    if (event != AudioTrack::EVENT_MORE_DATA) {
+        return;
+    }
+    android_atomic_inc((volatile int32_t *) user);
+    AudioTrack::Buffer *buffer = (AudioTrack::Buffer *) info;
+    for (size_t i = 0; i < buffer->size / sizeof(int16_t); ++i) {
+        buffer->i16[i] = (i / 2) % 64 < 32 ? 64 : -64;
+    }
+}
+
+// Returns the number of times the threads of the process gave up the CPU so far.
+static long contextSwitches()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw;
+}
+
+TEST_F(ScheduledActionsTest, stopidlescallbackthread) {
+    volatile int32_t moreData = 0;
+    mTrack = new AudioTrack(AUDIO_STREAM_MUSIC, mSampleRate, AUDIO_FORMAT_PCM_16_BIT,
+            AUDIO_CHANNEL_OUT_STEREO, 0 /*frameCount*/, AUDIO_OUTPUT_FLAG_NONE,
+            moreDataCallback, (void *) &moreData);
+    ASSERT_EQ(NO_ERROR, mTrack->initCheck());
+    const uint32_t stopPosition = mSampleRate / 4;
+    ASSERT_EQ(NO_ERROR, mTrack->start());
+    ASSERT_EQ(NO_ERROR, mTrack->scheduleStop(stopPosition, true /*atPosition*/));
+
+    usleep(500000);
+    uint32_t position;
+    ASSERT_EQ(NO_ERROR, mTrack->getPosition(&position));
+    EXPECT_EQ(stopPosition, position);
+
+    // the callback thread waits to be started again, rather than polling for room
+    const int32_t calls = android_atomic_acquire_load(&moreData);
+    const long switches = contextSwitches();
+    usleep(500000);
+    EXPECT_LT(contextSwitches() - switches, 50);
+    EXPECT_EQ(calls, android_atomic_acquire_load(&moreData));
+
+    // and asks for data again once restarted
+    mTrack->stop();
+    mTrack->flush();
+    ASSERT_EQ(NO_ERROR, mTrack->start());
+    usleep(200000);
+    EXPECT_GT(android_atomic_acquire_load(&moreData), calls);
+    mTrack->stop();
+    mTrack.clear();     // before moreData goes away
+}
+
+TEST_F(ScheduledActionsTest, volume) {
+    EXPECT_EQ(BAD_VALUE, mTrack->scheduleVolume(1.5f, 0.f, systemTime()));
+    EXPECT_EQ(BAD_VALUE, mTrack->scheduleVolume(0.f, -1.f, systemTime()));
+
+    fill();
+    ASSERT_EQ(NO_ERROR, mTrack->start());
+    ASSERT_EQ(NO_ERROR, mTrack->scheduleVolume(0.f, 0.f, mSampleRate / 4, true /*atPosition*/));
+    ASSERT_EQ(NO_ERROR, mTrack->scheduleVolume(0.5f, 0.5f, systemTime() + 500000000));
+    // a muted track keeps playing through the changes
+    usleep(700000);
+    uint32_t position;
+    ASSERT_EQ(NO_ERROR, mTrack->getPosition(&position));
+    EXPECT_GT(position, mSampleRate / 2);
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_timestretcher_tests"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+#include "AudioTimestretcher.h"
+
+static const uint32_t kSampleRate = 48000;
+static const float kAmplitude = 0.5f;
+
+// Channel c carries a sine at (c + 1) times the frequency.
+static void makeSine(std::vector<float> *in, uint32_t channels, size_t frames,
+        float frequency)
+{
+    in->resize(frames * channels);
+    for (size_t i = 0; i < frames; ++i) {
+        for (uint32_t c = 0; c < channels; ++c) {
+            (*in)[i * channels + c] =
+                    kAmplitude * sinf(2 * M_PI * frequency * (c + 1) * i / kSampleRate);
+        }
+    }
+}
+
+// Writes in at speeds[k] from frame switchFrames[k] on, in blocks of varying
+// size as a track would, reading the output after each block.
+static void stretch(android::AudioTimestretcher *ts, uint32_t channels,
+        const std::vector<float> &in, const std::vector<float> &speeds,
+        const std::vector<size_t> &switchFrames, std::vector<float> *out)
+{
+    const size_t frames = in.size() / channels;
+    std::vector<float> buffer(256 * channels);
+    size_t written = 0;
+    size_t next = 0;
+    while (written < frames) {
+        if (next < speeds.size() && written >= switchFrames[next]) {
+            ts->setSpeed(speeds[next++]);
+        }
+        size_t count = std::min(frames - written, (size_t)(300 + written % 77));
+        if (next < switchFrames.size()) {
+            count = std::min(count, switchFrames[next] - written);
+        }
+        ASSERT_TRUE(ts->write(&in[written * channels], count));
+        written += count;
+        size_t read;
+        while ((read = ts->read(&buffer[0], 256)) > 0) {
+            out->insert(out->end(), buffer.begin(), buffer.begin() + read * channels);
+        }
+    }
+}
+
+// Returns the frequency of channel c of buf from its zero crossings, skipping
+// the first skipFrames.
+static double measureFrequency(const std::vector<float> &buf, uint32_t channels,
+        uint32_t c, size_t skipFrames)
+{
+    const size_t frames = buf.size() / channels;
+    size_t crossings = 0;
+    for (size_t i = skipFrames + 1; i < frames; ++i) {
+        if ((buf[(i - 1) * channels + c] < 0) != (buf[i * channels + c] < 0)) {
+            ++crossings;
+        }
+    }
+    return crossings / 2. * kSampleRate / (frames - skipFrames - 1);
+}
+
+// Returns the largest difference between consecutive samples of channel c.
+static float maxStep(const std::vector<float> &buf, uint32_t channels, uint32_t c)
+{
+    const size_t frames = buf.size() / channels;
+    float step = 0.f;
+    for (size_t i = 1; i < frames; ++i) {
+        step = std::max(step, fabsf(buf[i * channels + c] - buf[(i - 1) * channels + c]));
+    }
+    return step;
+}
+
+// Returns the smallest peak of channel c over consecutive windows of
+// windowFrames, which a crossfade of segments out of phase lowers.
+static float minPeak(const std::vector<float> &buf, uint32_t channels, uint32_t c,
+        size_t windowFrames)
+{
+    const size_t frames = buf.size() / channels;
+    float peak = INFINITY;
+    for (size_t i = 0; i + windowFrames <= frames; i += windowFrames) {
+        float windowPeak = 0.f;
+        for (size_t j = i; j < i + windowFrames; ++j) {
+            windowPeak = std::max(windowPeak, fabsf(buf[j * channels + c]));
+        }
+        peak = std::min(peak, windowPeak);
+    }
+    return peak;
+}
+
+/* Stretching keeps the pitch, scales the duration by 1 / speed, and does not
+ * introduce steps larger than those of the sine itself, beyond the crossfades
+ * of slightly mismatched segments, nor dips in its level.
+ */
+TEST(audioflinger_timestretcher, lengthpitchcontinuity) {
+    static const uint32_t channelCounts[] = { 1, 2, 6 };
+    static const float speeds[] = { 0.5f, 0.75f, 1.25f, 1.5f, 2.f, 3.f };
+    const float frequency = 440.f;
+    const size_t frames = kSampleRate * 2;
+
+    for (size_t i = 0; i < sizeof(channelCounts) / sizeof(channelCounts[0]); ++i) {
+        const uint32_t channels = channelCounts[i];
+        std::vector<float> in;
+        makeSine(&in, channels, frames, frequency);
+        for (size_t j = 0; j < sizeof(speeds) / sizeof(speeds[0]); ++j) {
+            const float speed = speeds[j];
+            android::AudioTimestretcher ts(channels, kSampleRate);
+            std::vector<float> out;
+            stretch(&ts, channels, in, std::vector<float>(1, speed),
+                    std::vector<size_t>(1, 0), &out);
+            const size_t outFrames = out.size() / channels;
+            const size_t consumed = frames - ts.inputFramesQueued();
+
+            // the output is the consumed input at the speed, within one frame
+            // per segment of rounding.
+            EXPECT_NEAR(consumed / speed, outFrames, 0.001 * outFrames)
+                    << "channels " << channels << " speed " << speed;
+            // all but the input held for the next segment is consumed.
+            EXPECT_LT(ts.inputFramesQueued(), kSampleRate / 2);
+
+            for (uint32_t c = 0; c < channels; c += channels - 1) {
+                const float f = frequency * (c + 1);
+                EXPECT_NEAR(f, measureFrequency(out, channels, c, kSampleRate / 10),
+                        0.01 * f) << "channels " << channels << " speed " << speed;
+                const float sineStep = kAmplitude * 2 * M_PI * f / kSampleRate;
+                EXPECT_LT(maxStep(out, channels, c), 1.5f * sineStep)
+                        << "channels " << channels << " speed " << speed;
+                EXPECT_GT(minPeak(out, channels, c, kSampleRate / f + 1), 0.9f * kAmplitude)
+                        << "channels " << channels << " speed " << speed;
+                if (channels == 1) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* At normal speed the input passes through unchanged, and the stretcher tells
+ * its caller once the frames may be copied directly.
+ */
+TEST(audioflinger_timestretcher, unityspeed) {
+    const uint32_t channels = 2;
+    const size_t frames = kSampleRate;
+    std::vector<float> in;
+    makeSine(&in, channels, frames, 440.f);
+
+    android::AudioTimestretcher ts(channels, kSampleRate);
+    EXPECT_TRUE(ts.isPassthrough());
+    std::vector<float> out;
+    stretch(&ts, channels, in, std::vector<float>(1, 1.f), std::vector<size_t>(1, 0), &out);
+    ASSERT_EQ(in.size(), out.size());
+    EXPECT_TRUE(in == out);
+    EXPECT_TRUE(ts.isPassthrough());
+
+    // slower, then back to normal speed.
+    std::vector<float> speeds;
+    speeds.push_back(0.75f);
+    speeds.push_back(1.f);
+    std::vector<size_t> switchFrames;
+    switchFrames.push_back(0);
+    switchFrames.push_back(frames / 2);
+    out.clear();
+    stretch(&ts, channels, in, speeds, switchFrames, &out);
+    EXPECT_TRUE(ts.isPassthrough());
+    EXPECT_EQ(0u, ts.inputFramesQueued());
+
+    // after the crossfade the output is the input, from the offset matched.
+    const size_t tailFrames = frames / 4;
+    const std::vector<float> tail(out.end() - tailFrames * channels, out.end());
+    EXPECT_TRUE(std::equal(tail.begin(), tail.end(), in.end() - tailFrames * channels));
+    for (uint32_t c = 0; c < channels; ++c) {
+        const float sineStep = kAmplitude * 2 * M_PI * 440.f * (c + 1) / kSampleRate;
+        EXPECT_LT(maxStep(out, channels, c), 1.5f * sineStep);
+        EXPECT_GT(minPeak(out, channels, c, kSampleRate / (440.f * (c + 1)) + 1),
+                0.9f * kAmplitude);
+    }
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <new>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <private/media/AudioTrackShared.h>
+
+/* Benchmark of the client wakeups of normal tracks.
+ *
+ * Each client thread writes to its own track with blocking obtainBuffer() calls, as an
+ * AudioTrack does.  The server thread plays the normal mixer: each cycle it releases a
+ * period of every track in chunks, as the resamplers pull them, then sleeps for the period
+ * as if writing to the HAL.  This is run with immediate wakeups, then with the wakeups
+ * deferred and issued after each cycle (see ServerProxy::setDeferWake()), and the context
+ * switches of the process per second are compared.
+ */
+
+using namespace android;
+
+struct Options {
+    int         mTracks;
+    size_t      mPeriodFrames;      // normal mixer period
+    size_t      mChunkFrames;       // frames released by each releaseBuffer()
+    size_t      mTrackFrames;       // track buffer
+    size_t      mNotificationFrames; // minimum free frames to wake the client
+    uint32_t    mSampleRate;
+    int         mSeconds;           // of each run
+    int64_t     mMinIntervalNs;
+};
+
+struct Track {
+    audio_track_cblk_t*         mCblk;
+    void*                       mBuffers;
+    sp<AudioTrackClientProxy>   mClientProxy;
+    sp<AudioTrackServerProxy>   mServerProxy;
+    pthread_t                   mThread;
+    uint64_t                    mObtains;       // client obtainBuffer() calls that returned data
+};
+
+static const size_t kFrameSize = 2 * sizeof(int16_t);
+
+static volatile bool sStop;
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t contextSwitches() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+static void *clientThread(void *arg) {
+    Track *track = (Track *) arg;
+    while (!sStop) {
+        Proxy::Buffer buffer;
+        buffer.mFrameCount = track->mClientProxy->getMisalignment() + 1024;
+        status_t status = track->mClientProxy->obtainBuffer(&buffer, &ClientProxy::kForever);
+        if (status != NO_ERROR) {
+            continue;   // interrupted, or spurious wakeup
+        }
+        memset(buffer.mRaw, 0, buffer.mFrameCount * kFrameSize);
+        track->mClientProxy->releaseBuffer(&buffer);
+        track->mObtains++;
+    }
+    return NULL;
+}
+
+static void run(const Options& options, bool defer) {
+    Track *tracks = new Track[options.mTracks];
+    // as for a Track, the streaming buffer is rounded up to a power of 2
+    const size_t size = sizeof(audio_track_cblk_t) + roundup(options.mTrackFrames) * kFrameSize;
+    for (int i = 0; i < options.mTracks; i++) {
+        Track& track = tracks[i];
+        void *memory = calloc(1, size);
+        track.mCblk = new (memory) audio_track_cblk_t();
+        track.mBuffers = (char *) memory + sizeof(audio_track_cblk_t);
+        track.mClientProxy = new AudioTrackClientProxy(track.mCblk, track.mBuffers,
+                options.mTrackFrames, kFrameSize, true /*clientInServer*/);
+        track.mClientProxy->setMinimum(options.mNotificationFrames);
+        track.mServerProxy = new AudioTrackServerProxy(track.mCblk, track.mBuffers,
+                options.mTrackFrames, kFrameSize, true /*clientInServer*/, options.mSampleRate);
+        track.mServerProxy->setDeferWake(defer, options.mMinIntervalNs);
+        track.mObtains = 0;
+    }
+    sStop = false;
+    for (int i = 0; i < options.mTracks; i++) {
+        pthread_create(&tracks[i].mThread, NULL, clientThread, &tracks[i]);
+    }
+    usleep(100000);     // let the clients fill their buffers
+
+    const int64_t periodNs = (int64_t) options.mPeriodFrames * 1000000000 / options.mSampleRate;
+    const int64_t startNs = nowNs();
+    const int64_t startSwitches = contextSwitches();
+    uint64_t startObtains = 0;
+    for (int i = 0; i < options.mTracks; i++) {
+        startObtains += tracks[i].mObtains;
+    }
+    uint64_t underruns = 0;
+    int64_t cycleNs = startNs;
+    while (nowNs() - startNs < options.mSeconds * 1000000000LL) {
+        for (int i = 0; i < options.mTracks; i++) {
+            size_t frames = options.mPeriodFrames;
+            while (frames > 0) {
+                Proxy::Buffer buffer;
+                buffer.mFrameCount = frames < options.mChunkFrames ? frames : options.mChunkFrames;
+                if (tracks[i].mServerProxy->obtainBuffer(&buffer) != NO_ERROR) {
+                    underruns++;
+                    break;
+                }
+                frames -= buffer.mFrameCount;
+                tracks[i].mServerProxy->releaseBuffer(&buffer);
+            }
+        }
+        // the HAL write
+        cycleNs += periodNs;
+        const int64_t sleepNs = cycleNs - nowNs();
+        if (sleepNs > 0) {
+            usleep(sleepNs / 1000);
+        }
+        if (defer) {
+            const int64_t now = nowNs();
+            for (int i = 0; i < options.mTracks; i++) {
+                tracks[i].mServerProxy->flushWake(now);
+            }
+        }
+    }
+    const double seconds = (nowNs() - startNs) * 1e-9;
+    const int64_t switches = contextSwitches() - startSwitches;
+
+    sStop = true;
+    uint64_t obtains = 0;
+    uint64_t wakes = 0;
+    uint64_t coalesced = 0;
+    for (int i = 0; i < options.mTracks; i++) {
+        tracks[i].mClientProxy->interrupt();
+        pthread_join(tracks[i].mThread, NULL);
+        obtains += tracks[i].mObtains;
+        wakes += tracks[i].mServerProxy->getWakeCount();
+        coalesced += tracks[i].mServerProxy->getCoalescedWakeCount();
+    }
+    printf("%-9s %10.0f %10.0f %10.0f %10" PRIu64 " %10" PRIu64 "\n",
+            defer ? "batched" : "immediate", switches / seconds, wakes / seconds,
+            (obtains - startObtains) / seconds, coalesced, underruns);
+
+    for (int i = 0; i < options.mTracks; i++) {
+        tracks[i].mClientProxy.clear();
+        tracks[i].mServerProxy.clear();
+        free(tracks[i].mCblk);
+    }
+    delete[] tracks;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-t tracks] [-p period] [-c chunk] [-b buffer] [-r rate] "
+            "[-n notification] [-s seconds] [-i interval]\n", name);
+    fprintf(stderr, "    -t    number of tracks (default 16)\n");
+    fprintf(stderr, "    -p    normal mixer period in frames (default 960)\n");
+    fprintf(stderr, "    -c    frames released by each releaseBuffer() (default 256)\n");
+    fprintf(stderr, "    -b    track buffer in frames (default 4 periods)\n");
+    fprintf(stderr, "    -n    client notification frames (default half the buffer)\n");
+    fprintf(stderr, "    -r    sample rate (default 48000)\n");
+    fprintf(stderr, "    -s    duration of each run in seconds (default 5)\n");
+    fprintf(stderr, "    -i    minimum wakeup interval of batched wakeups in ms (default 0)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *const progname = argv[0];
+    Options options;
+    options.mTracks = 16;
+    options.mPeriodFrames = 960;
+    options.mChunkFrames = 256;
+    options.mTrackFrames = 0;
+    options.mNotificationFrames = 0;
+    options.mSampleRate = 48000;
+    options.mSeconds = 5;
+    options.mMinIntervalNs = 0;
+
+    for (int ch; (ch = getopt(argc, argv, "t:p:c:b:n:r:s:i:")) != -1;) {
+        switch (ch) {
+        case 't':
+            options.mTracks = atoi(optarg);
+            break;
+        case 'p':
+            options.mPeriodFrames = atoi(optarg);
+            break;
+        case 'c':
+            options.mChunkFrames = atoi(optarg);
+            break;
+        case 'b':
+            options.mTrackFrames = atoi(optarg);
+            break;
+        case 'n':
+            options.mNotificationFrames = atoi(optarg);
+            break;
+        case 'r':
+            options.mSampleRate = atoi(optarg);
+            break;
+        case 's':
+            options.mSeconds = atoi(optarg);
+            break;
+        case 'i':
+            options.mMinIntervalNs = atoi(optarg) * 1000000LL;
+            break;
+        case '?':
+        default:
+            usage(progname);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.mTrackFrames == 0) {
+        options.mTrackFrames = options.mPeriodFrames * 4;
+    }
+    if (options.mNotificationFrames == 0) {
+        // as an AudioTrack with the default notification period
+        options.mNotificationFrames = options.mTrackFrames / 2;
+    }
+    if (options.mTracks <= 0 || options.mPeriodFrames == 0 || options.mChunkFrames == 0 ||
+            options.mSampleRate == 0 || options.mSeconds <= 0) {
+        usage(progname);
+        return EXIT_FAILURE;
+    }
+
+    printf("%d tracks of %zu frames notified every %zu frames, period %zu frames released "
+            "in chunks of %zu\n", options.mTracks, options.mTrackFrames,
+            options.mNotificationFrames, options.mPeriodFrames, options.mChunkFrames);
+    printf("%-9s %10s %10s %10s %10s %10s\n", "wakeups", "switches/s", "futex/s", "writes/s",
+            "coalesced", "underruns");
+    run(options, false /*defer*/);
+    run(options, true /*defer*/);
+    return EXIT_SUCCESS;
+}
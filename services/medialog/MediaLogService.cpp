@@ -54,7 +54,7 @@ void MediaLogService::unregisterWriter(const sp<IMemory>& shared)
     }
 }
 
-status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
+status_t MediaLogService::dump(int fd, const Vector<String16>& args)
 {
     // FIXME merge with similar but not identical code at services/audioflinger/ServiceUtilities.cpp
     static const String16 sDump("android.permission.DUMP");
@@ -71,6 +71,23 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
         Mutex::Autolock _l(mLock);
         namedReaders = mNamedReaders;
     }
+
+    // "--raw" dumps the logs in binary, for decoding by the nblog-decode host tool
+    bool raw = false;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == String16("--raw")) {
+            raw = true;
+        }
+    }
+    if (raw) {
+        if (fd >= 0) {
+            for (size_t i = 0; i < namedReaders.size(); i++) {
+                namedReaders[i].reader()->dumpRaw(fd, namedReaders[i].name());
+            }
+        }
+        return NO_ERROR;
+    }
+
     for (size_t i = 0; i < namedReaders.size(); i++) {
         const NamedReader& namedReader = namedReaders[i];
         if (fd >= 0) {